@@ -0,0 +1,119 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "aligned-buffer-pool.h"
+
+#include <atomic>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace libz {
+
+bool IsAligned(const AlignedBuffer& buffer) {
+  return reinterpret_cast<std::uintptr_t>(buffer.data()) %
+             AlignedBufferPool::kAlignment ==
+         0;
+}
+
+CATCH_TEST_CASE("size classes", "[aligned-buffer-pool]") {
+  CATCH_REQUIRE(AlignedBufferPool::SizeClassOf(0) == 0);
+  CATCH_REQUIRE(AlignedBufferPool::SizeClassOf(4096) == 0);
+  CATCH_REQUIRE(AlignedBufferPool::SizeClassOf(4097) == 1);
+  CATCH_REQUIRE(AlignedBufferPool::SizeClassOf(AlignedBufferPool::kMaxSize) ==
+                AlignedBufferPool::kNumClasses - 1);
+  CATCH_REQUIRE(AlignedBufferPool::SizeClassOf(AlignedBufferPool::kMaxSize +
+                                               1) == -1);
+
+  auto buffer = AlignedBuffer::Make(5000);
+  CATCH_REQUIRE(buffer);
+  CATCH_REQUIRE(IsAligned(buffer));
+  CATCH_REQUIRE(buffer.size() == 5000);
+  CATCH_REQUIRE(buffer.capacity() == 8192);
+
+  // the size is adjusted without touching the content
+  std::memset(buffer.data(), 'x', buffer.capacity());
+  buffer.Resize(100);
+  buffer.Resize(8192);
+  CATCH_REQUIRE(buffer.data()[8191] == 'x');
+
+  // the huge one isn't pooled
+  auto huge = AlignedBuffer::Make(AlignedBufferPool::kMaxSize + 1);
+  CATCH_REQUIRE(IsAligned(huge));
+  CATCH_REQUIRE(huge.capacity() ==
+                AlignedBufferPool::kMaxSize + AlignedBufferPool::kAlignment);
+  huge.data()[huge.size() - 1] = 'x';
+}
+
+CATCH_TEST_CASE("reuse", "[aligned-buffer-pool]") {
+  auto pool = AlignedBufferPool::Default();
+
+  auto data = AlignedBuffer::Make(1 << 20).data();
+  auto before = pool->stats();
+
+  // the released one is borrowed again from the thread cache
+  for (int i = 0; i < 100; ++i) {
+    auto buffer = pool->Acquire(1 << 20);
+    CATCH_REQUIRE(buffer.data() == data);
+  }
+
+  auto after = pool->stats();
+  CATCH_REQUIRE(after.hits - before.hits == 100);
+  CATCH_REQUIRE(after.misses == before.misses);
+  CATCH_REQUIRE(after.pooled_bytes == before.pooled_bytes);
+
+  // the moved one is released once
+  auto a = pool->Acquire(4096);
+  auto b = std::move(a);
+  CATCH_REQUIRE(!a);
+  a = std::move(b);
+  CATCH_REQUIRE(a.data());
+}
+
+CATCH_TEST_CASE("threads", "[aligned-buffer-pool]") {
+  auto pool = AlignedBufferPool::Default();
+  auto before = pool->stats();
+
+  // the buffers are released by the other threads, and the caches of the
+  // exited threads are flushed
+  constexpr int kNum = 1000;
+  std::vector<AlignedBuffer> buffers;
+  for (int i = 0; i < kNum; ++i) {
+    buffers.push_back(pool->Acquire(64 << 10));
+  }
+
+  std::atomic<int> misaligned{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = t; i < kNum; i += 4) {
+        buffers[i].Release();
+      }
+
+      for (int i = 0; i < kNum; ++i) {
+        auto buffer = pool->Acquire(64 << 10);
+        if (!IsAligned(buffer)) {
+          ++misaligned;
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  CATCH_REQUIRE(misaligned == 0);
+
+  auto after = pool->stats();
+  CATCH_REQUIRE(after.hits + after.misses - before.hits - before.misses ==
+                5 * kNum);
+
+  // the released ones are enough for all, no more than a slab is allocated
+  // by each thread
+  CATCH_REQUIRE(after.misses - before.misses <= kNum / 16 + 1 + 4);
+}
+
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
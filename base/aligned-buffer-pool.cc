@@ -0,0 +1,292 @@
+#include "aligned-buffer-pool.h"
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "check.h"
+
+namespace libz {
+
+namespace {
+
+constexpr std::size_t kBitsPerLong = 8 * sizeof(unsigned long);
+
+std::size_t RoundUp(std::size_t size) {
+  auto align = AlignedBufferPool::kAlignment;
+  return (size + align - 1) / align * align;
+}
+
+// the count of the possible numa nodes, like "0-3"
+int PossibleNodes() {
+  std::ifstream in("/sys/devices/system/node/possible");
+  std::string range;
+  if (!(in >> range)) {
+    return 1;
+  }
+
+  auto pos = range.find_last_of("-,");
+  pos = pos == std::string::npos ? 0 : pos + 1;
+  return std::max(std::atoi(range.c_str() + pos) + 1, 1);
+}
+
+int CurrentNode(int nodes) {
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return 0;
+  }
+  return static_cast<int>(node) < nodes ? static_cast<int>(node) : 0;
+}
+
+char* Map(std::size_t len) {
+  auto ptr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char*>(ptr);
+}
+
+// prefer the pages of the node, it's only a hint, and the failure is ignored
+void BindToNode(char* ptr, std::size_t len, int node) {
+  std::vector<unsigned long> mask(node / kBitsPerLong + 1);
+  mask[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong);
+  ::syscall(SYS_mbind, ptr, len, MPOL_PREFERRED, mask.data(),
+            mask.size() * kBitsPerLong, 0);
+}
+
+// the counters are written by the owner thread only, so that there is no
+// contended read-modify-write
+void Count(std::atomic<std::uint64_t>* counter) {
+  counter->store(counter->load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+}
+
+}  // namespace
+
+struct AlignedBufferPool::ThreadCache {
+  explicit ThreadCache(int node) : node(node) {}
+
+  int node;
+  std::vector<char*> free[kNumClasses];
+
+  std::atomic<std::uint64_t> hits{0};
+  std::atomic<std::uint64_t> misses{0};
+};
+
+thread_local AlignedBufferPool::ThreadCache* AlignedBufferPool::tls_cache_ =
+    nullptr;
+thread_local bool AlignedBufferPool::tls_exited_ = false;
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other) noexcept
+    : data_(other.data_),
+      size_(other.size_),
+      capacity_(other.capacity_),
+      size_class_(other.size_class_),
+      node_(other.node_) {
+  other.data_ = nullptr;
+  other.size_ = other.capacity_ = 0;
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) noexcept {
+  if (this != &other) {
+    Release();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_class_, other.size_class_);
+    std::swap(node_, other.node_);
+  }
+  return *this;
+}
+
+AlignedBuffer AlignedBuffer::Make(std::size_t size) {
+  return AlignedBufferPool::Default()->Acquire(size);
+}
+
+void AlignedBuffer::Release() {
+  if (data_) {
+    AlignedBufferPool::Default()->Release(this);
+  }
+
+  data_ = nullptr;
+  size_ = capacity_ = 0;
+}
+
+void AlignedBuffer::Resize(std::size_t size) {
+  DCHECK(size <= capacity_);
+  size_ = size;
+}
+
+AlignedBufferPool* AlignedBufferPool::Default() {
+  static auto pool = new AlignedBufferPool();
+  return pool;
+}
+
+AlignedBufferPool::AlignedBufferPool()
+    : nodes_(), pooled_bytes_(0), caches_mutex_(), caches_(), retired_() {
+  auto n = PossibleNodes();
+  for (int i = 0; i < n; ++i) {
+    nodes_.push_back(std::make_unique<Node>());
+  }
+}
+
+int AlignedBufferPool::SizeClassOf(std::size_t size) {
+  if (size > kMaxSize) {
+    return -1;
+  }
+
+  int size_class = 0;
+  while (SizeOf(size_class) < size) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+AlignedBuffer AlignedBufferPool::Acquire(std::size_t size) {
+  auto size_class = SizeClassOf(size);
+  auto cache = size_class < 0 ? nullptr : LocalCache();
+
+  // the huge one, or the one on an exiting thread isn't pooled
+  if (!cache) {
+    auto capacity = RoundUp(std::max<std::size_t>(size, 1));
+    std::lock_guard<std::mutex> guard(caches_mutex_);
+    ++retired_.misses;
+    return AlignedBuffer(Map(capacity), size, capacity, -1, 0);
+  }
+
+  auto& free = cache->free[size_class];
+  if (free.empty() && !Refill(cache, size_class)) {
+    Count(&cache->misses);
+    auto data = Allocate(cache, size_class);
+    return AlignedBuffer(data, size, SizeOf(size_class), size_class,
+                         cache->node);
+  }
+
+  Count(&cache->hits);
+  auto data = free.back();
+  free.pop_back();
+  return AlignedBuffer(data, size, SizeOf(size_class), size_class,
+                       cache->node);
+}
+
+AlignedBufferPool::Stats AlignedBufferPool::stats() const {
+  std::lock_guard<std::mutex> guard(caches_mutex_);
+
+  auto stats = retired_;
+  for (auto cache : caches_) {
+    stats.hits += cache->hits.load(std::memory_order_relaxed);
+    stats.misses += cache->misses.load(std::memory_order_relaxed);
+  }
+  stats.pooled_bytes = pooled_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+AlignedBufferPool::ThreadCache* AlignedBufferPool::LocalCache() {
+  if (tls_cache_ || tls_exited_) {
+    return tls_cache_;
+  }
+
+  // the cache is retired on the thread exit
+  struct Retirer {
+    ~Retirer() {
+      Default()->Retire(tls_cache_);
+      delete tls_cache_;
+      tls_cache_ = nullptr;
+      tls_exited_ = true;
+    }
+  };
+  static thread_local Retirer retirer;
+
+  tls_cache_ = new ThreadCache(CurrentNode(nodes()));
+  std::lock_guard<std::mutex> guard(caches_mutex_);
+  caches_.push_back(tls_cache_);
+  return tls_cache_;
+}
+
+void AlignedBufferPool::Release(AlignedBuffer* buffer) {
+  if (buffer->size_class_ < 0) {
+    ::munmap(buffer->data_, buffer->capacity_);
+    return;
+  }
+
+  auto cache = LocalCache();
+  if (!cache || cache->node != buffer->node_) {
+    auto& node = *nodes_[buffer->node_];
+    std::lock_guard<std::mutex> guard(node.mutex);
+    node.free[buffer->size_class_].push_back(buffer->data_);
+    return;
+  }
+
+  auto& free = cache->free[buffer->size_class_];
+  free.push_back(buffer->data_);
+  if (free.size() > kCacheSize) {
+    Flush(cache, buffer->size_class_, kCacheSize / 2);
+  }
+}
+
+bool AlignedBufferPool::Refill(ThreadCache* cache, int size_class) {
+  auto& node = *nodes_[cache->node];
+  auto& free = cache->free[size_class];
+
+  std::lock_guard<std::mutex> guard(node.mutex);
+  auto& shared = node.free[size_class];
+  auto n = std::min(shared.size(), kCacheSize / 2);
+  free.insert(free.end(), shared.end() - n, shared.end());
+  shared.resize(shared.size() - n);
+  return n > 0;
+}
+
+void AlignedBufferPool::Flush(ThreadCache* cache, int size_class,
+                              std::size_t keep) {
+  auto& free = cache->free[size_class];
+  if (free.size() <= keep) {
+    return;
+  }
+
+  auto& node = *nodes_[cache->node];
+  std::lock_guard<std::mutex> guard(node.mutex);
+  node.free[size_class].insert(node.free[size_class].end(),
+                               free.begin() + keep, free.end());
+  free.resize(keep);
+}
+
+char* AlignedBufferPool::Allocate(ThreadCache* cache, int size_class) {
+  auto size = SizeOf(size_class);
+  auto len = std::max(size, kSlabSize);
+
+  auto slab = Map(len);
+  if (nodes() > 1) {
+    BindToNode(slab, len, cache->node);
+  }
+  pooled_bytes_.fetch_add(len, std::memory_order_relaxed);
+
+  // the rest of the slab goes to the cache, and the overflow to the node
+  auto& free = cache->free[size_class];
+  for (auto offset = len - size; offset > 0; offset -= size) {
+    free.push_back(slab + offset);
+  }
+  Flush(cache, size_class, kCacheSize);
+  return slab;
+}
+
+void AlignedBufferPool::Retire(ThreadCache* cache) {
+  for (int i = 0; i < kNumClasses; ++i) {
+    Flush(cache, i, 0);
+  }
+
+  std::lock_guard<std::mutex> guard(caches_mutex_);
+  retired_.hits += cache->hits.load(std::memory_order_relaxed);
+  retired_.misses += cache->misses.load(std::memory_order_relaxed);
+  caches_.erase(std::find(caches_.begin(), caches_.end(), cache));
+}
+
+}  // namespace libz
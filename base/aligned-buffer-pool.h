@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace libz {
+
+class AlignedBufferPool;
+
+// AlignedBuffer is a page aligned buffer for the direct io, borrowed from the
+// pool and returned on destruction. the content isn't initialized, and the
+// size is adjusted within the capacity without touching the memory, unlike
+// the std::string.
+//
+// Notes, the buffer can be released by any thread
+class AlignedBuffer {
+ public:
+  AlignedBuffer() = default;
+  AlignedBuffer(AlignedBuffer&& other) noexcept;
+  AlignedBuffer& operator=(AlignedBuffer&& other) noexcept;
+  ~AlignedBuffer() { Release(); }
+
+  // at least |size| bytes from the default pool
+  static AlignedBuffer Make(std::size_t size);
+
+ public:
+  void Release();
+
+  // |size| must not exceed the capacity
+  void Resize(std::size_t size);
+
+  explicit operator bool() const { return data_ != nullptr; }
+
+  char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  AlignedBuffer(char* data, std::size_t size, std::size_t capacity,
+                int size_class, int node)
+      : data_(data),
+        size_(size),
+        capacity_(capacity),
+        size_class_(size_class),
+        node_(node) {}
+
+  char* data_{nullptr};
+  std::size_t size_{0};
+  std::size_t capacity_{0};
+
+  // it's -1 for the huge one, which is mapped and unmapped directly
+  int size_class_{-1};
+  int node_{0};
+
+  friend AlignedBufferPool;
+  DISALLOW_COPY_AND_ASSIGN(AlignedBuffer);
+};
+
+// AlignedBufferPool keeps the page aligned buffers in the power of two size
+// classes from 4k to kMaxSize. every thread caches a few buffers of each
+// class without any lock, and the rest are kept in the free lists of the numa
+// node, whose memory is bound to the node. the thread borrows from the free
+// lists of the node it first used the pool on, so the buffers stay local to
+// the cpu doing the io as long as the thread is pinned.
+//
+// Notes, the memory is carved from the mapped slabs, and it's never returned
+// to the system, that is, the pool grows to the high water mark. the buffers
+// larger than kMaxSize aren't pooled
+class AlignedBufferPool {
+ public:
+  static constexpr std::size_t kAlignment = 4096;
+  static constexpr int kNumClasses = 11;
+  static constexpr std::size_t kMaxSize = kAlignment << (kNumClasses - 1);
+
+  // the buffers of a size class cached by a thread, the half of them are
+  // moved to the free list of the node if it's full
+  static constexpr std::size_t kCacheSize = 16;
+
+  // the small buffers are carved from a slab of the size
+  static constexpr std::size_t kSlabSize = 1 << 20;
+
+  struct Stats {
+    // borrowed from the thread cache or the free list of the node
+    std::uint64_t hits{0};
+
+    // allocated from the system
+    std::uint64_t misses{0};
+
+    // the bytes allocated from the system, the huge ones excluded
+    std::uint64_t pooled_bytes{0};
+  };
+
+  // the pool of the process, it's never destroyed, so that the buffers can
+  // be released at any time
+  static AlignedBufferPool* Default();
+
+ public:
+  AlignedBuffer Acquire(std::size_t size);
+
+  Stats stats() const;
+  int nodes() const { return static_cast<int>(nodes_.size()); }
+
+  // the size class of |size|, or -1 if it's larger than kMaxSize
+  static int SizeClassOf(std::size_t size);
+  static std::size_t SizeOf(int size_class) { return kAlignment << size_class; }
+
+ private:
+  struct ThreadCache;
+
+  struct Node {
+    std::mutex mutex;
+    std::vector<char*> free[kNumClasses];
+  };
+
+  AlignedBufferPool();
+
+  ThreadCache* LocalCache();
+  void Release(AlignedBuffer* buffer);
+
+  // move the buffers of the node into the cache of the thread, return false
+  // if there is none
+  bool Refill(ThreadCache* cache, int size_class);
+  void Flush(ThreadCache* cache, int size_class, std::size_t keep);
+
+  // allocate a slab on the node, and carve it into the buffers
+  char* Allocate(ThreadCache* cache, int size_class);
+
+  void Retire(ThreadCache* cache);
+
+  // the cache of the thread is a plain pointer, so that the buffers can be
+  // released safely within the destructors of the other thread locals
+  static thread_local ThreadCache* tls_cache_;
+  static thread_local bool tls_exited_;
+
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::atomic<std::uint64_t> pooled_bytes_;
+
+  // the live thread caches, and the counters of the exited threads
+  mutable std::mutex caches_mutex_;
+  std::vector<ThreadCache*> caches_;
+  Stats retired_;
+
+  friend AlignedBuffer;
+  DISALLOW_COPY_MOVE_AND_ASSIGN(AlignedBufferPool);
+};
+
+}  // namespace libz
@@ -0,0 +1,68 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "histogram.h"
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace libz {
+
+CATCH_TEST_CASE("percentiles", "[histogram]") {
+  Histogram h;
+  CATCH_REQUIRE(h.ValueAt(50) == 0);
+
+  for (std::uint64_t i = 1; i <= 1000; ++i) {
+    h.Record(i);
+  }
+
+  // the small values are exact
+  CATCH_REQUIRE(h.count() == 1000);
+  CATCH_REQUIRE(h.min() == 1);
+  CATCH_REQUIRE(h.max() == 1000);
+  CATCH_REQUIRE(h.mean() == 500.5);
+  CATCH_REQUIRE(h.ValueAt(0) == 1);
+  CATCH_REQUIRE(h.ValueAt(50) == 500);
+  CATCH_REQUIRE(h.ValueAt(99) == 990);
+  CATCH_REQUIRE(h.ValueAt(100) == 1000);
+}
+
+CATCH_TEST_CASE("precision", "[histogram]") {
+  for (std::uint64_t value : {2047ul, 2048ul, 4097ul, 123456ul, 987654321ul,
+                              Histogram::kMaxValue}) {
+    Histogram h;
+    h.Record(1);
+    h.Record(value);
+
+    // the equivalent value is within 0.1%
+    auto v = h.ValueAt(100);
+    CATCH_REQUIRE(v == value);
+
+    auto p = h.ValueAt(75);
+    CATCH_REQUIRE(p >= value);
+    CATCH_REQUIRE(p - value <= value / 1000);
+  }
+
+  // clamped
+  Histogram h;
+  h.Record(Histogram::kMaxValue * 2);
+  CATCH_REQUIRE(h.max() == Histogram::kMaxValue);
+}
+
+CATCH_TEST_CASE("merge", "[histogram]") {
+  Histogram a, b;
+  a.Record(10, 99);
+  b.Record(100000);
+
+  a.Merge(b);
+  CATCH_REQUIRE(a.count() == 100);
+  CATCH_REQUIRE(a.ValueAt(99) == 10);
+  CATCH_REQUIRE(a.ValueAt(99.9) == 100000);
+  CATCH_REQUIRE(a.min() == 10);
+
+  a.Reset();
+  CATCH_REQUIRE(a.count() == 0);
+  CATCH_REQUIRE(a.ValueAt(50) == 0);
+}
+
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,101 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace libz {
+
+namespace {
+
+constexpr std::uint64_t kSubBuckets = std::uint64_t{1}
+                                      << Histogram::kSubBucketBits;
+constexpr std::uint64_t kHalfSubBuckets = kSubBuckets / 2;
+
+int Msb(std::uint64_t value) { return 63 - __builtin_clzll(value); }
+
+}  // namespace
+
+// the values in [2^(b + kSubBucketBits - 1), 2^(b + kSubBucketBits)) share
+// the bucket b, which has kHalfSubBuckets slots of width 2^b
+std::size_t Histogram::IndexOf(std::uint64_t value) {
+  if (value < kSubBuckets) {
+    return value;
+  }
+
+  auto shift = Msb(value) - (kSubBucketBits - 1);
+  auto sub = value >> shift;
+  return kSubBuckets + (shift - 1) * kHalfSubBuckets + (sub - kHalfSubBuckets);
+}
+
+std::uint64_t Histogram::HighestOf(std::size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  auto shift = (index - kSubBuckets) / kHalfSubBuckets + 1;
+  auto sub = (index - kSubBuckets) % kHalfSubBuckets + kHalfSubBuckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+Histogram::Histogram()
+    : counts_(IndexOf(kMaxValue) + 1, 0),
+      count_(0),
+      min_(std::numeric_limits<std::uint64_t>::max()),
+      max_(0),
+      sum_(0) {}
+
+void Histogram::Record(std::uint64_t value, std::uint64_t count) {
+  value = std::min(value, kMaxValue);
+  counts_[IndexOf(value)] += count;
+
+  count_ += count;
+  sum_ += value * count;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+void Histogram::Merge(const Histogram& other) {
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void Histogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+  min_ = std::numeric_limits<std::uint64_t>::max();
+  max_ = 0;
+}
+
+std::uint64_t Histogram::ValueAt(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  auto rank = std::max<std::uint64_t>(
+      static_cast<std::uint64_t>(std::ceil(percentile / 100 * count_)), 1);
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(HighestOf(i), max_);
+    }
+  }
+
+  return max_;
+}
+
+double Histogram::mean() const {
+  return count_ ? static_cast<double>(sum_) / count_ : 0;
+}
+
+}  // namespace libz
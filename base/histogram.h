@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "macros.h"
+
+namespace libz {
+
+// Histogram records the values in the log linear buckets like HdrHistogram.
+// the values below 2^kSubBucketBits are exact, and the larger ones are kept
+// with kSubBucketBits - 1 significant bits, that is, the relative error is
+// less than 0.1%. the values larger than kMaxValue are clamped.
+//
+// it's meant for the latency in micro seconds, the memory is fixed, and the
+// histograms of the threads are merged at the end
+class Histogram {
+ public:
+  static constexpr int kSubBucketBits = 11;
+  static constexpr std::uint64_t kMaxValue = (std::uint64_t{1} << 36) - 1;
+
+  Histogram();
+
+ public:
+  void Record(std::uint64_t value, std::uint64_t count = 1);
+  void Merge(const Histogram& other);
+  void Reset();
+
+  // the highest value equivalent to the one at |percentile|, in [0, 100]
+  std::uint64_t ValueAt(double percentile) const;
+
+  std::uint64_t count() const { return count_; }
+  std::uint64_t min() const { return count_ ? min_ : 0; }
+  std::uint64_t max() const { return max_; }
+  double mean() const;
+
+ private:
+  static std::size_t IndexOf(std::uint64_t value);
+  static std::uint64_t HighestOf(std::size_t index);
+
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t count_;
+  std::uint64_t min_;
+  std::uint64_t max_;
+
+  // the sum overflows after 2^28 samples of kMaxValue, it's good enough
+  std::uint64_t sum_;
+};
+
+}  // namespace libz
@@ -0,0 +1,193 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "ring.h"
+
+#include <atomic>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace libz {
+
+constexpr std::uint64_t kNum = 200000;
+
+CATCH_TEST_CASE("spsc", "[ring]") {
+  SpscRing<int> ring(5);
+  CATCH_REQUIRE(ring.capacity() == 8);
+  CATCH_REQUIRE(ring.empty());
+
+  for (int i = 0; i < 8; ++i) {
+    CATCH_REQUIRE(ring.TryPush(i));
+  }
+  CATCH_REQUIRE(!ring.TryPush(8));
+  CATCH_REQUIRE(ring.size() == 8);
+
+  int val = 0;
+  for (int i = 0; i < 8; ++i) {
+    CATCH_REQUIRE(ring.TryPop(&val));
+    CATCH_REQUIRE(val == i);
+  }
+  CATCH_REQUIRE(!ring.TryPop(&val));
+
+  // the batches wrap around the end
+  std::vector<int> items{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  CATCH_REQUIRE(ring.TryPushBatch(items.data(), 3) == 3);
+  CATCH_REQUIRE(ring.TryPushBatch(items.data() + 3, 7) == 5);
+
+  std::vector<int> out(10);
+  CATCH_REQUIRE(ring.TryPopBatch(out.data(), 6) == 6);
+  CATCH_REQUIRE(ring.TryPopBatch(out.data() + 6, 6) == 2);
+  for (int i = 0; i < 8; ++i) {
+    CATCH_REQUIRE(out[i] == i);
+  }
+  CATCH_REQUIRE(ring.TryPopBatch(out.data(), 6) == 0);
+}
+
+CATCH_TEST_CASE("the elements left are destroyed", "[ring]") {
+  auto val = std::make_shared<int>(1);
+  {
+    SpscRing<std::shared_ptr<int>> spsc(4);
+    MpmcRing<std::shared_ptr<int>> mpmc(4);
+    for (int i = 0; i < 3; ++i) {
+      CATCH_REQUIRE(spsc.TryPush(val));
+      CATCH_REQUIRE(mpmc.TryPush(val));
+    }
+
+    std::shared_ptr<int> out;
+    CATCH_REQUIRE(mpmc.TryPop(&out));
+    out.reset();
+    CATCH_REQUIRE(val.use_count() == 6);
+  }
+  CATCH_REQUIRE(val.use_count() == 1);
+}
+
+CATCH_TEST_CASE("spsc stress", "[ring]") {
+  SpscRing<std::uint64_t> ring(64);
+
+  // the producer mixes the single and the batch pushes
+  std::thread producer([&]() {
+    std::uint64_t batch[16];
+    std::uint64_t i = 0;
+    while (i < kNum) {
+      if (i % 3 == 0) {
+        ring.Push(i++);
+        continue;
+      }
+
+      std::size_t n = 0;
+      for (; n < 16 && i < kNum; ++n) {
+        batch[n] = i++;
+      }
+      ring.PushBatch(batch, n);
+    }
+  });
+
+  std::uint64_t expected = 0;
+  std::uint64_t batch[8];
+  while (expected < kNum) {
+    auto n = ring.PopBatch(batch, expected % 2 == 0 ? 8 : 1);
+    for (std::size_t i = 0; i < n; ++i) {
+      CATCH_REQUIRE(batch[i] == expected++);
+    }
+  }
+  producer.join();
+  CATCH_REQUIRE(ring.empty());
+}
+
+CATCH_TEST_CASE("mpmc", "[ring]") {
+  MpmcRing<int> ring(3);
+  CATCH_REQUIRE(ring.capacity() == 4);
+
+  for (int i = 0; i < 4; ++i) {
+    CATCH_REQUIRE(ring.TryPush(i));
+  }
+  CATCH_REQUIRE(!ring.TryPush(4));
+
+  int val = 0;
+  CATCH_REQUIRE(ring.TryPop(&val));
+  CATCH_REQUIRE(val == 0);
+
+  std::vector<int> items{4, 5, 6};
+  CATCH_REQUIRE(ring.TryPushBatch(items.data(), 3) == 1);
+
+  std::vector<int> out(8);
+  CATCH_REQUIRE(ring.TryPopBatch(out.data(), 8) == 4);
+  for (int i = 0; i < 4; ++i) {
+    CATCH_REQUIRE(out[i] == i + 1);
+  }
+  CATCH_REQUIRE(!ring.TryPop(&val));
+  CATCH_REQUIRE(ring.TryPopBatch(out.data(), 8) == 0);
+}
+
+// the messages of a producer are popped in order by every consumer
+CATCH_TEST_CASE("mpmc stress", "[ring]") {
+  constexpr int kProducers = 4;
+  constexpr int kConsumers = 4;
+  constexpr std::uint64_t kEach = kNum / kProducers;
+  MpmcRing<std::uint64_t> ring(128);
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < kProducers; ++p) {
+    threads.emplace_back([&ring, p]() {
+      std::uint64_t batch[8];
+      std::uint64_t i = 0;
+      while (i < kEach) {
+        if (p % 2 == 0) {
+          ring.Push((std::uint64_t(p) << 32) | i++);
+          continue;
+        }
+
+        std::size_t n = 0;
+        for (; n < 8 && i < kEach; ++n) {
+          batch[n] = (std::uint64_t(p) << 32) | i++;
+        }
+        ring.PushBatch(batch, n);
+      }
+    });
+  }
+
+  std::atomic<std::uint64_t> popped{0};
+  std::vector<std::uint64_t> sums(kConsumers, 0);
+  std::vector<char> ordered(kConsumers, 1);
+  for (int c = 0; c < kConsumers; ++c) {
+    threads.emplace_back([&, c]() {
+      std::vector<std::int64_t> last(kProducers, -1);
+      std::uint64_t batch[8];
+      while (popped.load() < kNum) {
+        auto n = ring.TryPopBatch(batch, c % 2 == 0 ? 8 : 1);
+        for (std::size_t i = 0; i < n; ++i) {
+          auto p = batch[i] >> 32;
+          auto seq = static_cast<std::int64_t>(batch[i] & 0xffffffff);
+          if (seq <= last[p]) {
+            ordered[c] = 0;
+          }
+          last[p] = seq;
+          sums[c] += seq;
+        }
+        popped += n;
+        if (n == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::uint64_t sum = 0;
+  for (int c = 0; c < kConsumers; ++c) {
+    CATCH_REQUIRE(ordered[c]);
+    sum += sums[c];
+  }
+  CATCH_REQUIRE(popped.load() == kNum);
+  CATCH_REQUIRE(sum == kProducers * (kEach * (kEach - 1) / 2));
+  CATCH_REQUIRE(ring.empty());
+}
+
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,453 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "macros.h"
+
+namespace libz {
+
+// the indices written by the different threads are kept on the different
+// cache lines, so that they don't bounce between the cores
+constexpr std::size_t kCacheLineSize = 64;
+
+namespace _ {
+
+// the capacity of a ring is rounded up to the power of two, so that the
+// slot of an index is taken by the mask
+inline std::size_t RingCapacity(std::size_t capacity) {
+  std::size_t n = 2;
+  while (n < capacity) {
+    n <<= 1;
+  }
+  return n;
+}
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// the blocking variants spin for a while, and then yield the cpu, the rings
+// are meant for the threads which are busy, rather than the sleeping ones
+class RingBackoff {
+ public:
+  void Pause() {
+    if (spins_ < kSpins) {
+      ++spins_;
+      CpuRelax();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  static constexpr int kSpins = 64;
+  int spins_{0};
+};
+
+// the uninitialized storage of an element
+template <typename T>
+struct RingStorage {
+  template <typename... Args>
+  void Construct(Args&&... args) {
+    new (data) T(std::forward<Args>(args)...);
+  }
+
+  T* Get() { return std::launder(reinterpret_cast<T*>(data)); }
+
+  // move the element out, and destroy it
+  T Take() {
+    T* p = Get();
+    T val(std::move(*p));
+    p->~T();
+    return val;
+  }
+
+  void Destroy() { Get()->~T(); }
+
+  alignas(T) unsigned char data[sizeof(T)];
+};
+
+}  // namespace _
+
+// SpscRing is a bounded lock free queue of a producer thread and a consumer
+// thread. every side caches the index of the other one, which is reloaded
+// only if the ring seems full or empty, so the indices are rarely shared.
+// the batch variants move the elements with a single release of the index.
+//
+// the Try* ones return at once, while the blocking ones spin and yield till
+// they're done.
+//
+// Notes, Push* must be invoked by the same thread, and so do Pop*. the
+// capacity is rounded up to the power of two
+template <typename T>
+class SpscRing {
+ public:
+  explicit SpscRing(std::size_t capacity)
+      : mask_(_::RingCapacity(capacity) - 1),
+        slots_(new _::RingStorage<T>[mask_ + 1]) {}
+
+  ~SpscRing() {
+    auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_relaxed);
+    for (; head != tail; ++head) {
+      slots_[head & mask_].Destroy();
+    }
+  }
+
+ public:
+  template <typename... Args>
+  bool TryPush(Args&&... args) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) {
+        return false;
+      }
+    }
+
+    slots_[tail & mask_].Construct(std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T* out) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+
+    *out = slots_[head & mask_].Take();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // move the leading elements of |items| till the ring is full, return the
+  // number moved
+  std::size_t TryPushBatch(T* items, std::size_t n) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (capacity() - (tail - cached_head_) < n) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+    }
+
+    n = std::min(n, capacity() - (tail - cached_head_));
+    for (std::size_t i = 0; i < n; ++i) {
+      slots_[(tail + i) & mask_].Construct(std::move(items[i]));
+    }
+    if (n > 0) {
+      tail_.store(tail + n, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // pop at most |n| elements into |out|, return the number popped
+  std::size_t TryPopBatch(T* out, std::size_t n) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (cached_tail_ - head < n) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+    }
+
+    n = std::min(n, cached_tail_ - head);
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i] = slots_[(head + i) & mask_].Take();
+    }
+    if (n > 0) {
+      head_.store(head + n, std::memory_order_release);
+    }
+    return n;
+  }
+
+  template <typename U>
+  void Push(U&& val) {
+    _::RingBackoff backoff;
+    while (!TryPush(std::forward<U>(val))) {
+      backoff.Pause();
+    }
+  }
+
+  void Pop(T* out) {
+    _::RingBackoff backoff;
+    while (!TryPop(out)) {
+      backoff.Pause();
+    }
+  }
+
+  // all the |n| elements are moved
+  void PushBatch(T* items, std::size_t n) {
+    _::RingBackoff backoff;
+    while (n > 0) {
+      auto pushed = TryPushBatch(items, n);
+      if (pushed == 0) {
+        backoff.Pause();
+      }
+      items += pushed;
+      n -= pushed;
+    }
+  }
+
+  // wait for an element at least, return the number popped
+  std::size_t PopBatch(T* out, std::size_t n) {
+    _::RingBackoff backoff;
+    while (true) {
+      auto popped = TryPopBatch(out, n);
+      if (popped > 0 || n == 0) {
+        return popped;
+      }
+      backoff.Pause();
+    }
+  }
+
+  // it's approximate if the other side is running
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  std::size_t capacity() const { return mask_ + 1; }
+
+ private:
+  const std::size_t mask_;
+  const std::unique_ptr<_::RingStorage<T>[]> slots_;
+
+  // the line of the producer
+  alignas(kCacheLineSize) std::atomic<std::size_t> tail_{0};
+  std::size_t cached_head_{0};
+
+  // the line of the consumer
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_{0};
+  std::size_t cached_tail_{0};
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(SpscRing);
+};
+
+// MpmcRing is a bounded lock free queue of the producers and the consumers
+// by Dmitry Vyukov. every cell carries a sequence, which tells the lap it's
+// ready for the producer or the consumer, so that a thread claims a cell by
+// a CAS on the index, and the others don't wait for its copy. the batch
+// variants claim the ready cells following the index by a single CAS.
+//
+// Notes, the cells are padded to the cache line, so that the neighbours
+// written by the different threads don't share the line, that is, a small
+// element takes a line. the capacity is rounded up to the power of two
+template <typename T>
+class MpmcRing {
+ public:
+  explicit MpmcRing(std::size_t capacity)
+      : mask_(_::RingCapacity(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpmcRing() {
+    auto head = dequeue_pos_.load(std::memory_order_relaxed);
+    auto tail = enqueue_pos_.load(std::memory_order_relaxed);
+    for (; head != tail; ++head) {
+      cells_[head & mask_].storage.Destroy();
+    }
+  }
+
+ public:
+  template <typename... Args>
+  bool TryPush(Args&&... args) {
+    Cell* cell = nullptr;
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      auto seq = cell->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq - pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->storage.Construct(std::forward<Args>(args)...);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T* out) {
+    Cell* cell = nullptr;
+    auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos & mask_];
+      auto seq = cell->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    *out = cell->storage.Take();
+    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // move the leading elements of |items| into the free cells, return the
+  // number moved
+  std::size_t TryPushBatch(T* items, std::size_t n) {
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    std::size_t k = 0;
+    while (true) {
+      // the free cells of the lap following the index
+      k = Ready(pos, 0, n);
+      if (k == 0) {
+        if (Lagged(pos, 0)) {
+          pos = enqueue_pos_.load(std::memory_order_relaxed);
+          continue;
+        }
+        return 0;
+      }
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + k,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    for (std::size_t i = 0; i < k; ++i) {
+      auto& cell = cells_[(pos + i) & mask_];
+      cell.storage.Construct(std::move(items[i]));
+      cell.seq.store(pos + i + 1, std::memory_order_release);
+    }
+    return k;
+  }
+
+  // pop at most |n| elements into |out|, return the number popped
+  std::size_t TryPopBatch(T* out, std::size_t n) {
+    auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    std::size_t k = 0;
+    while (true) {
+      k = Ready(pos, 1, n);
+      if (k == 0) {
+        if (Lagged(pos, 1)) {
+          pos = dequeue_pos_.load(std::memory_order_relaxed);
+          continue;
+        }
+        return 0;
+      }
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + k,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    for (std::size_t i = 0; i < k; ++i) {
+      auto& cell = cells_[(pos + i) & mask_];
+      out[i] = cell.storage.Take();
+      cell.seq.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+    return k;
+  }
+
+  template <typename U>
+  void Push(U&& val) {
+    _::RingBackoff backoff;
+    while (!TryPush(std::forward<U>(val))) {
+      backoff.Pause();
+    }
+  }
+
+  void Pop(T* out) {
+    _::RingBackoff backoff;
+    while (!TryPop(out)) {
+      backoff.Pause();
+    }
+  }
+
+  // all the |n| elements are moved
+  void PushBatch(T* items, std::size_t n) {
+    _::RingBackoff backoff;
+    while (n > 0) {
+      auto pushed = TryPushBatch(items, n);
+      if (pushed == 0) {
+        backoff.Pause();
+      }
+      items += pushed;
+      n -= pushed;
+    }
+  }
+
+  // wait for an element at least, return the number popped
+  std::size_t PopBatch(T* out, std::size_t n) {
+    _::RingBackoff backoff;
+    while (true) {
+      auto popped = TryPopBatch(out, n);
+      if (popped > 0 || n == 0) {
+        return popped;
+      }
+      backoff.Pause();
+    }
+  }
+
+  // it's approximate if the others are running
+  std::size_t size() const {
+    auto tail = enqueue_pos_.load(std::memory_order_acquire);
+    auto head = dequeue_pos_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+  bool empty() const { return size() == 0; }
+  std::size_t capacity() const { return mask_ + 1; }
+
+ private:
+  struct alignas(kCacheLineSize) Cell {
+    std::atomic<std::size_t> seq;
+    _::RingStorage<T> storage;
+  };
+
+  // the cells from |pos| whose sequence is ready, at most |n|, the offset is
+  // 0 for the producers, and 1 for the consumers
+  std::size_t Ready(std::size_t pos, std::size_t offset, std::size_t n) {
+    std::size_t k = 0;
+    for (; k < n && k <= mask_; ++k) {
+      auto seq = cells_[(pos + k) & mask_].seq.load(std::memory_order_acquire);
+      if (seq != pos + k + offset) {
+        break;
+      }
+    }
+    return k;
+  }
+
+  // the cell of |pos| is taken by the others, that is, |pos| is stale
+  bool Lagged(std::size_t pos, std::size_t offset) {
+    auto seq = cells_[pos & mask_].seq.load(std::memory_order_acquire);
+    return static_cast<std::intptr_t>(seq - (pos + offset)) > 0;
+  }
+
+  const std::size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+
+  alignas(kCacheLineSize) std::atomic<std::size_t> enqueue_pos_{0};
+  alignas(kCacheLineSize) std::atomic<std::size_t> dequeue_pos_{0};
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(MpmcRing);
+};
+
+}  // namespace libz
@@ -2,6 +2,8 @@ set (BASE_SRC_PREFIX ${CMAKE_SOURCE_DIR}/base)
 set (BASE_SRC 
   ${BASE_SRC_PREFIX}/timer-wheel.cc
   ${BASE_SRC_PREFIX}/error.cc
+  ${BASE_SRC_PREFIX}/histogram.cc
+  ${BASE_SRC_PREFIX}/aligned-buffer-pool.cc
 )
 
 if(BUILD_TESTS)
@@ -9,4 +11,7 @@ if(BUILD_TESTS)
 
   add_tc(NAME "${BASE_SRC_PREFIX}/error-test.cc" LIBS ${ld_libs})
   add_tc(NAME "${BASE_SRC_PREFIX}/result-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${BASE_SRC_PREFIX}/histogram-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${BASE_SRC_PREFIX}/aligned-buffer-pool-test.cc" LIBS ${ld_libs} pthread)
+  add_tc(NAME "${BASE_SRC_PREFIX}/ring-test.cc" LIBS ${ld_libs} pthread)
 endif()
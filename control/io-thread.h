@@ -1,6 +1,8 @@
 #include <event/io-message-loop.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 namespace libz {
@@ -33,14 +35,24 @@ class IOThread {
   // block wait for thread to exit
   void Join() { thread_->join(); }
 
+  // block wait for the loop to run, event_loop() is valid after it
+  void WaitRunning() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return Running(); });
+  }
+
   event::MessageLoop* event_loop() { return loop_; }
 
   bool Running() const { return running_.load(std::memory_order_relaxed); }
 
  protected:
   virtual void Init(event::MessageLoop* loop) {
-    loop_ = loop;
-    running_.store(true, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      loop_ = loop;
+      running_.store(true, std::memory_order_release);
+    }
+    cond_.notify_all();
   }
   virtual void Deinit() {
     loop_ = nullptr;
@@ -51,6 +63,9 @@ class IOThread {
   std::atomic<bool> running_;
   event::MessageLoop* loop_;
   std::unique_ptr<std::thread> thread_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
 };
 
 class IOThreadPool {
@@ -78,6 +93,13 @@ class IOThreadPool {
     }
   }
 
+  // block wait for all loops to run
+  void WaitRunning() {
+    for (auto& t : pool_) {
+      t.WaitRunning();
+    }
+  }
+
   void Run() {
     for (auto& t : pool_) {
       t.Run();
@@ -0,0 +1,376 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "async-file.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "coroutine.h"
+#include "io-message-loop.h"
+
+namespace libz {
+namespace event {
+
+std::string MkTempPath() {
+  char path[] = "/tmp/libz-async-file-XXXXXX";
+  auto fd = ::mkstemp(path);
+  CATCH_REQUIRE(fd >= 0);
+  ::close(fd);
+  return path;
+}
+
+std::string MkContent(std::size_t size) {
+  std::string content(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    content[i] = 'a' + i % 26;
+  }
+  return content;
+}
+
+// the cases are run on every backend available
+std::vector<std::string> BackendNames() {
+#ifdef ENABLE_IOURING
+  return {"thread-pool", "io_uring"};
+#else
+  return {"thread-pool"};
+#endif
+}
+
+std::unique_ptr<FileBackend> MkBackend(IOMessageLoop* loop,
+                                       const std::string& name) {
+#ifdef ENABLE_IOURING
+  if (name == "io_uring") {
+    CATCH_REQUIRE(loop->uring());
+    return std::make_unique<IOUringFileBackend>(loop->uring());
+  }
+#endif
+  return std::make_unique<ThreadPoolFileBackend>(loop);
+}
+
+// run |body| as a coroutine on the loop, and shutdown the loop after it
+template <typename F>
+void RunOnLoop(IOMessageLoop* loop, F&& body) {
+  loop->Post([loop, &body]() {
+    [](IOMessageLoop* loop, F* body) -> Notifier {
+      co_await (*body)();
+      loop->Shutdown();
+      co_return {};
+    }(loop, &body);
+  });
+
+  auto guard = loop->AddTimerEvent([&](Error&&) { loop->Shutdown(); },
+                                   Seconds(10));
+  loop->Run();
+}
+
+void ReadAndWrite(const std::string& name) {
+  IOMessageLoop loop;
+  auto backend = MkBackend(&loop, name);
+
+  auto path = MkTempPath();
+  auto file = AsyncFile::Open(backend.get(), path, O_RDWR);
+  CATCH_REQUIRE(file);
+  ::unlink(path.c_str());
+
+  auto f = file.PassResult();
+  bool done = false;
+  RunOnLoop(&loop, [&]() -> Notifier {
+    std::string hello = "hello, ";
+    std::string world = "world";
+    auto n = co_await f.WriteAt(hello.data(), hello.size(), 0);
+    CATCH_REQUIRE(n);
+    CATCH_REQUIRE(n.GetResult() == hello.size());
+
+    // the vectored write at the offset
+    ::iovec iov[2] = {{world.data(), 2}, {world.data() + 2, 3}};
+    n = co_await f.WritevAt(iov, 2, hello.size());
+    CATCH_REQUIRE(n);
+    CATCH_REQUIRE(n.GetResult() == world.size());
+
+    auto e = co_await f.Fdatasync();
+    CATCH_REQUIRE(!e);
+    e = co_await f.Fsync();
+    CATCH_REQUIRE(!e);
+
+    char buffer[64] = {};
+    n = co_await f.ReadAt(buffer, sizeof(buffer), 7);
+    CATCH_REQUIRE(n);
+    CATCH_REQUIRE(std::string(buffer, n.GetResult()) == "world");
+
+    char a[5], b[7];
+    ::iovec riov[2] = {{a, sizeof(a)}, {b, sizeof(b)}};
+    n = co_await f.ReadvAt(riov, 2, 0);
+    CATCH_REQUIRE(n);
+    CATCH_REQUIRE(n.GetResult() == 12);
+    CATCH_REQUIRE(std::string(a, 5) + std::string(b, 7) == "hello, world");
+
+    // the space is allocated without changing the size
+    e = co_await f.Fallocate(FALLOC_FL_KEEP_SIZE, 0, 1 << 20);
+    CATCH_REQUIRE(!e);
+    auto stx = co_await f.Statx();
+    CATCH_REQUIRE(stx);
+    CATCH_REQUIRE(stx.GetResult().stx_size == 12);
+
+    // at the end of file
+    n = co_await f.ReadAt(buffer, sizeof(buffer), 100);
+    CATCH_REQUIRE(n);
+    CATCH_REQUIRE(n.GetResult() == 0);
+
+    done = true;
+    co_return {};
+  });
+
+  CATCH_REQUIRE(done);
+}
+
+// the reads longer than 5000 bytes are short, at an unaligned offset
+class ShortReadBackend : public ThreadPoolFileBackend {
+ public:
+  explicit ShortReadBackend(MessageLoop* loop) : ThreadPoolFileBackend(loop) {}
+
+  void Read(int fd, void* data, std::size_t len, std::uint64_t offset,
+            Callback&& callback) override {
+    ThreadPoolFileBackend::Read(
+        fd, data, len, offset,
+        [callback = std::move(callback)](long res) {
+          callback(std::min<long>(res, 5000));
+        });
+  }
+};
+
+void ReadWhole(const std::string& name) {
+  IOMessageLoop loop;
+  std::unique_ptr<FileBackend> backend;
+  if (name == "short-read") {
+    backend = std::make_unique<ShortReadBackend>(&loop);
+  } else {
+    backend = MkBackend(&loop, name);
+  }
+
+  auto path = MkTempPath();
+  auto content = MkContent((3 << 20) + 123);
+  {
+    auto fd = ::open(path.c_str(), O_WRONLY);
+    CATCH_REQUIRE(::write(fd, content.data(), content.size()) ==
+                  static_cast<ssize_t>(content.size()));
+    ::close(fd);
+  }
+
+  // O_DIRECT isn't supported by every file system, such as tmpfs
+  auto file = AsyncFile::Open(backend.get(), path, O_RDONLY | O_DIRECT);
+  if (!file) {
+    file = AsyncFile::Open(backend.get(), path, O_RDONLY);
+  }
+  CATCH_REQUIRE(file);
+
+  auto empty_path = MkTempPath();
+  auto empty = AsyncFile::Open(backend.get(), empty_path, O_RDONLY);
+  CATCH_REQUIRE(empty);
+
+  ::unlink(path.c_str());
+  ::unlink(empty_path.c_str());
+
+  auto whole = file.PassResult();
+  auto nothing = empty.PassResult();
+
+  bool done = false;
+  RunOnLoop(&loop, [&]() -> Notifier {
+    AsyncFile::ReadWholeOptions opts;
+    opts.chunk_size = 256 << 10;
+    opts.parallelism = 4;
+
+    // the file is closed with the read pending
+    auto pending = whole.ReadWhole(opts);
+    whole.Close();
+    auto data = co_await pending;
+    CATCH_REQUIRE(data);
+    auto buffer = data.PassResult();
+    CATCH_REQUIRE(std::string_view(buffer.data(), buffer.size()) == content);
+
+    data = co_await nothing.ReadWhole();
+    CATCH_REQUIRE(data);
+    CATCH_REQUIRE(data.GetResult().size() == 0);
+
+    done = true;
+    co_return {};
+  });
+
+  CATCH_REQUIRE(done);
+}
+
+// the file is closed with the requests pending, and the fd is reused by
+// another file at once
+void CloseWithPending(const std::string& name) {
+  IOMessageLoop loop;
+  auto backend = MkBackend(&loop, name);
+
+  auto path = MkTempPath();
+  auto other_path = MkTempPath();
+  auto file = AsyncFile::Open(backend.get(), path, O_RDWR);
+  CATCH_REQUIRE(file);
+
+  constexpr int kWrites = 64;
+  auto content = MkContent(4096);
+  auto f = file.PassResult();
+  std::vector<Promise<std::size_t>> writes;
+  for (int i = 0; i < kWrites; ++i) {
+    writes.push_back(f.WriteAt(content.data(), content.size(), i * 4096));
+  }
+  auto sync = f.Fsync();
+  f.Close();
+  CATCH_REQUIRE(!f.is_open());
+
+  auto other = AsyncFile::Open(backend.get(), other_path, O_RDWR);
+  CATCH_REQUIRE(other);
+
+  bool done = false;
+  RunOnLoop(&loop, [&]() -> Notifier {
+    for (auto& write : writes) {
+      auto n = co_await write;
+      CATCH_REQUIRE(n);
+      CATCH_REQUIRE(n.GetResult() == content.size());
+    }
+    auto e = co_await sync;
+    CATCH_REQUIRE(!e);
+
+    done = true;
+    co_return {};
+  });
+  CATCH_REQUIRE(done);
+
+  struct ::stat st;
+  CATCH_REQUIRE(::stat(path.c_str(), &st) == 0);
+  CATCH_REQUIRE(st.st_size == kWrites * 4096);
+  CATCH_REQUIRE(::stat(other_path.c_str(), &st) == 0);
+  CATCH_REQUIRE(st.st_size == 0);
+
+  ::unlink(path.c_str());
+  ::unlink(other_path.c_str());
+}
+
+// the write beyond RLIMIT_FSIZE is short, and the sync is skipped
+void ShortWriteSync(const std::string& name) {
+  IOMessageLoop loop;
+  auto backend = MkBackend(&loop, name);
+
+  auto path = MkTempPath();
+  auto file = AsyncFile::Open(backend.get(), path, O_RDWR);
+  CATCH_REQUIRE(file);
+  ::unlink(path.c_str());
+  auto f = file.PassResult();
+
+  struct rlimit saved;
+  CATCH_REQUIRE(::getrlimit(RLIMIT_FSIZE, &saved) == 0);
+  struct rlimit limit = saved;
+  limit.rlim_cur = 6000;
+  CATCH_REQUIRE(::setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  auto handler = ::signal(SIGXFSZ, SIG_IGN);
+
+  auto content = MkContent(8192);
+  std::vector<long> results;
+  RunOnLoop(&loop, [&]() -> Notifier {
+    for (auto len : {4096ul, 8192ul}) {
+      Promise<long> promise;
+      backend->WriteSync(
+          f.fd(), content.data(), len, 0, true,
+          f.Keep([resolver = promise.GetResolver()](long res) mutable {
+            resolver.Resolve(res);
+          }));
+      auto r = co_await promise;
+      results.push_back(r.GetResult());
+    }
+    co_return {};
+  });
+
+  ::signal(SIGXFSZ, handler);
+  CATCH_REQUIRE(::setrlimit(RLIMIT_FSIZE, &saved) == 0);
+  CATCH_REQUIRE(results == std::vector<long>{4096, 6000});
+}
+
+void BadFile(const std::string& name) {
+  IOMessageLoop loop;
+  auto backend = MkBackend(&loop, name);
+
+  CATCH_REQUIRE(!AsyncFile::Open(backend.get(), "/not/exist", O_RDONLY));
+
+  // the closed file is rejected by the kernel
+  AsyncFile file(backend.get(), -1);
+  bool done = false;
+  RunOnLoop(&loop, [&]() -> Notifier {
+    char buffer[16];
+    auto n = co_await file.ReadAt(buffer, sizeof(buffer), 0);
+    CATCH_REQUIRE(!n);
+
+    auto data = co_await file.ReadWhole();
+    CATCH_REQUIRE(!data);
+
+    done = true;
+    co_return {};
+  });
+
+  CATCH_REQUIRE(done);
+}
+
+CATCH_TEST_CASE("read and write", "[async-file]") {
+  for (auto& name : BackendNames()) {
+    CATCH_INFO("backend " << name);
+    ReadAndWrite(name);
+  }
+}
+
+CATCH_TEST_CASE("read whole", "[async-file]") {
+  auto names = BackendNames();
+  names.push_back("short-read");
+  for (auto& name : names) {
+    CATCH_INFO("backend " << name);
+    ReadWhole(name);
+  }
+}
+
+CATCH_TEST_CASE("close with pending requests", "[async-file]") {
+  for (auto& name : BackendNames()) {
+    CATCH_INFO("backend " << name);
+    CloseWithPending(name);
+  }
+}
+
+CATCH_TEST_CASE("short write and sync", "[async-file]") {
+  for (auto& name : BackendNames()) {
+    CATCH_INFO("backend " << name);
+    ShortWriteSync(name);
+  }
+}
+
+CATCH_TEST_CASE("bad file", "[async-file]") {
+  for (auto& name : BackendNames()) {
+    CATCH_INFO("backend " << name);
+    BadFile(name);
+  }
+}
+
+CATCH_TEST_CASE("backend of the loop", "[async-file]") {
+  IOMessageLoop loop;
+  auto backend = loop.file_backend();
+  CATCH_REQUIRE(backend);
+  CATCH_REQUIRE(backend == loop.file_backend());
+
+#ifdef ENABLE_IOURING
+  if (loop.uring()) {
+    CATCH_REQUIRE(std::string(backend->name()) == "io_uring");
+    return;
+  }
+#endif
+  CATCH_REQUIRE(std::string(backend->name()) == "thread-pool");
+}
+
+}  // namespace event
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
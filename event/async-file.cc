@@ -0,0 +1,273 @@
+#include "async-file.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+
+namespace libz {
+namespace event {
+
+namespace {
+
+// rounded up to the alignment of O_DIRECT
+std::size_t Align(std::size_t size) {
+  constexpr auto kAlignment = AlignedBufferPool::kAlignment;
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+std::size_t AlignDown(std::size_t size) {
+  constexpr auto kAlignment = AlignedBufferPool::kAlignment;
+  return size / kAlignment * kAlignment;
+}
+
+// the state of ReadWhole shared by the chunks
+struct WholeRead {
+  FileBackend* backend;
+  int fd;
+
+  // the file is kept open till the read is done, and the reads of O_DIRECT
+  // must be aligned
+  std::shared_ptr<_::FileHandle> handle;
+  bool direct;
+
+  AlignedBuffer buffer;
+  std::size_t size;
+  std::size_t chunk_size;
+
+  // the offset of the next chunk, and the chunks in flight
+  std::size_t next;
+  std::size_t inflight;
+
+  // the end of file may be before |size| if the file is truncated
+  std::size_t eof;
+  Error error;
+
+  PromiseResolver<AlignedBuffer> resolver;
+};
+
+void ReadRange(const std::shared_ptr<WholeRead>& read, std::size_t offset,
+               std::size_t end);
+
+// read the next chunk if any, or settle the promise after the last one
+void ReadNextChunk(const std::shared_ptr<WholeRead>& read) {
+  if (!read->error && read->next < read->eof) {
+    auto offset = read->next;
+    read->next = std::min(offset + read->chunk_size, read->size);
+    ReadRange(read, offset, read->next);
+    return;
+  }
+
+  if (read->inflight > 0) {
+    return;
+  }
+
+  if (read->error) {
+    read->resolver.Reject(std::move(read->error));
+    return;
+  }
+
+  read->buffer.Resize(std::min(read->size, read->eof));
+  read->resolver.Resolve(std::move(read->buffer));
+}
+
+// read [offset, end) into its place, and the rest of a short read again.
+// for O_DIRECT, the read starts at the alignment below |offset|, and the
+// length is rounded up to the alignment, which is within the capacity of
+// the buffer
+void ReadRange(const std::shared_ptr<WholeRead>& read, std::size_t offset,
+               std::size_t end) {
+  auto start = offset;
+  auto len = end - offset;
+  if (read->direct) {
+    start = AlignDown(offset);
+    len = Align(end) - start;
+  }
+  len = std::min(len, read->buffer.capacity() - start);
+
+  ++read->inflight;
+  read->backend->Read(
+      read->fd, read->buffer.data() + start, len, start,
+      [read, offset, start, end](long res) {
+        --read->inflight;
+        if (res < 0) {
+          if (!read->error) {
+            read->error = Error::MkSysError(-res);
+          }
+        } else if (start + res <= offset) {
+          // nothing beyond |offset|, it's the end of file
+          read->eof = std::min(read->eof, offset);
+        } else if (start + res < end && !read->error) {
+          ReadRange(read, start + res, end);
+          return;
+        }
+
+        ReadNextChunk(read);
+      });
+}
+
+}  // namespace
+
+Result<AsyncFile> AsyncFile::Open(FileBackend* backend,
+                                  const std::string& path, int flags,
+                                  mode_t mode) {
+  auto fd = ::open(path.c_str(), flags | O_CLOEXEC, mode);
+  if (fd < 0) {
+    return Error::MkSysError(errno);
+  }
+  return AsyncFile(backend, fd);
+}
+
+namespace _ {
+
+FileHandle::~FileHandle() { ::close(fd_); }
+
+}  // namespace _
+
+FileBackend::Callback AsyncFile::Keep(FileBackend::Callback&& callback) const {
+  if (!handle_) {
+    return std::move(callback);
+  }
+
+  return [handle = handle_, callback = std::move(callback)](long res) {
+    callback(res);
+  };
+}
+
+template <typename Start>
+Promise<std::size_t> AsyncFile::RunSize(Start&& start) {
+  Promise<std::size_t> promise;
+  start(Keep([resolver = promise.GetResolver()](long res) mutable {
+    if (res < 0) {
+      resolver.Reject(Error::MkSysError(-res));
+    } else {
+      resolver.Resolve(static_cast<std::size_t>(res));
+    }
+  }));
+  return promise;
+}
+
+template <typename Start>
+Notifier AsyncFile::RunVoid(Start&& start) {
+  Notifier ntfr;
+  start(Keep([resolver = ntfr.GetResolver()](long res) mutable {
+    if (res < 0) {
+      resolver.Reject(Error::MkSysError(-res));
+    } else {
+      resolver.Resolve();
+    }
+  }));
+  return ntfr;
+}
+
+Promise<std::size_t> AsyncFile::ReadAt(void* data, std::size_t len,
+                                       std::uint64_t offset) {
+  return RunSize([&](FileBackend::Callback&& callback) {
+    backend_->Read(fd(), data, len, offset, std::move(callback));
+  });
+}
+
+Promise<std::size_t> AsyncFile::WriteAt(const void* data, std::size_t len,
+                                        std::uint64_t offset) {
+  return RunSize([&](FileBackend::Callback&& callback) {
+    backend_->Write(fd(), data, len, offset, std::move(callback));
+  });
+}
+
+Promise<std::size_t> AsyncFile::ReadvAt(const ::iovec* iov, int iovcnt,
+                                        std::uint64_t offset) {
+  return RunSize([&](FileBackend::Callback&& callback) {
+    backend_->Readv(fd(), iov, iovcnt, offset, std::move(callback));
+  });
+}
+
+Promise<std::size_t> AsyncFile::WritevAt(const ::iovec* iov, int iovcnt,
+                                         std::uint64_t offset) {
+  return RunSize([&](FileBackend::Callback&& callback) {
+    backend_->Writev(fd(), iov, iovcnt, offset, std::move(callback));
+  });
+}
+
+Notifier AsyncFile::Fsync() {
+  return RunVoid([&](FileBackend::Callback&& callback) {
+    backend_->Fsync(fd(), false, std::move(callback));
+  });
+}
+
+Notifier AsyncFile::Fdatasync() {
+  return RunVoid([&](FileBackend::Callback&& callback) {
+    backend_->Fsync(fd(), true, std::move(callback));
+  });
+}
+
+Notifier AsyncFile::Fallocate(int mode, std::uint64_t offset,
+                              std::uint64_t len) {
+  return RunVoid([&](FileBackend::Callback&& callback) {
+    backend_->Fallocate(fd(), mode, offset, len, std::move(callback));
+  });
+}
+
+Promise<struct ::statx> AsyncFile::Statx(unsigned mask) {
+  Promise<struct ::statx> promise;
+
+  // the result is written by the backend, it's alive until the completion
+  auto stx = std::make_shared<struct ::statx>();
+  backend_->Statx(fd(), mask, stx.get(),
+                  Keep([stx, resolver = promise.GetResolver()](
+                           long res) mutable {
+                    if (res < 0) {
+                      resolver.Reject(Error::MkSysError(-res));
+                    } else {
+                      resolver.Resolve(*stx);
+                    }
+                  }));
+  return promise;
+}
+
+Promise<AlignedBuffer> AsyncFile::ReadWhole(const ReadWholeOptions& opts) {
+  auto chunk_size = std::max(Align(opts.chunk_size), Align(1));
+  auto parallelism = std::max<std::size_t>(opts.parallelism, 1);
+
+  auto direct = is_open() && (::fcntl(fd(), F_GETFL) & O_DIRECT) != 0;
+
+  return Statx(STATX_SIZE)
+      .Then(
+          [backend = backend_, handle = handle_, fd = fd(), direct, chunk_size,
+           parallelism](Result<struct ::statx>&& r) -> Promise<AlignedBuffer> {
+            if (!r) {
+              return MkRejectedPromise<AlignedBuffer>(r.PassError());
+            }
+
+            auto read = std::make_shared<WholeRead>();
+            read->backend = backend;
+            read->fd = fd;
+            read->handle = handle;
+            read->direct = direct;
+            read->size = r.GetResult().stx_size;
+            read->chunk_size = chunk_size;
+            read->next = 0;
+            read->inflight = 0;
+            read->eof = read->size;
+
+            // room for the tail rounded up to the alignment
+            read->buffer = AlignedBuffer::Make(Align(read->size));
+
+            Promise<AlignedBuffer> promise;
+            read->resolver = promise.GetResolver();
+            if (read->size == 0) {
+              ReadNextChunk(read);
+              return promise;
+            }
+
+            for (std::size_t i = 0; i < parallelism && read->next < read->size;
+                 ++i) {
+              ReadNextChunk(read);
+            }
+            return promise;
+          },
+          nullptr);
+}
+
+}  // namespace event
+}  // namespace libz
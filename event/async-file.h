@@ -0,0 +1,129 @@
+#pragma once
+
+#include <base/aligned-buffer-pool.h>
+#include <base/common.h>
+#include <base/error.h>
+#include <base/result.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "file-backend.h"
+#include "promise.h"
+
+namespace libz {
+namespace event {
+
+namespace _ {
+
+// the fd shared by the file and its pending requests, it's closed once the
+// last of them is gone
+class FileHandle {
+ public:
+  explicit FileHandle(int fd) : fd_(fd) {}
+  ~FileHandle();
+
+  int fd() const { return fd_; }
+
+ private:
+  int fd_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(FileHandle);
+};
+
+}  // namespace _
+
+// AsyncFile is a file whose io is done by the file backend of a loop, the
+// io_uring or the thread pool, and the promises are resolved within the loop
+// thread. the offsets are explicit, the file offset is never used, so that
+// the requests can be in flight at the same time.
+//
+// Notes, the buffers must be alive until the promise is settled. with
+// O_DIRECT, the buffers, the offsets and the lengths must be aligned to the
+// logical block size, see AlignedBuffer
+class AsyncFile {
+ public:
+  struct ReadWholeOptions {
+    // the size of a chunk, it's rounded up to the alignment
+    std::size_t chunk_size{1 << 20};
+
+    // the chunks read in parallel
+    std::size_t parallelism{8};
+  };
+
+  // open |path| synchronously, the open of a local file doesn't block for
+  // long, and the file is usually opened once for many requests
+  static Result<AsyncFile> Open(FileBackend* backend, const std::string& path,
+                                int flags, mode_t mode = 0644);
+
+  // adopt |fd|, it's closed after the file and its pending requests are gone
+  AsyncFile(FileBackend* backend, int fd)
+      : backend_(backend),
+        handle_(fd >= 0 ? std::make_shared<_::FileHandle>(fd) : nullptr) {}
+
+  AsyncFile(AsyncFile&& other) noexcept = default;
+  AsyncFile& operator=(AsyncFile&& other) noexcept = default;
+  ~AsyncFile() { Close(); }
+
+ public:
+  // resolved with the bytes transferred, which is short at the end of file
+  Promise<std::size_t> ReadAt(void* data, std::size_t len,
+                              std::uint64_t offset);
+  Promise<std::size_t> WriteAt(const void* data, std::size_t len,
+                               std::uint64_t offset);
+
+  // the iovecs must be alive until the promise is settled as well
+  Promise<std::size_t> ReadvAt(const ::iovec* iov, int iovcnt,
+                               std::uint64_t offset);
+  Promise<std::size_t> WritevAt(const ::iovec* iov, int iovcnt,
+                                std::uint64_t offset);
+
+  // the notifiers are settled with the errors
+  Notifier Fsync();
+  Notifier Fdatasync();
+
+  // |mode| is the mode of fallocate(2), such as FALLOC_FL_KEEP_SIZE
+  Notifier Fallocate(int mode, std::uint64_t offset, std::uint64_t len);
+
+  Promise<struct ::statx> Statx(unsigned mask = STATX_BASIC_STATS);
+
+  // read the whole file by the chunks in parallel, every chunk is read into
+  // its place in the buffer, so that there is no copy. the size is taken by
+  // statx first, and the file mustn't be changed during the read
+  Promise<AlignedBuffer> ReadWhole(const ReadWholeOptions& opts);
+  Promise<AlignedBuffer> ReadWhole() { return ReadWhole(ReadWholeOptions{}); }
+
+  // the pending requests keep the file open until they are completed, the
+  // ReadWhole ones as well
+  void Close() { handle_.reset(); }
+
+  // |callback| keeps the file open until it's invoked or dropped, for the
+  // requests issued on the backend directly, eg.
+  //
+  //   backend->Fsync(file.fd(), false, file.Keep(std::move(callback)));
+  FileBackend::Callback Keep(FileBackend::Callback&& callback) const;
+
+  int fd() const { return handle_ ? handle_->fd() : -1; }
+  bool is_open() const { return handle_ != nullptr; }
+  FileBackend* backend() const { return backend_; }
+
+ private:
+  // |start(callback)| starts the request
+  template <typename Start>
+  Promise<std::size_t> RunSize(Start&& start);
+
+  template <typename Start>
+  Notifier RunVoid(Start&& start);
+
+  FileBackend* backend_;
+  std::shared_ptr<_::FileHandle> handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFile);
+};
+
+}  // namespace event
+}  // namespace libz
@@ -0,0 +1,250 @@
+#include "file-backend.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <memory>
+
+namespace libz {
+namespace event {
+
+ThreadPoolFileBackend::ThreadPoolFileBackend(MessageLoop* loop,
+                                             const Options& opts)
+    : loop_(loop),
+      opts_(opts),
+      mutex_(),
+      cond_(),
+      tasks_(),
+      stopped_(false),
+      threads_() {
+  for (std::size_t i = 0; i < std::max<std::size_t>(opts_.threads, 1); ++i) {
+    threads_.emplace_back([this]() { Work(); });
+  }
+}
+
+ThreadPoolFileBackend::~ThreadPoolFileBackend() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopped_ = true;
+  }
+  cond_.notify_all();
+
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void ThreadPoolFileBackend::Execute(std::function<long()>&& syscall,
+                                    Callback&& callback) {
+  auto task = [loop = loop_, syscall = std::move(syscall),
+               callback = std::move(callback)]() mutable {
+    auto res = syscall();
+    if (res < 0) {
+      res = -errno;
+    }
+
+    loop->remote_executor()->Post(
+        [res, callback = std::move(callback)]() { callback(res); });
+  };
+
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  cond_.notify_one();
+}
+
+void ThreadPoolFileBackend::Work() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+      if (stopped_) {
+        return;
+      }
+
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    task();
+  }
+}
+
+void ThreadPoolFileBackend::Read(int fd, void* data, std::size_t len,
+                                 std::uint64_t offset, Callback&& callback) {
+  Execute([=]() -> long { return ::pread(fd, data, len, offset); },
+          std::move(callback));
+}
+
+void ThreadPoolFileBackend::Write(int fd, const void* data, std::size_t len,
+                                  std::uint64_t offset, Callback&& callback) {
+  Execute([=]() -> long { return ::pwrite(fd, data, len, offset); },
+          std::move(callback));
+}
+
+void ThreadPoolFileBackend::Readv(int fd, const ::iovec* iov, int iovcnt,
+                                  std::uint64_t offset, Callback&& callback) {
+  Execute([=]() -> long { return ::preadv(fd, iov, iovcnt, offset); },
+          std::move(callback));
+}
+
+void ThreadPoolFileBackend::Writev(int fd, const ::iovec* iov, int iovcnt,
+                                   std::uint64_t offset, Callback&& callback) {
+  Execute([=]() -> long { return ::pwritev(fd, iov, iovcnt, offset); },
+          std::move(callback));
+}
+
+void ThreadPoolFileBackend::Fsync(int fd, bool datasync, Callback&& callback) {
+  Execute([=]() -> long { return datasync ? ::fdatasync(fd) : ::fsync(fd); },
+          std::move(callback));
+}
+
+void ThreadPoolFileBackend::Fallocate(int fd, int mode, std::uint64_t offset,
+                                      std::uint64_t len, Callback&& callback) {
+  Execute([=]() -> long { return ::fallocate(fd, mode, offset, len); },
+          std::move(callback));
+}
+
+void ThreadPoolFileBackend::WriteSync(int fd, const void* data,
+                                      std::size_t len, std::uint64_t offset,
+                                      bool datasync, Callback&& callback) {
+  // both on the same worker, in one round trip
+  Execute(
+      [=]() -> long {
+        auto n = ::pwrite(fd, data, len, offset);
+        if (n < 0 || static_cast<std::size_t>(n) < len) {
+          return n;
+        }
+
+        auto ret = datasync ? ::fdatasync(fd) : ::fsync(fd);
+        return ret < 0 ? ret : n;
+      },
+      std::move(callback));
+}
+
+void ThreadPoolFileBackend::Statx(int fd, unsigned mask, struct ::statx* stx,
+                                  Callback&& callback) {
+  Execute(
+      [=]() -> long { return ::statx(fd, "", AT_EMPTY_PATH, mask, stx); },
+      std::move(callback));
+}
+
+void ThreadPoolFileBackend::Madvise(void* addr, std::size_t len, int advice,
+                                    Callback&& callback) {
+  Execute([=]() -> long { return ::madvise(addr, len, advice); },
+          std::move(callback));
+}
+
+#ifdef ENABLE_IOURING
+void IOUringFileBackend::Read(int fd, void* data, std::size_t len,
+                              std::uint64_t offset, Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_read(sqe, fd, data, len, offset);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::Write(int fd, const void* data, std::size_t len,
+                               std::uint64_t offset, Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_write(sqe, fd, data, len, offset);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::Readv(int fd, const ::iovec* iov, int iovcnt,
+                               std::uint64_t offset, Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_readv(sqe, fd, iov, iovcnt, offset);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::Writev(int fd, const ::iovec* iov, int iovcnt,
+                                std::uint64_t offset, Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_writev(sqe, fd, iov, iovcnt, offset);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::Fsync(int fd, bool datasync, Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_fsync(sqe, fd, datasync ? IORING_FSYNC_DATASYNC : 0);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::Fallocate(int fd, int mode, std::uint64_t offset,
+                                   std::uint64_t len, Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_fallocate(sqe, fd, mode, offset, len);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::WriteSync(int fd, const void* data, std::size_t len,
+                                   std::uint64_t offset, bool datasync,
+                                   Callback&& callback) {
+  // the linked requests must be in one submission, and the short write
+  // breaks the link, so that the sync is cancelled
+  if (::io_uring_sq_space_left(uring_->ring()) < 2) {
+    uring_->Submit();
+  }
+
+  // the cqe of the write comes first
+  auto written = std::make_shared<long>(-ECANCELED);
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_write(sqe, fd, data, len, offset);
+        sqe->flags |= IOSQE_IO_LINK;
+      },
+      [written](int res) { *written = res; });
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_fsync(sqe, fd, datasync ? IORING_FSYNC_DATASYNC : 0);
+      },
+      [written, len, callback = std::move(callback)](int res) {
+        if (*written < 0) {
+          callback(*written);
+        } else if (static_cast<std::size_t>(*written) < len) {
+          // the sync is cancelled by the broken link, the short write is
+          // reported as the thread pool one does
+          callback(*written);
+        } else {
+          callback(res < 0 ? res : *written);
+        }
+      });
+}
+
+void IOUringFileBackend::Statx(int fd, unsigned mask, struct ::statx* stx,
+                               Callback&& callback) {
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_statx(sqe, fd, "", AT_EMPTY_PATH, mask, stx);
+      },
+      std::move(callback));
+}
+
+void IOUringFileBackend::Madvise(void* addr, std::size_t len, int advice,
+                                 Callback&& callback) {
+  // it's always run by the io workers of the kernel
+  uring_->Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_madvise(sqe, addr, len, advice);
+      },
+      std::move(callback));
+}
+#endif
+
+}  // namespace event
+}  // namespace libz
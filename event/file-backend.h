@@ -0,0 +1,171 @@
+#pragma once
+
+#include <base/common.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "message-loop.h"
+
+#ifdef ENABLE_IOURING
+#include "io-uring-engine.h"
+#endif
+
+namespace libz {
+namespace event {
+
+// FileBackend runs the file io of AsyncFile. the callback is invoked within
+// the loop thread with the result of the syscall, or -errno, like the cqe of
+// io_uring.
+//
+// Notes, the fd must be open until the callback is invoked, since the thread
+// pool one runs the syscall later on a worker, see AsyncFile::Keep. the
+// backend of a loop is chosen by IOMessageLoop::file_backend, the io_uring
+// one if it's enabled and supported by the kernel, or else the thread pool
+// one
+class FileBackend {
+ public:
+  using Callback = std::function<void(long)>;
+
+  virtual ~FileBackend() {}
+
+  virtual void Read(int fd, void* data, std::size_t len, std::uint64_t offset,
+                    Callback&& callback) = 0;
+  virtual void Write(int fd, const void* data, std::size_t len,
+                     std::uint64_t offset, Callback&& callback) = 0;
+  virtual void Readv(int fd, const ::iovec* iov, int iovcnt,
+                     std::uint64_t offset, Callback&& callback) = 0;
+  virtual void Writev(int fd, const ::iovec* iov, int iovcnt,
+                      std::uint64_t offset, Callback&& callback) = 0;
+  virtual void Fsync(int fd, bool datasync, Callback&& callback) = 0;
+  virtual void Fallocate(int fd, int mode, std::uint64_t offset,
+                         std::uint64_t len, Callback&& callback) = 0;
+
+  // write and then sync, the sync is issued only if the whole buffer is
+  // written. the callback is invoked with the bytes written, or the error
+  // of either
+  virtual void WriteSync(int fd, const void* data, std::size_t len,
+                         std::uint64_t offset, bool datasync,
+                         Callback&& callback) = 0;
+
+  // |stx| is written before the callback
+  virtual void Statx(int fd, unsigned mask, struct ::statx* stx,
+                     Callback&& callback) = 0;
+
+  // madvise(2) off the loop thread, such as MADV_POPULATE_READ, which faults
+  // the pages in
+  virtual void Madvise(void* addr, std::size_t len, int advice,
+                       Callback&& callback) = 0;
+
+  virtual const char* name() const = 0;
+};
+
+// ThreadPoolFileBackend runs the blocking syscalls on a few worker threads
+// of its own, and the results are posted back to the loop. it's the fallback
+// where io_uring is disabled, such as some container sandboxes.
+//
+// Notes, the pending requests are dropped on destruction, so it must be
+// destroyed after the loop stops
+class ThreadPoolFileBackend : public FileBackend {
+ public:
+  struct Options {
+    std::size_t threads{4};
+  };
+
+  explicit ThreadPoolFileBackend(MessageLoop* loop)
+      : ThreadPoolFileBackend(loop, Options{}) {}
+  ThreadPoolFileBackend(MessageLoop* loop, const Options& opts);
+
+  ~ThreadPoolFileBackend() override;
+
+ public:
+  void Read(int fd, void* data, std::size_t len, std::uint64_t offset,
+            Callback&& callback) override;
+  void Write(int fd, const void* data, std::size_t len, std::uint64_t offset,
+             Callback&& callback) override;
+  void Readv(int fd, const ::iovec* iov, int iovcnt, std::uint64_t offset,
+             Callback&& callback) override;
+  void Writev(int fd, const ::iovec* iov, int iovcnt, std::uint64_t offset,
+              Callback&& callback) override;
+  void Fsync(int fd, bool datasync, Callback&& callback) override;
+  void Fallocate(int fd, int mode, std::uint64_t offset, std::uint64_t len,
+                 Callback&& callback) override;
+  void WriteSync(int fd, const void* data, std::size_t len,
+                 std::uint64_t offset, bool datasync,
+                 Callback&& callback) override;
+  void Statx(int fd, unsigned mask, struct ::statx* stx,
+             Callback&& callback) override;
+  void Madvise(void* addr, std::size_t len, int advice,
+               Callback&& callback) override;
+
+  const char* name() const override { return "thread-pool"; }
+
+  const Options& options() const { return opts_; }
+
+ private:
+  // |syscall| returns the result, or -1 with errno
+  void Execute(std::function<long()>&& syscall, Callback&& callback);
+  void Work();
+
+  MessageLoop* loop_;
+  Options opts_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopped_;
+
+  std::vector<std::thread> threads_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(ThreadPoolFileBackend);
+};
+
+#ifdef ENABLE_IOURING
+// IOUringFileBackend queues the requests on the io_uring of the loop, they
+// are submitted together at the end of the loop iteration. the sync of
+// WriteSync is linked after the write, so that both cost one submission
+class IOUringFileBackend : public FileBackend {
+ public:
+  explicit IOUringFileBackend(IOUringEngine* uring) : uring_(uring) {}
+
+ public:
+  void Read(int fd, void* data, std::size_t len, std::uint64_t offset,
+            Callback&& callback) override;
+  void Write(int fd, const void* data, std::size_t len, std::uint64_t offset,
+             Callback&& callback) override;
+  void Readv(int fd, const ::iovec* iov, int iovcnt, std::uint64_t offset,
+             Callback&& callback) override;
+  void Writev(int fd, const ::iovec* iov, int iovcnt, std::uint64_t offset,
+              Callback&& callback) override;
+  void Fsync(int fd, bool datasync, Callback&& callback) override;
+  void Fallocate(int fd, int mode, std::uint64_t offset, std::uint64_t len,
+                 Callback&& callback) override;
+  void WriteSync(int fd, const void* data, std::size_t len,
+                 std::uint64_t offset, bool datasync,
+                 Callback&& callback) override;
+  void Statx(int fd, unsigned mask, struct ::statx* stx,
+             Callback&& callback) override;
+  void Madvise(void* addr, std::size_t len, int advice,
+               Callback&& callback) override;
+
+  const char* name() const override { return "io_uring"; }
+
+  IOUringEngine* uring() const { return uring_; }
+
+ private:
+  IOUringEngine* uring_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IOUringFileBackend);
+};
+#endif
+
+}  // namespace event
+}  // namespace libz
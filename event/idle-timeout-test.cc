@@ -0,0 +1,143 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "idle-timeout.h"
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <vector>
+
+#include "io-message-loop.h"
+
+namespace libz {
+namespace event {
+
+struct Connection {
+  explicit Connection(std::size_t* fired)
+      : idle([fired]() { ++*fired; }) {}
+
+  IdleTimer idle;
+};
+
+CATCH_TEST_CASE("lazy relink", "[idle-timeout]") {
+  IdleTimeoutManager::Options opts;
+  opts.resolution = MilliSeconds(10);
+  IdleTimeoutManager manager(nullptr, opts);
+
+  std::size_t fired = 0;
+  Connection a(&fired), b(&fired), c(&fired);
+  for (auto conn : {&a, &b, &c}) {
+    manager.Start(&conn->idle, MilliSeconds(100));
+    CATCH_REQUIRE(conn->idle.timeout() == 10);
+  }
+
+  // the touch isn't relinked until the slot expires
+  manager.Advance(5);
+  a.idle.Touch();
+  CATCH_REQUIRE(a.idle.last_active() == 5);
+  CATCH_REQUIRE(manager.stats().relinked == 0);
+
+  // the timeout fires within the slack, that is, one tick
+  manager.Advance(5);
+  CATCH_REQUIRE(fired == 0);
+  manager.Advance(1);
+  CATCH_REQUIRE(fired == 2);
+  CATCH_REQUIRE(manager.stats().relinked == 1);
+  CATCH_REQUIRE(a.idle.IsActive());
+  CATCH_REQUIRE(!b.idle.IsStarted());
+
+  // the relinked one fires after the rest of its timeout
+  manager.Advance(4);
+  CATCH_REQUIRE(fired == 2);
+  manager.Advance(1);
+  CATCH_REQUIRE(fired == 3);
+  CATCH_REQUIRE(manager.stats().fired == 3);
+
+  // the stopped one never fires
+  manager.Start(&c.idle, MilliSeconds(100));
+  manager.Stop(&c.idle);
+  manager.Advance(100);
+  CATCH_REQUIRE(fired == 3);
+  CATCH_REQUIRE(!c.idle.IsActive());
+}
+
+CATCH_TEST_CASE("many connections", "[idle-timeout]") {
+  IdleTimeoutManager manager(nullptr);
+
+  constexpr std::size_t kNum = 100000;
+  std::size_t fired = 0;
+  std::vector<std::unique_ptr<Connection>> conns;
+  for (std::size_t i = 0; i < kNum; ++i) {
+    conns.push_back(std::make_unique<Connection>(&fired));
+    manager.Start(&conns.back()->idle, Seconds(30));
+  }
+
+  // every connection is active on every tick, but it's relinked only once
+  // per timeout
+  for (int tick = 0; tick < 6000; ++tick) {
+    manager.Advance(1);
+    for (std::size_t i = tick % 10; i < kNum; i += 10) {
+      conns[i]->idle.Touch();
+    }
+  }
+
+  CATCH_REQUIRE(fired == 0);
+  CATCH_REQUIRE(manager.stats().relinked <= 3 * kNum);
+
+  // the timer can be destroyed within the callback
+  std::unique_ptr<IdleTimer> timer;
+  timer = std::make_unique<IdleTimer>([&]() { timer.reset(); });
+  manager.Start(timer.get(), Seconds(1));
+
+  conns.clear();
+  manager.Advance(200);
+  CATCH_REQUIRE(!timer);
+}
+
+CATCH_TEST_CASE("loop", "[idle-timeout]") {
+  IOMessageLoop loop;
+
+  IdleTimeoutManager::Options opts;
+  opts.resolution = MilliSeconds(5);
+  IdleTimeoutManager manager(&loop, opts);
+
+  std::size_t fired = 0;
+  Connection idle(&fired);
+  Connection busy(&fired);
+
+  auto start = loop.MonoNow();
+  Tm idle_at;
+  IdleTimer watcher([&]() {
+    idle_at = loop.MonoNow();
+    loop.Shutdown();
+  });
+
+  std::function<void(Error&&)> touch = [&](Error&& e) {
+    if (!e) {
+      busy.idle.Touch();
+      loop.RunAfter(std::function<void(Error&&)>(touch), MilliSeconds(10));
+    }
+  };
+
+  loop.Post([&]() {
+    manager.Start(&idle.idle, MilliSeconds(50));
+    manager.Start(&busy.idle, MilliSeconds(50));
+    manager.Start(&watcher, MilliSeconds(200));
+    touch({});
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(fired == 1);
+  CATCH_REQUIRE(!idle.idle.IsStarted());
+  CATCH_REQUIRE(busy.idle.IsStarted());
+  CATCH_REQUIRE(idle_at - start >= MilliSeconds(200));
+  CATCH_REQUIRE(idle_at - start < Seconds(1));
+}
+
+}  // namespace event
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
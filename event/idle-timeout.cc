@@ -0,0 +1,90 @@
+#include "idle-timeout.h"
+
+#include <algorithm>
+
+namespace libz {
+namespace event {
+
+void IdleTimer::Execute() {
+  auto idle = manager_->now() - last_active_;
+  if (idle < timeout_) {
+    // touched since it's scheduled
+    ++manager_->stats_.relinked;
+    manager_->Schedule(this, timeout_ - idle);
+    return;
+  }
+
+  ++manager_->stats_.fired;
+  manager_ = nullptr;
+
+  // Notes, the timer may be destroyed by the callback
+  on_idle_();
+}
+
+IdleTimeoutManager::IdleTimeoutManager(MessageLoop* loop, const Options& opts)
+    : loop_(loop), opts_(opts), wheel_(), epoch_(), ticker_(),
+      retired_ticker_(), stats_() {
+  opts_.resolution = std::max(opts_.resolution, MilliSeconds(1));
+
+  if (loop_) {
+    epoch_ = loop_->MonoNow();
+    ScheduleTick();
+  }
+}
+
+IdleTimeoutManager::~IdleTimeoutManager() {
+  ticker_.Cancel();
+  retired_ticker_.Cancel();
+  wheel_.Abort();
+}
+
+void IdleTimeoutManager::Start(IdleTimer* timer, MilliSeconds timeout) {
+  timer->manager_ = this;
+  timer->timeout_ = std::max<Tick>(ToTicks(timeout), 1);
+  timer->last_active_ = now();
+
+  Schedule(timer, timer->timeout_);
+}
+
+void IdleTimeoutManager::Stop(IdleTimer* timer) {
+  timer->Cancel();
+  timer->manager_ = nullptr;
+}
+
+Tick IdleTimeoutManager::ToTicks(MilliSeconds duration) const {
+  return (duration.count() + opts_.resolution.count() - 1) /
+         opts_.resolution.count();
+}
+
+void IdleTimeoutManager::Schedule(IdleTimer* timer, Tick delay) {
+  auto slack = static_cast<Tick>(timer->timeout_ * opts_.slack);
+  wheel_.ScheduleInRange(timer, delay, delay + std::max<Tick>(slack, 1));
+}
+
+void IdleTimeoutManager::ScheduleTick() {
+  // Notes, the current ticker is still running its callback, so it's kept
+  // until the next tick instead of being released here
+  retired_ticker_ = std::move(ticker_);
+  ticker_ = loop_->AddTimerEvent(
+      [this](Error&& e) {
+        // the loop is shutdown
+        if (!e) {
+          OnTick();
+        }
+      },
+      opts_.resolution);
+}
+
+void IdleTimeoutManager::OnTick() {
+  // catch up with the loop time, the ticks may be delayed
+  auto elapsed = DurationCast<MilliSeconds>(loop_->MonoNow() - epoch_);
+  auto target = static_cast<Tick>(elapsed / opts_.resolution);
+  if (target > now()) {
+    wheel_.Advance(target - now());
+  }
+
+  ScheduleTick();
+}
+
+}  // namespace event
+}  // namespace libz
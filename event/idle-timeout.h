@@ -0,0 +1,117 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/timer-wheel.h>
+
+#include <cstdint>
+#include <functional>
+
+#include "message-loop.h"
+#include "timer-event.h"
+
+namespace libz {
+namespace event {
+
+class IdleTimeoutManager;
+
+// IdleTimer is embedded in the connection, and it's linked into the timer
+// wheel of the manager without any allocation. the activity is marked with
+// a single store, the timer isn't relinked until its slot expires.
+//
+// Notes, the timer is unlinked on destruction, so it's safe to destroy the
+// connection at any time, including within the idle callback
+class IdleTimer : public TimerEventBase {
+ public:
+  explicit IdleTimer(std::function<void()>&& on_idle)
+      : TimerEventBase(), on_idle_(std::move(on_idle)) {}
+
+ public:
+  inline void Touch();
+
+  bool IsStarted() const { return manager_ != nullptr; }
+  Tick last_active() const { return last_active_; }
+  Tick timeout() const { return timeout_; }
+
+ private:
+  void Execute() override;
+
+  IdleTimeoutManager* manager_{nullptr};
+  Tick last_active_{0};
+  Tick timeout_{0};
+  std::function<void()> on_idle_;
+
+  friend IdleTimeoutManager;
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IdleTimer);
+};
+
+// IdleTimeoutManager tracks the idle timeouts of many connections on a loop
+// local hierarchical timer wheel. the timers are scheduled in a range, so
+// that they stay in the coarse slots, and the one touched since is relinked
+// to its new deadline only when the slot expires. the timeout fires between
+// |timeout| and |timeout| plus the slack, rounded to the resolution.
+//
+// Notes, the manager is bound to a message loop, and all methods must be
+// invoked within the loop thread. it must outlive the timers
+class IdleTimeoutManager {
+ public:
+  struct Options {
+    // the duration of one tick
+    MilliSeconds resolution{MilliSeconds(10)};
+
+    // the ratio of the timeout a timer may be late by
+    double slack{0.1};
+  };
+
+  struct Stats {
+    std::uint64_t fired{0};
+    std::uint64_t relinked{0};
+  };
+
+  // the manager is driven by the loop, or by Advance without the loop
+  explicit IdleTimeoutManager(MessageLoop* loop)
+      : IdleTimeoutManager(loop, Options{}) {}
+  IdleTimeoutManager(MessageLoop* loop, const Options& opts);
+
+  // the timers are unlinked without firing
+  ~IdleTimeoutManager();
+
+ public:
+  // start or restart the timer, it's touched as well
+  void Start(IdleTimer* timer, MilliSeconds timeout);
+  void Stop(IdleTimer* timer);
+
+  void Advance(Tick ticks) { wheel_.Advance(ticks); }
+
+  Tick now() const { return wheel_.now(); }
+  Tick ToTicks(MilliSeconds duration) const;
+
+  const Options& options() const { return opts_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  void Schedule(IdleTimer* timer, Tick delay);
+  void ScheduleTick();
+  void OnTick();
+
+  MessageLoop* loop_;
+  Options opts_;
+  ::libz::TimerWheel wheel_;
+
+  // the loop time of the tick zero
+  Tm epoch_;
+  TimerToken ticker_;
+  TimerToken retired_ticker_;
+
+  Stats stats_;
+
+  friend IdleTimer;
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IdleTimeoutManager);
+};
+
+inline void IdleTimer::Touch() {
+  DCHECK(manager_);
+  last_active_ = manager_->now();
+}
+
+}  // namespace event
+}  // namespace libz
@@ -7,9 +7,14 @@
 #include <asio/system_timer.hpp>
 
 #include "deadline-timer.h"
+#include "file-backend.h"
 #include "message-loop.h"
 #include "timer-event.h"
 
+#ifdef ENABLE_IOURING
+#include "io-uring-engine.h"
+#endif
+
 namespace libz {
 namespace event {
 
@@ -76,6 +81,48 @@ class IOMessageLoop : public MessageLoop {
 
   Executor* remote_executor() override { return &remote_executor_; }
 
+#ifdef ENABLE_IOURING
+ public:
+  // the io_uring engine is created on the first use. it's nullptr if the
+  // kernel doesn't support io_uring, see uring_error
+  IOUringEngine* uring() {
+    if (!uring_ && !uring_error_) {
+      auto r = IOUringEngine::Make(this, uring_opts_);
+      if (r) {
+        uring_ = r.PassResult();
+      } else {
+        uring_error_ = r.PassError();
+      }
+    }
+    return uring_.get();
+  }
+
+  const Error& uring_error() const { return uring_error_; }
+
+  // the options of the engine, such as sqpoll, it's effective only before
+  // the first use of uring
+  void set_uring_options(const IOUringEngine::Options& opts) {
+    uring_opts_ = opts;
+  }
+#endif
+
+ public:
+  // the backend of AsyncFile, it's chosen on the first use, the io_uring one
+  // if it's enabled and supported by the kernel, or else the thread pool
+  FileBackend* file_backend() {
+    if (!file_backend_) {
+#ifdef ENABLE_IOURING
+      if (auto engine = uring(); engine) {
+        file_backend_ = std::make_unique<IOUringFileBackend>(engine);
+      }
+#endif
+      if (!file_backend_) {
+        file_backend_ = std::make_unique<ThreadPoolFileBackend>(this);
+      }
+    }
+    return file_backend_.get();
+  }
+
  public:
   void Initialize() {
     heartbeat_timer_.emplace(proactor_, WallNow() + kHeartbeatInterval);
@@ -110,6 +157,12 @@ class IOMessageLoop : public MessageLoop {
       task_sched_timer_->cancel();
       timer_wheel_.Cancel(Err(kErrorEventLoopShutdown));
 
+#ifdef ENABLE_IOURING
+      if (uring_) {
+        uring_->Shutdown();
+      }
+#endif
+
       proactor_.stop();
 
       RunTasks();
@@ -154,6 +207,18 @@ class IOMessageLoop : public MessageLoop {
 
   DeadlineTimer deadline_timer_;
 
+#ifdef ENABLE_IOURING
+  IOUringEngine::Options uring_opts_;
+
+  // destroyed before the proactor, which watches its eventfd
+  std::unique_ptr<IOUringEngine> uring_;
+  Error uring_error_;
+#endif
+
+  // destroyed before the io_uring engine, and the proactor which the results
+  // of the thread pool are posted to
+  std::unique_ptr<FileBackend> file_backend_;
+
   DISALLOW_COPY_MOVE_AND_ASSIGN(IOMessageLoop);
 };
 
@@ -0,0 +1,340 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "io-uring-engine.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <asio/post.hpp>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "io-message-loop.h"
+
+namespace libz {
+namespace event {
+
+CATCH_TEST_CASE("read on the loop", "[io-uring-engine]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  char path[] = "/tmp/libz-io-uring-XXXXXX";
+  int fd = ::mkstemp(path);
+  CATCH_REQUIRE(fd >= 0);
+  ::unlink(path);
+
+  std::string content = "hello, io_uring";
+  CATCH_REQUIRE(::write(fd, content.data(), content.size()) ==
+                static_cast<ssize_t>(content.size()));
+
+  std::string buffer(64, '\0');
+  std::thread::id completed_on;
+  std::optional<Promise<int>> promise;
+
+  loop.Post([&]() {
+    promise.emplace(uring->Run([&](::io_uring_sqe* sqe) {
+      ::io_uring_prep_read(sqe, fd, buffer.data(), buffer.size(), 7);
+    }));
+    promise->Then(
+        [&](Result<int>&& r) {
+          CATCH_REQUIRE(r);
+          buffer.resize(r.GetResult());
+          completed_on = std::this_thread::get_id();
+          loop.Shutdown();
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+  ::close(fd);
+
+  // the completion is on the loop thread
+  CATCH_REQUIRE(completed_on == std::this_thread::get_id());
+  CATCH_REQUIRE(buffer == "io_uring");
+  CATCH_REQUIRE(uring->inflight() == 0);
+}
+
+CATCH_TEST_CASE("many requests", "[io-uring-engine]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  // more than the entries of the queue
+  constexpr int kNum = 1000;
+  int completed = 0;
+  int failed = 0;
+
+  loop.Post([&]() {
+    for (int i = 0; i < kNum; ++i) {
+      uring->Run([](::io_uring_sqe* sqe) { ::io_uring_prep_nop(sqe); },
+                 [&](int res) {
+                   if (res < 0) {
+                     ++failed;
+                   }
+                   if (++completed == kNum) {
+                     loop.Shutdown();
+                   }
+                 });
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(completed == kNum);
+  CATCH_REQUIRE(failed == 0);
+  CATCH_REQUIRE(uring->stats().completed == kNum);
+}
+
+CATCH_TEST_CASE("batched submission", "[io-uring-engine]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  constexpr int kNum = 16;
+  int completed = 0;
+  auto nop = [](::io_uring_sqe* sqe) { ::io_uring_prep_nop(sqe); };
+  auto on_done = [&](int res) {
+    CATCH_REQUIRE(res == 0);
+    if (++completed == 2 * kNum) {
+      loop.Shutdown();
+    }
+  };
+
+  loop.Post([&]() {
+    // the requests within an iteration are submitted together at the end
+    for (int i = 0; i < kNum; ++i) {
+      uring->Run(nop, on_done);
+    }
+    CATCH_REQUIRE(uring->stats().submit_calls == 0);
+
+    asio::post(*loop.proactor(), [&]() {
+      CATCH_REQUIRE(uring->stats().submitted == kNum);
+      CATCH_REQUIRE(uring->stats().submit_calls == 1);
+
+      // and the immediate ones are submitted in place
+      for (int i = 0; i < kNum; ++i) {
+        uring->Run(nop, on_done, IOUringEngine::SubmitMode::kImmediate);
+      }
+      CATCH_REQUIRE(uring->stats().submit_calls == 1 + kNum);
+    });
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(completed == 2 * kNum);
+  CATCH_REQUIRE(uring->stats().submitted == 2 * kNum);
+}
+
+CATCH_TEST_CASE("registered buffers and files", "[io-uring-engine]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+  CATCH_REQUIRE(!uring->RegisterBuffers(2, 1000));
+  CATCH_REQUIRE(uring->RegisterBuffers(2, 1000));
+
+  // the buffers are page aligned, and returned on release
+  auto a = uring->AcquireBuffer();
+  auto b = uring->AcquireBuffer();
+  CATCH_REQUIRE(a);
+  CATCH_REQUIRE(b);
+  CATCH_REQUIRE(a.size() == 4096);
+  CATCH_REQUIRE(reinterpret_cast<std::uintptr_t>(b.data()) % 4096 == 0);
+  CATCH_REQUIRE(!uring->AcquireBuffer());
+
+  auto moved = std::move(b);
+  CATCH_REQUIRE(!b);
+  moved.Release();
+  CATCH_REQUIRE(uring->free_buffers() == 1);
+  b = uring->AcquireBuffer();
+  CATCH_REQUIRE(b);
+
+  char path[] = "/tmp/libz-io-uring-XXXXXX";
+  int fd = ::mkstemp(path);
+  CATCH_REQUIRE(fd >= 0);
+  ::unlink(path);
+
+  auto file = uring->RegisterFile(fd);
+  CATCH_REQUIRE(file);
+
+  std::string content = "hello, fixed buffers";
+  std::memcpy(a.data(), content.data(), content.size());
+  std::optional<Promise<int>> written;
+  std::optional<Promise<int>> read;
+  std::string result;
+
+  loop.Post([&]() {
+    written.emplace(
+        uring->WriteFixed(file.GetResult(), a, content.size(), 100));
+    written->Then(
+        [&](Result<int>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult() == static_cast<int>(content.size()));
+
+          read.emplace(uring->ReadFixed(file.GetResult(), b, b.size(), 100));
+          read->Then(
+              [&](Result<int>&& r) {
+                CATCH_REQUIRE(r);
+                result.assign(b.data(), r.GetResult());
+                loop.Shutdown();
+              },
+              nullptr);
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+  CATCH_REQUIRE(result == content);
+
+  uring->UnregisterFile(file.GetResult());
+  ::close(fd);
+}
+
+// run nops, more than the entries, on an engine of |opts|, it's skipped if
+// the kernel refuses the setup
+void RunNops(const IOUringEngine::Options& opts) {
+  IOMessageLoop loop;
+  auto r = IOUringEngine::Make(&loop, opts);
+  if (!r) {
+    CATCH_WARN("unsupported: " << r.GetError().Details());
+    return;
+  }
+  auto uring = r.PassResult();
+
+  constexpr int kNum = 100;
+  int completed = 0;
+  int failed = 0;
+  loop.Post([&]() {
+    for (int i = 0; i < kNum; ++i) {
+      uring->Run([](::io_uring_sqe* sqe) { ::io_uring_prep_nop(sqe); },
+                 [&](int res) {
+                   if (res < 0) {
+                     ++failed;
+                   }
+                   if (++completed == kNum) {
+                     loop.Shutdown();
+                   }
+                 });
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(completed == kNum);
+  CATCH_REQUIRE(failed == 0);
+  CATCH_REQUIRE(uring->inflight() == 0);
+}
+
+CATCH_TEST_CASE("setup modes", "[io-uring-engine]") {
+  IOUringEngine::Options opts;
+  opts.entries = 32;
+
+  CATCH_SECTION("sqpoll") {
+    opts.sqpoll = true;
+    opts.sq_thread_idle = 10;
+    RunNops(opts);
+
+    opts.sq_thread_cpu = 0;
+    RunNops(opts);
+  }
+
+  CATCH_SECTION("iopoll") {
+    opts.iopoll = true;
+    RunNops(opts);
+  }
+
+  CATCH_SECTION("defer taskrun") {
+    opts.single_issuer = true;
+    RunNops(opts);
+
+    opts.defer_taskrun = true;
+    RunNops(opts);
+  }
+}
+
+CATCH_TEST_CASE("queue depth", "[io-uring-engine]") {
+  IOMessageLoop loop;
+
+  // clamped to the maximum of the kernel
+  IOUringEngine::Options opts;
+  opts.entries = 1 << 30;
+  auto r = IOUringEngine::Make(&loop, opts);
+  CATCH_REQUIRE(r);
+  CATCH_REQUIRE(r.GetResult()->options().entries < opts.entries);
+  CATCH_REQUIRE(r.GetResult()->options().entries >=
+                IOUringEngine::kMinEntries);
+
+  // rounded up to the power of 2
+  opts.entries = 100;
+  r = IOUringEngine::Make(&loop, opts);
+  CATCH_REQUIRE(r);
+  CATCH_REQUIRE(r.GetResult()->options().entries == 128);
+}
+
+CATCH_TEST_CASE("shutdown", "[io-uring-engine]") {
+  int fds[2];
+  CATCH_REQUIRE(::pipe(fds) == 0);
+
+  char buffer[16];
+  std::optional<Error> error;
+  std::optional<Promise<int>> promise;
+
+  {
+    IOMessageLoop loop;
+    auto uring = loop.uring();
+    CATCH_REQUIRE(uring);
+
+    // the read never completes, and it's cancelled on shutdown
+    loop.Post([&]() {
+      promise.emplace(uring->Run([&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_read(sqe, fds[0], buffer, sizeof(buffer), 0);
+      }));
+      promise->Then(
+          [&](Result<int>&& r) {
+            CATCH_REQUIRE(!r);
+            error = r.PassError();
+          },
+          nullptr);
+
+      loop.Shutdown();
+    });
+
+    loop.Run();
+
+    CATCH_REQUIRE(uring->inflight() == 0);
+    CATCH_REQUIRE(uring->is_shutdown());
+
+    // the request after shutdown is rejected in place
+    int res = 0;
+    uring->Run([](::io_uring_sqe* sqe) { ::io_uring_prep_nop(sqe); },
+               [&](int r) { res = r; });
+    CATCH_REQUIRE(res == -ECANCELED);
+  }
+
+  CATCH_REQUIRE(error);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+}  // namespace event
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,499 @@
+#include "io-uring-engine.h"
+
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <asio/post.hpp>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace libz {
+namespace event {
+
+namespace {
+
+constexpr std::size_t kPageSize = 4096;
+
+}  // namespace
+
+Result<std::unique_ptr<IOUringEngine>> IOUringEngine::Make(
+    MessageLoop* loop, const Options& opts) {
+  std::unique_ptr<IOUringEngine> engine(new IOUringEngine(loop, opts));
+  if (auto e = engine->Initialize(); e) {
+    return e;
+  }
+  return engine;
+}
+
+IOUringEngine::IOUringEngine(MessageLoop* loop, const Options& opts)
+    : loop_(loop),
+      opts_(opts),
+      ring_(),
+      ring_initialized_(false),
+      event_(),
+      event_value_(0),
+      head_(nullptr),
+      inflight_(0),
+      submit_scheduled_(false),
+      poll_scheduled_(false),
+      token_(std::make_shared<IOUringEngine*>(this)),
+      buffer_region_(nullptr),
+      buffer_size_(0),
+      free_buffers_(),
+      files_(),
+      free_files_(),
+      shutdown_(false),
+      stats_() {}
+
+IOUringEngine::~IOUringEngine() {
+  // the registered buffers and files are released with the ring, which is
+  // exited by the shutdown. the region is leaked with the ops left, which
+  // the kernel may still write into
+  Shutdown();
+  if (!head_) {
+    ::free(buffer_region_);
+  }
+}
+
+Error IOUringEngine::Initialize() {
+  ::io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  params.flags = opts_.flags | IORING_SETUP_CLAMP;
+
+  if (opts_.sqpoll) {
+    params.flags |= IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = opts_.sq_thread_idle;
+    if (opts_.sq_thread_cpu >= 0) {
+      params.flags |= IORING_SETUP_SQ_AFF;
+      params.sq_thread_cpu = opts_.sq_thread_cpu;
+    }
+  }
+
+  if (opts_.iopoll) {
+    params.flags |= IORING_SETUP_IOPOLL;
+  }
+
+  if (opts_.single_issuer || opts_.defer_taskrun) {
+    params.flags |= IORING_SETUP_SINGLE_ISSUER;
+  }
+
+  if (opts_.defer_taskrun) {
+    params.flags |= IORING_SETUP_DEFER_TASKRUN;
+  }
+
+  // the rings are charged to the locked memory on the old kernels
+  auto entries = std::max(opts_.entries, kMinEntries);
+  for (;;) {
+    auto p = params;
+    auto ret = ::io_uring_queue_init_params(entries, &ring_, &p);
+    if (ret == -ENOMEM && entries > kMinEntries) {
+      entries /= 2;
+      continue;
+    }
+
+    if (ret < 0) {
+      return Error::MkSysError(-ret);
+    }
+
+    opts_.entries = p.sq_entries;
+    break;
+  }
+  ring_initialized_ = true;
+
+  int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0) {
+    return Error::MkSysError(errno);
+  }
+
+  if (auto ret = ::io_uring_register_eventfd(&ring_, fd); ret < 0) {
+    ::close(fd);
+    return Error::MkSysError(-ret);
+  }
+
+  event_.emplace(*loop_->proactor(), fd);
+  WaitEvent();
+  return {};
+}
+
+void IOUringEngine::WaitEvent() {
+  event_->async_wait(asio::posix::stream_descriptor::wait_read,
+                     [this](const asio::error_code& ec) {
+                       if (ec) {
+                         return;
+                       }
+
+                       // the counter is cleared before reaping, so that the
+                       // cqes posted after are signaled again
+                       [[maybe_unused]] auto n =
+                           ::read(event_->native_handle(), &event_value_,
+                                  sizeof(event_value_));
+                       Reap();
+                       WaitEvent();
+                     });
+}
+
+Error IOUringEngine::RegisterBuffers(std::size_t count, std::size_t size) {
+  if (buffer_region_) {
+    return Error::MkSysError(EBUSY);
+  }
+
+  // the buffers are rounded up to the page, so that every one is aligned
+  size = (size + kPageSize - 1) / kPageSize * kPageSize;
+
+  void* region = nullptr;
+  if (auto ret = ::posix_memalign(&region, kPageSize, count * size);
+      ret != 0) {
+    return Error::MkSysError(ret);
+  }
+
+  std::vector<::iovec> iovecs(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    iovecs[i].iov_base = static_cast<char*>(region) + i * size;
+    iovecs[i].iov_len = size;
+  }
+
+  if (auto ret = ::io_uring_register_buffers(&ring_, iovecs.data(), count);
+      ret < 0) {
+    ::free(region);
+    return Error::MkSysError(-ret);
+  }
+
+  buffer_region_ = static_cast<char*>(region);
+  buffer_size_ = size;
+
+  // the lower ones are borrowed first
+  free_buffers_.reserve(count);
+  for (auto i = static_cast<int>(count) - 1; i >= 0; --i) {
+    free_buffers_.push_back(i);
+  }
+  return {};
+}
+
+IOUringBuffer IOUringEngine::AcquireBuffer() {
+  if (free_buffers_.empty()) {
+    return {};
+  }
+
+  auto index = free_buffers_.back();
+  free_buffers_.pop_back();
+  return IOUringBuffer(this, index, buffer_region_ + index * buffer_size_,
+                       buffer_size_);
+}
+
+Result<int> IOUringEngine::RegisterFile(int fd) {
+  if (files_.empty()) {
+    std::vector<int> files(opts_.files, -1);
+    if (auto ret = ::io_uring_register_files(&ring_, files.data(),
+                                             files.size());
+        ret < 0) {
+      return Error::MkSysError(-ret);
+    }
+
+    files_ = std::move(files);
+    free_files_.reserve(files_.size());
+    for (auto i = static_cast<int>(files_.size()) - 1; i >= 0; --i) {
+      free_files_.push_back(i);
+    }
+  }
+
+  if (free_files_.empty()) {
+    return Error::MkSysError(ENFILE);
+  }
+
+  auto file = free_files_.back();
+  if (auto ret = ::io_uring_register_files_update(&ring_, file, &fd, 1);
+      ret < 0) {
+    return Error::MkSysError(-ret);
+  }
+
+  free_files_.pop_back();
+  files_[file] = fd;
+  return file;
+}
+
+void IOUringEngine::UnregisterFile(int file) {
+  DCHECK(file >= 0 && file < static_cast<int>(files_.size()));
+  DCHECK(files_[file] >= 0);
+
+  // the pending requests keep their references to the file, and the table
+  // is gone with the ring after the shutdown
+  if (ring_initialized_) {
+    int fd = -1;
+    ::io_uring_register_files_update(&ring_, file, &fd, 1);
+  }
+
+  files_[file] = -1;
+  free_files_.push_back(file);
+}
+
+Promise<int> IOUringEngine::ReadFixed(int file, const IOUringBuffer& buffer,
+                                      std::size_t len, std::uint64_t offset,
+                                      SubmitMode mode) {
+  DCHECK(buffer && len <= buffer.size());
+  return Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_read_fixed(sqe, file, buffer.data(), len, offset,
+                                   buffer.index());
+        sqe->flags |= IOSQE_FIXED_FILE;
+      },
+      mode);
+}
+
+Promise<int> IOUringEngine::WriteFixed(int file, const IOUringBuffer& buffer,
+                                       std::size_t len, std::uint64_t offset,
+                                       SubmitMode mode) {
+  DCHECK(buffer && len <= buffer.size());
+  return Run(
+      [&](::io_uring_sqe* sqe) {
+        ::io_uring_prep_write_fixed(sqe, file, buffer.data(), len, offset,
+                                    buffer.index());
+        sqe->flags |= IOSQE_FIXED_FILE;
+      },
+      mode);
+}
+
+::io_uring_sqe* IOUringEngine::GetSqe(IOUringOp* op) {
+  auto sqe = ::io_uring_get_sqe(&ring_);
+  if (!sqe) {
+    ++stats_.sq_full;
+    Submit();
+    sqe = ::io_uring_get_sqe(&ring_);
+  }
+
+  // the sqes are consumed by the poller thread asynchronously
+  if (!sqe && (ring_.flags & IORING_SETUP_SQPOLL)) {
+    ::io_uring_sqring_wait(&ring_);
+    sqe = ::io_uring_get_sqe(&ring_);
+  }
+
+  // the kernel refuses the submission while the completion queue overflows,
+  // so that the cqes are reaped in place
+  if (!sqe && Reap() > 0) {
+    sqe = ::io_uring_get_sqe(&ring_);
+  }
+
+  if (sqe) {
+    ::io_uring_sqe_set_data(sqe, op);
+    Link(op);
+
+    // nothing signals the polled completions
+    if (ring_.flags & IORING_SETUP_IOPOLL) {
+      SchedulePoll();
+    }
+  }
+  return sqe;
+}
+
+Error IOUringEngine::Cancel(IOUringOp* op) {
+  // the pending ops are cancelled by the shutdown
+  if (shutdown_) {
+    return {};
+  }
+
+  auto sqe = ::io_uring_get_sqe(&ring_);
+  if (!sqe) {
+    Submit();
+    sqe = ::io_uring_get_sqe(&ring_);
+  }
+
+  if (!sqe) {
+    return Error::MkSysError(EBUSY);
+  }
+
+  // the cancel request has no op
+  ::io_uring_prep_cancel(sqe, op, 0);
+  ::io_uring_sqe_set_data(sqe, nullptr);
+  ScheduleSubmit();
+  return {};
+}
+
+int IOUringEngine::Submit() {
+  auto ret = ::io_uring_submit(&ring_);
+  if (ret > 0) {
+    stats_.submitted += ret;
+    ++stats_.submit_calls;
+  }
+  return ret;
+}
+
+void IOUringEngine::ScheduleSubmit() {
+  if (submit_scheduled_) {
+    return;
+  }
+  submit_scheduled_ = true;
+
+  // the handlers posted within the iteration run before the proactor waits
+  // for the events again
+  asio::post(*loop_->proactor(),
+             [token = std::weak_ptr<IOUringEngine*>(token_)]() {
+               auto self = token.lock();
+               if (!self) {
+                 return;
+               }
+
+               auto engine = *self;
+               engine->submit_scheduled_ = false;
+               if (!engine->shutdown_ &&
+                   ::io_uring_sq_ready(&engine->ring_) > 0) {
+                 engine->Submit();
+               }
+             });
+}
+
+void IOUringEngine::SchedulePoll() {
+  if (poll_scheduled_) {
+    return;
+  }
+  poll_scheduled_ = true;
+
+  // it's posted again while any request is in flight, so that the proactor
+  // doesn't block, and the loop spins
+  asio::post(*loop_->proactor(),
+             [token = std::weak_ptr<IOUringEngine*>(token_)]() {
+               auto self = token.lock();
+               if (!self) {
+                 return;
+               }
+
+               auto engine = *self;
+               engine->poll_scheduled_ = false;
+               if (engine->shutdown_) {
+                 return;
+               }
+
+               engine->Reap();
+               if (engine->inflight_ > 0) {
+                 engine->SchedulePoll();
+               }
+             });
+}
+
+std::size_t IOUringEngine::Reap() {
+  std::size_t n = 0;
+
+  // the ring is exited by the shutdown, which may be invoked by a completion
+  // as well
+  if (!ring_initialized_) {
+    return n;
+  }
+
+  // the polled completions are found, and the deferred completion work is
+  // run, only by entering the kernel
+  if (ring_.flags & (IORING_SETUP_IOPOLL | IORING_SETUP_DEFER_TASKRUN)) {
+    ::io_uring_get_events(&ring_);
+  }
+
+  // the completion may queue new requests, so that the cqe is consumed
+  // before the op is completed
+  ::io_uring_cqe* cqe = nullptr;
+  while (ring_initialized_ && ::io_uring_peek_cqe(&ring_, &cqe) == 0) {
+    auto op = static_cast<IOUringOp*>(::io_uring_cqe_get_data(cqe));
+    auto res = cqe->res;
+    auto flags = cqe->flags;
+    ::io_uring_cqe_seen(&ring_, cqe);
+    ++n;
+
+    // the cancel requests have no op
+    if (!op) {
+      continue;
+    }
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+      Unlink(op);
+    }
+    op->Complete(res, flags);
+  }
+
+  stats_.completed += n;
+  if (!shutdown_ && ::io_uring_sq_ready(&ring_) > 0) {
+    Submit();
+  }
+  return n;
+}
+
+void IOUringEngine::Shutdown() {
+  if (shutdown_) {
+    return;
+  }
+  shutdown_ = true;
+
+  if (event_) {
+    asio::error_code ignored;
+    event_->cancel(ignored);
+  }
+
+  if (!ring_initialized_) {
+    return;
+  }
+
+  for (auto op = head_; op; op = op->next_) {
+    auto sqe = ::io_uring_get_sqe(&ring_);
+    if (!sqe) {
+      ::io_uring_submit(&ring_);
+      sqe = ::io_uring_get_sqe(&ring_);
+    }
+
+    // the sqes are consumed by the poller thread asynchronously
+    if (!sqe && (ring_.flags & IORING_SETUP_SQPOLL)) {
+      ::io_uring_sqring_wait(&ring_);
+      sqe = ::io_uring_get_sqe(&ring_);
+    }
+
+    if (sqe) {
+      ::io_uring_prep_cancel(sqe, op, 0);
+      ::io_uring_sqe_set_data(sqe, nullptr);
+    }
+  }
+  ::io_uring_submit(&ring_);
+
+  // the kernel may write into the buffers of a request until its cqe is
+  // posted, and closing the ring doesn't wait for that, so that every cqe is
+  // waited without a timeout. the cancellation always completes, and the
+  // requests which can't be cancelled, such as the reads of the regular
+  // files, complete on their own
+  while (head_) {
+    ::io_uring_cqe* cqe = nullptr;
+    if (auto ret = ::io_uring_wait_cqe(&ring_, &cqe);
+        ret < 0 && ret != -EINTR) {
+      break;
+    }
+    Reap();
+  }
+
+  // only if the wait fails, the ops left are leaked on purpose, so that
+  // their owners keep the buffers, rather than completed while the kernel
+  // may still use them
+  ::io_uring_queue_exit(&ring_);
+  ring_initialized_ = false;
+}
+
+void IOUringEngine::Link(IOUringOp* op) {
+  op->prev_ = nullptr;
+  op->next_ = head_;
+  if (head_) {
+    head_->prev_ = op;
+  }
+  head_ = op;
+  ++inflight_;
+}
+
+void IOUringEngine::Unlink(IOUringOp* op) {
+  if (op->prev_) {
+    op->prev_->next_ = op->next_;
+  } else {
+    head_ = op->next_;
+  }
+
+  if (op->next_) {
+    op->next_->prev_ = op->prev_;
+  }
+
+  op->prev_ = op->next_ = nullptr;
+  --inflight_;
+}
+
+}  // namespace event
+}  // namespace libz
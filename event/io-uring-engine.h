@@ -0,0 +1,377 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <base/result.h>
+#include <liburing.h>
+
+#include <asio/posix/stream_descriptor.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "message-loop.h"
+#include "promise.h"
+
+namespace libz {
+namespace event {
+
+class IOUringEngine;
+
+// IOUringOp is the context of a request, and it's the user data of the sqe.
+// it's completed once per cqe, and the multishot one stays linked in the
+// engine while the cqe has IORING_CQE_F_MORE. the op owns itself, it's
+// usually deleted in the last Complete.
+class IOUringOp {
+ public:
+  virtual ~IOUringOp() {}
+
+  // |res| is the result of the request, or -errno
+  virtual void Complete(int res, std::uint32_t flags) = 0;
+
+ private:
+  IOUringOp* prev_{nullptr};
+  IOUringOp* next_{nullptr};
+
+  friend IOUringEngine;
+};
+
+namespace _ {
+
+class CallbackOp : public IOUringOp {
+ public:
+  explicit CallbackOp(std::function<void(int)>&& callback)
+      : IOUringOp(), callback_(std::move(callback)) {}
+
+  void Complete(int res, std::uint32_t) override {
+    auto callback = std::move(callback_);
+    delete this;
+    callback(res);
+  }
+
+ private:
+  std::function<void(int)> callback_;
+};
+
+}  // namespace _
+
+// IOUringBuffer is a registered buffer borrowed from the engine, and it's
+// returned to the engine on destruction. the pages of the registered buffers
+// are pinned once on registration, rather than on every READ_FIXED or
+// WRITE_FIXED request.
+//
+// Notes, the engine must outlive the buffers borrowed from it
+class IOUringBuffer {
+ public:
+  IOUringBuffer() = default;
+  inline IOUringBuffer(IOUringBuffer&& other) noexcept;
+  inline IOUringBuffer& operator=(IOUringBuffer&& other) noexcept;
+  ~IOUringBuffer() { Release(); }
+
+ public:
+  // return the buffer to the engine, it must not be used by any pending
+  // request
+  inline void Release();
+
+  explicit operator bool() const { return data_ != nullptr; }
+
+  char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  // the index of the registered buffer, as buf_index of the request
+  int index() const { return index_; }
+
+ private:
+  IOUringBuffer(IOUringEngine* engine, int index, char* data, std::size_t size)
+      : engine_(engine), index_(index), data_(data), size_(size) {}
+
+  IOUringEngine* engine_{nullptr};
+  int index_{-1};
+  char* data_{nullptr};
+  std::size_t size_{0};
+
+  friend IOUringEngine;
+  DISALLOW_COPY_AND_ASSIGN(IOUringBuffer);
+};
+
+// IOUringEngine is the io_uring of a message loop. the completion eventfd is
+// watched by the proactor of the loop, so that the requests are completed,
+// and the promises are resolved, within the loop thread without any lock.
+//
+// the sqes prepared within a loop iteration are submitted together by one
+// io_uring_enter at the end of it, before the loop blocks, unless the request
+// asks to be submitted in place.
+//
+// Notes, the engine is created by IOMessageLoop on the first use, and all
+// methods must be invoked within the loop thread. the buffers of a request
+// must be alive until it's completed. on shutdown, the pending requests are
+// cancelled and waited out. with single_issuer or defer_taskrun, the engine
+// must be created within the loop thread as well
+class IOUringEngine {
+ public:
+  enum class SubmitMode {
+    kBatched,
+
+    // for the latency sensitive requests, it costs a syscall per request
+    kImmediate,
+  };
+
+  struct Options {
+    // the depth of the submission queue. it's clamped to the maximum of the
+    // kernel, and halved while the ring can't be allocated, down to
+    // kMinEntries, such as where the locked memory is limited before 5.12.
+    // the depth in use is in options() after Make, and it's fixed from then
+    // on.
+    //
+    // Notes, the depth isn't tuned with the load. the rings can't be resized
+    // in place before IORING_REGISTER_RESIZE_RINGS (6.13), and a new ring
+    // drops the registered buffers, files and buffer rings, and can only
+    // replace the old one while nothing is in flight, which never happens
+    // to a loop holding the multishot accepts and recvs. a full submission
+    // queue costs only an io_uring_enter in place, see Stats::sq_full
+    unsigned entries{256};
+
+    // the raw flags of io_uring_setup, OR-ed with the ones below
+    unsigned flags{0};
+
+    // a kernel thread polls the submission queue, so that the submission
+    // costs no syscall while the poller is awake. it sleeps after
+    // |sq_thread_idle| ms without any sqe, and it's pinned to
+    // |sq_thread_cpu| if it's not negative
+    bool sqpoll{false};
+    unsigned sq_thread_idle{1000};
+    int sq_thread_cpu{-1};
+
+    // the completions are polled rather than interrupt driven, the loop
+    // spins while any request is in flight. only O_DIRECT read and write on
+    // the block devices with poll queues are supported, the other requests
+    // fail, so that it's for a dedicated engine rather than the one of the
+    // loop
+    bool iopoll{false};
+
+    // only the loop thread submits (6.0), and the completion work is
+    // deferred until the loop reaps (6.1), rather than interrupting the loop
+    // thread at any time. defer_taskrun implies single_issuer, and it can't
+    // be used with sqpoll
+    bool single_issuer{false};
+    bool defer_taskrun{false};
+
+    // the slots of the fixed-file table
+    unsigned files{256};
+  };
+
+  struct Stats {
+    std::uint64_t submitted{0};
+    std::uint64_t completed{0};
+
+    // the calls of io_uring_submit which submit anything
+    std::uint64_t submit_calls{0};
+
+    // the times the submission queue is full on a new request, the sqes
+    // are submitted in place then. the engine doesn't act on it, the caller
+    // may raise Options::entries for the next engine, such as by
+    // set_uring_options of IOMessageLoop before the first use
+    std::uint64_t sq_full{0};
+  };
+
+  static constexpr unsigned kMinEntries = 16;
+
+  static Result<std::unique_ptr<IOUringEngine>> Make(MessageLoop* loop,
+                                                     const Options& opts);
+
+  ~IOUringEngine();
+
+ public:
+  // prepare a request by |prep(sqe)| and submit it. it's resolved with the
+  // non-negative result, or rejected with the errno
+  template <typename Prep>
+  Promise<int> Run(Prep&& prep, SubmitMode mode = SubmitMode::kBatched);
+
+  // the callback version, the callback is invoked with the result or -errno,
+  // and it's invoked in place if the request can't be queued
+  template <typename Prep>
+  void Run(Prep&& prep, std::function<void(int)>&& callback,
+           SubmitMode mode = SubmitMode::kBatched);
+
+  // register |count| buffers of |size| bytes, page aligned, so that they are
+  // usable by O_DIRECT. it can be done only once
+  Error RegisterBuffers(std::size_t count, std::size_t size);
+
+  // borrow a registered buffer, it's empty if all are borrowed
+  IOUringBuffer AcquireBuffer();
+
+  // register |fd| into the fixed-file table, and return the slot, which is
+  // passed as the fd of the request with IOSQE_FIXED_FILE. the table is
+  // registered on the first use. the fd isn't owned by the engine
+  Result<int> RegisterFile(int fd);
+  void UnregisterFile(int file);
+
+  // read into, or write from, the first |len| bytes of the registered buffer
+  // at |offset| of the registered |file|
+  Promise<int> ReadFixed(int file, const IOUringBuffer& buffer,
+                         std::size_t len, std::uint64_t offset,
+                         SubmitMode mode = SubmitMode::kBatched);
+  Promise<int> WriteFixed(int file, const IOUringBuffer& buffer,
+                          std::size_t len, std::uint64_t offset,
+                          SubmitMode mode = SubmitMode::kBatched);
+
+  // the sqe of |op|. if the queue is full, it's submitted first, and the
+  // cqes may be reaped in place. nullptr if the queue is still full
+  ::io_uring_sqe* GetSqe(IOUringOp* op);
+
+  // cancel the pending |op|, it's completed with -ECANCELED, or with the
+  // result if it's done before the cancellation. the cancellation is
+  // submitted at the end of the loop iteration
+  Error Cancel(IOUringOp* op);
+
+  // submit the prepared sqes. if the kernel is busy, they are submitted
+  // again once a request completes
+  int Submit();
+
+  // submit the prepared sqes at the end of the loop iteration
+  void ScheduleSubmit();
+
+  // complete the available cqes, and return the number
+  std::size_t Reap();
+
+  // cancel the pending requests, and wait out all of them without a timeout
+  // before the ring is exited, as the kernel may use their buffers until
+  // they complete. the engine can't be used any more
+  void Shutdown();
+
+  std::size_t inflight() const { return inflight_; }
+  std::size_t free_buffers() const { return free_buffers_.size(); }
+  bool is_shutdown() const { return shutdown_; }
+
+  ::io_uring* ring() { return &ring_; }
+  MessageLoop* loop() const { return loop_; }
+
+  const Options& options() const { return opts_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  IOUringEngine(MessageLoop* loop, const Options& opts);
+
+  Error Initialize();
+  void WaitEvent();
+
+  // poll the completions at the end of the loop iteration, with iopoll
+  void SchedulePoll();
+
+  void Link(IOUringOp* op);
+  void Unlink(IOUringOp* op);
+
+  void ReleaseBuffer(int index) { free_buffers_.push_back(index); }
+
+  MessageLoop* loop_;
+  Options opts_;
+
+  ::io_uring ring_;
+  bool ring_initialized_;
+
+  std::optional<asio::posix::stream_descriptor> event_;
+  std::uint64_t event_value_;
+
+  // the pending ops
+  IOUringOp* head_;
+  std::size_t inflight_;
+
+  // the scheduled submission holds the token weakly, since the engine may be
+  // destroyed before it runs
+  bool submit_scheduled_;
+  bool poll_scheduled_;
+  std::shared_ptr<IOUringEngine*> token_;
+
+  // the registered buffers, they are in one region
+  char* buffer_region_;
+  std::size_t buffer_size_;
+  std::vector<int> free_buffers_;
+
+  // the fixed-file table, the free slot is -1
+  std::vector<int> files_;
+  std::vector<int> free_files_;
+
+  bool shutdown_;
+  Stats stats_;
+
+  friend IOUringBuffer;
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IOUringEngine);
+};
+
+inline IOUringBuffer::IOUringBuffer(IOUringBuffer&& other) noexcept
+    : engine_(other.engine_),
+      index_(other.index_),
+      data_(other.data_),
+      size_(other.size_) {
+  other.engine_ = nullptr;
+  other.data_ = nullptr;
+}
+
+inline IOUringBuffer& IOUringBuffer::operator=(
+    IOUringBuffer&& other) noexcept {
+  if (this != &other) {
+    Release();
+    std::swap(engine_, other.engine_);
+    std::swap(index_, other.index_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+  }
+  return *this;
+}
+
+inline void IOUringBuffer::Release() {
+  if (engine_) {
+    engine_->ReleaseBuffer(index_);
+  }
+
+  engine_ = nullptr;
+  index_ = -1;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+template <typename Prep>
+Promise<int> IOUringEngine::Run(Prep&& prep, SubmitMode mode) {
+  Promise<int> promise;
+  Run(
+      std::forward<Prep>(prep),
+      [resolver = promise.GetResolver()](int res) mutable {
+        if (res < 0) {
+          resolver.Reject(Error::MkSysError(-res));
+        } else {
+          resolver.Resolve(res);
+        }
+      },
+      mode);
+  return promise;
+}
+
+template <typename Prep>
+void IOUringEngine::Run(Prep&& prep, std::function<void(int)>&& callback,
+                        SubmitMode mode) {
+  if (shutdown_) {
+    callback(-ECANCELED);
+    return;
+  }
+
+  auto op = new _::CallbackOp(std::move(callback));
+  auto sqe = GetSqe(op);
+  if (!sqe) {
+    op->Complete(-EBUSY, 0);
+    return;
+  }
+
+  prep(sqe);
+  ::io_uring_sqe_set_data(sqe, op);
+
+  if (mode == SubmitMode::kImmediate) {
+    Submit();
+  } else {
+    ScheduleSubmit();
+  }
+}
+
+}  // namespace event
+}  // namespace libz
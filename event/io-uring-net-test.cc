@@ -0,0 +1,333 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "io-uring-net.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <asio/post.hpp>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io-message-loop.h"
+
+namespace libz {
+namespace event {
+
+// a listener on the loopback, at a port picked by the kernel
+class Listener {
+ public:
+  Listener() {
+    fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    CATCH_REQUIRE(fd_ >= 0);
+
+    ::sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CATCH_REQUIRE(::bind(fd_, reinterpret_cast<::sockaddr*>(&addr),
+                         sizeof(addr)) == 0);
+    CATCH_REQUIRE(::listen(fd_, 16) == 0);
+
+    ::socklen_t len = sizeof(addr_);
+    CATCH_REQUIRE(
+        ::getsockname(fd_, reinterpret_cast<::sockaddr*>(&addr_), &len) == 0);
+  }
+
+  ~Listener() { ::close(fd_); }
+
+  // a blocking client, the connection completes on the backlog
+  int Connect() {
+    auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    CATCH_REQUIRE(fd >= 0);
+    CATCH_REQUIRE(::connect(fd, reinterpret_cast<::sockaddr*>(&addr_),
+                            sizeof(addr_)) == 0);
+    return fd;
+  }
+
+  int fd() const { return fd_; }
+
+ private:
+  int fd_;
+  ::sockaddr_in addr_;
+};
+
+std::string ReadAll(int fd) {
+  std::string received;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    received.append(buffer, n);
+  }
+  return received;
+}
+
+CATCH_TEST_CASE("echo", "[io-uring-net]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  Listener listener;
+  std::string content(64, 'x');
+  for (std::size_t i = 0; i < content.size(); ++i) {
+    content[i] = 'a' + i % 26;
+  }
+
+  constexpr int kClients = 3;
+  std::vector<int> clients;
+  for (int i = 0; i < kClients; ++i) {
+    clients.push_back(listener.Connect());
+    CATCH_REQUIRE(::write(clients.back(), content.data(), content.size()) ==
+                  static_cast<ssize_t>(content.size()));
+    ::shutdown(clients.back(), SHUT_WR);
+  }
+
+  // 2 buffers of 16 bytes for all, the recvs stop on ENOBUFS while the
+  // buffers are held, and they are armed again once given back
+  auto r = IOUringBufferRing::Make(uring, 7, 2, 16);
+  CATCH_REQUIRE(r);
+  auto ring = r.PassResult();
+  CATCH_REQUIRE(ring->count() == 2);
+  CATCH_REQUIRE(ring->available() == 2);
+
+  struct Connection {
+    int fd;
+    std::unique_ptr<IOUringReceiver> receiver;
+    std::string received;
+    bool eof{false};
+  };
+  std::vector<std::unique_ptr<Connection>> conns;
+  std::vector<IOUringProvidedBuffer> held;
+  int sent = 0;
+  int closed = 0;
+
+  IOUringAcceptor acceptor(uring, listener.fd());
+  auto OnReceived = [&](Connection* conn, int res,
+                        IOUringProvidedBuffer&& buffer) {
+    if (res <= 0) {
+      CATCH_REQUIRE(res == 0);
+      conn->eof = true;
+
+      // echo all back, from the buffer of the connection
+      SendZeroCopy(uring, conn->fd, conn->received.data(),
+                   conn->received.size(), [&, conn](int res) {
+                     CATCH_REQUIRE(res ==
+                                   static_cast<int>(conn->received.size()));
+                     ::close(conn->fd);
+                     if (++sent == kClients) {
+                       loop.Shutdown();
+                     }
+                   });
+      conn->receiver.reset();
+      ++closed;
+      return;
+    }
+
+    CATCH_REQUIRE(buffer.size() == static_cast<std::size_t>(res));
+    conn->received.append(buffer.view());
+
+    // hold the buffers until the ring runs out, and give them back at the
+    // end of the iteration
+    held.push_back(std::move(buffer));
+    if (held.size() == ring->count()) {
+      CATCH_REQUIRE(ring->available() == 0);
+      asio::post(*loop.proactor(), [&]() { held.clear(); });
+    }
+  };
+
+  loop.Post([&]() {
+    auto e = acceptor.Start([&](int fd) {
+      CATCH_REQUIRE(fd >= 0);
+      auto conn = std::make_unique<Connection>();
+      conn->fd = fd;
+      conn->receiver = std::make_unique<IOUringReceiver>(uring, ring, fd);
+      auto e = conn->receiver->Start(
+          [&, conn = conn.get()](int res, IOUringProvidedBuffer&& buffer) {
+            OnReceived(conn, res, std::move(buffer));
+          });
+      CATCH_REQUIRE(!e);
+      conns.push_back(std::move(conn));
+
+      if (conns.size() == kClients) {
+        acceptor.Stop();
+      }
+    });
+    CATCH_REQUIRE(!e);
+    CATCH_REQUIRE(acceptor.is_started());
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(!acceptor.is_started());
+  CATCH_REQUIRE(conns.size() == kClients);
+  CATCH_REQUIRE(closed == kClients);
+  CATCH_REQUIRE(sent == kClients);
+  for (auto& conn : conns) {
+    CATCH_REQUIRE(conn->eof);
+    CATCH_REQUIRE(conn->received == content);
+  }
+  CATCH_REQUIRE(ring->available() == ring->count());
+
+  for (auto fd : clients) {
+    CATCH_REQUIRE(ReadAll(fd) == content);
+    ::close(fd);
+  }
+}
+
+CATCH_TEST_CASE("stop", "[io-uring-net]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  Listener listener;
+  auto client = listener.Connect();
+
+  auto r = IOUringBufferRing::Make(uring, 3, 4, 64);
+  CATCH_REQUIRE(r);
+  auto ring = r.PassResult();
+
+  int accepted = -1;
+  int received = 0;
+  std::unique_ptr<IOUringReceiver> receiver;
+  TimerToken settled;
+  IOUringAcceptor acceptor(uring, listener.fd());
+
+  loop.Post([&]() {
+    CATCH_REQUIRE(!acceptor.Start([&](int fd) {
+      CATCH_REQUIRE(fd >= 0);
+      accepted = fd;
+      acceptor.Stop();
+      CATCH_REQUIRE(!acceptor.is_started());
+
+      receiver = std::make_unique<IOUringReceiver>(uring, ring, fd);
+      CATCH_REQUIRE(!receiver->Start(
+          [&](int res, IOUringProvidedBuffer&&) { ++received; }));
+      CATCH_REQUIRE(receiver->Start([](int, IOUringProvidedBuffer&&) {}));
+
+      // the data after is given back to the ring by the detached recv
+      receiver->Stop();
+      CATCH_REQUIRE(!receiver->is_started());
+      CATCH_REQUIRE(::write(client, "hello", 5) == 5);
+      settled = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                   MilliSeconds(100));
+    }));
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(accepted >= 0);
+  CATCH_REQUIRE(received == 0);
+  CATCH_REQUIRE(ring->available() == ring->count());
+
+  receiver.reset();
+  ::close(accepted);
+  ::close(client);
+}
+
+CATCH_TEST_CASE("buffers given back within the callback", "[io-uring-net]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  int fds[2];
+  CATCH_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  std::string content(64, 'y');
+  CATCH_REQUIRE(::write(fds[1], content.data(), content.size()) ==
+                static_cast<ssize_t>(content.size()));
+  ::shutdown(fds[1], SHUT_WR);
+
+  auto r = IOUringBufferRing::Make(uring, 5, 2, 16);
+  CATCH_REQUIRE(r);
+  auto ring = r.PassResult();
+
+  std::string received;
+  bool eof = false;
+  std::vector<IOUringProvidedBuffer> held;
+  IOUringReceiver receiver(uring, ring, fds[0]);
+
+  loop.Post([&]() {
+    CATCH_REQUIRE(!receiver.Start([&](int res,
+                                      IOUringProvidedBuffer&& buffer) {
+      if (res <= 0) {
+        CATCH_REQUIRE(res == 0);
+        eof = true;
+        loop.Shutdown();
+        return;
+      }
+
+      // the ring runs out, and the buffers are given back in place, before
+      // the recv ends with ENOBUFS, nothing is given back after that
+      received.append(buffer.view());
+      held.push_back(std::move(buffer));
+      if (held.size() == ring->count()) {
+        held.clear();
+      }
+    }));
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(eof);
+  CATCH_REQUIRE(received == content);
+  CATCH_REQUIRE(ring->available() == ring->count());
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+CATCH_TEST_CASE("send zero copy", "[io-uring-net]") {
+  IOMessageLoop loop;
+  auto uring = loop.uring();
+  CATCH_REQUIRE(uring);
+
+  int fds[2];
+  CATCH_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  std::string content(1 << 16, 'z');
+  std::optional<Promise<int>> promise;
+  int result = 0;
+
+  loop.Post([&]() {
+    promise.emplace(
+        SendZeroCopy(uring, fds[0], content.data(), content.size()));
+    promise->Then(
+        [&](Result<int>&& r) {
+          // unix sockets don't support the zero copy, but the data is sent
+          // by copying as well, or it fails with EOPNOTSUPP on the old
+          // kernels
+          if (r) {
+            result = r.GetResult();
+          } else {
+            result = -1;
+          }
+          loop.Shutdown();
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(result != 0);
+  if (result > 0) {
+    CATCH_REQUIRE(result == static_cast<int>(content.size()));
+    ::shutdown(fds[0], SHUT_WR);
+    CATCH_REQUIRE(ReadAll(fds[1]) == content);
+  }
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+}  // namespace event
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,404 @@
+#include "io-uring-net.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace libz {
+namespace event {
+
+namespace {
+
+constexpr unsigned kMaxRingEntries = 1 << 15;
+
+constexpr std::size_t kPageSize = 4096;
+
+// the op of SendZeroCopy, the result comes first, and the notification
+// after the buffer is released
+class SendZeroCopyOp : public IOUringOp {
+ public:
+  explicit SendZeroCopyOp(std::function<void(int)>&& callback)
+      : IOUringOp(), callback_(std::move(callback)), result_(0) {}
+
+  void Complete(int res, std::uint32_t flags) override {
+    if (!(flags & IORING_CQE_F_NOTIF)) {
+      result_ = res;
+      if (flags & IORING_CQE_F_MORE) {
+        return;
+      }
+    }
+
+    auto callback = std::move(callback_);
+    auto result = result_;
+    delete this;
+    callback(result);
+  }
+
+ private:
+  std::function<void(int)> callback_;
+  int result_;
+};
+
+}  // namespace
+
+IOUringProvidedBuffer::IOUringProvidedBuffer(
+    IOUringProvidedBuffer&& other) noexcept
+    : ring_(other.ring_),
+      id_(other.id_),
+      data_(other.data_),
+      size_(other.size_) {
+  other.ring_ = nullptr;
+  other.data_ = nullptr;
+}
+
+IOUringProvidedBuffer& IOUringProvidedBuffer::operator=(
+    IOUringProvidedBuffer&& other) noexcept {
+  if (this != &other) {
+    Release();
+    std::swap(ring_, other.ring_);
+    std::swap(id_, other.id_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+  }
+  return *this;
+}
+
+void IOUringProvidedBuffer::Release() {
+  if (ring_) {
+    ring_->Recycle(id_);
+  }
+
+  ring_ = nullptr;
+  id_ = -1;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+Result<std::shared_ptr<IOUringBufferRing>> IOUringBufferRing::Make(
+    IOUringEngine* uring, std::uint16_t group, unsigned count,
+    std::size_t size) {
+  unsigned entries = 1;
+  while (entries < count && entries < kMaxRingEntries) {
+    entries <<= 1;
+  }
+
+  std::shared_ptr<IOUringBufferRing> ring(
+      new IOUringBufferRing(uring, group, entries, size));
+  if (auto e = ring->Initialize(); e) {
+    return e;
+  }
+  return ring;
+}
+
+IOUringBufferRing::IOUringBufferRing(IOUringEngine* uring,
+                                     std::uint16_t group, unsigned count,
+                                     std::size_t size)
+    : uring_(uring),
+      group_(group),
+      count_(count),
+      size_(size),
+      ring_(nullptr),
+      ring_size_(0),
+      registered_(false),
+      buffers_(nullptr),
+      taken_(0),
+      waiters_() {}
+
+IOUringBufferRing::~IOUringBufferRing() {
+  // the buffer ring is unregistered with the ring on shutdown
+  if (registered_ && !uring_->is_shutdown()) {
+    ::io_uring_unregister_buf_ring(uring_->ring(), group_);
+  }
+
+  if (ring_) {
+    ::munmap(ring_, ring_size_);
+  }
+  ::free(buffers_);
+}
+
+Error IOUringBufferRing::Initialize() {
+  // the ring is shared with the kernel, it must be page aligned
+  ring_size_ = count_ * sizeof(::io_uring_buf);
+  auto ring = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    return Error::MkSysError(errno);
+  }
+  ring_ = static_cast<::io_uring_buf_ring*>(ring);
+  ::io_uring_buf_ring_init(ring_);
+
+  ::io_uring_buf_reg reg{};
+  reg.ring_addr = reinterpret_cast<std::uint64_t>(ring_);
+  reg.ring_entries = count_;
+  reg.bgid = group_;
+  if (auto ret = ::io_uring_register_buf_ring(uring_->ring(), &reg, 0);
+      ret < 0) {
+    return Error::MkSysError(-ret);
+  }
+  registered_ = true;
+
+  void* buffers = nullptr;
+  if (auto ret = ::posix_memalign(&buffers, kPageSize, count_ * size_);
+      ret != 0) {
+    return Error::MkSysError(ret);
+  }
+  buffers_ = static_cast<char*>(buffers);
+
+  auto mask = ::io_uring_buf_ring_mask(count_);
+  for (unsigned i = 0; i < count_; ++i) {
+    ::io_uring_buf_ring_add(ring_, buffers_ + i * size_, size_, i, mask, i);
+  }
+  ::io_uring_buf_ring_advance(ring_, count_);
+  return {};
+}
+
+IOUringProvidedBuffer IOUringBufferRing::Take(int res, std::uint32_t flags) {
+  DCHECK(flags & IORING_CQE_F_BUFFER);
+
+  int id = flags >> IORING_CQE_BUFFER_SHIFT;
+  ++taken_;
+  return IOUringProvidedBuffer(this, id, buffers_ + id * size_,
+                               res > 0 ? res : 0);
+}
+
+void IOUringBufferRing::Recycle(int id) {
+  ::io_uring_buf_ring_add(ring_, buffers_ + id * size_, size_, id,
+                          ::io_uring_buf_ring_mask(count_), 0);
+  ::io_uring_buf_ring_advance(ring_, 1);
+  --taken_;
+
+  // the waiters may wait again
+  if (!waiters_.empty()) {
+    auto waiters = std::move(waiters_);
+    waiters_.clear();
+    for (auto& waiter : waiters) {
+      waiter();
+    }
+  }
+}
+
+Error IOUringAcceptor::Start(Callback&& callback) {
+  if (op_) {
+    return Error::MkSysError(EBUSY);
+  }
+
+  callback_ = std::move(callback);
+  return Arm();
+}
+
+void IOUringAcceptor::Stop() {
+  if (!op_) {
+    return;
+  }
+
+  op_->Detach([](int res, std::uint32_t) {
+    if (res >= 0) {
+      ::close(res);
+    }
+  });
+  uring_->Cancel(op_);
+  op_ = nullptr;
+}
+
+Error IOUringAcceptor::Arm() {
+  if (uring_->is_shutdown()) {
+    return Error::MkSysError(ECANCELED);
+  }
+
+  auto op = new _::MultishotOp(
+      [this](int res, std::uint32_t flags) { OnAccepted(res, flags); });
+  auto sqe = uring_->GetSqe(op);
+  if (!sqe) {
+    delete op;
+    return Error::MkSysError(EBUSY);
+  }
+
+  ::io_uring_prep_multishot_accept(sqe, listen_fd_, nullptr, nullptr,
+                                   SOCK_NONBLOCK | SOCK_CLOEXEC);
+  ::io_uring_sqe_set_data(sqe, op);
+  uring_->ScheduleSubmit();
+
+  op_ = op;
+  return {};
+}
+
+void IOUringAcceptor::OnAccepted(int res, std::uint32_t flags) {
+  if (!(flags & IORING_CQE_F_MORE)) {
+    op_ = nullptr;
+
+    // the kernel ends the multishot accept on the overflow of the
+    // completion queue as well, it's armed again
+    if (res >= 0) {
+      if (auto e = Arm(); e) {
+        callback_(res);
+        callback_(-e.code());
+        return;
+      }
+    }
+  }
+
+  callback_(res);
+}
+
+IOUringReceiver::IOUringReceiver(IOUringEngine* uring,
+                                 std::shared_ptr<IOUringBufferRing> ring,
+                                 int fd)
+    : uring_(uring),
+      ring_(std::move(ring)),
+      fd_(fd),
+      op_(nullptr),
+      started_(false),
+      callback_(),
+      token_(std::make_shared<IOUringReceiver*>(this)) {}
+
+IOUringReceiver::~IOUringReceiver() { Stop(); }
+
+Error IOUringReceiver::Start(Callback&& callback) {
+  if (started_) {
+    return Error::MkSysError(EBUSY);
+  }
+
+  callback_ = std::move(callback);
+  started_ = true;
+  if (auto e = Arm(); e) {
+    started_ = false;
+    return e;
+  }
+  return {};
+}
+
+void IOUringReceiver::Stop() {
+  if (!started_) {
+    return;
+  }
+  started_ = false;
+
+  if (op_) {
+    // the buffers picked after are given back
+    op_->Detach([ring = ring_](int res, std::uint32_t flags) {
+      if (flags & IORING_CQE_F_BUFFER) {
+        ring->Take(res, flags).Release();
+      }
+    });
+    uring_->Cancel(op_);
+    op_ = nullptr;
+  }
+}
+
+Error IOUringReceiver::Arm() {
+  if (uring_->is_shutdown()) {
+    return Error::MkSysError(ECANCELED);
+  }
+
+  auto op = new _::MultishotOp(
+      [this](int res, std::uint32_t flags) { OnReceived(res, flags); });
+  auto sqe = uring_->GetSqe(op);
+  if (!sqe) {
+    delete op;
+    return Error::MkSysError(EBUSY);
+  }
+
+  ::io_uring_prep_recv_multishot(sqe, fd_, nullptr, 0, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = ring_->group();
+  ::io_uring_sqe_set_data(sqe, op);
+  uring_->ScheduleSubmit();
+
+  op_ = op;
+  return {};
+}
+
+void IOUringReceiver::OnReceived(int res, std::uint32_t flags) {
+  IOUringProvidedBuffer buffer;
+  if (flags & IORING_CQE_F_BUFFER) {
+    buffer = ring_->Take(res, flags);
+  }
+
+  if (flags & IORING_CQE_F_MORE) {
+    callback_(res, std::move(buffer));
+    return;
+  }
+  op_ = nullptr;
+
+  // the buffers may be given back within the callbacks of the cqes before
+  // this one, it's armed again in place then, or once a buffer is given back
+  if (res == -ENOBUFS) {
+    if (ring_->available() > 0) {
+      Resume();
+      return;
+    }
+
+    ring_->OnAvailable([token = std::weak_ptr<IOUringReceiver*>(token_)]() {
+      if (auto self = token.lock(); self) {
+        (*self)->Resume();
+      }
+    });
+    return;
+  }
+
+  // the kernel ends the multishot recv on the overflow of the completion
+  // queue as well, it's armed again
+  if (res > 0) {
+    if (auto e = Arm(); !e) {
+      callback_(res, std::move(buffer));
+      return;
+    }
+    callback_(res, std::move(buffer));
+    res = -EBUSY;
+  }
+
+  // the last one, the receiver may be destroyed within the callback
+  started_ = false;
+  auto callback = std::move(callback_);
+  callback(res, std::move(buffer));
+}
+
+void IOUringReceiver::Resume() {
+  if (!started_ || op_) {
+    return;
+  }
+
+  if (auto e = Arm(); e) {
+    started_ = false;
+    callback_(-e.code(), {});
+  }
+}
+
+void SendZeroCopy(IOUringEngine* uring, int fd, const void* data,
+                  std::size_t len, std::function<void(int)>&& callback) {
+  if (uring->is_shutdown()) {
+    callback(-ECANCELED);
+    return;
+  }
+
+  auto op = new SendZeroCopyOp(std::move(callback));
+  auto sqe = uring->GetSqe(op);
+  if (!sqe) {
+    op->Complete(-EBUSY, 0);
+    return;
+  }
+
+  ::io_uring_prep_send_zc(sqe, fd, data, len, MSG_NOSIGNAL, 0);
+  ::io_uring_sqe_set_data(sqe, op);
+  uring->ScheduleSubmit();
+}
+
+Promise<int> SendZeroCopy(IOUringEngine* uring, int fd, const void* data,
+                          std::size_t len) {
+  Promise<int> promise;
+  SendZeroCopy(uring, fd, data, len,
+               [resolver = promise.GetResolver()](int res) mutable {
+                 if (res < 0) {
+                   resolver.Reject(Error::MkSysError(-res));
+                 } else {
+                   resolver.Resolve(res);
+                 }
+               });
+  return promise;
+}
+
+}  // namespace event
+}  // namespace libz
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <base/result.h>
+#include <liburing.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "io-uring-engine.h"
+#include "promise.h"
+
+namespace libz {
+namespace event {
+
+class IOUringBufferRing;
+
+namespace _ {
+
+// the op of a multishot request, the callback is invoked per cqe, and the
+// op is deleted after the last one, which is without IORING_CQE_F_MORE
+class MultishotOp : public IOUringOp {
+ public:
+  using Callback = std::function<void(int, std::uint32_t)>;
+
+  explicit MultishotOp(Callback&& callback)
+      : IOUringOp(), callback_(std::move(callback)) {}
+
+  void Complete(int res, std::uint32_t flags) override {
+    auto& callback = detached_ ? detached_ : callback_;
+    if (flags & IORING_CQE_F_MORE) {
+      callback(res, flags);
+      return;
+    }
+
+    auto last = std::move(callback);
+    delete this;
+    last(res, flags);
+  }
+
+  // the owner is gone, even within the callback, and the rest of the cqes
+  // are handled by |callback|
+  void Detach(Callback&& callback) { detached_ = std::move(callback); }
+
+ private:
+  Callback callback_;
+  Callback detached_;
+};
+
+}  // namespace _
+
+// IOUringProvidedBuffer is a buffer of a ring which the kernel picked for a
+// recv, and it's given back to the ring on destruction, so that the kernel
+// can pick it again.
+//
+// Notes, the ring must outlive the buffers taken from it
+class IOUringProvidedBuffer {
+ public:
+  IOUringProvidedBuffer() = default;
+  IOUringProvidedBuffer(IOUringProvidedBuffer&& other) noexcept;
+  IOUringProvidedBuffer& operator=(IOUringProvidedBuffer&& other) noexcept;
+  ~IOUringProvidedBuffer() { Release(); }
+
+ public:
+  void Release();
+
+  explicit operator bool() const { return data_ != nullptr; }
+
+  // the bytes received
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  std::string_view view() const { return {data_, size_}; }
+
+ private:
+  IOUringProvidedBuffer(IOUringBufferRing* ring, int id, const char* data,
+                        std::size_t size)
+      : ring_(ring), id_(id), data_(data), size_(size) {}
+
+  IOUringBufferRing* ring_{nullptr};
+  int id_{-1};
+  const char* data_{nullptr};
+  std::size_t size_{0};
+
+  friend IOUringBufferRing;
+  DISALLOW_COPY_AND_ASSIGN(IOUringProvidedBuffer);
+};
+
+// IOUringBufferRing is a ring of the provided buffers (5.19), the kernel
+// picks one when the data arrives, rather than a buffer is held by every
+// pending recv, so that the idle connections cost no buffer.
+//
+// Notes, it's shared by the receivers, and the engine must outlive it
+class IOUringBufferRing {
+ public:
+  // |count| is rounded up to the power of 2
+  static Result<std::shared_ptr<IOUringBufferRing>> Make(
+      IOUringEngine* uring, std::uint16_t group, unsigned count,
+      std::size_t size);
+
+  ~IOUringBufferRing();
+
+ public:
+  // the buffer picked for the cqe of |res| bytes with |flags|
+  IOUringProvidedBuffer Take(int res, std::uint32_t flags);
+
+  // give the buffer of |id| back to the kernel
+  void Recycle(int id);
+
+  // invoke |callback| once a buffer is given back, for the recv which
+  // stopped on ENOBUFS
+  void OnAvailable(std::function<void()>&& callback) {
+    waiters_.push_back(std::move(callback));
+  }
+
+  std::uint16_t group() const { return group_; }
+  unsigned count() const { return count_; }
+  std::size_t buffer_size() const { return size_; }
+
+  // the buffers owned by the kernel
+  unsigned available() const { return count_ - taken_; }
+
+ private:
+  IOUringBufferRing(IOUringEngine* uring, std::uint16_t group,
+                    unsigned count, std::size_t size);
+
+  Error Initialize();
+
+  IOUringEngine* uring_;
+  std::uint16_t group_;
+  unsigned count_;
+  std::size_t size_;
+
+  ::io_uring_buf_ring* ring_;
+  std::size_t ring_size_;
+  bool registered_;
+  char* buffers_;
+
+  unsigned taken_;
+  std::vector<std::function<void()>> waiters_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IOUringBufferRing);
+};
+
+// IOUringAcceptor accepts the connections by one multishot accept (5.19),
+// which stays armed for all of them, rather than a request per connection.
+//
+// Notes, the accepted fds are non-blocking and close-on-exec
+class IOUringAcceptor {
+ public:
+  // |fd| is the accepted one, or -errno, and the acceptor stops on error
+  using Callback = std::function<void(int fd)>;
+
+  IOUringAcceptor(IOUringEngine* uring, int listen_fd)
+      : uring_(uring), listen_fd_(listen_fd), op_(nullptr), callback_() {}
+  ~IOUringAcceptor() { Stop(); }
+
+ public:
+  Error Start(Callback&& callback);
+
+  // the connections accepted after are closed
+  void Stop();
+
+  bool is_started() const { return op_ != nullptr; }
+
+ private:
+  Error Arm();
+  void OnAccepted(int res, std::uint32_t flags);
+
+  IOUringEngine* uring_;
+  int listen_fd_;
+  _::MultishotOp* op_;
+  Callback callback_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IOUringAcceptor);
+};
+
+// IOUringReceiver receives by one multishot recv (6.0) into the buffers
+// picked from the ring, there is no syscall per recv.
+//
+// the recv is armed again if the ring runs out of the buffers, once one is
+// given back.
+//
+// Notes, the fd isn't owned by the receiver
+class IOUringReceiver {
+ public:
+  // |res| is the bytes received into |buffer|, 0 on eof, or -errno. the
+  // receiver stops on eof or error, and it may be destroyed within the
+  // callback then, but only stopped within the others
+  using Callback = std::function<void(int res, IOUringProvidedBuffer&&)>;
+
+  IOUringReceiver(IOUringEngine* uring,
+                  std::shared_ptr<IOUringBufferRing> ring, int fd);
+  ~IOUringReceiver();
+
+ public:
+  Error Start(Callback&& callback);
+  void Stop();
+
+  bool is_started() const { return started_; }
+  int fd() const { return fd_; }
+
+ private:
+  Error Arm();
+  void OnReceived(int res, std::uint32_t flags);
+
+  // arm the recv stopped on ENOBUFS again, unless it's stopped by the user
+  void Resume();
+
+  IOUringEngine* uring_;
+  std::shared_ptr<IOUringBufferRing> ring_;
+  int fd_;
+
+  _::MultishotOp* op_;
+  bool started_;
+  Callback callback_;
+
+  // the waiter of the ring holds it weakly
+  std::shared_ptr<IOUringReceiver*> token_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(IOUringReceiver);
+};
+
+// send |data| by IORING_OP_SEND_ZC (6.0), the pages are sent in place
+// rather than copied into the kernel. the callback is invoked with the bytes
+// sent, or -errno, after the kernel releases the buffer, which is after the
+// data is acknowledged by the peer on tcp, so that it's worth it only for
+// the large sends. the buffer must be alive until then
+void SendZeroCopy(IOUringEngine* uring, int fd, const void* data,
+                  std::size_t len, std::function<void(int)>&& callback);
+Promise<int> SendZeroCopy(IOUringEngine* uring, int fd, const void* data,
+                          std::size_t len);
+
+}  // namespace event
+}  // namespace libz
@@ -0,0 +1,168 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "mapped-file.h"
+
+#include <unistd.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "coroutine.h"
+#include "io-message-loop.h"
+
+namespace libz {
+namespace event {
+
+// a temp file of |content|, it's removed on destruction
+class TempFile {
+ public:
+  explicit TempFile(const std::string& content) {
+    char path[] = "/tmp/libz-mapped-file-XXXXXX";
+    auto fd = ::mkstemp(path);
+    CATCH_REQUIRE(fd >= 0);
+    CATCH_REQUIRE(::write(fd, content.data(), content.size()) ==
+                  static_cast<ssize_t>(content.size()));
+    ::close(fd);
+    path_ = path;
+  }
+
+  ~TempFile() { ::unlink(path_.c_str()); }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+std::string MkContent(std::size_t size) {
+  std::string content(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    content[i] = 'a' + i % 26;
+  }
+  return content;
+}
+
+std::vector<std::string> BackendNames() {
+#ifdef ENABLE_IOURING
+  return {"thread-pool", "io_uring"};
+#else
+  return {"thread-pool"};
+#endif
+}
+
+std::unique_ptr<FileBackend> MkBackend(IOMessageLoop* loop,
+                                       const std::string& name) {
+#ifdef ENABLE_IOURING
+  if (name == "io_uring") {
+    CATCH_REQUIRE(loop->uring());
+    return std::make_unique<IOUringFileBackend>(loop->uring());
+  }
+#endif
+  return std::make_unique<ThreadPoolFileBackend>(loop);
+}
+
+CATCH_TEST_CASE("map and view", "[mapped-file]") {
+  auto content = MkContent(10000);
+  TempFile temp(content);
+
+  auto r = MappedFile::Open(temp.path());
+  CATCH_REQUIRE(r);
+  auto file = r.PassResult();
+  CATCH_REQUIRE(file.size() == content.size());
+  CATCH_REQUIRE(file.view() == content);
+
+  // the views are clamped to the file
+  CATCH_REQUIRE(file.view(26, 3) == "abc");
+  CATCH_REQUIRE(file.view(9998, 10) == content.substr(9998));
+  CATCH_REQUIRE(file.view(20000, 10).empty());
+
+  CATCH_REQUIRE(!file.Advise(MappedFile::Advice::kSequential));
+  CATCH_REQUIRE(!file.Advise(MappedFile::Advice::kRandom, 5000, 100));
+  CATCH_REQUIRE(!file.Advise(MappedFile::Advice::kWillNeed, 4096));
+  CATCH_REQUIRE(!file.Advise(MappedFile::Advice::kNormal, 20000));
+
+  auto moved = std::move(file);
+  CATCH_REQUIRE(file.empty());
+  CATCH_REQUIRE(moved.view() == content);
+  moved.Unmap();
+  CATCH_REQUIRE(moved.empty());
+}
+
+CATCH_TEST_CASE("map options", "[mapped-file]") {
+  auto content = MkContent(3 << 20);
+  TempFile temp(content);
+
+  // the mapping is aligned to the huge page
+  MappedFile::Options opts;
+  opts.huge_pages = true;
+  opts.populate = true;
+  opts.advice = MappedFile::Advice::kRandom;
+  auto r = MappedFile::Open(temp.path(), opts);
+  CATCH_REQUIRE(r);
+  auto file = r.PassResult();
+  CATCH_REQUIRE(reinterpret_cast<std::uintptr_t>(file.data()) %
+                    MappedFile::kHugePageSize ==
+                0);
+  CATCH_REQUIRE(file.view() == content);
+
+  TempFile empty("");
+  r = MappedFile::Open(empty.path());
+  CATCH_REQUIRE(r);
+  CATCH_REQUIRE(r.GetResult().empty());
+
+  CATCH_REQUIRE(!MappedFile::Open("/not/exist"));
+}
+
+void Prefetch(const std::string& name) {
+  IOMessageLoop loop;
+  auto backend = MkBackend(&loop, name);
+
+  // more than a chunk
+  auto content = MkContent(MappedFile::kPrefetchChunk + (1 << 20) + 123);
+  TempFile temp(content);
+
+  auto r = MappedFile::Open(temp.path());
+  CATCH_REQUIRE(r);
+  auto file = r.PassResult();
+
+  bool done = false;
+  loop.Post([&]() {
+    [](IOMessageLoop* loop, FileBackend* backend, MappedFile* file,
+       bool* done) -> Notifier {
+      auto e = co_await file->Prefetch(backend);
+      CATCH_REQUIRE(!e);
+
+      e = co_await file->Prefetch(backend, 4097, 10000);
+      CATCH_REQUIRE(!e);
+
+      // the empty range is settled in place
+      e = co_await file->Prefetch(backend, file->size());
+      CATCH_REQUIRE(!e);
+
+      *done = true;
+      loop->Shutdown();
+      co_return {};
+    }(&loop, backend.get(), &file, &done);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(done);
+  CATCH_REQUIRE(file.view() == content);
+}
+
+CATCH_TEST_CASE("prefetch", "[mapped-file]") {
+  for (auto& name : BackendNames()) {
+    CATCH_INFO("backend " << name);
+    Prefetch(name);
+  }
+}
+
+}  // namespace event
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,239 @@
+#include "mapped-file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+
+namespace libz {
+namespace event {
+
+namespace {
+
+std::size_t PageSize() {
+  static const std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+
+int ToMadvise(MappedFile::Advice advice) {
+  switch (advice) {
+    case MappedFile::Advice::kSequential:
+      return MADV_SEQUENTIAL;
+    case MappedFile::Advice::kRandom:
+      return MADV_RANDOM;
+    case MappedFile::Advice::kWillNeed:
+      return MADV_WILLNEED;
+    case MappedFile::Advice::kDontNeed:
+      return MADV_DONTNEED;
+    default:
+      return MADV_NORMAL;
+  }
+}
+
+// map |size| bytes of |fd| at the huge page. the address space is reserved
+// with a huge page more, and the parts around the aligned mapping are
+// returned
+void* MapAligned(int fd, std::size_t size, int flags) {
+  auto reserved_size = size + MappedFile::kHugePageSize;
+  auto reserved = ::mmap(nullptr, reserved_size, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reserved == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+
+  auto begin = reinterpret_cast<std::uintptr_t>(reserved);
+  auto aligned = (begin + MappedFile::kHugePageSize - 1) /
+                 MappedFile::kHugePageSize * MappedFile::kHugePageSize;
+  auto data = ::mmap(reinterpret_cast<void*>(aligned), size, PROT_READ,
+                     flags | MAP_FIXED, fd, 0);
+  if (data == MAP_FAILED) {
+    auto e = errno;
+    ::munmap(reserved, reserved_size);
+    errno = e;
+    return MAP_FAILED;
+  }
+
+  auto mapped_end =
+      aligned + (size + PageSize() - 1) / PageSize() * PageSize();
+  if (aligned > begin) {
+    ::munmap(reserved, aligned - begin);
+  }
+  if (begin + reserved_size > mapped_end) {
+    ::munmap(reinterpret_cast<void*>(mapped_end),
+             begin + reserved_size - mapped_end);
+  }
+  return data;
+}
+
+// the state of Prefetch shared by the chunks
+struct PrefetchState {
+  std::size_t inflight;
+  Error error;
+  NotifierResolver resolver;
+};
+
+// settle the prefetch after the last chunk
+void Settle(PrefetchState* state) {
+  if (--state->inflight > 0) {
+    return;
+  }
+
+  if (state->error) {
+    state->resolver.Reject(std::move(state->error));
+  } else {
+    state->resolver.Resolve();
+  }
+}
+
+void PrefetchChunk(FileBackend* backend,
+                   const std::shared_ptr<PrefetchState>& state, char* addr,
+                   std::size_t len, int advice) {
+  ++state->inflight;
+  backend->Madvise(addr, len, advice, [=](long res) {
+    // MADV_POPULATE_READ is unknown before 5.14, the pages are read ahead
+    // into the page cache instead, and mapped by the minor faults
+    if (res == -EINVAL && advice == MADV_POPULATE_READ) {
+      PrefetchChunk(backend, state, addr, len, MADV_WILLNEED);
+    } else if (res < 0 && !state->error) {
+      state->error = Error::MkSysError(-res);
+    }
+
+    Settle(state.get());
+  });
+}
+
+}  // namespace
+
+Result<MappedFile> MappedFile::Open(const std::string& path,
+                                    const Options& opts) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Error::MkSysError(errno);
+  }
+
+  struct ::stat st;
+  if (::fstat(fd, &st) < 0) {
+    auto e = errno;
+    ::close(fd);
+    return Error::MkSysError(e);
+  }
+
+  // nothing to map
+  std::size_t size = st.st_size;
+  if (size == 0) {
+    ::close(fd);
+    return MappedFile();
+  }
+
+  int flags = MAP_SHARED | (opts.populate ? MAP_POPULATE : 0);
+  auto data = opts.huge_pages
+                  ? MapAligned(fd, size, flags)
+                  : ::mmap(nullptr, size, PROT_READ, flags, fd, 0);
+  auto e = errno;
+
+  // the mapping holds the file
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return Error::MkSysError(e);
+  }
+
+  MappedFile file(static_cast<char*>(data), size);
+
+  // it fails where the transparent huge pages are disabled, which is fine
+  if (opts.huge_pages) {
+    ::madvise(data, size, MADV_HUGEPAGE);
+  }
+
+  if (opts.advice != Advice::kNormal) {
+    if (auto e = file.Advise(opts.advice); e) {
+      return e;
+    }
+  }
+  return file;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(other.data_), size_(other.size_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Unmap();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+  }
+  return *this;
+}
+
+void MappedFile::Unmap() {
+  if (data_) {
+    ::munmap(data_, size_);
+  }
+
+  data_ = nullptr;
+  size_ = 0;
+}
+
+std::string_view MappedFile::view(std::size_t offset, std::size_t len) const {
+  return view().substr(std::min(offset, size_), len);
+}
+
+std::pair<char*, std::size_t> MappedFile::PageRange(std::size_t offset,
+                                                    std::size_t len) const {
+  offset = std::min(offset, size_);
+  len = std::min(len, size_ - offset);
+  if (len == 0) {
+    return {data_ + offset, 0};
+  }
+
+  // the mapping starts at the page
+  auto begin = offset / PageSize() * PageSize();
+  return {data_ + begin, offset + len - begin};
+}
+
+Error MappedFile::Advise(Advice advice, std::size_t offset, std::size_t len) {
+  auto [addr, size] = PageRange(offset, len);
+  if (size == 0) {
+    return {};
+  }
+
+  if (::madvise(addr, size, ToMadvise(advice)) < 0) {
+    return Error::MkSysError(errno);
+  }
+  return {};
+}
+
+Notifier MappedFile::Prefetch(FileBackend* backend, std::size_t offset,
+                              std::size_t len) {
+  auto [addr, size] = PageRange(offset, len);
+  if (size == 0) {
+    return MkResolvedNotifier();
+  }
+
+  Notifier ntfr;
+  // it's held until all chunks are issued, in case any completes in place
+  auto state = std::make_shared<PrefetchState>(
+      PrefetchState{1, Error{}, ntfr.GetResolver()});
+
+  // the chunks are faulted in in parallel, by the workers of the backend
+  for (std::size_t i = 0; i < size; i += kPrefetchChunk) {
+    PrefetchChunk(backend, state, addr + i, std::min(kPrefetchChunk, size - i),
+                  MADV_POPULATE_READ);
+  }
+  Settle(state.get());
+  return ntfr;
+}
+
+}  // namespace event
+}  // namespace libz
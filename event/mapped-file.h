@@ -0,0 +1,98 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <base/result.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "file-backend.h"
+#include "promise.h"
+
+namespace libz {
+namespace event {
+
+// MappedFile maps a file read-only, for the large lookup tables which are
+// read in place rather than copied into the buffers. the views are into the
+// mapping, and they are valid until the file is unmapped.
+//
+// Notes, the access to a page which isn't resident blocks the thread on the
+// major fault, so that the ranges read by the loop should be prefetched.
+// the file mustn't be truncated while it's mapped, or the access beyond the
+// end gets SIGBUS
+class MappedFile {
+ public:
+  enum class Advice {
+    kNormal,
+    kSequential,
+    kRandom,
+    kWillNeed,
+    kDontNeed,
+  };
+
+  struct Options {
+    // align the mapping to the huge page, and ask for the huge pages by
+    // MADV_HUGEPAGE. they are used where the file system supports, such as
+    // tmpfs with huge=, or by khugepaged with CONFIG_READ_ONLY_THP_FOR_FS
+    bool huge_pages{false};
+
+    // fault all pages in by MAP_POPULATE, it blocks until they are read
+    bool populate{false};
+
+    // the hint for the whole mapping
+    Advice advice{Advice::kNormal};
+  };
+
+  // the size of the chunks of Prefetch, which are faulted in in parallel
+  static constexpr std::size_t kPrefetchChunk = 16 << 20;
+  static constexpr std::size_t kHugePageSize = 2 << 20;
+
+  static Result<MappedFile> Open(const std::string& path, const Options& opts);
+  static Result<MappedFile> Open(const std::string& path) {
+    return Open(path, Options{});
+  }
+
+  MappedFile() = default;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  ~MappedFile() { Unmap(); }
+
+ public:
+  // the range is clamped to the file
+  std::string_view view() const { return {data_, size_}; }
+  std::string_view view(std::size_t offset, std::size_t len) const;
+
+  // madvise the range, it's rounded out to the pages
+  Error Advise(Advice advice, std::size_t offset = 0,
+               std::size_t len = std::string_view::npos);
+
+  // fault the pages of the range in on the |backend|, so that the access
+  // from the loop doesn't block. the pages are read ahead by MADV_WILLNEED
+  // instead before 5.14. the file must be mapped until it's settled
+  Notifier Prefetch(FileBackend* backend, std::size_t offset = 0,
+                    std::size_t len = std::string_view::npos);
+
+  void Unmap();
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  MappedFile(char* data, std::size_t size) : data_(data), size_(size) {}
+
+  // the pages which cover [offset, offset + len) within the file
+  std::pair<char*, std::size_t> PageRange(std::size_t offset,
+                                          std::size_t len) const;
+
+  char* data_{nullptr};
+  std::size_t size_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace event
+}  // namespace libz
@@ -4,16 +4,37 @@ set(EVENT_SRC
   ${EVENT_SRC_PREFIX}/basic.cc
   ${EVENT_SRC_PREFIX}/message-loop.cc
   ${EVENT_SRC_PREFIX}/timer-event.cc
+  ${EVENT_SRC_PREFIX}/idle-timeout.cc
+  ${EVENT_SRC_PREFIX}/file-backend.cc
+  ${EVENT_SRC_PREFIX}/async-file.cc
+  ${EVENT_SRC_PREFIX}/wal-writer.cc
+  ${EVENT_SRC_PREFIX}/mapped-file.cc
 )
 
+if(ENABLE_IOURING)
+  list(APPEND EVENT_SRC
+    ${EVENT_SRC_PREFIX}/io-uring-engine.cc
+    ${EVENT_SRC_PREFIX}/io-uring-net.cc
+  )
+endif(ENABLE_IOURING)
+
 if(BUILD_TESTS)
   set(ld_libs event base fmt)
 
   add_tc(NAME "${EVENT_SRC_PREFIX}/promise-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${EVENT_SRC_PREFIX}/idle-timeout-test.cc" LIBS ${ld_libs})
 
 if (ENABLE_CO)
   add_tc(NAME "${EVENT_SRC_PREFIX}/coroutine-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${EVENT_SRC_PREFIX}/async-file-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${EVENT_SRC_PREFIX}/wal-writer-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${EVENT_SRC_PREFIX}/mapped-file-test.cc" LIBS ${ld_libs})
 endif(ENABLE_CO)
 
+if (ENABLE_IOURING)
+  add_tc(NAME "${EVENT_SRC_PREFIX}/io-uring-engine-test.cc" LIBS ${ld_libs} uring)
+  add_tc(NAME "${EVENT_SRC_PREFIX}/io-uring-net-test.cc" LIBS ${ld_libs} uring)
+endif(ENABLE_IOURING)
+
 endif(BUILD_TESTS)
 
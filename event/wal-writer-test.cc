@@ -0,0 +1,293 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "wal-writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "coroutine.h"
+#include "io-message-loop.h"
+
+namespace libz {
+namespace event {
+
+std::string MkTempPath() {
+  char path[] = "/tmp/libz-wal-XXXXXX";
+  auto fd = ::mkstemp(path);
+  CATCH_REQUIRE(fd >= 0);
+  ::close(fd);
+  return path;
+}
+
+std::string ReadAll(const std::string& path) {
+  std::string content;
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  CATCH_REQUIRE(fd >= 0);
+
+  char buffer[4096];
+  for (;;) {
+    auto n = ::read(fd, buffer, sizeof(buffer));
+    CATCH_REQUIRE(n >= 0);
+    if (n == 0) {
+      break;
+    }
+    content.append(buffer, n);
+  }
+  ::close(fd);
+  return content;
+}
+
+std::vector<std::string> BackendNames() {
+#ifdef ENABLE_IOURING
+  return {"thread-pool", "io_uring"};
+#else
+  return {"thread-pool"};
+#endif
+}
+
+std::unique_ptr<FileBackend> MkBackend(IOMessageLoop* loop,
+                                       const std::string& name) {
+#ifdef ENABLE_IOURING
+  if (name == "io_uring") {
+    CATCH_REQUIRE(loop->uring());
+    return std::make_unique<IOUringFileBackend>(loop->uring());
+  }
+#endif
+  return std::make_unique<ThreadPoolFileBackend>(loop);
+}
+
+// every write and sync fails
+class FailedBackend : public ThreadPoolFileBackend {
+ public:
+  explicit FailedBackend(MessageLoop* loop)
+      : ThreadPoolFileBackend(loop), loop_(loop) {}
+
+  void WriteSync(int, const void*, std::size_t, std::uint64_t, bool,
+                 Callback&& callback) override {
+    loop_->remote_executor()->Post(
+        [callback = std::move(callback)]() { callback(-EIO); });
+  }
+
+ private:
+  MessageLoop* loop_;
+};
+
+// the records are appended by a few coroutines, and the last one shuts the
+// loop down
+Notifier AppendRecords(IOMessageLoop* loop, WalWriter* wal, int id, int num,
+                       int* running, std::vector<std::uint64_t>* offsets) {
+  for (int i = 0; i < num; ++i) {
+    auto record = std::to_string(id) + ":" + std::string(i % 100 + 1, 'x');
+    auto offset = co_await wal->Append(record);
+    CATCH_REQUIRE(offset);
+    offsets->push_back(offset.GetResult());
+  }
+
+  if (--*running == 0) {
+    loop->Shutdown();
+  }
+  co_return {};
+}
+
+void GroupCommit(const std::string& name) {
+  IOMessageLoop loop;
+  auto backend = MkBackend(&loop, name);
+
+  auto path = MkTempPath();
+  auto r = WalWriter::Open(&loop, backend.get(), path, WalWriter::Options{});
+  CATCH_REQUIRE(r);
+  auto wal = r.PassResult();
+
+  constexpr int kWriters = 8;
+  constexpr int kRecords = 200;
+  int running = kWriters;
+  std::vector<std::vector<std::uint64_t>> offsets(kWriters);
+
+  loop.Post([&]() {
+    for (int i = 0; i < kWriters; ++i) {
+      AppendRecords(&loop, wal.get(), i, kRecords, &running, &offsets[i]);
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+  CATCH_REQUIRE(running == 0);
+
+  // the records of the writers are committed together
+  const auto& stats = wal->stats();
+  CATCH_REQUIRE(stats.records == kWriters * kRecords);
+  CATCH_REQUIRE(stats.groups < stats.records);
+  CATCH_REQUIRE(stats.group_records.max() >= kWriters);
+  CATCH_REQUIRE(stats.commit_latency.count() == stats.groups);
+  CATCH_REQUIRE(wal->durable_end() == wal->end());
+
+  // every record is at its offset, in the order of every writer
+  auto log = ReadAll(path);
+  ::unlink(path.c_str());
+  CATCH_REQUIRE(log.size() % AlignedBufferPool::kAlignment == 0);
+
+  auto records = WalWriter::ParseRecords(log);
+  CATCH_REQUIRE(records.size() == kWriters * kRecords);
+
+  for (int i = 0; i < kWriters; ++i) {
+    CATCH_REQUIRE(offsets[i].size() == kRecords);
+    for (int j = 0; j < kRecords; ++j) {
+      auto offset = offsets[i][j];
+      auto record = std::to_string(i) + ":" + std::string(j % 100 + 1, 'x');
+      CATCH_REQUIRE(log.substr(offset + WalWriter::kHeaderSize,
+                               record.size()) == record);
+    }
+  }
+}
+
+// the directory of the log is synced as well, it's the working one for the
+// relative path
+CATCH_TEST_CASE("open", "[wal-writer]") {
+  IOMessageLoop loop;
+  ThreadPoolFileBackend backend(&loop);
+
+  auto path = MkTempPath();
+  auto r = WalWriter::Open(&loop, &backend, path, WalWriter::Options{});
+  CATCH_REQUIRE(r);
+  ::unlink(path.c_str());
+
+  char cwd[] = "/tmp/libz-wal-dir-XXXXXX";
+  CATCH_REQUIRE(::mkdtemp(cwd));
+  char prev[4096];
+  CATCH_REQUIRE(::getcwd(prev, sizeof(prev)));
+  CATCH_REQUIRE(::chdir(cwd) == 0);
+
+  r = WalWriter::Open(&loop, &backend, "wal", WalWriter::Options{});
+  CATCH_REQUIRE(::chdir(prev) == 0);
+  CATCH_REQUIRE(r);
+  CATCH_REQUIRE(::unlink((std::string(cwd) + "/wal").c_str()) == 0);
+  ::rmdir(cwd);
+
+  r = WalWriter::Open(&loop, &backend, "/tmp/libz-wal-none/wal",
+                      WalWriter::Options{});
+  CATCH_REQUIRE(!r);
+  CATCH_REQUIRE(r.GetError().code() == ENOENT);
+}
+
+CATCH_TEST_CASE("group commit", "[wal-writer]") {
+  for (auto& name : BackendNames()) {
+    CATCH_INFO("backend " << name);
+    GroupCommit(name);
+  }
+}
+
+CATCH_TEST_CASE("max group bytes", "[wal-writer]") {
+  IOMessageLoop loop;
+  ThreadPoolFileBackend backend(&loop);
+
+  WalWriter::Options opts;
+  opts.max_group_bytes = 100;
+
+  auto path = MkTempPath();
+  auto r = WalWriter::Open(&loop, &backend, path, opts);
+  CATCH_REQUIRE(r);
+  auto wal = r.PassResult();
+  ::unlink(path.c_str());
+
+  // 3 records in a group, and the large one is in a group of its own
+  std::vector<Promise<std::uint64_t>> promises;
+  int settled = 0;
+  loop.Post([&]() {
+    for (int i = 0; i < 6; ++i) {
+      promises.push_back(wal->Append(std::string(26, 'a' + i)));
+    }
+    promises.push_back(wal->Append(std::string(1000, 'z')));
+    CATCH_REQUIRE(wal->Append("").IsUnsatisfied());
+
+    for (auto& promise : promises) {
+      promise.Then(
+          [&](Result<std::uint64_t>&& r) {
+            CATCH_REQUIRE(r);
+            if (++settled == static_cast<int>(promises.size())) {
+              loop.Shutdown();
+            }
+          },
+          nullptr);
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(settled == 7);
+  CATCH_REQUIRE(wal->stats().groups == 3);
+  CATCH_REQUIRE(wal->stats().group_records.max() == 3);
+}
+
+CATCH_TEST_CASE("failed sync", "[wal-writer]") {
+  IOMessageLoop loop;
+  FailedBackend backend(&loop);
+
+  auto path = MkTempPath();
+  auto r = WalWriter::Open(&loop, &backend, path, WalWriter::Options{});
+  CATCH_REQUIRE(r);
+  auto wal = r.PassResult();
+  ::unlink(path.c_str());
+
+  std::optional<Promise<std::uint64_t>> first;
+  std::optional<Promise<std::uint64_t>> second;
+  bool done = false;
+  loop.Post([&]() {
+    first.emplace(wal->Append("first"));
+    first->Then(
+        [&](Result<std::uint64_t>&& r) {
+          CATCH_REQUIRE(!r);
+
+          // the log is broken after the failure
+          second.emplace(wal->Append("second"));
+          second->Then(
+              [&](Result<std::uint64_t>&& r) {
+                CATCH_REQUIRE(!r);
+                done = true;
+                loop.Shutdown();
+              },
+              nullptr);
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(done);
+  CATCH_REQUIRE(wal->error());
+  CATCH_REQUIRE(wal->stats().groups == 1);
+}
+
+CATCH_TEST_CASE("parse records", "[wal-writer]") {
+  std::string log;
+  for (std::string record : {"a", "bc", "def"}) {
+    std::uint32_t len = record.size();
+    log.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    log.append(record);
+  }
+
+  auto records = WalWriter::ParseRecords(log);
+  CATCH_REQUIRE(records.size() == 3);
+  CATCH_REQUIRE(records[2] == "def");
+
+  // the torn record at the end, and the padding
+  CATCH_REQUIRE(WalWriter::ParseRecords(log.substr(0, log.size() - 1))
+                    .size() == 2);
+  CATCH_REQUIRE(WalWriter::ParseRecords(log + std::string(100, '\0'))
+                    .size() == 3);
+}
+
+}  // namespace event
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,260 @@
+#include "wal-writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <asio/post.hpp>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+namespace libz {
+namespace event {
+
+namespace {
+
+constexpr std::size_t kAlignment = AlignedBufferPool::kAlignment;
+
+std::size_t Align(std::size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// the fsync of a file doesn't persist its entry in the directory
+Error SyncParentDir(const std::string& path) {
+  auto slash = path.rfind('/');
+  std::string dir = slash == std::string::npos ? "."
+                    : slash == 0               ? "/"
+                                               : path.substr(0, slash);
+
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return Error::MkSysError(errno);
+  }
+
+  Error e;
+  if (::fsync(fd) != 0) {
+    e = Error::MkSysError(errno);
+  }
+  ::close(fd);
+  return e;
+}
+
+}  // namespace
+
+Result<std::unique_ptr<WalWriter>> WalWriter::Open(MessageLoop* loop,
+                                                   FileBackend* backend,
+                                                   const std::string& path,
+                                                   const Options& opts) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  auto file =
+      AsyncFile::Open(backend, path, flags | (opts.direct ? O_DIRECT : 0));
+
+  // O_DIRECT isn't supported by every file system, such as tmpfs
+  if (!file && opts.direct && file.GetError().code() == EINVAL) {
+    file = AsyncFile::Open(backend, path, flags);
+  }
+
+  if (!file) {
+    return file.PassError();
+  }
+
+  // the log may be created just now, and the groups synced by fdatasync
+  // would be lost with the file on a crash unless its entry is durable
+  // before the first one is resolved
+  if (auto e = SyncParentDir(path); e) {
+    return e;
+  }
+
+  return std::unique_ptr<WalWriter>(
+      new WalWriter(loop, file.PassResult(), opts));
+}
+
+WalWriter::WalWriter(MessageLoop* loop, AsyncFile&& file, const Options& opts)
+    : loop_(loop),
+      file_(std::move(file)),
+      opts_(opts),
+      pending_(),
+      end_(0),
+      durable_end_(0),
+      tail_(),
+      committing_(false),
+      commit_scheduled_(false),
+      error_(),
+      token_(std::make_shared<WalWriter*>(this)),
+      stats_() {}
+
+WalWriter::~WalWriter() {
+  // the group in flight is settled by its completion
+  for (auto& record : pending_) {
+    record.resolver.Reject(Error::MkSysError(ECANCELED));
+  }
+}
+
+Promise<std::uint64_t> WalWriter::Append(std::string_view record) {
+  if (error_) {
+    return MkRejectedPromise<std::uint64_t>(Error(error_));
+  }
+
+  if (record.empty() ||
+      record.size() > std::numeric_limits<std::uint32_t>::max()) {
+    return MkRejectedPromise<std::uint64_t>(Error::MkSysError(EINVAL));
+  }
+
+  std::uint32_t len = record.size();
+  std::string data(kHeaderSize + record.size(), '\0');
+  std::memcpy(data.data(), &len, kHeaderSize);
+  std::memcpy(data.data() + kHeaderSize, record.data(), record.size());
+
+  Promise<std::uint64_t> promise;
+  pending_.push_back(PendingRecord{std::move(data), end_,
+                                   promise.GetResolver(), loop_->MonoNow()});
+  end_ += kHeaderSize + record.size();
+
+  ScheduleCommit();
+  return promise;
+}
+
+std::vector<std::string_view> WalWriter::ParseRecords(std::string_view log) {
+  std::vector<std::string_view> records;
+  while (log.size() >= kHeaderSize) {
+    std::uint32_t len = 0;
+    std::memcpy(&len, log.data(), kHeaderSize);
+
+    // the padding, or the torn record at the end
+    if (len == 0 || log.size() - kHeaderSize < len) {
+      break;
+    }
+
+    records.push_back(log.substr(kHeaderSize, len));
+    log.remove_prefix(kHeaderSize + len);
+  }
+  return records;
+}
+
+void WalWriter::ScheduleCommit() {
+  if (commit_scheduled_ || committing_) {
+    return;
+  }
+  commit_scheduled_ = true;
+
+  // the records appended within the iteration are committed together
+  asio::post(*loop_->proactor(),
+             [token = std::weak_ptr<WalWriter*>(token_)]() {
+               auto self = token.lock();
+               if (!self) {
+                 return;
+               }
+
+               auto writer = *self;
+               writer->commit_scheduled_ = false;
+               writer->Commit();
+             });
+}
+
+void WalWriter::Commit() {
+  if (committing_ || error_ || pending_.empty()) {
+    return;
+  }
+
+  std::size_t n = 0;
+  std::size_t bytes = 0;
+  for (; n < pending_.size(); ++n) {
+    auto size = pending_[n].data.size();
+    if (n > 0 && bytes + size > opts_.max_group_bytes) {
+      break;
+    }
+    bytes += size;
+  }
+
+  // the partial block at the durable end is written again, so that the
+  // write starts at the block
+  auto group = std::make_shared<Group>();
+  group->start = durable_end_ - tail_.size();
+  group->end = durable_end_ + bytes;
+  group->started = pending_.front().appended;
+
+  auto len = tail_.size() + bytes;
+  group->buffer = AlignedBuffer::Make(Align(len));
+  auto data = group->buffer.data();
+  std::memcpy(data, tail_.data(), tail_.size());
+  data += tail_.size();
+
+  group->resolvers.reserve(n);
+  group->offsets.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto& record = pending_.front();
+    std::memcpy(data, record.data.data(), record.data.size());
+    data += record.data.size();
+
+    group->resolvers.push_back(std::move(record.resolver));
+    group->offsets.push_back(record.offset);
+    pending_.pop_front();
+  }
+  std::memset(data, 0, group->buffer.size() - len);
+
+  committing_ = true;
+  ++stats_.groups;
+  stats_.records += n;
+  stats_.bytes_written += group->buffer.size();
+  stats_.group_records.Record(n);
+
+  // the file is kept open by the callback till the completion
+  auto callback = [group, token = std::weak_ptr<WalWriter*>(token_)](long res) {
+    Error error;
+    if (res < 0) {
+      error = Error::MkSysError(-res);
+    } else if (static_cast<std::size_t>(res) < group->buffer.size()) {
+      error = Error::MkSysError(EIO);
+    }
+
+    // the records appended by the continuations are left to the next
+    // group, which is started by OnCommitted
+    Settle(group.get(), error);
+    if (auto self = token.lock(); self) {
+      (*self)->OnCommitted(*group, error);
+    }
+  };
+  file_.backend()->WriteSync(file_.fd(), group->buffer.data(),
+                             group->buffer.size(), group->start,
+                             opts_.datasync, file_.Keep(std::move(callback)));
+}
+
+void WalWriter::OnCommitted(const Group& group, const Error& error) {
+  committing_ = false;
+  if (error) {
+    Fail(Error(error));
+    return;
+  }
+
+  // keep the partial block at the end for the next group
+  auto tail = group.end % kAlignment;
+  tail_.assign(group.buffer.data() + (group.end - group.start - tail), tail);
+  durable_end_ = group.end;
+
+  stats_.commit_latency.Record(
+      DurationCast<MicroSeconds>(loop_->MonoNow() - group.started).count());
+
+  // the records appended during the write make up the next group
+  Commit();
+}
+
+void WalWriter::Settle(Group* group, const Error& error) {
+  for (std::size_t i = 0; i < group->resolvers.size(); ++i) {
+    if (error) {
+      group->resolvers[i].Reject(Error(error));
+    } else {
+      group->resolvers[i].Resolve(group->offsets[i]);
+    }
+  }
+}
+
+void WalWriter::Fail(Error&& error) {
+  error_ = std::move(error);
+  while (!pending_.empty()) {
+    pending_.front().resolver.Reject(Error(error_));
+    pending_.pop_front();
+  }
+}
+
+}  // namespace event
+}  // namespace libz
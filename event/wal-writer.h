@@ -0,0 +1,156 @@
+#pragma once
+
+#include <base/aligned-buffer-pool.h>
+#include <base/common.h>
+#include <base/error.h>
+#include <base/histogram.h>
+#include <base/result.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "async-file.h"
+#include "file-backend.h"
+#include "message-loop.h"
+#include "promise.h"
+
+namespace libz {
+namespace event {
+
+// WalWriter appends the records to a write-ahead log with group commit. the
+// records appended within a loop iteration, and the ones appended while a
+// group is being written, make up the next group, which is written by one
+// aligned write followed by one sync. every record is resolved with its
+// offset in the log once its group is durable.
+//
+// a record is framed by its length of 4 bytes in the host order, and the
+// log is padded with zeros to the block, so that the zero length marks the
+// end, see ParseRecords. the partial block at the end is written again with
+// the next group, so that the writes are aligned for O_DIRECT.
+//
+// Notes, all methods must be invoked within the loop thread. once a write or
+// a sync fails, the log is broken, the pending records and the later ones
+// are rejected, since the pages which failed to be written may be dropped by
+// the kernel. the writer must be destroyed after the promises are settled
+class WalWriter {
+ public:
+  struct Options {
+    // the records beyond it are left to the next group, but a group has one
+    // record at least
+    std::size_t max_group_bytes{4 << 20};
+
+    // open with O_DIRECT, it falls back to the buffered io if the file
+    // system doesn't support it
+    bool direct{true};
+
+    // fdatasync rather than fsync, the size of the log is changed by the
+    // appends anyway
+    bool datasync{true};
+  };
+
+  struct Stats {
+    std::uint64_t records{0};
+    std::uint64_t groups{0};
+
+    // the bytes written, the partial blocks are counted again
+    std::uint64_t bytes_written{0};
+
+    // the records of a group, and the micro seconds from the first record
+    // of a group appended to the group being durable
+    Histogram group_records;
+    Histogram commit_latency;
+  };
+
+  static constexpr std::size_t kHeaderSize = sizeof(std::uint32_t);
+
+  // create the log at |path|, it's truncated if it exists. its directory is
+  // synced before returning, so that the log survives a crash
+  static Result<std::unique_ptr<WalWriter>> Open(MessageLoop* loop,
+                                                 FileBackend* backend,
+                                                 const std::string& path,
+                                                 const Options& opts);
+
+  ~WalWriter();
+
+ public:
+  // resolved with the offset of the record in the log, once it's durable.
+  // the record mustn't be empty
+  Promise<std::uint64_t> Append(std::string_view record);
+
+  // the records of |log| up to the end, for the recovery
+  static std::vector<std::string_view> ParseRecords(std::string_view log);
+
+  // the end of the appended records, and of the durable ones
+  std::uint64_t end() const { return end_; }
+  std::uint64_t durable_end() const { return durable_end_; }
+
+  std::size_t pending() const { return pending_.size(); }
+  const Error& error() const { return error_; }
+
+  const Options& options() const { return opts_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct PendingRecord {
+    std::string data;
+    std::uint64_t offset;
+    PromiseResolver<std::uint64_t> resolver;
+    Tm appended;
+  };
+
+  // the group being written, it's shared with the completion, which may
+  // come after the writer is destroyed
+  struct Group {
+    AlignedBuffer buffer;
+    std::vector<PromiseResolver<std::uint64_t>> resolvers;
+    std::vector<std::uint64_t> offsets;
+
+    // the buffer is written at |start|, the aligned offset, and the records
+    // end at |end|
+    std::uint64_t start;
+    std::uint64_t end;
+    Tm started;
+  };
+
+  WalWriter(MessageLoop* loop, AsyncFile&& file, const Options& opts);
+
+  // write the next group at the end of the loop iteration
+  void ScheduleCommit();
+  void Commit();
+  void OnCommitted(const Group& group, const Error& error);
+
+  // resolve the records of |group|, or reject them with |error|
+  static void Settle(Group* group, const Error& error);
+
+  void Fail(Error&& error);
+
+  MessageLoop* loop_;
+  AsyncFile file_;
+  Options opts_;
+
+  // the records not written yet
+  std::deque<PendingRecord> pending_;
+  std::uint64_t end_;
+
+  // the durable end, and the bytes of the partial block before it
+  std::uint64_t durable_end_;
+  std::string tail_;
+
+  bool committing_;
+  bool commit_scheduled_;
+  Error error_;
+
+  // the scheduled commit and the completion hold the token weakly
+  std::shared_ptr<WalWriter*> token_;
+
+  Stats stats_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(WalWriter);
+};
+
+}  // namespace event
+}  // namespace libz
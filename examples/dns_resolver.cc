@@ -3,6 +3,7 @@
 #include <control/io-thread.h>
 #include <event/coroutine.h>
 #include <event/io-message-loop.h>
+#include <net/resolver.h>
 
 #include <asio.hpp>
 
@@ -15,52 +16,7 @@ using libz::event::IOMessageLoop;
 using libz::event::MessageLoop;
 using libz::event::Notifier;
 using libz::event::Promise;
-
-class Resolver {
- public:
-  Resolver(MessageLoop* loop) : loop_(loop) {}
-
-  Resolver(Resolver&&) = default;
-  Resolver(const Resolver&) = default;
-  Resolver& operator=(Resolver&&) = default;
-  Resolver& operator=(const Resolver&) = default;
-
- public:
-  using IPAddressList = std::vector<std::string>;
-
-  Promise<IPAddressList> Resolve(const std::string& host) {
-    Promise<IPAddressList> promise;
-    auto resolver = std::make_shared<tcp::resolver>(*loop_->proactor());
-
-    resolver->async_resolve(
-        host, "",
-        [_ = resolver, resolver = promise.GetResolver()](
-            const asio::error_code& ec, tcp::resolver::iterator it) mutable {
-          if (ec) {
-            resolver.Reject(Error::MkBoostError(ec.value(), ec.message()));
-            return;
-          }
-
-          asio::error_code err;
-          IPAddressList addr_list;
-          tcp::resolver::iterator end;
-          while (it != end) {
-            if (auto ip = it->endpoint().address().to_string(err); !err) {
-              addr_list.push_back(std::move(ip));
-            }
-
-            ++it;
-          }
-
-          resolver.Resolve(std::move(addr_list));
-        });
-
-    return promise;
-  }
-
- private:
-  MessageLoop* loop_;
-};
+using libz::net::Resolver;
 
 int main() {
   IOMessageLoop loop;
@@ -80,6 +36,12 @@ int main() {
       std::for_each(ip_list.begin(), ip_list.end(),
                     [](const auto& ip) { std::cout << ip << std::endl; });
 
+      // served from the dns cache
+      auto cached_result = co_await resolver.Resolve(host);
+      assert(cached_result);
+      std::cout << "cached: " << cached_result.PassResult().size()
+                << " address(es)" << std::endl;
+
       co_return {};
     };
     handler();
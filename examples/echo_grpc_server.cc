@@ -1,7 +1,10 @@
+#include <absl/strings/str_format.h>
+#include <control/io-thread.h>
 #include <event/coroutine.h>
 #include <event/io-message-loop.h>
 #include <event/promise.h>
 #include <grpcpp/grpcpp.h>
+#include <net/grpc-bridge.h>
 
 #include <thread>
 
@@ -23,23 +26,29 @@ using helloworld::Greeter;
 using helloworld::HelloReply;
 using helloworld::HelloRequest;
 
+using libz::ctl::IOThreadPool;
 using libz::event::IOMessageLoop;
 using libz::event::MessageLoop;
 using libz::event::MkRejectedNotifier;
 using libz::event::MkResolvedNotifier;
 using libz::event::Notifier;
 using libz::event::Promise;
+using libz::net::GrpcBridgeGroup;
+using libz::net::GrpcTag;
 
+// a completion queue per io thread, the tags of a queue are handed to the
+// loop of its thread in batches, so that an rpc stays on one thread
 class ServerImpl final {
    public:
-    ServerImpl(MessageLoop* loop, std::uint16_t port) : loop_(loop) {
+    ServerImpl(const std::vector<MessageLoop*>& loops, std::uint16_t port)
+        : loops_(loops) {
         Run(port);
     }
 
     ~ServerImpl() {
         server_->Shutdown();
         // Always shutdown the completion queue after the server.
-        cq_->Shutdown();
+        bridges_->Shutdown();
     }
 
     // There is no shutdown handling in this code.
@@ -54,39 +63,20 @@ class ServerImpl final {
         // with clients. In this case it corresponds to an *asynchronous*
         // service.
         builder.RegisterService(&service_);
-        // Get hold of the completion queue used for the asynchronous
-        // communication with the gRPC runtime.
-        cq_ = builder.AddCompletionQueue();
+        // Get hold of the completion queues used for the asynchronous
+        // communication with the gRPC runtime, one per loop.
+        bridges_ = std::make_unique<GrpcBridgeGroup>(
+            loops_, &builder, GrpcBridgeGroup::Options{});
         // Finally assemble the server.
         server_ = builder.BuildAndStart();
         std::cout << "Server listening on " << server_address << std::endl;
 
+        bridges_->Start();
         Start();
     }
 
-    void Poll() {
-        void* got_tag;
-        bool ok = false;
-
-        while (cq_->Next(&got_tag, &ok)) {
-            loop_->Dispatch(loop_,
-                            [this, tag = got_tag] { MakeProgress(tag); });
-        }
-    }
-
-    void MakeProgress(void* tag) {
-        auto s = static_cast<Session*>(tag);
-        if (s->state == Session::kRequest) {
-            s->Process();
-        } else if (s->state == Session::kProcess) {
-            s->Finish();
-        } else {
-            std::cout << "unknown state: " << s->state << std::endl;
-        }
-    }
-
    public:
-    struct Session {
+    struct Session : public GrpcTag {
         enum State { kRequest = 0, kProcess, kFinish };
         State state;
 
@@ -103,6 +93,20 @@ class ServerImpl final {
             service->RequestSayHello(&ctx, &request, &responder, cq, cq, this);
         }
 
+        // it's on the loop of the queue
+        void Proceed(bool ok) override {
+            if (!ok) {
+                // the server is shut down
+                delete this;
+            } else if (state == Session::kRequest) {
+                Process();
+            } else if (state == Session::kProcess) {
+                Finish();
+            } else {
+                std::cout << "unknown state: " << state << std::endl;
+            }
+        }
+
         Promise<HelloReply> Handle(HelloRequest* req) {
             HelloReply response;
 
@@ -137,23 +141,36 @@ class ServerImpl final {
         void Finish() { delete this; }
     };
 
-    void Start() { new Session(&service_, cq_.get()); }
+    // a session is waiting on every queue
+    void Start() {
+        for (std::size_t i = 0; i < bridges_->size(); ++i) {
+            new Session(&service_, bridges_->At(i)->server_cq());
+        }
+    }
 
    private:
-    MessageLoop* loop_;
-    std::unique_ptr<ServerCompletionQueue> cq_;
+    std::vector<MessageLoop*> loops_;
+    std::unique_ptr<GrpcBridgeGroup> bridges_;
     Greeter::AsyncService service_;
     std::unique_ptr<Server> server_;
 };
 
 int main(int argc, char** argv) {
-    IOMessageLoop loop;
+    std::size_t threads = argc > 1 ? std::atoi(argv[1]) : 4;
 
-    ServerImpl server(&loop, 50051);
-    std::thread t(&ServerImpl::Poll, &server);
+    IOThreadPool pool(threads);
+    pool.Run();
+
+    std::vector<MessageLoop*> loops;
+    for (std::size_t i = 0; i < threads; ++i) {
+        while (!pool.At(i)->Running()) {
+            std::this_thread::yield();
+        }
+        loops.push_back(pool.At(i)->event_loop());
+    }
 
-    loop.Run();
-    t.join();
+    ServerImpl server(loops, 50051);
+    pool.JoinAll();
 
     return 0;
 }
@@ -1,9 +1,12 @@
+#include <absl/strings/str_format.h>
 #include <event/coroutine.h>
 #include <event/io-message-loop.h>
 #include <event/promise.h>
 #include <grpcpp/grpcpp.h>
+#include <net/grpc-bridge.h>
+#include <net/grpc-server.h>
 
-#include <thread>
+#include <iostream>
 
 #include "helloworld2.grpc.pb.h"
 
@@ -14,11 +17,8 @@
 // clang-format on
 
 using grpc::Server;
-using grpc::ServerAsyncResponseWriter;
 using grpc::ServerBuilder;
-using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
-using grpc::Status;
 using helloworld2::EchoReply;
 using helloworld2::EchoRequest;
 using helloworld2::Greeter;
@@ -27,103 +27,31 @@ using helloworld2::HelloRequest;
 
 using libz::event::IOMessageLoop;
 using libz::event::MessageLoop;
-using libz::event::MkRejectedNotifier;
-using libz::event::MkResolvedNotifier;
 using libz::event::Notifier;
-using libz::event::Promise;
+using libz::net::GrpcBridgeGroup;
+using libz::net::GrpcServerMethod;
 
-struct SessionBase {
-    enum State { kRequest = 0, kProcess, kFinish };
+using HelloMethod =
+    GrpcServerMethod<Greeter::AsyncService, HelloRequest, HelloReply>;
+using EchoMethod =
+    GrpcServerMethod<Greeter::AsyncService, EchoRequest, EchoReply>;
 
-    virtual void Finish() { delete this; }
+// the messages are on the arena of the session, which is recycled after
+Notifier SayHello(ServerContext*, const HelloRequest* req, HelloReply* rsp) {
+    std::cout << "hello session recv: " << req->name() << std::endl;
 
-    virtual State stat() = 0;
-    virtual Notifier Process() = 0;
-    virtual ~SessionBase() {}
-};
-
-template <typename Req, typename Rsp>
-struct Session : public SessionBase {
-    State state;
-
-    Req request;
-    std::optional<Rsp> response;
-
-    Greeter::AsyncService* service;
-    ServerContext ctx;
-    ServerCompletionQueue* cq;
-    ServerAsyncResponseWriter<Rsp> responder;
-
-    Session(Greeter::AsyncService* as, ServerCompletionQueue* cq)
-        : SessionBase(),
-          state(kRequest),
-          service(as),
-          ctx(),
-          cq(cq),
-          responder(&ctx) {}
-
-    virtual Promise<Rsp> Handle(Req*) = 0;
-    virtual void NewSession() = 0;
-
-    State stat() override { return state; }
-
-    Notifier Process() override {
-        NewSession();
-
-        state = Session::kProcess;
-
-        auto resp = co_await Handle(&request);
-        if (!resp) {
-            auto e = resp.PassError();
-            responder.FinishWithError(
-                Status(grpc::StatusCode::INTERNAL, e.GetMessage()), this);
-            co_return e;
-        }
-
-        response = resp.PassResult();
-        responder.Finish(response.value(), Status::OK, this);
-
-        co_return {};
-    }
-};
-
-struct HelloSession : public Session<HelloRequest, HelloReply> {
-    HelloSession(Greeter::AsyncService* as, ServerCompletionQueue* cq)
-        : Session(as, cq) {
-        service->RequestSayHello(&ctx, &request, &responder, cq, cq, this);
-    }
-
-    void NewSession() override { new HelloSession(service, cq); }
-
-    Promise<HelloReply> Handle(HelloRequest* req) override {
-        HelloReply response;
+    std::string prefix("Hello ");
+    rsp->set_message(prefix + req->name());
 
-        std::cout << "hello session recv: " << req->name() << std::endl;
-
-        std::string prefix("Hello ");
-        response.set_message(prefix + req->name());
-
-        co_return response;
-    }
-};
-
-struct EchoSession : public Session<EchoRequest, EchoReply> {
-    EchoSession(Greeter::AsyncService* as, ServerCompletionQueue* cq)
-        : Session(as, cq) {
-        service->RequestSayEcho(&ctx, &request, &responder, cq, cq, this);
-    }
-
-    void NewSession() override { new EchoSession(service, cq); }
-
-    Promise<EchoReply> Handle(EchoRequest* req) override {
-        EchoReply response;
+    co_return {};
+}
 
-        std::cout << "echo session recv: " << req->content() << std::endl;
-        response.set_content(req->content());
+Notifier SayEcho(ServerContext*, const EchoRequest* req, EchoReply* rsp) {
+    std::cout << "echo session recv: " << req->content() << std::endl;
+    rsp->set_content(req->content());
 
-        co_return response;
-    }
-};
+    co_return {};
+}
 
 class ServerImpl final {
    public:
@@ -134,7 +62,7 @@ class ServerImpl final {
     ~ServerImpl() {
         server_->Shutdown();
         // Always shutdown the completion queue after the server.
-        cq_->Shutdown();
+        bridges_->Shutdown();
     }
 
     // There is no shutdown handling in this code.
@@ -150,57 +78,49 @@ class ServerImpl final {
         // service.
         builder.RegisterService(&service_);
         // Get hold of the completion queue used for the asynchronous
-        // communication with the gRPC runtime.
-        cq_ = builder.AddCompletionQueue();
+        // communication with the gRPC runtime, it's bridged to the loop.
+        bridges_ = std::make_unique<GrpcBridgeGroup>(
+            std::vector<MessageLoop*>{loop_}, &builder,
+            GrpcBridgeGroup::Options{});
         // Finally assemble the server.
         server_ = builder.BuildAndStart();
         std::cout << "Server listening on " << server_address << std::endl;
 
+        bridges_->Start();
         Start();
     }
 
-    void Poll() {
-        void* got_tag;
-        bool ok = false;
-
-        while (cq_->Next(&got_tag, &ok)) {
-            loop_->Dispatch(loop_,
-                            [this, tag = got_tag] { MakeProgress(tag); });
-        }
-    }
-
-    void MakeProgress(void* tag) {
-        auto s = static_cast<SessionBase*>(tag);
-        if (s->stat() == SessionBase::kRequest) {
-            s->Process();
-        } else if (s->stat() == SessionBase::kProcess) {
-            s->Finish();
-        } else {
-            std::cout << "unknown state: " << s->stat() << std::endl;
-        }
-    }
-
    public:
+    // the requests of both methods are posted ahead, the sessions are
+    // recycled by the pools of the loop
     void Start() {
-        new EchoSession(&service_, cq_.get());
-        new HelloSession(&service_, cq_.get());
+        hello_ = std::make_unique<HelloMethod>(
+            &service_, &Greeter::AsyncService::RequestSayHello, SayHello,
+            bridges_.get(), HelloMethod::Options{});
+        echo_ = std::make_unique<EchoMethod>(
+            &service_, &Greeter::AsyncService::RequestSayEcho, SayEcho,
+            bridges_.get(), EchoMethod::Options{});
+
+        hello_->Start();
+        echo_->Start();
     }
 
    private:
     MessageLoop* loop_;
-    std::unique_ptr<ServerCompletionQueue> cq_;
+    std::unique_ptr<GrpcBridgeGroup> bridges_;
     Greeter::AsyncService service_;
     std::unique_ptr<Server> server_;
+
+    std::unique_ptr<HelloMethod> hello_;
+    std::unique_ptr<EchoMethod> echo_;
 };
 
 int main(int argc, char** argv) {
     IOMessageLoop loop;
 
     ServerImpl server(&loop, 50051);
-    std::thread t(&ServerImpl::Poll, &server);
 
     loop.Run();
-    t.join();
 
     return 0;
 }
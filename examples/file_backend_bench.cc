@@ -0,0 +1,150 @@
+#include <base/aligned-buffer-pool.h>
+#include <base/common.h>
+#include <event/file-backend.h>
+#include <event/io-message-loop.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using libz::AlignedBuffer;
+using libz::MilliSeconds;
+using libz::event::FileBackend;
+using libz::event::IOMessageLoop;
+using libz::event::ThreadPoolFileBackend;
+
+constexpr std::size_t kBlockSize = 4096;
+
+// keep |depth| random 4k reads in flight on the backend until |total| are
+// completed, every completion queues the next read
+struct RandomReader {
+  RandomReader(IOMessageLoop* loop, FileBackend* backend, int fd,
+               std::size_t blocks, std::size_t depth, std::size_t total)
+      : loop(loop),
+        backend(backend),
+        fd(fd),
+        blocks(blocks),
+        total(total),
+        buffers(),
+        random(20240601) {
+    for (std::size_t i = 0; i < depth; ++i) {
+      buffers.push_back(AlignedBuffer::Make(kBlockSize));
+    }
+  }
+
+  void Start() {
+    for (auto& buffer : buffers) {
+      Next(buffer.data());
+    }
+  }
+
+  void Next(char* buffer) {
+    if (issued == total) {
+      return;
+    }
+    ++issued;
+
+    std::uint64_t offset = random() % blocks * kBlockSize;
+    backend->Read(fd, buffer, kBlockSize, offset, [this, buffer](long res) {
+      if (res < 0) {
+        ++failed;
+      }
+
+      if (++completed == total) {
+        loop->Shutdown();
+        return;
+      }
+      Next(buffer);
+    });
+  }
+
+  IOMessageLoop* loop;
+  FileBackend* backend;
+  int fd;
+  std::size_t blocks;
+  std::size_t total;
+
+  std::vector<AlignedBuffer> buffers;
+  std::mt19937_64 random;
+
+  std::size_t issued{0};
+  std::size_t completed{0};
+  std::size_t failed{0};
+};
+
+// usage: file_backend_bench [file] [mb] [depth] [reads] [threads]
+//
+// the random reads are run on the thread pool backend, and on the io_uring
+// one if it's available, to compare the two at the same depth
+int main(int argc, char* argv[]) {
+  std::string path = argc > 1 ? argv[1] : "/tmp/libz-file-backend-bench";
+  std::size_t mb = argc > 2 ? std::atoi(argv[2]) : 256;
+  std::size_t depth = argc > 3 ? std::atoi(argv[3]) : 64;
+  std::size_t total = argc > 4 ? std::atoi(argv[4]) : 200000;
+  std::size_t threads = argc > 5 ? std::atoi(argv[5]) : 4;
+  std::size_t len = mb << 20;
+
+  int writer = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (writer < 0) {
+    std::cout << "open " << path << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+
+  if (static_cast<std::size_t>(::lseek(writer, 0, SEEK_END)) < len) {
+    std::string chunk(1 << 20, 'x');
+    ::lseek(writer, 0, SEEK_SET);
+    for (std::size_t i = 0; i < len; i += chunk.size()) {
+      ::write(writer, chunk.data(), chunk.size());
+    }
+    ::fsync(writer);
+  }
+  ::close(writer);
+
+  auto direct = true;
+  int fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+  if (fd < 0) {
+    direct = false;
+    fd = ::open(path.c_str(), O_RDONLY);
+  }
+
+  std::cout << mb << "MB file, depth " << depth << ", " << total
+            << " reads of 4k" << (direct ? ", O_DIRECT" : ", buffered")
+            << std::endl;
+
+  for (auto uring : {false, true}) {
+    IOMessageLoop loop;
+
+    std::unique_ptr<FileBackend> pool;
+    FileBackend* backend = nullptr;
+    if (uring) {
+      backend = loop.file_backend();
+      if (std::string(backend->name()) != "io_uring") {
+        std::cout << "io_uring: unavailable" << std::endl;
+        break;
+      }
+    } else {
+      ThreadPoolFileBackend::Options opts;
+      opts.threads = threads;
+      pool = std::make_unique<ThreadPoolFileBackend>(&loop, opts);
+      backend = pool.get();
+    }
+
+    RandomReader reader(&loop, backend, fd, len / kBlockSize, depth, total);
+    auto start = loop.MonoNow();
+    loop.Post([&]() { reader.Start(); });
+    loop.Run();
+
+    auto ms = std::max<long>(
+        libz::DurationCast<MilliSeconds>(loop.MonoNow() - start).count(), 1);
+    std::cout << backend->name() << ": " << reader.completed * 1000 / ms
+              << " iops, " << reader.failed << " failed" << std::endl;
+  }
+
+  ::close(fd);
+  return 0;
+}
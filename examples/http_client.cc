@@ -4,6 +4,8 @@
 #include <control/io-thread.h>
 #include <event/coroutine.h>
 #include <event/io-message-loop.h>
+#include <net/connector.h>
+#include <net/resolver.h>
 
 #include <asio.hpp>
 
@@ -19,6 +21,9 @@ using libz::event::MkRejectedPromise;
 using libz::event::Notifier;
 using libz::event::Promise;
 using libz::event::TimerToken;
+using libz::net::Connector;
+using libz::net::IPAddressList;
+using libz::net::Resolver;
 
 template <typename Resolver>
 bool HandleError(const asio::error_code& ec, Resolver& resolver) {
@@ -34,75 +39,6 @@ bool HandleError(const asio::error_code& ec, Resolver& resolver) {
   return false;
 }
 
-class Resolver {
- public:
-  Resolver(MessageLoop* loop) : loop_(loop) {}
-
-  Resolver(Resolver&&) = default;
-  Resolver(const Resolver&) = default;
-  Resolver& operator=(Resolver&&) = default;
-  Resolver& operator=(const Resolver&) = default;
-
- public:
-  using IPAddressList = std::vector<std::string>;
-
-  Promise<IPAddressList> Resolve(std::string_view host,
-                                 std::optional<MilliSeconds> timeout = {}) {
-    Promise<IPAddressList> promise;
-    auto resolver = std::make_shared<tcp::resolver>(*loop_->proactor());
-
-    auto handler = [_ = resolver, resolver = promise.GetResolver()](
-                       const asio::error_code& ec,
-                       tcp::resolver::iterator it) mutable {
-      if (HandleError(ec, resolver)) {
-        return;
-      }
-
-      asio::error_code err;
-      IPAddressList addr_list;
-      tcp::resolver::iterator end;
-      while (it != end) {
-        if (auto ip = it->endpoint().address().to_string(err); !err) {
-          addr_list.push_back(std::move(ip));
-        }
-
-        ++it;
-      }
-
-      resolver.Resolve(std::move(addr_list));
-    };
-
-    if (timeout) {
-      auto token = loop_->AddTimerEvent(
-          [promise_resolver = promise.GetResolver(),
-           weak_resolver = std::weak_ptr(resolver)](Error&& e) mutable {
-            UNUSE(e);
-            if (auto resolver = weak_resolver.lock(); resolver) {
-              resolver->cancel();
-              promise_resolver.Reject(
-                  Error::MkGeneralError(-1, "cancel", "net"));
-            }
-          },
-          *timeout);
-
-      resolver->async_resolve(
-          host, "",
-          [handler = std::move(handler), cancelable = token.AsCancelable()](
-              const asio::error_code& ec, tcp::resolver::iterator it) mutable {
-            cancelable.reset();
-            handler(ec, it);
-          });
-    } else {
-      resolver->async_resolve(host, "", std::move(handler));
-    }
-
-    return promise;
-  }
-
- private:
-  MessageLoop* loop_;
-};
-
 template <typename socket_type>
 struct ClientBase {
   struct Body : std::istream {
@@ -213,45 +149,15 @@ struct ClientBase {
         : connection(std::move(conn)), request_streambuf(std::move(request)) {}
   };
 
-  Promise<ConnectionPtr> Connect(std::string_view ip, short port,
+  // race the connects to all the addresses in the happy eyeballs way
+  Promise<ConnectionPtr> Connect(IPAddressList ip_list, short port,
                                  std::optional<MilliSeconds> timeout = {}) {
-    Promise<ConnectionPtr> promise;
-    auto ep = tcp::endpoint(asio::ip::make_address(ip), port);
-    auto conn = std::make_shared<Connection>(*loop->proactor());
-
-    auto handler = [resolver = promise.GetResolver(),
-                    conn](const asio::error_code& ec) mutable {
-      if (HandleError(ec, resolver)) {
-        return;
-      }
-      resolver.Resolve(std::move(conn));
-    };
-
-    auto socket_ptr = conn->socket.get();
-    if (timeout) {
-      auto token = loop->AddTimerEvent(
-          [resolver = promise.GetResolver(),
-           weak_conn = std::weak_ptr(conn)](Error&& e) mutable {
-            UNUSE(e);
-            if (auto conn = weak_conn.lock(); conn) {
-              auto socket_ptr = conn->socket.get();
-              socket_ptr->cancel();
-              resolver.Reject(Error::MkGeneralError(-1, "cancel", "net"));
-            }
-          },
-          *timeout);
-
-      socket_ptr->async_connect(
-          ep, [handler = std::move(handler), cancelable = token.AsCancelable()](
-                  const asio::error_code& ec) mutable {
-            cancelable.reset();
-            handler(ec);
-          });
-    } else {
-      socket_ptr->async_connect(ep, std::move(handler));
+    auto socket_result = co_await connector->Connect(ip_list, port, timeout);
+    if (!socket_result) {
+      co_return socket_result.PassError();
     }
 
-    return promise;
+    co_return std::make_shared<Connection>(socket_result.PassResult());
   }
 
   Promise<std::size_t> WriteRequest(const std::shared_ptr<Session>& sess,
@@ -401,7 +307,8 @@ struct ClientBase {
       co_return Error::MkGeneralError(-1, "invalid ip", "net");
     }
 
-    auto conn_result = co_await Connect(ip_list[0], port, opts.connect_timeout);
+    auto conn_result =
+        co_await Connect(std::move(ip_list), port, opts.connect_timeout);
     if (!conn_result) {
       co_return conn_result.PassError();
     }
@@ -434,10 +341,13 @@ struct ClientBase {
   }
 
   ClientBase(MessageLoop* loop)
-      : loop(loop), dns_resolver(std::make_unique<Resolver>(loop)) {}
+      : loop(loop),
+        dns_resolver(std::make_unique<Resolver>(loop)),
+        connector(std::make_unique<Connector>(loop)) {}
 
   MessageLoop* loop;
   std::unique_ptr<Resolver> dns_resolver;
+  std::unique_ptr<Connector> connector;
 };
 
 using HttpClient = ClientBase<tcp::socket>;
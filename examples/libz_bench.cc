@@ -0,0 +1,680 @@
+// libz-bench, a wrk style load generator on the libz loops.
+//
+//   libz-bench -t 2 -c 64 -d 10 -p echo 127.0.0.1:9000
+//   libz-bench -t 2 -c 64 -d 10 -R 50000 -p http --path /index.html host:80
+//   libz-bench -t 2 -p rpc --serve 127.0.0.1:9001
+//
+// the connections are spread over the loop threads. without a rate, every
+// connection sends the next request once the response arrives. with a rate,
+// the requests are sent on a fixed schedule, and the latency is measured from
+// the time the request was supposed to be sent, so that a stall isn't hidden
+// by the requests it held back (the coordinated omission).
+//
+// with --serve, it runs the echo or rpc server on the loop threads instead
+#include <base/common.h>
+#include <base/histogram.h>
+#include <control/io-thread.h>
+#include <event/promise.h>
+#include <fmt/format.h>
+#include <getopt.h>
+#include <net/connector.h>
+#include <net/dns-client.h>
+#include <net/rpc-connection.h>
+
+#include <asio.hpp>
+#include <atomic>
+#include <charconv>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using asio::ip::tcp;
+using libz::Error;
+using libz::Histogram;
+using libz::MicroSeconds;
+using libz::Result;
+using libz::Seconds;
+using libz::Tm;
+using libz::ctl::IOThreadPool;
+using libz::event::MessageLoop;
+using libz::event::Promise;
+using libz::net::Connector;
+using libz::net::DnsAnswer;
+using libz::net::DnsClient;
+using libz::net::IPAddressList;
+using libz::net::RpcFrame;
+using libz::net::TcpRpcConnection;
+
+struct Options {
+  int threads{2};
+  int connections{10};
+  int duration{10};
+  double rate{0};
+
+  std::string protocol{"echo"};
+  std::size_t size{64};
+  std::string path{"/"};
+  bool serve{false};
+
+  std::string host;
+  std::uint16_t port{0};
+};
+
+constexpr std::uint64_t kRpcEcho = 1;
+constexpr libz::MilliSeconds kConnectTimeout{5000};
+
+Error ToError(const asio::error_code& ec) {
+  return Error::MkBoostError(ec.value(), ec.message());
+}
+
+// Client sends one request at a time over its connection
+class Client {
+ public:
+  using Callback = std::function<void(Result<std::size_t>&&)>;
+
+  virtual ~Client() = default;
+
+  // |done| is invoked with the size of the response
+  virtual void Request(Callback&& done) = 0;
+};
+
+class EchoClient : public Client {
+ public:
+  EchoClient(tcp::socket&& socket, std::size_t size)
+      : socket_(std::move(socket)), request_(size, 'x'), response_(size, 0) {}
+
+  void Request(Callback&& done) override {
+    asio::async_write(
+        socket_, asio::buffer(request_),
+        [this, done = std::move(done)](const asio::error_code& ec,
+                                       std::size_t) mutable {
+          if (ec) {
+            done(ToError(ec));
+            return;
+          }
+
+          asio::async_read(socket_, asio::buffer(response_),
+                           [done = std::move(done)](const asio::error_code& ec,
+                                                    std::size_t n) {
+                             done(ec ? Result<std::size_t>(ToError(ec))
+                                     : Result<std::size_t>(n));
+                           });
+        });
+  }
+
+ private:
+  tcp::socket socket_;
+  std::string request_;
+  std::string response_;
+};
+
+// the keep-alive requests of http/1.1, the response must have the
+// content-length
+class HttpClient : public Client {
+ public:
+  HttpClient(tcp::socket&& socket, const Options& opts)
+      : socket_(std::move(socket)),
+        request_(fmt::format("GET {} HTTP/1.1\r\nHost: {}\r\n\r\n", opts.path,
+                             opts.host)) {}
+
+  void Request(Callback&& done) override {
+    done_ = std::move(done);
+    asio::async_write(socket_, asio::buffer(request_),
+                      [this](const asio::error_code& ec, std::size_t) {
+                        if (ec) {
+                          Done(ToError(ec));
+                          return;
+                        }
+                        Read();
+                      });
+  }
+
+ private:
+  void Done(Result<std::size_t>&& r) {
+    auto done = std::move(done_);
+    done(std::move(r));
+  }
+
+  void Read() {
+    asio::async_read_until(
+        socket_, asio::dynamic_buffer(buffer_), "\r\n\r\n",
+        [this](const asio::error_code& ec, std::size_t header) {
+          if (ec) {
+            Done(ToError(ec));
+            return;
+          }
+
+          auto length =
+              ContentLength(std::string_view(buffer_).substr(0, header));
+          if (length < 0) {
+            Done(Error::MkSysError(EPROTO));
+            return;
+          }
+
+          auto total = header + length;
+          auto rest = total > buffer_.size() ? total - buffer_.size() : 0;
+          asio::async_read(socket_, asio::dynamic_buffer(buffer_),
+                           asio::transfer_exactly(rest),
+                           [this, total](const asio::error_code& ec,
+                                         std::size_t) {
+                             if (ec) {
+                               Done(ToError(ec));
+                               return;
+                             }
+
+                             buffer_.erase(0, total);
+                             Done(total);
+                           });
+        });
+  }
+
+  static long ContentLength(std::string_view header) {
+    constexpr std::string_view kName = "content-length:";
+    std::string lower(header);
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    auto pos = lower.find(kName);
+    if (pos == std::string::npos) {
+      return -1;
+    }
+
+    auto begin = lower.data() + pos + kName.size();
+    while (*begin == ' ') {
+      ++begin;
+    }
+
+    long length = -1;
+    std::from_chars(begin, lower.data() + lower.size(), length);
+    return length;
+  }
+
+  tcp::socket socket_;
+  std::string request_;
+  std::string buffer_;
+  Callback done_;
+};
+
+class RpcClient : public Client {
+ public:
+  RpcClient(MessageLoop* loop, tcp::socket&& socket, std::size_t size)
+      : conn_(loop, std::move(socket)), payload_(size, 'x') {
+    conn_.Start();
+  }
+
+  void Request(Callback&& done) override {
+    promise_.emplace(conn_.Call(kRpcEcho, payload_));
+    promise_->Then(
+        [done = std::move(done)](Result<RpcFrame>&& r) {
+          done(r ? Result<std::size_t>(r.GetResult().payload.size())
+                 : Result<std::size_t>(r.PassError()));
+        },
+        nullptr);
+  }
+
+ private:
+  TcpRpcConnection conn_;
+  std::string payload_;
+  std::optional<Promise<RpcFrame>> promise_;
+};
+
+struct Worker;
+
+// Connection drives the requests of one client, in the closed loop or on
+// the schedule of the rate
+struct Connection {
+  void Next();
+
+  Worker* worker;
+  std::unique_ptr<Client> client;
+
+  // the intended time of the next request with the rate
+  Tm intended;
+  MicroSeconds interval{0};
+};
+
+// Worker runs the connections, or the server, on a loop of the pool, and
+// all of its methods are invoked within the loop thread
+struct Worker {
+  Worker(const Options& opts, int id, MessageLoop* loop)
+      : opts(opts), id(id), loop(loop) {}
+
+  void Run();
+  void Connect(const IPAddressList& addresses);
+  void Start();
+  void Stop();
+  void Fail(const std::string& what, Error&& e);
+
+  void Serve();
+  void Accept();
+
+  const Options& opts;
+  int id;
+  MessageLoop* loop;
+  std::unique_ptr<DnsClient> dns;
+  std::unique_ptr<Connector> connector;
+  std::vector<Connection> connections;
+  int connected{0};
+  bool stopped{false};
+  Tm start;
+
+  Histogram latency;
+  std::uint64_t requests{0};
+  std::uint64_t bytes{0};
+  std::uint64_t errors{0};
+  libz::MilliSeconds elapsed{0};
+
+  std::unique_ptr<tcp::acceptor> acceptor;
+  std::vector<std::unique_ptr<TcpRpcConnection>> served;
+};
+
+void Connection::Next() {
+  auto loop = worker->loop;
+  auto start = interval.count() > 0 ? intended : loop->MonoNow();
+
+  client->Request([this, start, loop](Result<std::size_t>&& r) {
+    if (worker->stopped) {
+      return;
+    }
+
+    if (!r) {
+      if (worker->errors++ == 0) {
+        fmt::print("thread {}: {}\n", worker->id, r.PassError().Details());
+      }
+      return;
+    }
+
+    auto now = loop->MonoNow();
+    worker->latency.Record(
+        libz::DurationCast<MicroSeconds>(now - start).count());
+    ++worker->requests;
+    worker->bytes += r.GetResult();
+
+    if (interval.count() == 0) {
+      Next();
+      return;
+    }
+
+    // the late request is sent at once, and its latency includes the delay
+    intended += interval;
+    if (intended <= now) {
+      Next();
+    } else {
+      loop->RunAt(
+          [this](Error&& e) {
+            if (!e && !worker->stopped) {
+              Next();
+            }
+          },
+          intended);
+    }
+  });
+}
+
+// the host is resolved, and the connections are established, on the loop
+// without blocking it. the loop is shut down at the end, or on the first
+// failure, so that its thread exits
+void Worker::Run() {
+  dns = std::make_unique<DnsClient>(loop);
+  connector = std::make_unique<Connector>(loop);
+  dns->LookupHost(opts.host, [this](Result<DnsAnswer>&& r) {
+    if (!r) {
+      Fail("resolve " + opts.host, r.PassError());
+      return;
+    }
+    Connect(r.GetResult().addresses);
+  });
+}
+
+void Worker::Connect(const IPAddressList& addresses) {
+  auto count = opts.connections / opts.threads +
+               (id < opts.connections % opts.threads ? 1 : 0);
+  connections.resize(count);
+  for (auto& conn : connections) {
+    conn.worker = this;
+    connector->Connect(
+        addresses, opts.port, kConnectTimeout,
+        [this, &conn](Result<tcp::socket>&& r) {
+          if (stopped) {
+            return;
+          }
+
+          if (!r) {
+            Fail(fmt::format("connect {}:{}", opts.host, opts.port),
+                 r.PassError());
+            return;
+          }
+
+          auto socket = r.PassResult();
+          asio::error_code ignored;
+          socket.set_option(tcp::no_delay(true), ignored);
+          if (opts.protocol == "http") {
+            conn.client = std::make_unique<HttpClient>(std::move(socket), opts);
+          } else if (opts.protocol == "rpc") {
+            conn.client =
+                std::make_unique<RpcClient>(loop, std::move(socket), opts.size);
+          } else {
+            conn.client =
+                std::make_unique<EchoClient>(std::move(socket), opts.size);
+          }
+
+          if (++connected == static_cast<int>(connections.size())) {
+            Start();
+          }
+        });
+  }
+}
+
+void Worker::Start() {
+  // the connection i of the worker is the (id + i * threads)th of all, and
+  // every connection has its share of the rate, staggered in between
+  start = loop->MonoNow();
+  for (int i = 0; i < static_cast<int>(connections.size()); ++i) {
+    auto& conn = connections[i];
+    if (opts.rate > 0) {
+      conn.interval = MicroSeconds(
+          static_cast<std::int64_t>(opts.connections * 1e6 / opts.rate));
+      conn.intended = start + conn.interval * (id + i * opts.threads) /
+                                  opts.connections;
+    }
+  }
+
+  for (auto& conn : connections) {
+    if (conn.interval.count() > 0) {
+      loop->RunAt(
+          [&conn](Error&& e) {
+            if (!e) {
+              conn.Next();
+            }
+          },
+          conn.intended);
+    } else {
+      conn.Next();
+    }
+  }
+
+  loop->RunAfter(
+      [this](Error&&) {
+        if (stopped) {
+          return;
+        }
+        elapsed =
+            libz::DurationCast<libz::MilliSeconds>(loop->MonoNow() - start);
+        Stop();
+      },
+      Seconds(opts.duration));
+}
+
+// the handlers of the requests cancelled by closing the sockets aren't run,
+// as the loop is stopped in the same handler
+void Worker::Stop() {
+  stopped = true;
+  connections.clear();
+  connector.reset();
+  dns.reset();
+  acceptor.reset();
+  loop->Shutdown();
+}
+
+// the resolver and the connector may be invoking it, so that they are
+// destroyed after it returns
+void Worker::Fail(const std::string& what, Error&& e) {
+  if (stopped) {
+    return;
+  }
+  stopped = true;
+
+  ++errors;
+  fmt::print("thread {}: {}: {}\n", id, what, e.Details());
+  loop->Post([this]() { Stop(); });
+}
+
+struct EchoSession : public std::enable_shared_from_this<EchoSession> {
+  explicit EchoSession(tcp::socket&& socket)
+      : socket(std::move(socket)), buffer(64 << 10, 0) {}
+
+  void Read() {
+    socket.async_read_some(
+        asio::buffer(buffer),
+        [self = shared_from_this()](const asio::error_code& ec,
+                                    std::size_t n) {
+          if (ec) {
+            return;
+          }
+
+          asio::async_write(self->socket, asio::buffer(self->buffer.data(), n),
+                            [self](const asio::error_code& ec, std::size_t) {
+                              if (!ec) {
+                                self->Read();
+                              }
+                            });
+        });
+  }
+
+  tcp::socket socket;
+  std::string buffer;
+};
+
+void Worker::Accept() {
+  acceptor->async_accept([this](const asio::error_code& ec,
+                                tcp::socket socket) {
+    if (ec) {
+      return;
+    }
+
+    socket.set_option(tcp::no_delay(true));
+    if (opts.protocol == "rpc") {
+      auto conn = std::make_unique<TcpRpcConnection>(loop, std::move(socket));
+      auto raw = conn.get();
+      conn->SetRequestHandler(
+          [raw](RpcFrame&& frame) { raw->Reply(frame, frame.payload); });
+      conn->Start();
+      served.push_back(std::move(conn));
+    } else {
+      std::make_shared<EchoSession>(std::move(socket))->Read();
+    }
+
+    Accept();
+  });
+}
+
+// every loop thread accepts on its own socket with SO_REUSEPORT, the loop is
+// shut down if it can't listen
+void Worker::Serve() {
+  using ReusePort =
+      asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+  asio::error_code ec;
+  auto address = asio::ip::make_address(opts.host, ec);
+  if (ec) {
+    Fail("listen on " + opts.host, ToError(ec));
+    return;
+  }
+
+  tcp::endpoint endpoint(address, opts.port);
+  acceptor = std::make_unique<tcp::acceptor>(*loop->proactor());
+  acceptor->open(endpoint.protocol(), ec);
+  if (!ec) {
+    acceptor->set_option(tcp::acceptor::reuse_address(true), ec);
+  }
+  if (!ec) {
+    acceptor->set_option(ReusePort(true), ec);
+  }
+  if (!ec) {
+    acceptor->bind(endpoint, ec);
+  }
+  if (!ec) {
+    acceptor->listen(asio::socket_base::max_listen_connections, ec);
+  }
+  if (ec) {
+    Fail(fmt::format("listen on {}:{}", opts.host, opts.port), ToError(ec));
+    return;
+  }
+  Accept();
+}
+
+void Usage(const char* name) {
+  fmt::print(
+      "usage: {} [options] <host:port>\n"
+      "  -t, --threads <n>      the loop threads, 2 by default\n"
+      "  -c, --connections <n>  the connections in total, 10 by default\n"
+      "  -d, --duration <s>     the seconds to run, 10 by default\n"
+      "  -R, --rate <n>         the requests per second in total, or the "
+      "closed loop\n"
+      "  -p, --protocol <p>     echo, http or rpc, echo by default\n"
+      "  -s, --size <n>         the payload size of echo and rpc, 64 by "
+      "default\n"
+      "      --path <path>      the path of http, / by default\n"
+      "      --serve            run the echo or rpc server instead\n",
+      name);
+}
+
+bool ParseOptions(int argc, char* argv[], Options* opts) {
+  static option longopts[] = {
+      {"threads", required_argument, nullptr, 't'},
+      {"connections", required_argument, nullptr, 'c'},
+      {"duration", required_argument, nullptr, 'd'},
+      {"rate", required_argument, nullptr, 'R'},
+      {"protocol", required_argument, nullptr, 'p'},
+      {"size", required_argument, nullptr, 's'},
+      {"path", required_argument, nullptr, 'P'},
+      {"serve", no_argument, nullptr, 'S'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  int c;
+  while ((c = ::getopt_long(argc, argv, "t:c:d:R:p:s:h", longopts,
+                            nullptr)) != -1) {
+    switch (c) {
+      case 't':
+        opts->threads = std::max(std::atoi(optarg), 1);
+        break;
+      case 'c':
+        opts->connections = std::max(std::atoi(optarg), 1);
+        break;
+      case 'd':
+        opts->duration = std::max(std::atoi(optarg), 1);
+        break;
+      case 'R':
+        opts->rate = std::atof(optarg);
+        break;
+      case 'p':
+        opts->protocol = optarg;
+        break;
+      case 's':
+        opts->size = std::max(std::atol(optarg), 1L);
+        break;
+      case 'P':
+        opts->path = optarg;
+        break;
+      case 'S':
+        opts->serve = true;
+        break;
+      default:
+        return false;
+    }
+  }
+
+  if (optind + 1 != argc) {
+    return false;
+  }
+
+  if (opts->protocol != "echo" && opts->protocol != "http" &&
+      opts->protocol != "rpc") {
+    return false;
+  }
+
+  std::string_view target(argv[optind]);
+  auto colon = target.rfind(':');
+  if (colon == std::string_view::npos) {
+    return false;
+  }
+
+  opts->host = target.substr(0, colon);
+  opts->port = std::atoi(std::string(target.substr(colon + 1)).c_str());
+  return opts->port != 0;
+}
+
+std::string FormatLatency(std::uint64_t us) {
+  return fmt::format("{:.3f}ms", us / 1000.0);
+}
+
+int main(int argc, char* argv[]) {
+  Options opts;
+  if (!ParseOptions(argc, argv, &opts)) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  IOThreadPool pool(opts.threads);
+  pool.Run();
+  pool.WaitRunning();
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int i = 0; i < opts.threads; ++i) {
+    workers.push_back(
+        std::make_unique<Worker>(opts, i, pool.At(i)->event_loop()));
+  }
+
+  if (opts.serve) {
+    fmt::print("serving {} on {}:{} with {} threads\n", opts.protocol,
+               opts.host, opts.port, opts.threads);
+    for (auto& worker : workers) {
+      auto loop = worker->loop;
+      loop->Dispatch(loop, [&worker]() { worker->Serve(); });
+    }
+    pool.JoinAll();
+
+    for (auto& worker : workers) {
+      if (worker->errors > 0) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  fmt::print("running {}s {} test @ {}:{}, {} threads and {} connections{}\n",
+             opts.duration, opts.protocol, opts.host, opts.port, opts.threads,
+             opts.connections,
+             opts.rate > 0 ? fmt::format(", {} requests/s", opts.rate) : "");
+
+  for (auto& worker : workers) {
+    auto loop = worker->loop;
+    loop->Dispatch(loop, [&worker]() { worker->Run(); });
+  }
+  pool.JoinAll();
+
+  Histogram latency;
+  std::uint64_t requests = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t errors = 0;
+  double throughput = 0;
+
+  for (auto& worker : workers) {
+    auto seconds = std::max<double>(worker->elapsed.count(), 1) / 1000;
+    fmt::print("  thread {}: {} requests, {:.1f} requests/s, {:.2f}MB/s, {} "
+               "errors\n",
+               worker->id, worker->requests, worker->requests / seconds,
+               worker->bytes / seconds / (1 << 20), worker->errors);
+
+    latency.Merge(worker->latency);
+    requests += worker->requests;
+    bytes += worker->bytes;
+    errors += worker->errors;
+    throughput += worker->requests / seconds;
+  }
+
+  fmt::print("  latency: min {}, mean {}, max {}\n",
+             FormatLatency(latency.min()),
+             FormatLatency(static_cast<std::uint64_t>(latency.mean())),
+             FormatLatency(latency.max()));
+  for (auto percentile : {50.0, 75.0, 90.0, 99.0, 99.9, 99.99}) {
+    fmt::print("  {:>8}% {:>12}\n", percentile,
+               FormatLatency(latency.ValueAt(percentile)));
+  }
+
+  fmt::print("{} requests, {} errors, {:.1f} requests/s, {:.2f}MB/s\n",
+             requests, errors, throughput,
+             throughput * bytes / std::max<double>(requests, 1) / (1 << 20));
+  return errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,130 @@
+#include <base/ring.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using libz::MpmcRing;
+using libz::SpscRing;
+
+constexpr std::size_t kBatch = 32;
+
+// the baseline, a deque behind the mutex, as the posting to the loop
+class MutexQueue {
+ public:
+  bool TryPush(std::uint64_t val) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    queue_.push_back(val);
+    return true;
+  }
+
+  std::size_t TryPopBatch(std::uint64_t* out, std::size_t n) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    n = std::min(n, queue_.size());
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i] = queue_.front();
+      queue_.pop_front();
+    }
+    return n;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<std::uint64_t> queue_;
+};
+
+// |producers| threads push |total| numbers into the queue, one by one or by
+// the batches, while a consumer pops them by the batches, as a loop drains
+// its tasks, return the millions per second
+template <typename Queue>
+double Run(Queue* queue, int producers, std::size_t total, bool batch) {
+  std::size_t each = total / producers;
+  std::atomic<bool> go{false};
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&]() {
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+
+      std::uint64_t items[kBatch];
+      std::size_t i = 0;
+      while (i < each) {
+        if constexpr (requires { queue->PushBatch(items, kBatch); }) {
+          if (batch) {
+            std::size_t n = 0;
+            for (; n < kBatch && i < each; ++n) {
+              items[n] = i++;
+            }
+            queue->PushBatch(items, n);
+            continue;
+          }
+        }
+        while (!queue->TryPush(i)) {
+          std::this_thread::yield();
+        }
+        ++i;
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+
+  std::uint64_t out[kBatch];
+  std::size_t popped = 0;
+  while (popped < each * producers) {
+    auto n = queue->TryPopBatch(out, kBatch);
+    if (n == 0) {
+      std::this_thread::yield();
+    }
+    popped += n;
+  }
+
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return static_cast<double>(popped) / std::max<long>(us, 1);
+}
+
+// usage: ring_bench [millions] [capacity]
+//
+// the throughput of the rings and the mutex queue, from 1 to 16 producers
+// into a consumer
+int main(int argc, char* argv[]) {
+  std::size_t total = (argc > 1 ? std::atoi(argv[1]) : 8) * 1000000ul;
+  std::size_t capacity = argc > 2 ? std::atoi(argv[2]) : 4096;
+
+  std::cout << total / 1000000 << "M numbers, capacity " << capacity
+            << ", batch " << kBatch << ", M/s" << std::endl;
+
+  {
+    SpscRing<std::uint64_t> ring(capacity);
+    std::cout << "spsc: " << Run(&ring, 1, total, false) << std::endl;
+    std::cout << "spsc batch: " << Run(&ring, 1, total, true) << std::endl;
+  }
+
+  for (int producers = 1; producers <= 16; producers *= 2) {
+    MpmcRing<std::uint64_t> ring(capacity);
+    MutexQueue queue;
+
+    auto single = Run(&ring, producers, total, false);
+    auto batch = Run(&ring, producers, total, true);
+    auto mutex = Run(&queue, producers, total, false);
+    std::cout << producers << " producers, mpmc: " << single
+              << ", mpmc batch: " << batch << ", mutex: " << mutex
+              << std::endl;
+  }
+
+  return 0;
+}
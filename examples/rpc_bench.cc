@@ -0,0 +1,171 @@
+#include <base/common.h>
+#include <event/io-message-loop.h>
+#include <event/promise.h>
+#include <net/rpc-connection.h>
+#include <sys/resource.h>
+
+#include <asio.hpp>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using asio::ip::tcp;
+using libz::Error;
+using libz::MilliSeconds;
+using libz::Result;
+using libz::Seconds;
+using libz::Tm;
+using libz::event::IOMessageLoop;
+using libz::event::MessageLoop;
+using libz::event::Promise;
+using libz::net::RpcFrame;
+using libz::net::TcpRpcConnection;
+
+constexpr std::uint64_t kEcho = 1;
+constexpr std::size_t kDepth = 128;
+
+// the user and system cpu time of the calling thread
+MilliSeconds CpuTime() {
+  struct rusage usage;
+  ::getrusage(RUSAGE_THREAD, &usage);
+
+  auto ms = [](const timeval& tv) {
+    return MilliSeconds(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+  };
+  return ms(usage.ru_utime) + ms(usage.ru_stime);
+}
+
+// the echo server runs on its own loop thread, one connection at a time
+struct Server {
+  void Run(std::promise<std::uint16_t>* port) {
+    IOMessageLoop loop;
+    tcp::acceptor acceptor(*loop.proactor(),
+                           tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+    port->set_value(acceptor.local_endpoint().port());
+
+    std::unique_ptr<TcpRpcConnection> conn;
+    std::function<void()> accept = [&]() {
+      acceptor.async_accept([&](const asio::error_code& ec, tcp::socket s) {
+        if (ec) {
+          return;
+        }
+
+        s.set_option(tcp::no_delay(true));
+        conn = std::make_unique<TcpRpcConnection>(&loop, std::move(s));
+        conn->SetRequestHandler(
+            [&](RpcFrame&& frame) { conn->Reply(frame, frame.payload); });
+        conn->Start();
+        accept();
+      });
+    };
+
+    std::function<void(Error&&)> poll = [&](Error&&) {
+      if (stopped) {
+        cpu = CpuTime();
+        loop.Shutdown();
+        return;
+      }
+      loop.RunAfter(std::function<void(Error&&)>(poll), MilliSeconds(50));
+    };
+
+    loop.Post([&]() {
+      accept();
+      poll({});
+    });
+    loop.Run();
+  }
+
+  std::atomic<bool> stopped{false};
+  MilliSeconds cpu{0};
+};
+
+// keep |kDepth| calls in flight until the deadline. the responses are handled
+// inline, since the executor of the loop would measure the task scheduling
+struct Pipeline {
+  Pipeline(MessageLoop* loop, TcpRpcConnection* conn, std::size_t size)
+      : loop(loop), conn(conn), payload(size, 'x'), slots(kDepth) {}
+
+  void Start(Tm until) {
+    deadline = until;
+    for (std::size_t i = 0; i < slots.size(); ++i) {
+      Issue(i);
+    }
+  }
+
+  void Issue(std::size_t slot) {
+    slots[slot].emplace(conn->Call(kEcho, payload));
+    slots[slot]->Then(
+        [this, slot](Result<RpcFrame>&& r) {
+          if (!r) {
+            std::cout << "err: " << r.PassError().Details() << std::endl;
+            loop->Shutdown();
+            return;
+          }
+
+          ++completed;
+          if (loop->MonoNow() < deadline) {
+            Issue(slot);
+          } else if (conn->inflight() == 0) {
+            loop->Shutdown();
+          }
+        },
+        nullptr);
+  }
+
+  MessageLoop* loop;
+  TcpRpcConnection* conn;
+  std::string payload;
+  std::vector<std::optional<Promise<RpcFrame>>> slots;
+  Tm deadline;
+  std::size_t completed{0};
+};
+
+int main(int argc, char* argv[]) {
+  auto seconds = argc > 1 ? std::atoi(argv[1]) : 2;
+
+  Server server;
+  std::promise<std::uint16_t> port;
+  auto ready = port.get_future();
+  std::thread server_thread([&]() { server.Run(&port); });
+  tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), ready.get());
+
+  auto total = CpuTime();
+  for (std::size_t size : {16, 256, 4096, 65536}) {
+    IOMessageLoop loop;
+    tcp::socket socket(*loop.proactor());
+    socket.connect(endpoint);
+    socket.set_option(tcp::no_delay(true));
+
+    TcpRpcConnection conn(&loop, std::move(socket));
+    Pipeline pipeline(&loop, &conn, size);
+
+    auto cpu = CpuTime();
+    auto start = loop.MonoNow();
+
+    loop.Post([&]() {
+      conn.Start();
+      pipeline.Start(start + Seconds(seconds));
+    });
+    loop.Run();
+
+    auto ms = std::max<long>(
+        libz::DurationCast<MilliSeconds>(loop.MonoNow() - start).count(), 1);
+    auto cpu_ms = std::max<long>((CpuTime() - cpu).count(), 1);
+    std::cout << "payload " << size << "B: " << pipeline.completed * 1000 / ms
+              << " calls/s, client " << pipeline.completed * 1000 / cpu_ms
+              << " calls per cpu second, " << conn.stats().calls /
+                     std::max<std::uint64_t>(conn.stats().writes, 1)
+              << " calls per write" << std::endl;
+  }
+  total = CpuTime() - total;
+
+  server.stopped = true;
+  server_thread.join();
+  std::cout << "cpu: client " << total.count() << "ms, server "
+            << server.cpu.count() << "ms" << std::endl;
+
+  return 0;
+}
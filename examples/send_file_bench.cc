@@ -0,0 +1,180 @@
+#include <base/common.h>
+#include <event/coroutine.h>
+#include <event/io-message-loop.h>
+#include <event/promise.h>
+#include <fcntl.h>
+#include <net/send-file.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <asio.hpp>
+#include <iostream>
+
+using asio::ip::tcp;
+using libz::Error;
+using libz::MilliSeconds;
+using libz::Result;
+using libz::event::IOMessageLoop;
+using libz::event::MessageLoop;
+using libz::event::Promise;
+using libz::event::PromiseResolver;
+using libz::net::SendFile;
+using libz::net::UniqueFd;
+
+constexpr std::size_t kChunkSize = 64 << 10;
+
+// the baseline, every byte is copied into the user space and out again.
+// Notes, the chunks are chained with the asio callbacks, since the coroutine
+// is resumed by the loop tasks and it would measure the task scheduling
+struct ReadWriteFile {
+  ReadWriteFile(tcp::socket& socket, int fd, std::size_t len)
+      : socket(socket), fd(fd), len(len), buffer(kChunkSize, '\0') {}
+
+  Promise<std::size_t> Start() {
+    Promise<std::size_t> promise;
+    resolver = promise.GetResolver();
+    Next();
+    return promise;
+  }
+
+  void Next() {
+    auto n = ::pread(fd, buffer.data(), std::min(kChunkSize, len - sent), sent);
+    if (n <= 0) {
+      resolver.Resolve(sent);
+      return;
+    }
+
+    asio::async_write(socket, asio::buffer(buffer.data(), n),
+                      [this](const asio::error_code& ec, std::size_t n) {
+                        if (ec) {
+                          resolver.Reject(
+                              Error::MkBoostError(ec.value(), ec.message()));
+                          return;
+                        }
+
+                        sent += n;
+                        if (sent < len) {
+                          Next();
+                        } else {
+                          resolver.Resolve(sent);
+                        }
+                      });
+  }
+
+  tcp::socket& socket;
+  int fd;
+  std::size_t len;
+  std::size_t sent{0};
+  std::string buffer;
+  PromiseResolver<std::size_t> resolver;
+};
+
+// drain the socket until the end of file
+struct Drainer {
+  explicit Drainer(tcp::socket& socket)
+      : socket(socket), buffer(kChunkSize, '\0') {}
+
+  Promise<std::size_t> Start() {
+    Promise<std::size_t> promise;
+    resolver = promise.GetResolver();
+    Next();
+    return promise;
+  }
+
+  void Next() {
+    socket.async_read_some(asio::buffer(buffer),
+                           [this](const asio::error_code& ec, std::size_t n) {
+                             if (ec) {
+                               resolver.Resolve(received);
+                               return;
+                             }
+
+                             received += n;
+                             Next();
+                           });
+  }
+
+  tcp::socket& socket;
+  std::string buffer;
+  std::size_t received{0};
+  PromiseResolver<std::size_t> resolver;
+};
+
+Promise<MilliSeconds> Run(MessageLoop* loop, bool zero_copy, int fd,
+                          std::size_t len) {
+  tcp::acceptor acceptor(*loop->proactor(),
+                         tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+  tcp::socket client(*loop->proactor());
+  client.connect(acceptor.local_endpoint());
+  auto server = acceptor.accept();
+
+  auto start = loop->MonoNow();
+
+  Drainer drainer(server);
+  auto drained = drainer.Start();
+
+  ReadWriteFile baseline(client, fd, len);
+  auto sent = zero_copy ? co_await SendFile(client, fd, 0, len)
+                        : co_await baseline.Start();
+  if (!sent) {
+    co_return sent.PassError();
+  }
+
+  client.shutdown(tcp::socket::shutdown_send);
+  co_await drained;
+
+  co_return libz::DurationCast<MilliSeconds>(loop->MonoNow() - start);
+}
+
+// the user and system cpu time of the process
+MilliSeconds CpuTime() {
+  struct rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+
+  auto ms = [](const timeval& tv) {
+    return MilliSeconds(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+  };
+  return ms(usage.ru_utime) + ms(usage.ru_stime);
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t mb = argc > 1 ? std::atoi(argv[1]) : 1024;
+  std::size_t len = mb << 20;
+
+  char path[] = "/tmp/libz-send-file-bench-XXXXXX";
+  UniqueFd fd(::mkstemp(path));
+  ::unlink(path);
+
+  std::string chunk(kChunkSize, 'x');
+  for (std::size_t i = 0; i < len; i += chunk.size()) {
+    ::write(fd.get(), chunk.data(), chunk.size());
+  }
+
+  for (auto zero_copy : {false, true}) {
+    IOMessageLoop loop;
+    std::optional<Promise<MilliSeconds>> promise;
+    auto cpu = CpuTime();
+
+    loop.Post([&]() {
+      promise.emplace(Run(&loop, zero_copy, fd.get(), len));
+      promise->Then(
+          [&](Result<MilliSeconds>&& r) {
+            if (!r) {
+              std::cout << "err: " << r.PassError().Details() << std::endl;
+            } else {
+              auto ms = std::max<long>(r.GetResult().count(), 1);
+              std::cout << (zero_copy ? "sendfile:   " : "read/write: ") << mb
+                        << "MB in " << ms << "ms, " << mb * 1000 / ms
+                        << "MB/s, cpu " << (CpuTime() - cpu).count() << "ms"
+                        << std::endl;
+            }
+            loop.Shutdown();
+          },
+          loop.executor());
+    });
+
+    loop.Run();
+  }
+
+  return 0;
+}
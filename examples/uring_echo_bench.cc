@@ -0,0 +1,343 @@
+#include <arpa/inet.h>
+#include <base/common.h>
+#include <event/io-message-loop.h>
+#include <event/io-uring-net.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using asio::ip::tcp;
+using libz::event::IOMessageLoop;
+using libz::event::IOUringAcceptor;
+using libz::event::IOUringBufferRing;
+using libz::event::IOUringEngine;
+using libz::event::IOUringProvidedBuffer;
+using libz::event::IOUringReceiver;
+
+// the echo session on asio, a read is pending per connection, with a buffer
+// held by it
+class AsioSession : public std::enable_shared_from_this<AsioSession> {
+ public:
+  AsioSession(tcp::socket&& sock, std::size_t buffer_size)
+      : sock_(std::move(sock)), buffer_(buffer_size, '\0') {}
+
+  void Read() {
+    sock_.async_read_some(
+        asio::buffer(buffer_),
+        [self = shared_from_this()](const asio::error_code& ec,
+                                    std::size_t n) {
+          if (ec) {
+            return;
+          }
+
+          asio::async_write(self->sock_, asio::buffer(self->buffer_.data(), n),
+                            [self](const asio::error_code& ec, std::size_t) {
+                              if (!ec) {
+                                self->Read();
+                              }
+                            });
+        });
+  }
+
+ private:
+  tcp::socket sock_;
+  std::string buffer_;
+};
+
+class AsioServer {
+ public:
+  AsioServer(IOMessageLoop* loop, int listen_fd, std::size_t buffer_size)
+      : acceptor_(*loop->proactor(), tcp::v4(), listen_fd),
+        buffer_size_(buffer_size) {}
+
+  void Start() {
+    acceptor_.async_accept([this](const asio::error_code& ec,
+                                  tcp::socket sock) {
+      if (ec) {
+        return;
+      }
+
+      sock.set_option(tcp::no_delay(true));
+      std::make_shared<AsioSession>(std::move(sock), buffer_size_)->Read();
+      Start();
+    });
+  }
+
+  // the listen fd is owned by the caller
+  void Stop() { acceptor_.release(); }
+
+ private:
+  tcp::acceptor acceptor_;
+  std::size_t buffer_size_;
+};
+
+// the echo session on io_uring, the data is received into the buffers of
+// the shared ring, and sent from them, one send in flight at a time so that
+// the order is kept. the session deletes itself after the eof
+class UringSession {
+ public:
+  UringSession(IOUringEngine* uring, std::shared_ptr<IOUringBufferRing> ring,
+               int fd, bool zero_copy)
+      : uring_(uring),
+        fd_(fd),
+        zero_copy_(zero_copy),
+        receiver_(uring, std::move(ring), fd) {}
+
+  ~UringSession() { ::close(fd_); }
+
+  void Start() {
+    auto e = receiver_.Start([this](int res, IOUringProvidedBuffer&& buffer) {
+      if (res <= 0) {
+        closed_ = true;
+        MaybeDelete();
+        return;
+      }
+
+      pending_.push_back(std::move(buffer));
+      if (!sending_) {
+        Send(0);
+      }
+    });
+    if (e) {
+      delete this;
+    }
+  }
+
+ private:
+  // send the front buffer from |offset|
+  void Send(std::size_t offset) {
+    sending_ = true;
+    auto& buffer = pending_.front();
+    auto data = buffer.data() + offset;
+    auto len = buffer.size() - offset;
+    auto callback = [this, offset, len](int res) {
+      if (res < 0) {
+        pending_.clear();
+        sending_ = false;
+        receiver_.Stop();
+        closed_ = true;
+        MaybeDelete();
+        return;
+      }
+
+      if (static_cast<std::size_t>(res) < len) {
+        Send(offset + res);
+        return;
+      }
+
+      pending_.pop_front();
+      sending_ = false;
+      if (!pending_.empty()) {
+        Send(0);
+      } else {
+        MaybeDelete();
+      }
+    };
+
+    if (zero_copy_) {
+      SendZeroCopy(uring_, fd_, data, len, std::move(callback));
+      return;
+    }
+
+    uring_->Run(
+        [this, data, len](::io_uring_sqe* sqe) {
+          ::io_uring_prep_send(sqe, fd_, data, len, MSG_NOSIGNAL);
+        },
+        std::move(callback));
+  }
+
+  void MaybeDelete() {
+    if (closed_ && !sending_) {
+      delete this;
+    }
+  }
+
+  IOUringEngine* uring_;
+  int fd_;
+  bool zero_copy_;
+  IOUringReceiver receiver_;
+
+  std::deque<IOUringProvidedBuffer> pending_;
+  bool sending_{false};
+  bool closed_{false};
+};
+
+class UringServer {
+ public:
+  UringServer(IOUringEngine* uring, std::shared_ptr<IOUringBufferRing> ring,
+              int listen_fd, bool zero_copy)
+      : uring_(uring),
+        ring_(std::move(ring)),
+        acceptor_(uring, listen_fd),
+        zero_copy_(zero_copy) {}
+
+  void Start() {
+    auto e = acceptor_.Start([this](int fd) {
+      if (fd < 0) {
+        std::cout << "accept: " << strerror(-fd) << std::endl;
+        return;
+      }
+
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      (new UringSession(uring_, ring_, fd, zero_copy_))->Start();
+    });
+    if (e) {
+      std::cout << "accept: " << e.Details() << std::endl;
+    }
+  }
+
+  void Stop() { acceptor_.Stop(); }
+
+ private:
+  IOUringEngine* uring_;
+  std::shared_ptr<IOUringBufferRing> ring_;
+  IOUringAcceptor acceptor_;
+  bool zero_copy_;
+};
+
+int Listen(sockaddr_in* addr) {
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  std::memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ::socklen_t len = sizeof(*addr);
+  if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(addr), len) < 0 ||
+      ::listen(fd, 1024) < 0 ||
+      ::getsockname(fd, reinterpret_cast<sockaddr*>(addr), &len) < 0) {
+    std::cout << "listen: " << strerror(errno) << std::endl;
+    std::exit(1);
+  }
+  return fd;
+}
+
+// a blocking client, which sends a message and reads it back, |rounds|
+// times
+bool PingPong(const sockaddr_in& addr, std::size_t size, std::size_t rounds) {
+  auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) <
+      0) {
+    ::close(fd);
+    return false;
+  }
+
+  int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  std::string message(size, 'x');
+  std::string buffer(size, '\0');
+  auto ok = true;
+  for (std::size_t i = 0; i < rounds && ok; ++i) {
+    ok = ::send(fd, message.data(), size, MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(size);
+    for (std::size_t n = 0; ok && n < size;) {
+      auto res = ::read(fd, buffer.data() + n, size - n);
+      ok = res > 0;
+      n += ok ? res : 0;
+    }
+  }
+
+  ::close(fd);
+  return ok;
+}
+
+// usage: uring_echo_bench [clients] [message size] [rounds]
+//
+// the clients are the threads of the blocking sockets, they ping-pong with
+// the echo server on the loop, which is on asio (epoll), or on io_uring by
+// the multishot accept and recv, with or without the zero copy send. the
+// idle connections of io_uring hold no buffer, the ring is shared by all
+int main(int argc, char* argv[]) {
+  std::size_t clients = argc > 1 ? std::atoi(argv[1]) : 16;
+  std::size_t size = argc > 2 ? std::atoi(argv[2]) : 512;
+  std::size_t rounds = argc > 3 ? std::atoi(argv[3]) : 20000;
+
+  std::cout << clients << " clients, " << size << " bytes, " << rounds
+            << " rounds each" << std::endl;
+
+  const char* names[] = {"asio:     ", "uring:    ", "uring zc: "};
+  for (int mode = 0; mode < 3; ++mode) {
+    IOMessageLoop loop;
+    auto uring = loop.uring();
+    if (mode > 0 && !uring) {
+      std::cout << names[mode] << loop.uring_error().Details() << std::endl;
+      continue;
+    }
+
+    sockaddr_in addr;
+    auto listen_fd = Listen(&addr);
+
+    std::unique_ptr<AsioServer> asio_server;
+    std::unique_ptr<UringServer> uring_server;
+    if (mode == 0) {
+      asio_server = std::make_unique<AsioServer>(&loop, listen_fd, size);
+    } else {
+      auto r = IOUringBufferRing::Make(uring, 1, 1024, std::max(size, 4096ul));
+      if (!r) {
+        std::cout << names[mode] << r.GetError().Details() << std::endl;
+        ::close(listen_fd);
+        continue;
+      }
+      uring_server = std::make_unique<UringServer>(uring, r.PassResult(),
+                                                   listen_fd, mode == 2);
+    }
+
+    loop.Post([&]() {
+      if (asio_server) {
+        asio_server->Start();
+      } else {
+        uring_server->Start();
+      }
+    });
+
+    std::atomic<std::size_t> finished{0};
+    std::atomic<std::size_t> failed{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < clients; ++i) {
+      threads.emplace_back([&]() {
+        if (!PingPong(addr, size, rounds)) {
+          ++failed;
+        }
+
+        if (++finished == clients) {
+          loop.remote_executor()->Post([&]() {
+            if (asio_server) {
+              asio_server->Stop();
+            } else {
+              uring_server->Stop();
+            }
+            loop.Shutdown();
+          });
+        }
+      });
+    }
+
+    loop.Run();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto ms = std::max<long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count(),
+        1);
+
+    std::cout << names[mode] << clients * rounds * 1000 / ms
+              << " round trips/s, " << failed << " failed" << std::endl;
+    ::close(listen_fd);
+  }
+  return 0;
+}
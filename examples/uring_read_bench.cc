@@ -0,0 +1,180 @@
+#include <base/common.h>
+#include <event/io-message-loop.h>
+#include <fcntl.h>
+#include <liburing.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using libz::MilliSeconds;
+using libz::event::IOMessageLoop;
+using libz::event::IOUringEngine;
+
+constexpr std::size_t kBlockSize = 4096;
+
+// keep |depth| random 4k reads in flight until |total| are completed. every
+// completion queues the next read, so that with the batched submission, the
+// reads queued by the completions of a reap are submitted together
+struct RandomReader {
+  RandomReader(IOMessageLoop* loop, IOUringEngine* uring, int fd,
+               std::size_t blocks, std::size_t depth, std::size_t total,
+               IOUringEngine::SubmitMode mode)
+      : loop(loop),
+        uring(uring),
+        fd(fd),
+        blocks(blocks),
+        total(total),
+        mode(mode),
+        buffers(depth),
+        random(20240601) {
+    for (auto& buffer : buffers) {
+      void* ptr = nullptr;
+      ::posix_memalign(&ptr, kBlockSize, kBlockSize);
+      buffer = static_cast<char*>(ptr);
+    }
+  }
+
+  ~RandomReader() {
+    for (auto buffer : buffers) {
+      ::free(buffer);
+    }
+  }
+
+  void Start() {
+    for (auto buffer : buffers) {
+      Next(buffer);
+    }
+  }
+
+  void Next(char* buffer) {
+    if (issued == total) {
+      return;
+    }
+    ++issued;
+
+    off_t offset = random() % blocks * kBlockSize;
+    uring->Run(
+        [&, buffer, offset](::io_uring_sqe* sqe) {
+          ::io_uring_prep_read(sqe, fd, buffer, kBlockSize, offset);
+        },
+        [this, buffer](int res) {
+          if (res < 0) {
+            ++failed;
+          }
+
+          if (++completed == total) {
+            loop->Shutdown();
+            return;
+          }
+          Next(buffer);
+        },
+        mode);
+  }
+
+  IOMessageLoop* loop;
+  IOUringEngine* uring;
+  int fd;
+  std::size_t blocks;
+  std::size_t total;
+  IOUringEngine::SubmitMode mode;
+
+  std::vector<char*> buffers;
+  std::mt19937_64 random;
+
+  std::size_t issued{0};
+  std::size_t completed{0};
+  std::size_t failed{0};
+};
+
+struct BenchCase {
+  const char* name;
+  IOUringEngine::SubmitMode mode;
+  IOUringEngine::Options opts;
+};
+
+// usage: uring_read_bench [file] [mb] [depth] [reads] [sqpoll cpu]
+//
+// the file is created if it doesn't exist. it's read with O_DIRECT if the
+// file system supports it, or else the reads are served by the page cache.
+// the sqpoll poller is pinned to the cpu if it's given
+int main(int argc, char* argv[]) {
+  std::string path = argc > 1 ? argv[1] : "/tmp/libz-uring-read-bench";
+  std::size_t mb = argc > 2 ? std::atoi(argv[2]) : 256;
+  std::size_t depth = argc > 3 ? std::atoi(argv[3]) : 64;
+  std::size_t total = argc > 4 ? std::atoi(argv[4]) : 200000;
+  int sqpoll_cpu = argc > 5 ? std::atoi(argv[5]) : -1;
+  std::size_t len = mb << 20;
+
+  int writer = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (writer < 0) {
+    std::cout << "open " << path << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+
+  if (static_cast<std::size_t>(::lseek(writer, 0, SEEK_END)) < len) {
+    std::string chunk(1 << 20, 'x');
+    ::lseek(writer, 0, SEEK_SET);
+    for (std::size_t i = 0; i < len; i += chunk.size()) {
+      ::write(writer, chunk.data(), chunk.size());
+    }
+    ::fsync(writer);
+  }
+  ::close(writer);
+
+  auto direct = true;
+  int fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+  if (fd < 0) {
+    direct = false;
+    fd = ::open(path.c_str(), O_RDONLY);
+  }
+
+  std::cout << mb << "MB file, depth " << depth << ", " << total
+            << " reads of 4k" << (direct ? ", O_DIRECT" : ", buffered")
+            << std::endl;
+
+  IOUringEngine::Options sqpoll;
+  sqpoll.sqpoll = true;
+  sqpoll.sq_thread_cpu = sqpoll_cpu;
+
+  IOUringEngine::Options defer_taskrun;
+  defer_taskrun.defer_taskrun = true;
+
+  BenchCase cases[] = {
+      {"unbatched:     ", IOUringEngine::SubmitMode::kImmediate, {}},
+      {"batched:       ", IOUringEngine::SubmitMode::kBatched, {}},
+      {"sqpoll:        ", IOUringEngine::SubmitMode::kBatched, sqpoll},
+      {"defer taskrun: ", IOUringEngine::SubmitMode::kBatched, defer_taskrun},
+  };
+
+  for (const auto& c : cases) {
+    IOMessageLoop loop;
+    loop.set_uring_options(c.opts);
+    auto uring = loop.uring();
+    if (!uring) {
+      std::cout << c.name << loop.uring_error().Details() << std::endl;
+      continue;
+    }
+
+    RandomReader reader(&loop, uring, fd, len / kBlockSize, depth, total,
+                        c.mode);
+    auto start = loop.MonoNow();
+    loop.Post([&]() { reader.Start(); });
+    loop.Run();
+
+    auto ms = std::max<long>(
+        libz::DurationCast<MilliSeconds>(loop.MonoNow() - start).count(), 1);
+    const auto& stats = uring->stats();
+    auto calls = std::max<std::uint64_t>(stats.submit_calls, 1);
+    std::cout << c.name << reader.completed * 1000 / ms << " iops, "
+              << stats.submit_calls << " submit calls, "
+              << stats.submitted / calls << " sqes per call, "
+              << reader.failed << " failed" << std::endl;
+  }
+
+  ::close(fd);
+  return 0;
+}
@@ -0,0 +1,33 @@
+#include "basic.h"
+
+#include <base/error.h>
+#include <fmt/format.h>
+
+namespace libz {
+namespace net {
+namespace {
+
+struct NetCategory : public Error::Category {
+  const char* GetName() const override { return "net"; }
+  std::string GetInformation(int c) const override {
+    switch (c) {
+#define __(A, B) \
+  case A:        \
+    return fmt::format("net[{}]", B);
+      NET_ERROR_LIST(__)
+#undef __
+      default:
+        return "net[none]";
+    }
+  }
+};
+
+}  // namespace
+
+const Error::Category* Cat() {
+  static NetCategory kC;
+  return &kC;
+}
+
+}  // namespace net
+}  // namespace libz
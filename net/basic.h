@@ -0,0 +1,42 @@
+#pragma once
+
+#include <base/error.h>
+#include <fmt/format.h>
+
+#define NET_ERROR_LIST(__)                          \
+  __(kErrorNetTimeout, "operation timeout")         \
+  __(kErrorNetCancelled, "operation cancelled")     \
+  __(kErrorNetInvalidAddress, "invalid address")    \
+  __(kErrorNetNoAddress, "no address for host")     \
+  __(kErrorNetTruncated, "message truncated")       \
+  __(kErrorNetClosed, "connection closed")          \
+  __(kErrorRpcMalformed, "malformed rpc frame")     \
+  __(kErrorRpcRemote, "rpc remote error")           \
+  __(kErrorRespMalformed, "malformed resp message") \
+  __(kErrorRedisReply, "redis error reply")         \
+  __(kErrorDnsMalformed, "malformed dns message")   \
+  __(kErrorDnsServerFailure, "dns server failure")  \
+  __(kErrorDnsRefused, "dns query refused")         \
+  __(kErrorDnsNoServer, "no dns server configured")
+
+namespace libz {
+namespace net {
+
+enum NetError {
+#define __(A, B) A,
+  NET_ERROR_LIST(__)
+#undef __
+};
+
+const Error::Category* Cat();
+
+inline Error Err(NetError e) { return Error{Cat(), e}; }
+
+template <typename... Args>
+Error Err(NetError e, const Args&... args) {
+  auto msg = fmt::format(args...);
+  return Error{Cat(), e, std::move(msg)};
+}
+
+}  // namespace net
+}  // namespace libz
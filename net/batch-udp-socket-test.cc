@@ -0,0 +1,215 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "batch-udp-socket.h"
+
+#include <event/io-message-loop.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace libz {
+namespace net {
+
+using asio::ip::udp;
+
+const udp::endpoint kLoopback(asio::ip::make_address("127.0.0.1"), 0);
+
+CATCH_TEST_CASE("batch", "[udp]") {
+  event::IOMessageLoop loop;
+
+  BatchUdpSocket::Options opts;
+  opts.batch_size = 16;
+  opts.receive_buffer_size = 1 << 20;
+
+  BatchUdpSocket receiver(&loop, opts);
+  BatchUdpSocket sender(&loop, opts);
+  CATCH_REQUIRE(!receiver.Open(kLoopback));
+  CATCH_REQUIRE(!sender.Open(kLoopback));
+
+  constexpr int kNum = 200;
+  std::vector<std::string> received;
+  std::size_t max_batch = 0;
+
+  receiver.StartReceive([&](const std::vector<Datagram>& batch) {
+    max_batch = std::max(max_batch, batch.size());
+    for (const auto& d : batch) {
+      CATCH_REQUIRE(d.endpoint == sender.local_endpoint());
+      received.emplace_back(d.data);
+    }
+
+    if (received.size() == kNum) {
+      loop.Shutdown();
+    }
+  });
+
+  std::vector<std::string> payloads;
+  for (int i = 0; i < kNum; ++i) {
+    payloads.push_back(fmt::format("message-{}", i));
+  }
+
+  loop.Post([&]() {
+    std::vector<Datagram> batch;
+    for (const auto& payload : payloads) {
+      batch.push_back(Datagram{payload, receiver.local_endpoint()});
+    }
+
+    CATCH_REQUIRE(!sender.Send(batch));
+    CATCH_REQUIRE(sender.stats().tx_batches <= kNum / 16 + 1);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(received == payloads);
+  CATCH_REQUIRE(max_batch > 1);
+  CATCH_REQUIRE(max_batch <= 16);
+  CATCH_REQUIRE(receiver.stats().rx_datagrams == kNum);
+  CATCH_REQUIRE(receiver.stats().rx_batches < kNum);
+  CATCH_REQUIRE(sender.stats().tx_datagrams == kNum);
+}
+
+CATCH_TEST_CASE("segmentation offload", "[udp]") {
+  event::IOMessageLoop loop;
+
+  BatchUdpSocket::Options opts;
+  opts.gro = true;
+  opts.gso = true;
+  opts.max_datagram_size = 1500;
+
+  BatchUdpSocket receiver(&loop, opts);
+  BatchUdpSocket sender(&loop, opts);
+  CATCH_REQUIRE(!receiver.Open(kLoopback));
+  CATCH_REQUIRE(!sender.Open(kLoopback));
+
+  // 100 segments take two sends with gso, the last one is short
+  std::string payload;
+  for (int i = 0; i < 100; ++i) {
+    payload += std::string(i == 99 ? 500 : 1000, 'a' + i % 26);
+  }
+
+  std::string received;
+  std::size_t datagrams = 0;
+  receiver.StartReceive([&](const std::vector<Datagram>& batch) {
+    for (const auto& d : batch) {
+      CATCH_REQUIRE(d.data.size() == (datagrams == 99 ? 500 : 1000));
+      received.append(d.data);
+      ++datagrams;
+    }
+
+    if (datagrams == 100) {
+      loop.Shutdown();
+    }
+  });
+
+  loop.Post([&]() {
+    auto to = receiver.local_endpoint();
+    CATCH_REQUIRE(!sender.SendSegments(payload, 1000, to));
+    CATCH_REQUIRE(sender.stats().tx_datagrams == 100);
+    if (sender.gso_enabled()) {
+      CATCH_REQUIRE(sender.stats().tx_batches == 1);
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(datagrams == 100);
+  CATCH_REQUIRE(received == payload);
+}
+
+// the segments of a gso send are within the udp payload limit together
+CATCH_TEST_CASE("large segments", "[udp]") {
+  event::IOMessageLoop loop;
+
+  BatchUdpSocket::Options opts;
+  opts.gro = true;
+  opts.gso = true;
+  opts.max_datagram_size = 32767;
+  opts.receive_buffer_size = 1 << 20;
+
+  BatchUdpSocket receiver(&loop, opts);
+  BatchUdpSocket sender(&loop, opts);
+  CATCH_REQUIRE(!receiver.Open(kLoopback));
+  CATCH_REQUIRE(!sender.Open(kLoopback));
+
+  std::string payload(3 * 32767, 'x');
+  std::size_t received = 0;
+  std::size_t datagrams = 0;
+  receiver.StartReceive([&](const std::vector<Datagram>& batch) {
+    for (const auto& d : batch) {
+      CATCH_REQUIRE(d.data.size() == 32767);
+      received += d.data.size();
+      ++datagrams;
+    }
+
+    if (datagrams == 3) {
+      loop.Shutdown();
+    }
+  });
+
+  loop.Post([&]() {
+    auto to = receiver.local_endpoint();
+    CATCH_REQUIRE(sender.SendSegments(payload, 65508, to).code() == EINVAL);
+    CATCH_REQUIRE(!sender.SendSegments(payload, 32767, to));
+    CATCH_REQUIRE(sender.stats().tx_datagrams == 3);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(datagrams == 3);
+  CATCH_REQUIRE(received == payload.size());
+}
+
+CATCH_TEST_CASE("truncated", "[udp]") {
+  event::IOMessageLoop loop;
+
+  BatchUdpSocket::Options opts;
+  opts.max_datagram_size = 100;
+
+  BatchUdpSocket receiver(&loop, opts);
+  BatchUdpSocket sender(&loop);
+  CATCH_REQUIRE(!receiver.Open(kLoopback));
+  CATCH_REQUIRE(!sender.Open(kLoopback));
+
+  std::vector<std::string> received;
+  receiver.StartReceive([&](const std::vector<Datagram>& batch) {
+    for (const auto& d : batch) {
+      received.emplace_back(d.data);
+    }
+
+    if (receiver.stats().rx_truncated == 1 && received.size() == 2) {
+      loop.Shutdown();
+    }
+  });
+
+  std::string big(200, 'x');
+  loop.Post([&]() {
+    auto to = receiver.local_endpoint();
+    CATCH_REQUIRE(!sender.Send("first", to));
+    CATCH_REQUIRE(!sender.Send(big, to));
+    CATCH_REQUIRE(!sender.Send("", to));
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(received == std::vector<std::string>{"first", ""});
+  CATCH_REQUIRE(receiver.stats().rx_truncated == 1);
+
+  auto to = receiver.local_endpoint();
+  sender.Close();
+  CATCH_REQUIRE(sender.Send("closed", to));
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,556 @@
+#include "batch-udp-socket.h"
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string>
+
+namespace libz {
+namespace net {
+
+using asio::ip::udp;
+
+namespace {
+
+// the buffer size of a gro slot, the coalesced datagrams never exceed it
+constexpr std::size_t kGroSlotSize = 65535;
+
+// the largest udp payloads, the 16 bits length of ipv4 covers the 20 bytes
+// ip header and the 8 bytes udp header, while the one of ipv6 covers only
+// the udp header
+constexpr std::size_t kMaxUdpPayload4 = 65535 - 20 - 8;
+constexpr std::size_t kMaxUdpPayload6 = 65535 - 8;
+
+std::size_t MaxUdpPayload(const udp::endpoint& to) {
+  auto addr = to.address();
+  if (addr.is_v4() || addr.to_v6().is_v4_mapped()) {
+    return kMaxUdpPayload4;
+  }
+  return kMaxUdpPayload6;
+}
+
+// linux refuses more segments within one gso send
+constexpr std::size_t kMaxGsoSegments = 64;
+
+constexpr std::size_t kRxControlSize = CMSG_SPACE(sizeof(int));
+constexpr std::size_t kTxControlSize = CMSG_SPACE(sizeof(std::uint16_t));
+
+struct TxEntry {
+  const char* data;
+  std::size_t size;
+  const udp::endpoint* to;
+
+  // the gso segment size, zero if the entry is a plain datagram
+  std::uint16_t segment;
+};
+
+struct Pending {
+  std::string data;
+  udp::endpoint to;
+  std::uint16_t segment;
+};
+
+bool IsGsoError(int err) { return err == EIO || err == EINVAL; }
+
+}  // namespace
+
+struct BatchUdpSocket::State : public std::enable_shared_from_this<State> {
+  State(event::MessageLoop* loop, const Options& opts)
+      : loop(loop),
+        opts(opts),
+        socket(*loop->proactor()),
+        slot_size(opts.max_datagram_size),
+        pending_bytes(0),
+        stats() {}
+
+  void Allocate();
+
+  void ArmRead();
+  void ArmWrite();
+  void OnReadable();
+  void OnWritable();
+
+  // return the number of the sent entries, or -errno
+  int SendBatch(const TxEntry* entries, std::size_t count);
+  Error SendEntries(std::vector<TxEntry>&& entries);
+  void Queue(const TxEntry* entries, std::size_t count);
+  std::vector<TxEntry> Split(const TxEntry& entry) const;
+
+  event::MessageLoop* loop;
+  Options opts;
+  udp::socket socket;
+
+  bool gro{false};
+  bool gso{false};
+
+  bool receiving{false};
+  bool reading{false};
+  bool writing{false};
+  ReceiveHandler handler;
+
+  // the receive arena, one slot per datagram of a batch
+  std::size_t slot_size;
+  std::unique_ptr<char[]> rx_arena;
+  std::unique_ptr<char[]> rx_control;
+  std::vector<mmsghdr> rx_msgs;
+  std::vector<iovec> rx_iovs;
+  std::vector<udp::endpoint> rx_names;
+  std::vector<Datagram> rx_datagrams;
+
+  std::unique_ptr<char[]> tx_control;
+  std::vector<mmsghdr> tx_msgs;
+  std::vector<iovec> tx_iovs;
+
+  std::deque<Pending> pending;
+  std::size_t pending_bytes;
+
+  Stats stats;
+};
+
+void BatchUdpSocket::State::Allocate() {
+  auto batch = std::max<std::size_t>(opts.batch_size, 1);
+  slot_size = gro ? kGroSlotSize : opts.max_datagram_size;
+
+  // Notes, the arena is never zeroed, the kernel writes before we read
+  rx_arena.reset(new char[batch * slot_size]);
+  rx_control.reset(new char[batch * kRxControlSize]);
+  rx_msgs.assign(batch, mmsghdr{});
+  rx_iovs.assign(batch, iovec{});
+  rx_names.assign(batch, udp::endpoint{});
+  rx_datagrams.reserve(batch);
+
+  for (std::size_t i = 0; i < batch; ++i) {
+    rx_iovs[i].iov_base = rx_arena.get() + i * slot_size;
+    rx_iovs[i].iov_len = slot_size;
+
+    auto& hdr = rx_msgs[i].msg_hdr;
+    hdr.msg_iov = &rx_iovs[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_name = rx_names[i].data();
+    hdr.msg_control = gro ? rx_control.get() + i * kRxControlSize : nullptr;
+  }
+
+  tx_control.reset(new char[batch * kTxControlSize]);
+  tx_msgs.assign(batch, mmsghdr{});
+  tx_iovs.assign(batch, iovec{});
+}
+
+void BatchUdpSocket::State::ArmRead() {
+  if (reading || !receiving || !socket.is_open()) {
+    return;
+  }
+
+  reading = true;
+  socket.async_wait(
+      udp::socket::wait_read,
+      [weak_state = weak_from_this()](const asio::error_code& ec) {
+        auto state = weak_state.lock();
+        if (!state) {
+          return;
+        }
+
+        state->reading = false;
+        if (!ec) {
+          state->OnReadable();
+        }
+      });
+}
+
+void BatchUdpSocket::State::ArmWrite() {
+  if (writing || !socket.is_open()) {
+    return;
+  }
+
+  writing = true;
+  socket.async_wait(
+      udp::socket::wait_write,
+      [weak_state = weak_from_this()](const asio::error_code& ec) {
+        auto state = weak_state.lock();
+        if (!state) {
+          return;
+        }
+
+        state->writing = false;
+        if (!ec) {
+          state->OnWritable();
+        }
+      });
+}
+
+void BatchUdpSocket::State::OnReadable() {
+  // keep alive, the handler may destroy the socket
+  auto self = shared_from_this();
+  auto fd = socket.native_handle();
+
+  for (std::size_t round = 0; round < opts.max_batches_per_event; ++round) {
+    if (!receiving || !socket.is_open()) {
+      return;
+    }
+
+    for (std::size_t i = 0; i < rx_msgs.size(); ++i) {
+      auto& hdr = rx_msgs[i].msg_hdr;
+      hdr.msg_namelen = rx_names[i].capacity();
+      hdr.msg_controllen = gro ? kRxControlSize : 0;
+      hdr.msg_flags = 0;
+    }
+
+    auto n = ::recvmmsg(fd, rx_msgs.data(), rx_msgs.size(), MSG_DONTWAIT,
+                        nullptr);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      // EAGAIN, or the pending error like ECONNREFUSED is consumed
+      break;
+    }
+
+    ++stats.rx_batches;
+    rx_datagrams.clear();
+
+    for (int i = 0; i < n; ++i) {
+      auto& hdr = rx_msgs[i].msg_hdr;
+      if (hdr.msg_flags & MSG_TRUNC) {
+        ++stats.rx_truncated;
+        continue;
+      }
+
+      rx_names[i].resize(hdr.msg_namelen);
+
+      std::size_t segment = 0;
+      if (gro) {
+        for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+             cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+          if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size;
+            std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            segment = static_cast<std::size_t>(size);
+          }
+        }
+      }
+
+      // split the coalesced datagrams
+      std::string_view data(static_cast<char*>(rx_iovs[i].iov_base),
+                            rx_msgs[i].msg_len);
+      if (segment == 0) {
+        segment = std::max<std::size_t>(data.size(), 1);
+      }
+
+      do {
+        auto len = std::min(segment, data.size());
+        rx_datagrams.push_back(Datagram{data.substr(0, len), rx_names[i]});
+        data.remove_prefix(len);
+      } while (!data.empty());
+    }
+
+    stats.rx_datagrams += rx_datagrams.size();
+    if (!rx_datagrams.empty()) {
+      handler(rx_datagrams);
+    }
+
+    // drained
+    if (static_cast<std::size_t>(n) < rx_msgs.size()) {
+      break;
+    }
+  }
+
+  ArmRead();
+}
+
+void BatchUdpSocket::State::OnWritable() {
+  std::vector<TxEntry> entries;
+  while (!pending.empty() && socket.is_open()) {
+    entries.clear();
+    for (std::size_t i = 0; i < pending.size() && i < tx_msgs.size(); ++i) {
+      const auto& p = pending[i];
+      entries.push_back(
+          TxEntry{p.data.data(), p.data.size(), &p.to, p.segment});
+    }
+
+    auto n = SendBatch(entries.data(), entries.size());
+    if (n == -EINTR) {
+      continue;
+    } else if (n == -EAGAIN || n == -EWOULDBLOCK) {
+      ArmWrite();
+      return;
+    } else if (n < 0 && gso && entries[0].segment && IsGsoError(-n)) {
+      gso = false;
+
+      auto front = std::move(pending.front());
+      pending.pop_front();
+      pending_bytes -= front.data.size();
+
+      auto segments = Split(TxEntry{front.data.data(), front.data.size(),
+                                    &front.to, front.segment});
+      std::reverse(segments.begin(), segments.end());
+      for (const auto& s : segments) {
+        pending.push_front(Pending{std::string(s.data, s.size), front.to, 0});
+        pending_bytes += s.size;
+      }
+      continue;
+    }
+
+    // the failed datagram is dropped
+    auto done = n < 0 ? 1 : static_cast<std::size_t>(n);
+    for (std::size_t i = 0; i < done; ++i) {
+      pending_bytes -= pending.front().data.size();
+      pending.pop_front();
+    }
+
+    if (n < 0) {
+      ++stats.tx_dropped;
+    }
+  }
+}
+
+int BatchUdpSocket::State::SendBatch(const TxEntry* entries,
+                                     std::size_t count) {
+  count = std::min(count, tx_msgs.size());
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto& entry = entries[i];
+    tx_iovs[i].iov_base = const_cast<char*>(entry.data);
+    tx_iovs[i].iov_len = entry.size;
+
+    auto& hdr = tx_msgs[i].msg_hdr;
+    hdr = msghdr{};
+    hdr.msg_iov = &tx_iovs[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_name = const_cast<udp::endpoint*>(entry.to)->data();
+    hdr.msg_namelen = entry.to->size();
+
+    if (entry.segment && entry.size > entry.segment) {
+      hdr.msg_control = tx_control.get() + i * kTxControlSize;
+      hdr.msg_controllen = kTxControlSize;
+
+      auto cmsg = CMSG_FIRSTHDR(&hdr);
+      cmsg->cmsg_level = IPPROTO_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+      std::memcpy(CMSG_DATA(cmsg), &entry.segment, sizeof(std::uint16_t));
+    }
+  }
+
+  auto n = ::sendmmsg(socket.native_handle(), tx_msgs.data(), count,
+                      MSG_DONTWAIT);
+  if (n < 0) {
+    return -errno;
+  }
+
+  ++stats.tx_batches;
+  for (int i = 0; i < n; ++i) {
+    const auto& entry = entries[i];
+    stats.tx_datagrams +=
+        entry.segment ? (entry.size + entry.segment - 1) / entry.segment : 1;
+  }
+
+  return n;
+}
+
+Error BatchUdpSocket::State::SendEntries(std::vector<TxEntry>&& entries) {
+  if (!socket.is_open()) {
+    return Error::MkSysError(EBADF);
+  }
+
+  // keep the order behind the queued ones
+  if (!pending.empty()) {
+    Queue(entries.data(), entries.size());
+    return {};
+  }
+
+  Error last_error;
+  std::size_t off = 0;
+  while (off < entries.size()) {
+    auto n = SendBatch(&entries[off], entries.size() - off);
+    if (n >= 0) {
+      off += n;
+      continue;
+    }
+
+    auto err = -n;
+    if (err == EINTR) {
+      continue;
+    } else if (err == EAGAIN || err == EWOULDBLOCK) {
+      Queue(&entries[off], entries.size() - off);
+      ArmWrite();
+      break;
+    } else if (gso && entries[off].segment && IsGsoError(err)) {
+      // the kernel or device can't segment, send them one by one from now on
+      gso = false;
+
+      auto segments = Split(entries[off]);
+      entries.erase(entries.begin() + off);
+      entries.insert(entries.begin() + off, segments.begin(), segments.end());
+      continue;
+    }
+
+    // eg. EMSGSIZE, or ECONNREFUSED reported by the previous send
+    last_error = Error::MkSysError(err);
+    ++stats.tx_dropped;
+    ++off;
+  }
+
+  return last_error;
+}
+
+void BatchUdpSocket::State::Queue(const TxEntry* entries, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto& entry = entries[i];
+    if (pending_bytes + entry.size > opts.max_pending_bytes) {
+      stats.tx_dropped +=
+          entry.segment ? (entry.size + entry.segment - 1) / entry.segment : 1;
+      continue;
+    }
+
+    pending.push_back(
+        Pending{std::string(entry.data, entry.size), *entry.to, entry.segment});
+    pending_bytes += entry.size;
+  }
+}
+
+std::vector<TxEntry> BatchUdpSocket::State::Split(const TxEntry& entry) const {
+  std::vector<TxEntry> segments;
+  for (std::size_t off = 0; off < entry.size; off += entry.segment) {
+    auto len = std::min<std::size_t>(entry.segment, entry.size - off);
+    segments.push_back(TxEntry{entry.data + off, len, entry.to, 0});
+  }
+  return segments;
+}
+
+BatchUdpSocket::BatchUdpSocket(event::MessageLoop* loop, const Options& opts)
+    : state_(std::make_shared<State>(loop, opts)) {}
+
+BatchUdpSocket::~BatchUdpSocket() { Close(); }
+
+Error BatchUdpSocket::Open(const udp::endpoint& local) {
+  auto& socket = state_->socket;
+  const auto& opts = state_->opts;
+
+  asio::error_code ec;
+  socket.open(local.protocol(), ec);
+  if (!ec) {
+    socket.non_blocking(true, ec);
+  }
+  if (!ec && opts.receive_buffer_size > 0) {
+    socket.set_option(
+        asio::socket_base::receive_buffer_size(opts.receive_buffer_size), ec);
+  }
+  if (!ec && opts.send_buffer_size > 0) {
+    socket.set_option(
+        asio::socket_base::send_buffer_size(opts.send_buffer_size), ec);
+  }
+  if (!ec) {
+    socket.bind(local, ec);
+  }
+
+  if (ec) {
+    Close();
+    return Error::MkBoostError(ec.value(), ec.message());
+  }
+
+  auto fd = socket.native_handle();
+  if (opts.gro) {
+    int on = 1;
+    state_->gro =
+        ::setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+  }
+
+  // probe gso with the per-socket segment size of zero, that means disabled
+  if (opts.gso) {
+    int off = 0;
+    state_->gso =
+        ::setsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &off, sizeof(off)) == 0;
+  }
+
+  state_->Allocate();
+  return {};
+}
+
+void BatchUdpSocket::Close() {
+  state_->receiving = false;
+  state_->handler = nullptr;
+
+  state_->pending.clear();
+  state_->pending_bytes = 0;
+
+  asio::error_code ec;
+  state_->socket.close(ec);
+}
+
+void BatchUdpSocket::StartReceive(ReceiveHandler&& handler) {
+  state_->handler = std::move(handler);
+  state_->receiving = true;
+  state_->ArmRead();
+}
+
+void BatchUdpSocket::StopReceive() { state_->receiving = false; }
+
+Error BatchUdpSocket::Send(const std::vector<Datagram>& datagrams) {
+  std::vector<TxEntry> entries;
+  entries.reserve(datagrams.size());
+  for (const auto& d : datagrams) {
+    entries.push_back(TxEntry{d.data.data(), d.data.size(), &d.endpoint, 0});
+  }
+
+  return state_->SendEntries(std::move(entries));
+}
+
+Error BatchUdpSocket::Send(std::string_view data, const udp::endpoint& to) {
+  return state_->SendEntries({TxEntry{data.data(), data.size(), &to, 0}});
+}
+
+Error BatchUdpSocket::SendSegments(std::string_view data,
+                                   std::size_t segment_size,
+                                   const udp::endpoint& to) {
+  auto max_payload = MaxUdpPayload(to);
+  if (segment_size == 0 || segment_size > max_payload) {
+    return Error::MkSysError(EINVAL);
+  }
+
+  auto segment = static_cast<std::uint16_t>(segment_size);
+  TxEntry whole{data.data(), data.size(), &to, segment};
+  if (!state_->gso) {
+    return state_->SendEntries(state_->Split(whole));
+  }
+
+  // every entry carries as many segments as the kernel allows, the whole
+  // of them is sent as one udp payload, and it's refused with EMSGSIZE over
+  // the limit
+  auto per_send = std::min(kMaxGsoSegments, max_payload / segment_size);
+  auto chunk = per_send * segment_size;
+
+  std::vector<TxEntry> entries;
+  for (std::size_t off = 0; off < data.size(); off += chunk) {
+    auto len = std::min(chunk, data.size() - off);
+    entries.push_back(TxEntry{data.data() + off, len, &to, segment});
+  }
+
+  return state_->SendEntries(std::move(entries));
+}
+
+bool BatchUdpSocket::gro_enabled() const { return state_->gro; }
+
+bool BatchUdpSocket::gso_enabled() const { return state_->gso; }
+
+std::size_t BatchUdpSocket::pending_bytes() const {
+  return state_->pending_bytes;
+}
+
+const BatchUdpSocket::Stats& BatchUdpSocket::stats() const {
+  return state_->stats;
+}
+
+udp::socket& BatchUdpSocket::socket() { return state_->socket; }
+
+udp::endpoint BatchUdpSocket::local_endpoint() const {
+  asio::error_code ec;
+  return state_->socket.local_endpoint(ec);
+}
+
+}  // namespace net
+}  // namespace libz
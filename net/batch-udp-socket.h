@@ -0,0 +1,119 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+
+#include <asio/ip/udp.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+struct Datagram {
+  // the received payload is a view into the buffer arena of the socket, and
+  // it's only valid within the receive handler
+  std::string_view data;
+
+  // the source of a received datagram, or the destination of a sent one
+  asio::ip::udp::endpoint endpoint;
+};
+
+// BatchUdpSocket moves many datagrams per syscall with recvmmsg/sendmmsg. the
+// readiness is watched by the proactor of the loop, then the socket is drained
+// in batches without blocking.
+//
+// with udp gro, the kernel coalesces the datagrams of a flow into one buffer,
+// and they are split into slices again before delivered. with udp gso, a large
+// payload is sent as equal-sized segments in one call. both are optional, and
+// they fall back silently if the kernel doesn't support them.
+//
+// Notes, the socket is bound to a message loop, and all methods must be
+// invoked within the loop thread
+class BatchUdpSocket {
+ public:
+  struct Options {
+    // the number of datagrams per recvmmsg/sendmmsg
+    std::size_t batch_size{64};
+
+    // the larger datagrams are truncated and dropped
+    std::size_t max_datagram_size{2048};
+
+    // the receive batches per readiness event, so that a busy socket won't
+    // starve the others on the loop
+    std::size_t max_batches_per_event{16};
+
+    // the bytes queued when the socket buffer is full, the exceeded datagrams
+    // are dropped
+    std::size_t max_pending_bytes{4 << 20};
+
+    bool gro{false};
+    bool gso{false};
+
+    // SO_RCVBUF/SO_SNDBUF, zero means the system default
+    int receive_buffer_size{0};
+    int send_buffer_size{0};
+  };
+
+  struct Stats {
+    std::uint64_t rx_datagrams{0};
+    std::uint64_t rx_batches{0};
+    std::uint64_t rx_truncated{0};
+    std::uint64_t tx_datagrams{0};
+    std::uint64_t tx_batches{0};
+    std::uint64_t tx_dropped{0};
+  };
+
+  // the datagrams of one batch, the vector is reused by the next batch
+  using ReceiveHandler = std::function<void(const std::vector<Datagram>&)>;
+
+  explicit BatchUdpSocket(event::MessageLoop* loop)
+      : BatchUdpSocket(loop, Options{}) {}
+  BatchUdpSocket(event::MessageLoop* loop, const Options& opts);
+
+  ~BatchUdpSocket();
+
+ public:
+  Error Open(const asio::ip::udp::endpoint& local);
+  void Close();
+
+  // the handler is invoked once per received batch until StopReceive
+  void StartReceive(ReceiveHandler&& handler);
+  void StopReceive();
+
+  // the payloads are sent in place, and only copied if the socket buffer is
+  // full. the error is returned for the hard failure, eg. the socket is closed
+  Error Send(const std::vector<Datagram>& datagrams);
+  Error Send(std::string_view data, const asio::ip::udp::endpoint& to);
+
+  // send the payload as datagrams of |segment_size| bytes, the last one may be
+  // shorter. it takes one syscall per 64 segments with gso. EINVAL if
+  // |segment_size| is over the udp payload limit, 65507 bytes on ipv4 and
+  // 65527 on ipv6
+  Error SendSegments(std::string_view data, std::size_t segment_size,
+                     const asio::ip::udp::endpoint& to);
+
+  bool gro_enabled() const;
+  bool gso_enabled() const;
+
+  std::size_t pending_bytes() const;
+  const Stats& stats() const;
+
+  asio::ip::udp::socket& socket();
+  asio::ip::udp::endpoint local_endpoint() const;
+
+ private:
+  struct State;
+  std::shared_ptr<State> state_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchUdpSocket);
+};
+
+}  // namespace net
+}  // namespace libz
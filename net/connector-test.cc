@@ -0,0 +1,190 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "connector.h"
+
+#include <event/io-message-loop.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+
+std::vector<std::string> ToStrings(const std::vector<tcp::endpoint>& eps) {
+  std::vector<std::string> addresses;
+  for (const auto& ep : eps) {
+    addresses.push_back(ep.address().to_string());
+  }
+  return addresses;
+}
+
+CATCH_TEST_CASE("plan", "[connector]") {
+  event::IOMessageLoop loop;
+  Connector connector(&loop);
+
+  auto plan =
+      connector.Plan({"::1", "::2", "::3", "1.1.1.1", "bad", "1.1.1.2"}, 80);
+  CATCH_REQUIRE(ToStrings(plan) == std::vector<std::string>{
+                                       "::1", "1.1.1.1", "::2", "1.1.1.2",
+                                       "::3"});
+  CATCH_REQUIRE(plan[0].port() == 80);
+
+  plan = connector.Plan({"1.1.1.1", "1.1.1.2", "::1"}, 80);
+  CATCH_REQUIRE(ToStrings(plan) ==
+                std::vector<std::string>{"1.1.1.1", "::1", "1.1.1.2"});
+
+  CATCH_REQUIRE(connector.Plan({}, 80).empty());
+  CATCH_REQUIRE(connector.AttemptDelay(asio::ip::make_address("::1")) ==
+                MilliSeconds(250));
+}
+
+CATCH_TEST_CASE("stats", "[connector]") {
+  ConnectStats stats(2);
+  auto now = MonotonicClock::now();
+  auto a = asio::ip::make_address("10.0.0.1");
+  auto b = asio::ip::make_address("10.0.0.2");
+  auto c = asio::ip::make_address("10.0.0.3");
+
+  stats.OnSuccess(a, MicroSeconds(800), now);
+  CATCH_REQUIRE(*stats.Find(a)->srtt == MicroSeconds(800));
+
+  stats.OnSuccess(a, MicroSeconds(1600), now);
+  CATCH_REQUIRE(*stats.Find(a)->srtt == MicroSeconds(900));
+  CATCH_REQUIRE(stats.Find(a)->successes == 2);
+
+  stats.OnFailure(b, now + Seconds(1));
+  CATCH_REQUIRE(stats.Find(b)->last_failure);
+  CATCH_REQUIRE(!stats.Find(b)->srtt);
+
+  // the least recently updated one is evicted
+  stats.OnFailure(c, now + Seconds(2));
+  CATCH_REQUIRE(stats.size() == 2);
+  CATCH_REQUIRE(!stats.Find(a));
+  CATCH_REQUIRE(stats.Find(c)->failures == 1);
+}
+
+CATCH_TEST_CASE("connect", "[connector]") {
+  event::IOMessageLoop loop;
+  tcp::acceptor acceptor(*loop.proactor(),
+                         tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+  auto port = acceptor.local_endpoint().port();
+
+  std::vector<tcp::socket> accepted;
+  std::function<void()> accept = [&]() {
+    acceptor.async_accept([&](const asio::error_code& ec, tcp::socket socket) {
+      if (!ec) {
+        accepted.push_back(std::move(socket));
+        accept();
+      }
+    });
+  };
+  accept();
+
+  Connector::Options opts;
+  opts.attempt_delay = MilliSeconds(1000);
+  Connector connector(&loop, opts);
+
+  std::vector<event::Promise<tcp::socket>> promises;
+  auto start = loop.MonoNow();
+
+  loop.Post([&]() {
+    // nobody listens on 127.0.0.2, the refused attempt is followed at once
+    promises.push_back(connector.Connect({"127.0.0.2", "127.0.0.1"}, port));
+    promises.back().Then(
+        [&](Result<tcp::socket>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult().remote_endpoint().address().to_string() ==
+                        "127.0.0.1");
+          CATCH_REQUIRE(loop.MonoNow() - start < MilliSeconds(500));
+
+          const auto& stats = connector.stats();
+          CATCH_REQUIRE(
+              stats.Find(asio::ip::make_address("127.0.0.2"))->failures == 1);
+          CATCH_REQUIRE(
+              stats.Find(asio::ip::make_address("127.0.0.1"))->srtt);
+
+          // the fast one is preferred from now on, and the next attempt
+          // follows it quickly
+          auto plan = connector.Plan({"127.0.0.2", "::1", "127.0.0.1"}, port);
+          CATCH_REQUIRE(ToStrings(plan) == std::vector<std::string>{
+                                               "127.0.0.1", "::1",
+                                               "127.0.0.2"});
+          CATCH_REQUIRE(connector.AttemptDelay(plan[0].address()) <
+                        MilliSeconds(1000));
+
+          // every attempt is refused
+          promises.push_back(
+              connector.Connect({"127.0.0.2", "127.0.0.3"}, port));
+          promises.back().Then(
+              [&](Result<tcp::socket>&& r) {
+                CATCH_REQUIRE(!r);
+                CATCH_REQUIRE(r.GetError().code() != kErrorNetTimeout);
+                CATCH_REQUIRE(connector.inflight() == 0);
+
+                loop.Shutdown();
+              },
+              loop.executor());
+        },
+        loop.executor());
+
+    promises.push_back(connector.Connect({"bad"}, port));
+    CATCH_REQUIRE(promises.back().IsPreRejected());
+  });
+
+  loop.Run();
+
+  CATCH_REQUIRE(accepted.size() == 1);
+}
+
+CATCH_TEST_CASE("staggered", "[connector]") {
+  event::IOMessageLoop loop;
+  tcp::acceptor acceptor(*loop.proactor(),
+                         tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+  auto port = acceptor.local_endpoint().port();
+  acceptor.async_accept([](const asio::error_code&, tcp::socket) {});
+
+  Connector::Options opts;
+  opts.attempt_delay = MilliSeconds(100);
+  Connector connector(&loop, opts);
+
+  std::vector<event::Promise<tcp::socket>> promises;
+  auto start = loop.MonoNow();
+
+  loop.Post([&]() {
+    // the blackholed address is raced after the attempt delay, or skipped at
+    // once if it's unreachable
+    promises.push_back(
+        connector.Connect({"10.255.255.1", "127.0.0.1"}, port, Seconds(5)));
+    promises.back().Then(
+        [&](Result<tcp::socket>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(loop.MonoNow() - start < Seconds(1));
+
+          // the deadline covers the whole connect
+          start = loop.MonoNow();
+          promises.push_back(connector.Connect({"10.255.255.1"}, port,
+                                               MilliSeconds(200)));
+          promises.back().Then(
+              [&](Result<tcp::socket>&& r) {
+                CATCH_REQUIRE(!r);
+                CATCH_REQUIRE(loop.MonoNow() - start < Seconds(1));
+
+                // the pending connects are cancelled with the connector
+                promises.push_back(connector.Connect({"10.255.255.1"}, port));
+                loop.Shutdown();
+              },
+              loop.executor());
+        },
+        loop.executor());
+  });
+
+  loop.Run();
+
+  CATCH_REQUIRE(connector.inflight() <= 1);
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
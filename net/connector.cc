@@ -0,0 +1,374 @@
+#include "connector.h"
+
+#include <algorithm>
+#include <asio/post.hpp>
+#include <deque>
+#include <unordered_set>
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+
+namespace {
+
+// the weight of the new sample in the smoothed latency, same as tcp srtt
+constexpr int kSrttShift = 3;
+
+}  // namespace
+
+ConnectStats::Entry& ConnectStats::Emplace(const asio::ip::address& addr,
+                                           Tm now) {
+  auto key = addr.to_string();
+  if (auto itr = entries_.find(key); itr != entries_.end()) {
+    itr->second.updated_at = now;
+    return itr->second;
+  }
+
+  // evict the least recently updated one
+  if (max_entries_ > 0 && entries_.size() >= max_entries_) {
+    auto victim = std::min_element(
+        entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+          return a.second.updated_at < b.second.updated_at;
+        });
+    entries_.erase(victim);
+  }
+
+  auto& entry = entries_[key];
+  entry.updated_at = now;
+  return entry;
+}
+
+void ConnectStats::OnSuccess(const asio::ip::address& addr,
+                             MicroSeconds latency, Tm now) {
+  auto& entry = Emplace(addr, now);
+  if (entry.srtt) {
+    *entry.srtt += (latency - *entry.srtt) / (1 << kSrttShift);
+  } else {
+    entry.srtt = latency;
+  }
+
+  entry.last_failure.reset();
+  ++entry.successes;
+}
+
+void ConnectStats::OnFailure(const asio::ip::address& addr, Tm now) {
+  auto& entry = Emplace(addr, now);
+  entry.last_failure = now;
+  ++entry.failures;
+}
+
+const ConnectStats::Entry* ConnectStats::Find(
+    const asio::ip::address& addr) const {
+  auto itr = entries_.find(addr.to_string());
+  return itr == entries_.end() ? nullptr : &itr->second;
+}
+
+struct Connector::Race {
+  struct Attempt {
+    tcp::endpoint endpoint;
+    tcp::socket socket;
+    Tm start;
+  };
+
+  using AttemptPtr = std::shared_ptr<Attempt>;
+
+  std::vector<tcp::endpoint> endpoints;
+  std::size_t next{0};
+
+  std::vector<AttemptPtr> attempts;
+  std::size_t failed{0};
+
+  std::shared_ptr<event::_::Cancelable> stagger_timer;
+  std::shared_ptr<event::_::Cancelable> deadline_timer;
+
+  Error last_error;
+  ConnectCallback callback;
+};
+
+struct Connector::State : public std::enable_shared_from_this<State> {
+  using RacePtr = std::shared_ptr<Race>;
+  using AttemptPtr = Race::AttemptPtr;
+
+  State(event::MessageLoop* loop, const Options& opts)
+      : loop(loop), opts(opts), stats(opts.max_stats_entries), races() {}
+
+  void Start(const RacePtr& race, std::optional<MilliSeconds> timeout);
+  void StartAttempt(const RacePtr& race);
+  void OnConnect(const RacePtr& race, const AttemptPtr& attempt,
+                 const asio::error_code& ec);
+  void Complete(const RacePtr& race, Result<tcp::socket>&& r);
+
+  // the callback of |timer| is deferred out of it, since the timer may be
+  // released by the callback
+  std::shared_ptr<event::_::Cancelable> ArmTimer(
+      const RacePtr& race, MilliSeconds delay,
+      std::function<void(State*, const RacePtr&)>&& callback);
+
+  MilliSeconds AttemptDelay(const asio::ip::address& addr) const;
+
+  event::MessageLoop* loop;
+  Options opts;
+  ConnectStats stats;
+  std::unordered_set<RacePtr> races;
+};
+
+void Connector::State::Start(const RacePtr& race,
+                             std::optional<MilliSeconds> timeout) {
+  races.insert(race);
+
+  if (timeout) {
+    race->deadline_timer =
+        ArmTimer(race, *timeout, [](State* state, const RacePtr& race) {
+          state->Complete(race, Err(kErrorNetTimeout, "connect timeout"));
+        });
+  }
+
+  StartAttempt(race);
+}
+
+void Connector::State::StartAttempt(const RacePtr& race) {
+  if (race->next >= race->endpoints.size()) {
+    return;
+  }
+
+  auto attempt = std::make_shared<Race::Attempt>(
+      race->endpoints[race->next++], tcp::socket(*loop->proactor()),
+      loop->MonoNow());
+  race->attempts.push_back(attempt);
+
+  attempt->socket.async_connect(
+      attempt->endpoint, [weak_state = weak_from_this(), race,
+                          attempt](const asio::error_code& ec) {
+        if (auto state = weak_state.lock(); state) {
+          state->OnConnect(race, attempt, ec);
+        }
+      });
+
+  if (race->stagger_timer) {
+    race->stagger_timer->CancelEvent();
+    race->stagger_timer.reset();
+  }
+
+  if (race->next < race->endpoints.size()) {
+    race->stagger_timer =
+        ArmTimer(race, AttemptDelay(attempt->endpoint.address()),
+                 [](State* state, const RacePtr& race) {
+                   state->StartAttempt(race);
+                 });
+  }
+}
+
+void Connector::State::OnConnect(const RacePtr& race,
+                                 const AttemptPtr& attempt,
+                                 const asio::error_code& ec) {
+  if (!race->callback) {
+    return;
+  }
+
+  auto now = loop->MonoNow();
+  auto addr = attempt->endpoint.address();
+
+  if (!ec) {
+    stats.OnSuccess(
+        addr, std::chrono::duration_cast<MicroSeconds>(now - attempt->start),
+        now);
+    Complete(race, std::move(attempt->socket));
+    return;
+  }
+
+  stats.OnFailure(addr, now);
+  race->last_error = Error::MkBoostError(ec.value(), ec.message());
+
+  if (++race->failed == race->endpoints.size()) {
+    Complete(race, std::move(race->last_error));
+    return;
+  }
+
+  // don't wait for the stagger timer if nothing else is in flight
+  if (race->failed == race->next) {
+    StartAttempt(race);
+  }
+}
+
+void Connector::State::Complete(const RacePtr& race, Result<tcp::socket>&& r) {
+  if (!race->callback) {
+    return;
+  }
+
+  races.erase(race);
+
+  for (auto timer : {race->stagger_timer, race->deadline_timer}) {
+    if (timer) {
+      timer->CancelEvent();
+    }
+  }
+  race->stagger_timer.reset();
+  race->deadline_timer.reset();
+
+  // cancel the losers, the moved-from socket of the winner is closed already
+  for (auto& attempt : race->attempts) {
+    asio::error_code ec;
+    attempt->socket.close(ec);
+  }
+
+  auto callback = std::move(race->callback);
+  race->callback = nullptr;
+  callback(std::move(r));
+}
+
+std::shared_ptr<event::_::Cancelable> Connector::State::ArmTimer(
+    const RacePtr& race, MilliSeconds delay,
+    std::function<void(State*, const RacePtr&)>&& callback) {
+  auto token = loop->AddTimerEvent(
+      [weak_state = weak_from_this(), weak_race = std::weak_ptr(race),
+       callback = std::move(callback)](Error&& e) mutable {
+        auto state = weak_state.lock();
+        auto race = weak_race.lock();
+        if (!state || !race) {
+          return;
+        }
+
+        asio::post(*state->loop->proactor(),
+                   [weak_state, race, e = std::move(e),
+                    callback = std::move(callback)]() mutable {
+                     auto state = weak_state.lock();
+                     if (!state || !race->callback) {
+                       return;
+                     }
+
+                     // the loop is shutting down
+                     if (e) {
+                       state->Complete(race, std::move(e));
+                       return;
+                     }
+
+                     callback(state.get(), race);
+                   });
+      },
+      delay);
+
+  return token.AsCancelable();
+}
+
+MilliSeconds Connector::State::AttemptDelay(
+    const asio::ip::address& addr) const {
+  auto entry = stats.Find(addr);
+  if (!entry || !entry->srtt) {
+    return opts.attempt_delay;
+  }
+
+  // give the pending attempt twice its usual latency before racing it
+  auto delay = std::chrono::ceil<MilliSeconds>(*entry->srtt * 2);
+  return std::clamp(delay, opts.min_attempt_delay, opts.max_attempt_delay);
+}
+
+Connector::Connector(event::MessageLoop* loop, const Options& opts)
+    : loop_(loop), state_(std::make_shared<State>(loop, opts)) {}
+
+Connector::~Connector() {
+  while (!state_->races.empty()) {
+    auto race = *state_->races.begin();
+    state_->Complete(race, Err(kErrorNetCancelled, "connector destroyed"));
+  }
+}
+
+event::Promise<tcp::socket> Connector::Connect(
+    const IPAddressList& addresses, std::uint16_t port,
+    std::optional<MilliSeconds> timeout) {
+  event::Promise<tcp::socket> promise;
+
+  Connect(addresses, port, timeout,
+          [resolver = promise.GetResolver()](
+              Result<tcp::socket>&& r) mutable { resolver.Set(std::move(r)); });
+
+  return promise;
+}
+
+void Connector::Connect(const IPAddressList& addresses, std::uint16_t port,
+                        std::optional<MilliSeconds> timeout,
+                        ConnectCallback&& callback) {
+  auto race = std::make_shared<Race>();
+  race->endpoints = Plan(addresses, port);
+  race->callback = std::move(callback);
+
+  if (race->endpoints.empty()) {
+    auto cb = std::move(race->callback);
+    cb(Err(kErrorNetNoAddress, "no valid address to connect"));
+    return;
+  }
+
+  state_->Start(race, timeout);
+}
+
+std::vector<tcp::endpoint> Connector::Plan(const IPAddressList& addresses,
+                                           std::uint16_t port) const {
+  std::deque<tcp::endpoint> preferred;
+  std::deque<tcp::endpoint> others;
+
+  for (const auto& address : addresses) {
+    asio::error_code ec;
+    auto addr = asio::ip::make_address(address, ec);
+    if (ec) {
+      continue;
+    }
+
+    if (preferred.empty() || preferred.front().address().is_v6() ==
+                                 addr.is_v6()) {
+      preferred.emplace_back(addr, port);
+    } else {
+      others.emplace_back(addr, port);
+    }
+  }
+
+  // interleave the address families, rfc8305 section 4
+  std::vector<tcp::endpoint> endpoints;
+  endpoints.reserve(preferred.size() + others.size());
+  while (!preferred.empty() || !others.empty()) {
+    for (auto* family : {&preferred, &others}) {
+      if (!family->empty()) {
+        endpoints.push_back(family->front());
+        family->pop_front();
+      }
+    }
+  }
+
+  // the fast addresses first in the order of latency, then the unknown ones,
+  // and the recently failed ones last
+  auto now = loop_->MonoNow();
+  auto rank = [this, now](const tcp::endpoint& ep) {
+    auto entry = state_->stats.Find(ep.address());
+    if (!entry) {
+      return std::make_pair(1, MicroSeconds(0));
+    }
+
+    if (entry->last_failure &&
+        now - *entry->last_failure < state_->opts.failure_penalty) {
+      return std::make_pair(2, MicroSeconds(0));
+    }
+
+    if (entry->srtt) {
+      return std::make_pair(0, *entry->srtt);
+    }
+
+    return std::make_pair(1, MicroSeconds(0));
+  };
+
+  std::stable_sort(endpoints.begin(), endpoints.end(),
+                   [&rank](const auto& a, const auto& b) {
+                     return rank(a) < rank(b);
+                   });
+
+  return endpoints;
+}
+
+MilliSeconds Connector::AttemptDelay(const asio::ip::address& addr) const {
+  return state_->AttemptDelay(addr);
+}
+
+std::size_t Connector::inflight() const { return state_->races.size(); }
+
+const ConnectStats& Connector::stats() const { return state_->stats; }
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+
+#include <asio/ip/tcp.hpp>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "basic.h"
+#include "dns-cache.h"
+
+namespace libz {
+namespace net {
+
+// ConnectStats remembers how the connects to each address went, the smoothed
+// connect latency of the successful ones, and the time of the last failure.
+// it's loop local and not thread safe
+class ConnectStats {
+ public:
+  struct Entry {
+    std::optional<MicroSeconds> srtt;
+    std::optional<Tm> last_failure;
+    std::uint32_t successes{0};
+    std::uint32_t failures{0};
+    Tm updated_at;
+  };
+
+  explicit ConnectStats(std::size_t max_entries = 1024)
+      : max_entries_(max_entries), entries_() {}
+
+ public:
+  void OnSuccess(const asio::ip::address& addr, MicroSeconds latency, Tm now);
+  void OnFailure(const asio::ip::address& addr, Tm now);
+
+  const Entry* Find(const asio::ip::address& addr) const;
+
+  void Clear() { entries_.clear(); }
+  std::size_t size() const { return entries_.size(); }
+
+ private:
+  Entry& Emplace(const asio::ip::address& addr, Tm now);
+
+  std::size_t max_entries_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+// Connector establishes a tcp connection to one of the resolved addresses in
+// the happy eyeballs way (rfc8305). the attempts are started one by one with a
+// staggered delay, and the next one is started at once if the previous one
+// failed. the first established connection wins, and the others are closed.
+//
+// the addresses are interleaved by family, the first family of the list is
+// preferred. besides, the addresses known to be fast are tried first, and the
+// recently failed ones are tried last. the delay before the next attempt is
+// derived from the latency of the pending one if it's known.
+//
+// Notes, the connector is bound to a message loop, and all methods must be
+// invoked within the loop thread
+class Connector {
+ public:
+  struct Options {
+    // rfc8305 recommends 250ms, and no less than 10ms
+    MilliSeconds attempt_delay{MilliSeconds(250)};
+    MilliSeconds min_attempt_delay{MilliSeconds(10)};
+    MilliSeconds max_attempt_delay{MilliSeconds(2000)};
+
+    // how long a failed address is deprioritized
+    Seconds failure_penalty{Seconds(10)};
+
+    std::size_t max_stats_entries{1024};
+  };
+
+  using ConnectCallback = std::function<void(Result<asio::ip::tcp::socket>&&)>;
+
+  explicit Connector(event::MessageLoop* loop) : Connector(loop, Options{}) {}
+  Connector(event::MessageLoop* loop, const Options& opts);
+
+  // the pending connects are rejected with kErrorNetCancelled
+  ~Connector();
+
+ public:
+  // the timeout covers all the attempts. without it, the connect ends once
+  // every attempt has failed
+  event::Promise<asio::ip::tcp::socket> Connect(
+      const IPAddressList& addresses, std::uint16_t port,
+      std::optional<MilliSeconds> timeout = {});
+
+  // the callback version of Connect, the callback may be invoked in place
+  void Connect(const IPAddressList& addresses, std::uint16_t port,
+               std::optional<MilliSeconds> timeout, ConnectCallback&& callback);
+
+  // the endpoints in the order they would be tried
+  std::vector<asio::ip::tcp::endpoint> Plan(const IPAddressList& addresses,
+                                            std::uint16_t port) const;
+
+  // the delay before the attempt following the one to |addr|
+  MilliSeconds AttemptDelay(const asio::ip::address& addr) const;
+
+  std::size_t inflight() const;
+  const ConnectStats& stats() const;
+
+ private:
+  struct State;
+  struct Race;
+
+  event::MessageLoop* loop_;
+  std::shared_ptr<State> state_;
+
+  DISALLOW_COPY_AND_ASSIGN(Connector);
+};
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,111 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "dns-cache.h"
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+CATCH_TEST_CASE("positive entry", "[dns-cache]") {
+  DnsCache cache;
+  auto now = MonotonicClock::now();
+
+  CATCH_REQUIRE(cache.Lookup("a.com", now) == nullptr);
+
+  cache.Insert("a.com", {"1.1.1.1", "2.2.2.2"}, Seconds(10), now);
+  CATCH_REQUIRE(cache.size() == 1);
+
+  auto entry = cache.Lookup("a.com", now + Seconds(1));
+  CATCH_REQUIRE(entry);
+  CATCH_REQUIRE(!entry->IsNegative());
+  CATCH_REQUIRE(entry->addresses.size() == 2);
+  CATCH_REQUIRE(entry->hits == 1);
+
+  // expired
+  CATCH_REQUIRE(cache.Lookup("a.com", now + Seconds(10)) == nullptr);
+  CATCH_REQUIRE(cache.size() == 0);
+}
+
+CATCH_TEST_CASE("ttl clamp", "[dns-cache]") {
+  DnsCache::Options opts;
+  opts.min_ttl = Seconds(5);
+  opts.max_ttl = Seconds(20);
+
+  DnsCache cache(opts);
+  auto now = MonotonicClock::now();
+
+  cache.Insert("a.com", {"1.1.1.1"}, Seconds(0), now);
+  cache.Insert("b.com", {"1.1.1.1"}, Seconds(3600), now);
+
+  CATCH_REQUIRE(cache.Peek("a.com", now + Seconds(4)));
+  CATCH_REQUIRE(!cache.Peek("b.com", now + Seconds(21)));
+}
+
+CATCH_TEST_CASE("negative entry", "[dns-cache]") {
+  DnsCache::Options opts;
+  opts.negative_ttl = Seconds(2);
+
+  DnsCache cache(opts);
+  auto now = MonotonicClock::now();
+
+  cache.InsertNegative("bad.com", Err(kErrorNetNoAddress), now);
+
+  auto entry = cache.Lookup("bad.com", now + Seconds(1));
+  CATCH_REQUIRE(entry);
+  CATCH_REQUIRE(entry->IsNegative());
+  CATCH_REQUIRE(entry->error.code() == kErrorNetNoAddress);
+  CATCH_REQUIRE(!cache.ShouldRefresh(*entry, now + Seconds(1)));
+
+  CATCH_REQUIRE(!cache.Lookup("bad.com", now + Seconds(2)));
+}
+
+CATCH_TEST_CASE("refresh ahead", "[dns-cache]") {
+  DnsCache::Options opts;
+  opts.refresh_hits = 2;
+  opts.refresh_ratio = 0.5;
+
+  DnsCache cache(opts);
+  auto now = MonotonicClock::now();
+
+  cache.Insert("a.com", {"1.1.1.1"}, Seconds(10), now);
+
+  // cold entry
+  auto entry = cache.Lookup("a.com", now + Seconds(6));
+  CATCH_REQUIRE(!cache.ShouldRefresh(*entry, now + Seconds(6)));
+
+  // hot entry, but not yet in the refresh window
+  entry = cache.Lookup("a.com", now + Seconds(1));
+  CATCH_REQUIRE(!cache.ShouldRefresh(*entry, now + Seconds(1)));
+  CATCH_REQUIRE(cache.ShouldRefresh(*entry, now + Seconds(6)));
+
+  // the refreshed entry is cold again
+  cache.Insert("a.com", {"2.2.2.2"}, Seconds(10), now + Seconds(6));
+  entry = cache.Lookup("a.com", now + Seconds(12));
+  CATCH_REQUIRE(entry->addresses[0] == "2.2.2.2");
+  CATCH_REQUIRE(!cache.ShouldRefresh(*entry, now + Seconds(12)));
+}
+
+CATCH_TEST_CASE("eviction", "[dns-cache]") {
+  DnsCache::Options opts;
+  opts.max_entries = 2;
+
+  DnsCache cache(opts);
+  auto now = MonotonicClock::now();
+
+  cache.Insert("a.com", {"1.1.1.1"}, Seconds(10), now);
+  cache.Insert("b.com", {"1.1.1.1"}, Seconds(20), now);
+  cache.Insert("c.com", {"1.1.1.1"}, Seconds(30), now);
+
+  CATCH_REQUIRE(cache.size() == 2);
+  CATCH_REQUIRE(!cache.Peek("a.com", now));
+  CATCH_REQUIRE(cache.Peek("b.com", now));
+  CATCH_REQUIRE(cache.Peek("c.com", now));
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,92 @@
+#include "dns-cache.h"
+
+#include <algorithm>
+
+namespace libz {
+namespace net {
+
+DnsCache::Entry* DnsCache::Lookup(const std::string& host, Tm now) {
+  auto itr = entries_.find(host);
+  if (itr == entries_.end()) {
+    return nullptr;
+  }
+
+  if (itr->second.expire_at <= now) {
+    entries_.erase(itr);
+    return nullptr;
+  }
+
+  ++itr->second.hits;
+  return &itr->second;
+}
+
+const DnsCache::Entry* DnsCache::Peek(const std::string& host, Tm now) const {
+  if (auto itr = entries_.find(host);
+      itr != entries_.end() && itr->second.expire_at > now) {
+    return &itr->second;
+  }
+  return nullptr;
+}
+
+void DnsCache::Insert(const std::string& host, IPAddressList&& addresses,
+                      Seconds ttl, Tm now) {
+  ttl = std::clamp(ttl, opts_.min_ttl, opts_.max_ttl);
+
+  auto entry = Emplace(host, now);
+  entry->addresses = std::move(addresses);
+  entry->error.Clear();
+  entry->expire_at = now + ttl;
+  entry->refresh_at =
+      now + DurationCast<MilliSeconds>(ttl * opts_.refresh_ratio);
+}
+
+void DnsCache::InsertNegative(const std::string& host, Error&& e, Tm now) {
+  auto entry = Emplace(host, now);
+  entry->addresses.clear();
+  entry->error = std::move(e);
+  entry->expire_at = now + opts_.negative_ttl;
+  // the negative entries are never refreshed ahead of time
+  entry->refresh_at = entry->expire_at;
+}
+
+bool DnsCache::ShouldRefresh(const Entry& entry, Tm now) const {
+  return !entry.IsNegative() && entry.hits >= opts_.refresh_hits &&
+         entry.refresh_at <= now;
+}
+
+DnsCache::Entry* DnsCache::Emplace(const std::string& host, Tm now) {
+  if (auto itr = entries_.find(host); itr != entries_.end()) {
+    // the hits are reset, so a refreshed entry has to be hot again to be
+    // refreshed next time
+    itr->second.hits = 0;
+    return &itr->second;
+  }
+
+  if (entries_.size() >= opts_.max_entries) {
+    Evict(now);
+  }
+
+  return &entries_[host];
+}
+
+void DnsCache::Evict(Tm now) {
+  for (auto itr = entries_.begin(); itr != entries_.end();) {
+    if (itr->second.expire_at <= now) {
+      itr = entries_.erase(itr);
+    } else {
+      ++itr;
+    }
+  }
+
+  // still full, drop the entry which expires first
+  if (entries_.size() >= opts_.max_entries && !entries_.empty()) {
+    auto victim = std::min_element(
+        entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+          return a.second.expire_at < b.second.expire_at;
+        });
+    entries_.erase(victim);
+  }
+}
+
+}  // namespace net
+}  // namespace libz
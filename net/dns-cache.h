@@ -0,0 +1,86 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+using IPAddressList = std::vector<std::string>;
+
+// DnsCache keeps the resolved addresses of hosts for their ttl. the failed
+// lookups are cached as well (negative caching), so that a broken host won't
+// hammer the resolver. it's loop local and not thread safe
+class DnsCache {
+ public:
+  struct Options {
+    // the ttl used when the backend doesn't report one, eg. getaddrinfo
+    Seconds default_ttl{Seconds(30)};
+    Seconds min_ttl{Seconds(1)};
+    Seconds max_ttl{Seconds(300)};
+    Seconds negative_ttl{Seconds(5)};
+
+    // an entry hit at least |refresh_hits| times is hot, and it will be
+    // refreshed in background once |refresh_ratio| of its ttl has elapsed
+    std::uint32_t refresh_hits{2};
+    double refresh_ratio{0.75};
+
+    std::size_t max_entries{4096};
+  };
+
+  struct Entry {
+    IPAddressList addresses;
+    Error error;
+    Tm expire_at;
+    Tm refresh_at;
+    std::uint32_t hits{0};
+
+    bool IsNegative() const { return error.Has(); }
+  };
+
+  DnsCache() : DnsCache(Options{}) {}
+  explicit DnsCache(const Options& opts) : opts_(opts), entries_() {}
+
+  DnsCache(DnsCache&&) = default;
+  DnsCache& operator=(DnsCache&&) = default;
+
+ public:
+  // return nullptr if the host is absent or expired. the hit counter of the
+  // returned entry is increased
+  Entry* Lookup(const std::string& host, Tm now);
+
+  // same as |Lookup|, but the hit counter is untouched
+  const Entry* Peek(const std::string& host, Tm now) const;
+
+  void Insert(const std::string& host, IPAddressList&& addresses, Seconds ttl,
+              Tm now);
+  void Insert(const std::string& host, IPAddressList&& addresses, Tm now) {
+    Insert(host, std::move(addresses), opts_.default_ttl, now);
+  }
+  void InsertNegative(const std::string& host, Error&& e, Tm now);
+
+  bool ShouldRefresh(const Entry& entry, Tm now) const;
+
+  void Erase(const std::string& host) { entries_.erase(host); }
+  void Clear() { entries_.clear(); }
+
+  std::size_t size() const { return entries_.size(); }
+  const Options& options() const { return opts_; }
+
+ private:
+  Entry* Emplace(const std::string& host, Tm now);
+  void Evict(Tm now);
+
+ private:
+  Options opts_;
+  std::unordered_map<std::string, Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsCache);
+};
+
+}  // namespace net
+}  // namespace libz
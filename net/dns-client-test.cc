@@ -0,0 +1,449 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "dns-client.h"
+
+#include <event/io-message-loop.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <asio/ip/tcp.hpp>
+#include <asio/ip/udp.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <list>
+#include <set>
+
+#include "resolver.h"
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+using asio::ip::udp;
+
+// FakeDnsServer answers the queries on 127.0.0.1 over both udp and tcp
+//  - *.test: A 10.0.0.1, no AAAA
+//  - v6.test: AAAA ::1
+//  - alias.test: CNAME a.test
+//  - missing.*: NXDOMAIN
+//  - slow.*: never answered
+//  - failure.*: SERVFAIL
+//  - big.test: truncated over udp, A 10.0.0.2 over tcp
+//  - spoofed.test: truncated over udp, A 10.0.0.3 of another id over tcp
+class FakeDnsServer {
+ public:
+  explicit FakeDnsServer(asio::io_context& ctx)
+      : udp_(ctx, udp::endpoint(asio::ip::address_v4::loopback(), 0)),
+        acceptor_(ctx, tcp::endpoint(asio::ip::address_v4::loopback(),
+                                     udp_.local_endpoint().port())),
+        buffer_(4096, '\0') {
+    ReceiveUdp();
+    AcceptTcp();
+  }
+
+  udp::endpoint endpoint() const { return udp_.local_endpoint(); }
+
+  std::size_t udp_queries() const { return udp_queries_; }
+  std::size_t tcp_queries() const { return tcp_queries_; }
+  std::size_t udp_ports() const { return ports_.size(); }
+
+ private:
+  std::optional<std::string> Answer(std::string_view packet, bool tcp) {
+    auto query = DecodeDnsMessage(packet);
+    CATCH_REQUIRE(query);
+
+    auto msg = query.PassResult();
+    CATCH_REQUIRE(msg.questions.size() == 1);
+
+    const auto& q = msg.questions[0];
+    msg.header.flags |= DnsHeader::kQR | DnsHeader::kRA;
+
+    if (q.name.starts_with("slow.")) {
+      return std::nullopt;
+    } else if (q.name.starts_with("missing.")) {
+      msg.header.set_rcode(DnsRcode::kNXDomain);
+    } else if (q.name.starts_with("failure.")) {
+      msg.header.set_rcode(DnsRcode::kServFail);
+    } else if (q.name == "big.test") {
+      if (!tcp) {
+        msg.header.flags |= DnsHeader::kTC;
+      } else if (q.type == DnsType::kA) {
+        msg.answers.push_back({q.name, DnsType::kA, 1, 30, "10.0.0.2"});
+      }
+    } else if (q.name == "spoofed.test") {
+      if (!tcp) {
+        msg.header.flags |= DnsHeader::kTC;
+      } else {
+        msg.header.id ^= 1;
+        msg.answers.push_back({q.name, DnsType::kA, 1, 30, "10.0.0.3"});
+      }
+    } else if (q.name == "alias.test") {
+      msg.answers.push_back({q.name, DnsType::kCNAME, 1, 10, "a.test"});
+      if (q.type == DnsType::kA) {
+        msg.answers.push_back({"a.test", DnsType::kA, 1, 60, "10.0.0.1"});
+      }
+    } else if (q.name == "v6.test") {
+      if (q.type == DnsType::kAAAA) {
+        msg.answers.push_back({q.name, DnsType::kAAAA, 1, 60, "::1"});
+      }
+    } else if (q.type == DnsType::kA) {
+      msg.answers.push_back({q.name, DnsType::kA, 1, 60, "10.0.0.1"});
+    }
+
+    auto packet_result = EncodeDnsMessage(msg);
+    CATCH_REQUIRE(packet_result);
+    return packet_result.PassResult();
+  }
+
+  void ReceiveUdp() {
+    udp_.async_receive_from(
+        asio::buffer(buffer_), from_,
+        [this](const asio::error_code& ec, std::size_t length) {
+          if (ec) {
+            return;
+          }
+
+          ++udp_queries_;
+          ports_.insert(from_.port());
+          if (auto answer = Answer({buffer_.data(), length}, false); answer) {
+            replies_.push_back(std::move(*answer));
+            udp_.send_to(asio::buffer(replies_.back()), from_);
+          }
+
+          ReceiveUdp();
+        });
+  }
+
+  void AcceptTcp() {
+    acceptor_.async_accept([this](const asio::error_code& ec,
+                                  tcp::socket socket) {
+      if (ec) {
+        return;
+      }
+
+      auto conn = std::make_shared<tcp::socket>(std::move(socket));
+      auto length = std::make_shared<std::array<unsigned char, 2>>();
+      asio::async_read(
+          *conn, asio::buffer(*length),
+          [this, conn, length](const asio::error_code& ec, std::size_t) {
+            CATCH_REQUIRE(!ec);
+
+            auto body = std::make_shared<std::string>(
+                ((*length)[0] << 8) | (*length)[1], '\0');
+            asio::async_read(
+                *conn, asio::buffer(*body),
+                [this, conn, body](const asio::error_code& ec, std::size_t) {
+                  CATCH_REQUIRE(!ec);
+
+                  ++tcp_queries_;
+                  auto answer = Answer(*body, true);
+                  CATCH_REQUIRE(answer);
+
+                  auto reply = std::make_shared<std::string>();
+                  reply->push_back(static_cast<char>(answer->size() >> 8));
+                  reply->push_back(static_cast<char>(answer->size() & 0xff));
+                  reply->append(*answer);
+                  asio::async_write(
+                      *conn, asio::buffer(*reply),
+                      [conn, reply](const asio::error_code&, std::size_t) {});
+                });
+          });
+
+      AcceptTcp();
+    });
+  }
+
+  udp::socket udp_;
+  tcp::acceptor acceptor_;
+
+  std::string buffer_;
+  udp::endpoint from_;
+  std::list<std::string> replies_;
+
+  std::size_t udp_queries_{0};
+  std::size_t tcp_queries_{0};
+  std::set<unsigned short> ports_;
+};
+
+DnsClient::Options MkOptions(const FakeDnsServer& server) {
+  DnsClient::Options opts;
+  opts.config.nameservers.push_back(server.endpoint());
+  opts.config.search.push_back("test");
+  opts.config.timeout = MilliSeconds(200);
+  opts.config.attempts = 2;
+  opts.hosts.Add("myhost", "192.168.1.1");
+  return opts;
+}
+
+CATCH_TEST_CASE("message", "[dns]") {
+  auto packet = EncodeDnsQuery(0x1234, "www.example.com.", DnsType::kAAAA);
+  CATCH_REQUIRE(packet);
+
+  auto query = DecodeDnsMessage(packet.GetResult());
+  CATCH_REQUIRE(query);
+  CATCH_REQUIRE(query.GetResult().header.id == 0x1234);
+  CATCH_REQUIRE(!query.GetResult().header.IsResponse());
+  CATCH_REQUIRE(query.GetResult().questions[0].name == "www.example.com");
+  CATCH_REQUIRE(query.GetResult().questions[0].type == DnsType::kAAAA);
+
+  // compressed answer: www.example.com CNAME example.com, A 1.2.3.4
+  std::string response = packet.GetResult();
+  response[2] = '\x81';
+  response[3] = '\x80';
+  response[7] = 2;
+  response += std::string("\xc0\x0c\x00\x05\x00\x01\x00\x00\x00\x3c\x00\x02"
+                          "\xc0\x10",
+                          14);
+  response += std::string("\xc0\x10\x00\x01\x00\x01\x00\x00\x00\x1e\x00\x04"
+                          "\x01\x02\x03\x04",
+                          16);
+
+  auto msg = DecodeDnsMessage(response);
+  CATCH_REQUIRE(msg);
+  CATCH_REQUIRE(msg.GetResult().header.IsResponse());
+  CATCH_REQUIRE(msg.GetResult().header.rcode() == DnsRcode::kNoError);
+  CATCH_REQUIRE(msg.GetResult().answers.size() == 2);
+  CATCH_REQUIRE(msg.GetResult().answers[0].data == "example.com");
+  CATCH_REQUIRE(msg.GetResult().answers[1].name == "example.com");
+  CATCH_REQUIRE(msg.GetResult().answers[1].data == "1.2.3.4");
+  CATCH_REQUIRE(msg.GetResult().answers[1].ttl == 30);
+
+  // pointer loop
+  std::string bad = packet.GetResult().substr(0, 12) + "\xc0\x0c";
+  bad[5] = 1;
+  CATCH_REQUIRE(!DecodeDnsMessage(bad));
+  CATCH_REQUIRE(!DecodeDnsMessage("short"));
+
+  CATCH_REQUIRE(DnsNameEqual("WWW.Example.com.", "www.example.com"));
+  CATCH_REQUIRE(!EncodeDnsQuery(1, "a..b", DnsType::kA));
+}
+
+CATCH_TEST_CASE("config", "[dns]") {
+  auto config = DnsConfig::Parse(
+      "# comment\n"
+      "nameserver 10.0.0.1\n"
+      "nameserver ::1 ; comment\n"
+      "nameserver bad\n"
+      "search a.com b.com\n"
+      "options ndots:2 timeout:1 attempts:3 rotate\n");
+
+  CATCH_REQUIRE(config.nameservers.size() == 2);
+  CATCH_REQUIRE(config.nameservers[0].address().to_string() == "10.0.0.1");
+  CATCH_REQUIRE(config.nameservers[0].port() == 53);
+  CATCH_REQUIRE(config.nameservers[1].address().is_v6());
+  CATCH_REQUIRE(config.search == std::vector<std::string>{"a.com", "b.com"});
+  CATCH_REQUIRE(config.ndots == 2);
+  CATCH_REQUIRE(config.attempts == 3);
+  CATCH_REQUIRE(config.timeout == Seconds(1));
+  CATCH_REQUIRE(config.rotate);
+
+  auto hosts = HostsFile::Parse(
+      "127.0.0.1 localhost  LocalHost.localdomain\n"
+      "::1\tlocalhost ip6-localhost # comment\n"
+      "bad-address host\n");
+  CATCH_REQUIRE(hosts.size() == 3);
+  CATCH_REQUIRE(hosts.Find("localhost.LOCALDOMAIN"));
+  CATCH_REQUIRE(*hosts.Find("localhost") ==
+                IPAddressList{"127.0.0.1", "::1"});
+  CATCH_REQUIRE(!hosts.Find("host"));
+}
+
+CATCH_TEST_CASE("client", "[dns]") {
+  event::IOMessageLoop loop;
+  FakeDnsServer server(*loop.proactor());
+  DnsClient client(&loop, MkOptions(server));
+
+  std::size_t done = 0;
+  std::vector<event::Promise<DnsAnswer>> promises;
+  auto expect = [&](std::string_view host,
+                    std::function<void(Result<DnsAnswer>&&)>&& check) {
+    promises.push_back(client.LookupHost(host));
+    promises.back().Then(
+        [&, check = std::move(check)](Result<DnsAnswer>&& r) mutable {
+          check(std::move(r));
+          if (++done == promises.size()) {
+            loop.Shutdown();
+          }
+        },
+        loop.executor());
+  };
+
+  loop.Post([&]() {
+    expect("a.test", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"10.0.0.1"});
+      CATCH_REQUIRE(r.GetResult().ttl == Seconds(60));
+    });
+
+    // via the search list
+    expect("short", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"10.0.0.1"});
+    });
+
+    expect("alias.test.", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"10.0.0.1"});
+      CATCH_REQUIRE(r.GetResult().ttl == Seconds(10));
+    });
+
+    expect("v6.test", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"::1"});
+    });
+
+    expect("missing.test", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(!r);
+      CATCH_REQUIRE(r.GetError().code() == kErrorNetNoAddress);
+    });
+
+    expect("slow.test", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(!r);
+      CATCH_REQUIRE(r.GetError().code() == kErrorNetTimeout);
+    });
+
+    expect("failure.test", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(!r);
+      CATCH_REQUIRE(r.GetError().code() == kErrorDnsServerFailure);
+    });
+
+    expect("big.test", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"10.0.0.2"});
+    });
+
+    expect("myhost", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"192.168.1.1"});
+    });
+
+    expect("10.1.1.1", [](Result<DnsAnswer>&& r) {
+      CATCH_REQUIRE(r);
+      CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"10.1.1.1"});
+    });
+
+    // many concurrent queries
+    for (int i = 0; i < 200; ++i) {
+      expect(fmt::format("host{}.test", i), [](Result<DnsAnswer>&& r) {
+        CATCH_REQUIRE(r);
+        CATCH_REQUIRE(r.GetResult().addresses == IPAddressList{"10.0.0.1"});
+      });
+    }
+
+    CATCH_REQUIRE(client.inflight() > 200);
+  });
+
+  loop.Run();
+
+  CATCH_REQUIRE(done == promises.size());
+  CATCH_REQUIRE(client.inflight() == 0);
+  CATCH_REQUIRE(server.tcp_queries() == 2);
+
+  // the queries are sent from the different ports
+  CATCH_REQUIRE(server.udp_ports() > 200);
+}
+
+// the sockets can't be opened, the attempts are exhausted rather than
+// retried without end
+CATCH_TEST_CASE("no socket", "[dns]") {
+  event::IOMessageLoop loop;
+  FakeDnsServer server(*loop.proactor());
+  DnsClient client(&loop, MkOptions(server));
+
+  // the lowest free fd is above the limit
+  int fd = ::dup(0);
+  CATCH_REQUIRE(fd >= 0);
+  ::close(fd);
+
+  struct rlimit saved;
+  CATCH_REQUIRE(::getrlimit(RLIMIT_NOFILE, &saved) == 0);
+  struct rlimit limit = saved;
+  limit.rlim_cur = fd;
+  CATCH_REQUIRE(::setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+  std::optional<Result<DnsMessage>> result;
+  auto promise = client.Query("a.test", DnsType::kA);
+  promise.Then([&](Result<DnsMessage>&& r) { result.emplace(std::move(r)); },
+               nullptr);
+  CATCH_REQUIRE(::setrlimit(RLIMIT_NOFILE, &saved) == 0);
+
+  CATCH_REQUIRE(result);
+  CATCH_REQUIRE(!*result);
+  CATCH_REQUIRE(result->GetError().code() == kErrorNetInvalidAddress);
+  CATCH_REQUIRE(client.inflight() == 0);
+}
+
+// the answer over tcp is checked as the one over udp
+CATCH_TEST_CASE("spoofed tcp answer", "[dns]") {
+  event::IOMessageLoop loop;
+  FakeDnsServer server(*loop.proactor());
+  DnsClient client(&loop, MkOptions(server));
+
+  std::optional<Result<DnsMessage>> result;
+  std::optional<event::Promise<DnsMessage>> promise;
+  loop.Post([&]() {
+    promise.emplace(client.Query("spoofed.test", DnsType::kA));
+    promise->Then(
+        [&](Result<DnsMessage>&& r) {
+          result.emplace(std::move(r));
+          loop.Shutdown();
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+  loop.Run();
+
+  CATCH_REQUIRE(result);
+  CATCH_REQUIRE(!*result);
+  CATCH_REQUIRE(result->GetError().code() == kErrorDnsMalformed);
+  CATCH_REQUIRE(server.tcp_queries() == 2);
+  CATCH_REQUIRE(client.inflight() == 0);
+}
+
+CATCH_TEST_CASE("resolver with stub backend", "[dns]") {
+  event::IOMessageLoop loop;
+  FakeDnsServer server(*loop.proactor());
+
+  Resolver::Options opts;
+  opts.backend = Resolver::Backend::kStub;
+  opts.stub = MkOptions(server);
+  Resolver resolver(&loop, opts);
+
+  std::vector<event::Promise<IPAddressList>> promises;
+  loop.Post([&]() {
+    // deduplicated into one lookup
+    for (int i = 0; i < 3; ++i) {
+      promises.push_back(resolver.Resolve("alias.test"));
+    }
+
+    promises.back().Then(
+        [&](Result<IPAddressList>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult() == IPAddressList{"10.0.0.1"});
+          CATCH_REQUIRE(server.udp_queries() == 2);
+
+          // the cname ttl wins
+          auto entry = resolver.cache()->Peek("alias.test", loop.MonoNow());
+          CATCH_REQUIRE(entry);
+          CATCH_REQUIRE(entry->expire_at - loop.MonoNow() <= Seconds(10));
+
+          // hit the cache
+          promises.push_back(resolver.Resolve("alias.test"));
+          CATCH_REQUIRE(promises.back().IsPending());
+          CATCH_REQUIRE(server.udp_queries() == 2);
+
+          loop.Shutdown();
+        },
+        loop.executor());
+  });
+
+  loop.Run();
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
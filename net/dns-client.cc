@@ -0,0 +1,658 @@
+#include "dns-client.h"
+
+#include <algorithm>
+#include <array>
+#include <asio/ip/tcp.hpp>
+#include <asio/ip/udp.hpp>
+#include <asio/post.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+#include <functional>
+#include <limits>
+#include <random>
+#include <unordered_map>
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+using asio::ip::udp;
+
+namespace {
+
+using QueryCallback = std::function<void(Result<DnsMessage>&&)>;
+
+// the addresses from literal or hosts file never change
+constexpr Seconds kStaticTtl = Seconds(3600);
+
+// the longest cname chain to follow within one answer
+constexpr int kMaxCnameChain = 8;
+
+constexpr std::size_t kMaxUdpPacket = 65536;
+
+struct Channel {
+  explicit Channel(asio::io_context& ctx)
+      : socket(ctx), buffer(new char[kMaxUdpPacket]), from() {}
+
+  udp::socket socket;
+  std::unique_ptr<char[]> buffer;
+  udp::endpoint from;
+};
+
+struct Request {
+  std::uint16_t id;
+  std::string name;
+  DnsType type;
+  std::string packet;
+
+  // the index of the nameserver tried currently, and the number of tries
+  std::size_t server;
+  int tries;
+
+  std::shared_ptr<event::_::Cancelable> timer;
+
+  // the udp socket of the current attempt, which is bound to a new
+  // ephemeral port, so that the source port is as random as the id against
+  // the spoofing. it's shared with the pending receive
+  std::shared_ptr<Channel> channel;
+
+  // the tcp fallback for the truncated response
+  std::unique_ptr<tcp::socket> tcp_socket;
+  std::array<unsigned char, 2> tcp_length;
+  std::string tcp_buffer;
+
+  QueryCallback callback;
+};
+
+using RequestPtr = std::shared_ptr<Request>;
+
+void CloseChannel(Request* req) {
+  if (req->channel) {
+    asio::error_code ec;
+    req->channel->socket.close(ec);
+    req->channel.reset();
+  }
+}
+
+void CollectAddresses(const DnsMessage& msg, std::string_view name,
+                      DnsType type, IPAddressList* addresses,
+                      std::uint32_t* ttl) {
+  std::string target(name);
+  for (int i = 0; i < kMaxCnameChain; ++i) {
+    auto itr = std::find_if(
+        msg.answers.begin(), msg.answers.end(), [&target](const auto& r) {
+          return r.type == DnsType::kCNAME && DnsNameEqual(r.name, target);
+        });
+    if (itr == msg.answers.end()) {
+      break;
+    }
+
+    *ttl = std::min(*ttl, itr->ttl);
+    target = itr->data;
+  }
+
+  for (const auto& r : msg.answers) {
+    if (r.type == type && DnsNameEqual(r.name, target)) {
+      *ttl = std::min(*ttl, r.ttl);
+      addresses->push_back(r.data);
+    }
+  }
+}
+
+std::vector<std::string> BuildCandidates(std::string_view host,
+                                         const DnsConfig& config) {
+  std::vector<std::string> candidates;
+
+  // the absolute name
+  if (host.back() == '.') {
+    candidates.emplace_back(host.substr(0, host.size() - 1));
+    return candidates;
+  }
+
+  std::vector<std::string> searched;
+  for (const auto& domain : config.search) {
+    searched.push_back(fmt::format("{}.{}", host, domain));
+  }
+
+  auto ndots = std::count(host.begin(), host.end(), '.');
+  if (ndots >= config.ndots) {
+    candidates.emplace_back(host);
+    candidates.insert(candidates.end(), searched.begin(), searched.end());
+  } else {
+    candidates = std::move(searched);
+    candidates.emplace_back(host);
+  }
+
+  return candidates;
+}
+
+}  // namespace
+
+struct DnsClient::State : public std::enable_shared_from_this<State> {
+  State(event::MessageLoop* loop, Options&& opts)
+      : loop(loop),
+        opts(std::move(opts)),
+        requests(),
+        rng(std::random_device{}()),
+        next_server(0),
+        closed(false) {}
+
+  event::MessageLoop* loop;
+  Options opts;
+
+  std::unordered_map<std::uint16_t, RequestPtr> requests;
+
+  std::mt19937 rng;
+  std::size_t next_server;
+
+  bool closed;
+
+ public:
+  void Query(std::string_view name, DnsType type, QueryCallback&& callback);
+  void Cancel(Error&& e);
+
+ private:
+  std::uint16_t NewId();
+  int MaxTries() const {
+    return opts.config.attempts *
+           static_cast<int>(opts.config.nameservers.size());
+  }
+  const udp::endpoint& Server(const Request& req) const {
+    const auto& servers = opts.config.nameservers;
+    return servers[req.server % servers.size()];
+  }
+
+  std::shared_ptr<Channel> OpenChannel(const udp::endpoint& ep);
+  void StartReceive(const RequestPtr& req);
+  void OnDatagram(const RequestPtr& req, std::size_t length);
+
+  // whether |msg| answers the pending |req|, over either udp or tcp
+  bool IsAnswer(const RequestPtr& req, const DnsMessage& msg) const;
+
+  void Send(const RequestPtr& req);
+  void SendTcp(const RequestPtr& req);
+  void Retry(const RequestPtr& req, Error&& e);
+  void OnResponse(const RequestPtr& req, DnsMessage&& msg);
+  void Complete(const RequestPtr& req, Result<DnsMessage>&& r);
+  void ArmTimer(const RequestPtr& req);
+};
+
+std::uint16_t DnsClient::State::NewId() {
+  std::uniform_int_distribution<std::uint16_t> dist(
+      0, std::numeric_limits<std::uint16_t>::max());
+
+  for (;;) {
+    auto id = dist(rng);
+    if (requests.count(id) == 0) {
+      return id;
+    }
+  }
+}
+
+void DnsClient::State::Query(std::string_view name, DnsType type,
+                             QueryCallback&& callback) {
+  if (closed) {
+    callback(Err(kErrorNetCancelled, "dns client closed"));
+    return;
+  }
+
+  if (opts.config.nameservers.empty()) {
+    callback(Err(kErrorDnsNoServer));
+    return;
+  }
+
+  if (requests.size() > std::numeric_limits<std::uint16_t>::max() / 2) {
+    callback(Err(kErrorDnsRefused, "too many queries in flight"));
+    return;
+  }
+
+  auto id = NewId();
+  auto packet = EncodeDnsQuery(id, name, type);
+  if (!packet) {
+    callback(packet.PassError());
+    return;
+  }
+
+  auto req = std::make_shared<Request>();
+  req->id = id;
+  req->name = std::string(name);
+  req->type = type;
+  req->packet = packet.PassResult();
+  req->server = opts.config.rotate ? next_server++ : 0;
+  req->tries = 0;
+  req->callback = std::move(callback);
+
+  requests.emplace(id, req);
+  Send(req);
+}
+
+void DnsClient::State::Cancel(Error&& e) {
+  closed = true;
+
+  while (!requests.empty()) {
+    auto req = requests.begin()->second;
+    Complete(req, Error{e});
+  }
+}
+
+std::shared_ptr<Channel> DnsClient::State::OpenChannel(
+    const udp::endpoint& ep) {
+  auto channel = std::make_shared<Channel>(*loop->proactor());
+
+  asio::error_code ec;
+  channel->socket.open(ep.protocol(), ec);
+  if (ec) {
+    return nullptr;
+  }
+
+  // bind to an ephemeral port chosen by kernel, which is randomized
+  channel->socket.bind(udp::endpoint(ep.protocol(), 0), ec);
+  if (ec) {
+    return nullptr;
+  }
+
+  return channel;
+}
+
+void DnsClient::State::StartReceive(const RequestPtr& req) {
+  auto channel = req->channel;
+  channel->socket.async_receive_from(
+      asio::buffer(channel->buffer.get(), kMaxUdpPacket), channel->from,
+      [weak_state = weak_from_this(), weak_req = std::weak_ptr(req),
+       channel](const asio::error_code& ec, std::size_t length) {
+        auto state = weak_state.lock();
+        auto req = weak_req.lock();
+
+        // the socket of the former attempt is closed
+        if (!state || !req || req->channel != channel ||
+            ec == asio::error::operation_aborted) {
+          return;
+        }
+
+        if (!ec) {
+          state->OnDatagram(req, length);
+        }
+
+        if (req->channel == channel) {
+          state->StartReceive(req);
+        }
+      });
+}
+
+void DnsClient::State::OnDatagram(const RequestPtr& req, std::size_t length) {
+  const auto& channel = *req->channel;
+  auto msg = DecodeDnsMessage(std::string_view(channel.buffer.get(), length));
+  if (!msg) {
+    return;
+  }
+
+  // drop the spoofed or stale answers
+  if (!IsAnswer(req, msg.GetResult()) || channel.from != Server(*req) ||
+      req->tcp_socket) {
+    return;
+  }
+
+  if (msg.GetResult().header.IsTruncated()) {
+    CloseChannel(req.get());
+    SendTcp(req);
+    return;
+  }
+
+  OnResponse(req, msg.PassResult());
+}
+
+bool DnsClient::State::IsAnswer(const RequestPtr& req,
+                                const DnsMessage& msg) const {
+  // the request may be completed, and its id may be reused
+  auto itr = requests.find(req->id);
+  if (itr == requests.end() || itr->second != req) {
+    return false;
+  }
+
+  const auto& header = msg.header;
+  const auto& questions = msg.questions;
+  return header.id == req->id && header.IsResponse() &&
+         questions.size() == 1 && questions[0].type == req->type &&
+         DnsNameEqual(questions[0].name, req->name);
+}
+
+void DnsClient::State::Send(const RequestPtr& req) {
+  const auto& server = Server(*req);
+
+  // the attempt is counted even if the socket can't be opened, so that the
+  // retries are bounded when none of the nameservers is reachable
+  ++req->tries;
+  CloseChannel(req.get());
+  req->channel = OpenChannel(server);
+  if (!req->channel) {
+    Retry(req,
+          Err(kErrorNetInvalidAddress, "{}", server.address().to_string()));
+    return;
+  }
+
+  StartReceive(req);
+  ArmTimer(req);
+
+  // the send failure is left to the timer
+  req->channel->socket.async_send_to(
+      asio::buffer(req->packet), server,
+      [req](const asio::error_code&, std::size_t) {});
+}
+
+void DnsClient::State::SendTcp(const RequestPtr& req) {
+  const auto& server = Server(*req);
+  ArmTimer(req);
+
+  auto length = static_cast<std::uint16_t>(req->packet.size());
+  req->tcp_buffer.clear();
+  req->tcp_buffer.push_back(static_cast<char>(length >> 8));
+  req->tcp_buffer.push_back(static_cast<char>(length & 0xff));
+  req->tcp_buffer.append(req->packet);
+
+  req->tcp_socket = std::make_unique<tcp::socket>(*loop->proactor());
+
+  auto socket = req->tcp_socket.get();
+  auto weak_state = weak_from_this();
+  auto on_error = [weak_state, req](const asio::error_code& ec) {
+    if (auto state = weak_state.lock();
+        state && ec != asio::error::operation_aborted) {
+      state->Retry(req, Error::MkBoostError(ec.value(), ec.message()));
+    }
+  };
+
+  socket->async_connect(
+      tcp::endpoint(server.address(), server.port()),
+      [weak_state, req, socket, on_error](const asio::error_code& ec) {
+        if (ec) {
+          on_error(ec);
+          return;
+        }
+
+        asio::async_write(
+            *socket, asio::buffer(req->tcp_buffer),
+            [weak_state, req, socket, on_error](const asio::error_code& ec,
+                                                std::size_t) {
+              if (ec) {
+                on_error(ec);
+                return;
+              }
+
+              asio::async_read(
+                  *socket, asio::buffer(req->tcp_length),
+                  [weak_state, req, socket, on_error](
+                      const asio::error_code& ec, std::size_t) {
+                    if (ec) {
+                      on_error(ec);
+                      return;
+                    }
+
+                    req->tcp_buffer.resize((req->tcp_length[0] << 8) |
+                                           req->tcp_length[1]);
+                    asio::async_read(
+                        *socket, asio::buffer(req->tcp_buffer),
+                        [weak_state, req, on_error](const asio::error_code& ec,
+                                                    std::size_t) {
+                          if (ec) {
+                            on_error(ec);
+                            return;
+                          }
+
+                          auto state = weak_state.lock();
+                          if (!state) {
+                            return;
+                          }
+
+                          auto msg = DecodeDnsMessage(req->tcp_buffer);
+                          if (!msg) {
+                            state->Retry(req, msg.PassError());
+                            return;
+                          }
+
+                          // the connection may be hijacked as well
+                          if (!state->IsAnswer(req, msg.GetResult())) {
+                            state->Retry(req, Err(kErrorDnsMalformed,
+                                                  "{} mismatched answer",
+                                                  req->name));
+                            return;
+                          }
+                          state->OnResponse(req, msg.PassResult());
+                        });
+                  });
+            });
+      });
+}
+
+void DnsClient::State::Retry(const RequestPtr& req, Error&& e) {
+  // the request may be completed, and its id may be reused
+  auto itr = requests.find(req->id);
+  if (itr == requests.end() || itr->second != req) {
+    return;
+  }
+
+  if (req->tcp_socket) {
+    asio::error_code ec;
+    req->tcp_socket->close(ec);
+    req->tcp_socket.reset();
+  }
+
+  if (req->tries >= MaxTries()) {
+    Complete(req, std::move(e));
+    return;
+  }
+
+  ++req->server;
+  Send(req);
+}
+
+void DnsClient::State::OnResponse(const RequestPtr& req, DnsMessage&& msg) {
+  switch (msg.header.rcode()) {
+    case DnsRcode::kNoError:
+    case DnsRcode::kNXDomain:
+      Complete(req, std::move(msg));
+      break;
+
+    case DnsRcode::kRefused:
+      Retry(req, Err(kErrorDnsRefused, "{}", req->name));
+      break;
+
+    default:
+      Retry(req, Err(kErrorDnsServerFailure, "{} rcode: {}", req->name,
+                     static_cast<int>(msg.header.rcode())));
+      break;
+  }
+}
+
+void DnsClient::State::Complete(const RequestPtr& req,
+                                Result<DnsMessage>&& r) {
+  auto itr = requests.find(req->id);
+  if (itr == requests.end() || itr->second != req) {
+    return;
+  }
+  requests.erase(itr);
+
+  if (req->timer) {
+    req->timer->CancelEvent();
+    req->timer.reset();
+  }
+
+  if (req->tcp_socket) {
+    asio::error_code ec;
+    req->tcp_socket->close(ec);
+  }
+  CloseChannel(req.get());
+
+  auto callback = std::move(req->callback);
+  if (callback) {
+    callback(std::move(r));
+  }
+}
+
+void DnsClient::State::ArmTimer(const RequestPtr& req) {
+  if (req->timer) {
+    req->timer->CancelEvent();
+  }
+
+  auto token = loop->AddTimerEvent(
+      [weak_state = weak_from_this(), weak_req = std::weak_ptr(req)](
+          Error&& e) {
+        auto state = weak_state.lock();
+        auto req = weak_req.lock();
+        if (!state || !req) {
+          return;
+        }
+
+        // Notes, both Retry and Complete release the timer which owns this
+        // callback, so they are deferred out of it
+        asio::post(*state->loop->proactor(),
+                   [weak_state, req, e = std::move(e)]() mutable {
+                     auto state = weak_state.lock();
+                     if (!state) {
+                       return;
+                     }
+
+                     if (e) {
+                       state->Complete(req, std::move(e));
+                     } else {
+                       state->Retry(
+                           req, Err(kErrorNetTimeout, "query {}", req->name));
+                     }
+                   });
+      },
+      opts.config.timeout);
+  req->timer = token.AsCancelable();
+}
+
+DnsClient::DnsClient(event::MessageLoop* loop)
+    : DnsClient(loop, Options{DnsConfig::Load(), HostsFile::Load()}) {}
+
+DnsClient::DnsClient(event::MessageLoop* loop, Options&& opts)
+    : state_(std::make_shared<State>(loop, std::move(opts))) {}
+
+DnsClient::~DnsClient() {
+  state_->Cancel(Err(kErrorNetCancelled, "dns client destroyed"));
+}
+
+std::size_t DnsClient::inflight() const { return state_->requests.size(); }
+
+const DnsClient::Options& DnsClient::options() const { return state_->opts; }
+
+event::Promise<DnsMessage> DnsClient::Query(std::string_view name,
+                                            DnsType type) {
+  event::Promise<DnsMessage> promise;
+
+  state_->Query(name, type,
+                [resolver = promise.GetResolver()](
+                    Result<DnsMessage>&& r) mutable {
+                  resolver.Set(std::move(r));
+                });
+
+  return promise;
+}
+
+event::Promise<DnsAnswer> DnsClient::LookupHost(std::string_view host) {
+  event::Promise<DnsAnswer> promise;
+
+  LookupHost(host, [resolver = promise.GetResolver()](
+                       Result<DnsAnswer>&& r) mutable {
+    resolver.Set(std::move(r));
+  });
+
+  return promise;
+}
+
+void DnsClient::LookupHost(std::string_view host, LookupCallback&& callback) {
+  if (host.empty()) {
+    callback(Err(kErrorNetInvalidAddress, "empty host"));
+    return;
+  }
+
+  asio::error_code ec;
+  if (auto addr = asio::ip::make_address(std::string(host), ec); !ec) {
+    callback(DnsAnswer{IPAddressList{addr.to_string()}, kStaticTtl});
+    return;
+  }
+
+  if (auto addresses = state_->opts.hosts.Find(host); addresses) {
+    callback(DnsAnswer{*addresses, kStaticTtl});
+    return;
+  }
+
+  struct Lookup {
+    std::vector<std::string> candidates;
+    std::size_t index{0};
+
+    // the answers of A and AAAA queries for the current candidate
+    int pending{0};
+    IPAddressList v4;
+    IPAddressList v6;
+    std::uint32_t ttl{std::numeric_limits<std::uint32_t>::max()};
+    Error error;
+
+    LookupCallback callback;
+  };
+
+  auto lookup = std::make_shared<Lookup>();
+  lookup->candidates = BuildCandidates(host, state_->opts.config);
+  lookup->callback = std::move(callback);
+
+  // try the candidates in turn, until one of them has address
+  auto step = std::make_shared<std::function<void()>>();
+  *step = [weak_state = std::weak_ptr(state_), lookup,
+           weak_step = std::weak_ptr(step)]() {
+    auto state = weak_state.lock();
+    if (!state) {
+      return;
+    }
+
+    if (lookup->index >= lookup->candidates.size()) {
+      if (lookup->error) {
+        lookup->callback(std::move(lookup->error));
+      } else {
+        lookup->callback(
+            Err(kErrorNetNoAddress, "{}", lookup->candidates.back()));
+      }
+      return;
+    }
+
+    const auto& name = lookup->candidates[lookup->index++];
+    lookup->pending = 2;
+
+    for (auto type : {DnsType::kA, DnsType::kAAAA}) {
+      state->Query(
+          name, type,
+          [lookup, name, type,
+           step = weak_step.lock()](Result<DnsMessage>&& r) mutable {
+            if (r) {
+              CollectAddresses(r.GetResult(), name, type,
+                               type == DnsType::kA ? &lookup->v4 : &lookup->v6,
+                               &lookup->ttl);
+            } else {
+              lookup->error = r.PassError();
+            }
+
+            if (--lookup->pending > 0) {
+              return;
+            }
+
+            if (lookup->v4.empty() && lookup->v6.empty()) {
+              (*step)();
+              return;
+            }
+
+            // the ipv6 addresses come first as rfc6724 recommends, and the
+            // connector is supposed to interleave the address families
+            DnsAnswer answer;
+            answer.addresses = std::move(lookup->v6);
+            answer.addresses.insert(answer.addresses.end(),
+                                    lookup->v4.begin(), lookup->v4.end());
+            answer.ttl = Seconds(lookup->ttl);
+            lookup->callback(std::move(answer));
+          });
+    }
+  };
+
+  (*step)();
+}
+
+}  // namespace net
+}  // namespace libz
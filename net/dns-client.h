@@ -0,0 +1,72 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "basic.h"
+#include "dns-cache.h"
+#include "dns-config.h"
+#include "dns-message.h"
+
+namespace libz {
+namespace net {
+
+struct DnsAnswer {
+  IPAddressList addresses;
+  Seconds ttl{0};
+};
+
+// DnsClient is a non-blocking stub resolver. it speaks the dns protocol with
+// the nameservers over udp on the message loop, and falls back to tcp when the
+// response is truncated. many queries can be in flight at the same time, each
+// attempt is sent from its own socket on a random port with a random query
+// id against the spoofing, and has its own timeout on the timer wheel.
+//
+// Notes, the client is bound to a message loop, and all methods must be
+// invoked within the loop thread
+class DnsClient {
+ public:
+  struct Options {
+    DnsConfig config;
+    HostsFile hosts;
+  };
+
+  // load the system /etc/resolv.conf and /etc/hosts
+  explicit DnsClient(event::MessageLoop* loop);
+  DnsClient(event::MessageLoop* loop, Options&& opts);
+
+  // the pending queries are rejected with kErrorNetCancelled
+  ~DnsClient();
+
+ public:
+  // send the question to the nameservers in turn until an answer arrives or
+  // the attempts are exhausted. a NXDOMAIN answer is resolved as well, and
+  // the caller should check the rcode
+  event::Promise<DnsMessage> Query(std::string_view name, DnsType type);
+
+  // look up the addresses of host. the hosts file is consulted first, then the
+  // names built from the search list are queried in turn, both A and AAAA
+  event::Promise<DnsAnswer> LookupHost(std::string_view host);
+
+  // the callback version of LookupHost, the callback may be invoked in place
+  using LookupCallback = std::function<void(Result<DnsAnswer>&&)>;
+  void LookupHost(std::string_view host, LookupCallback&& callback);
+
+  std::size_t inflight() const;
+  const Options& options() const;
+
+ private:
+  struct State;
+  std::shared_ptr<State> state_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsClient);
+};
+
+}  // namespace net
+}  // namespace libz
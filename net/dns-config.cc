@@ -0,0 +1,192 @@
+#include "dns-config.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+namespace libz {
+namespace net {
+
+namespace {
+
+constexpr std::uint16_t kDnsPort = 53;
+
+// the resolver(3) limitations
+constexpr std::size_t kMaxNameServers = 3;
+constexpr int kMaxNdots = 15;
+constexpr int kMaxAttempts = 5;
+constexpr int kMaxTimeout = 30;
+
+std::vector<std::string_view> SplitFields(std::string_view line) {
+  std::vector<std::string_view> fields;
+
+  if (auto comment = line.find_first_of("#;"); comment != line.npos) {
+    line = line.substr(0, comment);
+  }
+
+  std::size_t pos = 0;
+  while (pos < line.size()) {
+    pos = line.find_first_not_of(" \t\r", pos);
+    if (pos == line.npos) {
+      break;
+    }
+    auto end = line.find_first_of(" \t\r", pos);
+    if (end == line.npos) {
+      end = line.size();
+    }
+    fields.push_back(line.substr(pos, end - pos));
+    pos = end;
+  }
+
+  return fields;
+}
+
+template <typename F>
+void ForEachLine(std::string_view content, F&& f) {
+  while (!content.empty()) {
+    auto end = content.find('\n');
+    f(content.substr(0, end));
+    if (end == content.npos) {
+      break;
+    }
+    content.remove_prefix(end + 1);
+  }
+}
+
+bool ParseOption(std::string_view option, std::string_view name, int max,
+                 int* value) {
+  if (option.size() <= name.size() + 1 ||
+      option.substr(0, name.size()) != name || option[name.size()] != ':') {
+    return false;
+  }
+
+  option.remove_prefix(name.size() + 1);
+
+  int v = 0;
+  auto [_, ec] =
+      std::from_chars(option.data(), option.data() + option.size(), v);
+  if (ec != std::errc{}) {
+    return false;
+  }
+
+  *value = std::clamp(v, 0, max);
+  return true;
+}
+
+std::string Lower(std::string_view s) {
+  std::string result(s);
+  std::transform(result.begin(), result.end(), result.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (!result.empty() && result.back() == '.') {
+    result.pop_back();
+  }
+  return result;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    return {};
+  }
+
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+}  // namespace
+
+DnsConfig DnsConfig::Parse(std::string_view content) {
+  DnsConfig config;
+
+  ForEachLine(content, [&config](std::string_view line) {
+    auto fields = SplitFields(line);
+    if (fields.size() < 2) {
+      return;
+    }
+
+    if (fields[0] == "nameserver") {
+      asio::error_code ec;
+      auto addr = asio::ip::make_address(std::string(fields[1]), ec);
+      if (!ec && config.nameservers.size() < kMaxNameServers) {
+        config.nameservers.emplace_back(addr, kDnsPort);
+      }
+    } else if (fields[0] == "search" || fields[0] == "domain") {
+      // the last one wins
+      config.search.clear();
+      for (std::size_t i = 1; i < fields.size(); ++i) {
+        config.search.push_back(Lower(fields[i]));
+      }
+    } else if (fields[0] == "options") {
+      for (std::size_t i = 1; i < fields.size(); ++i) {
+        int v;
+        if (ParseOption(fields[i], "ndots", kMaxNdots, &v)) {
+          config.ndots = v;
+        } else if (ParseOption(fields[i], "attempts", kMaxAttempts, &v)) {
+          config.attempts = std::max(v, 1);
+        } else if (ParseOption(fields[i], "timeout", kMaxTimeout, &v)) {
+          config.timeout = Seconds(std::max(v, 1));
+        } else if (fields[i] == "rotate") {
+          config.rotate = true;
+        }
+      }
+    }
+  });
+
+  return config;
+}
+
+DnsConfig DnsConfig::Load(const std::string& path) {
+  auto config = Parse(ReadFile(path));
+
+  // the same default as glibc
+  if (config.nameservers.empty()) {
+    config.nameservers.emplace_back(asio::ip::address_v4::loopback(),
+                                    kDnsPort);
+  }
+
+  return config;
+}
+
+HostsFile HostsFile::Parse(std::string_view content) {
+  HostsFile hosts;
+
+  ForEachLine(content, [&hosts](std::string_view line) {
+    auto fields = SplitFields(line);
+    for (std::size_t i = 1; i < fields.size(); ++i) {
+      hosts.Add(fields[i], fields[0]);
+    }
+  });
+
+  return hosts;
+}
+
+HostsFile HostsFile::Load(const std::string& path) {
+  return Parse(ReadFile(path));
+}
+
+const IPAddressList* HostsFile::Find(std::string_view host) const {
+  if (auto itr = hosts_.find(Lower(host)); itr != hosts_.end()) {
+    return &itr->second;
+  }
+  return nullptr;
+}
+
+void HostsFile::Add(std::string_view host, std::string_view address) {
+  asio::error_code ec;
+  auto addr = asio::ip::make_address(std::string(address), ec);
+  if (ec) {
+    return;
+  }
+
+  auto& list = hosts_[Lower(host)];
+  auto ip = addr.to_string();
+  if (std::find(list.begin(), list.end(), ip) == list.end()) {
+    list.push_back(std::move(ip));
+  }
+}
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <base/common.h>
+
+#include <asio/ip/udp.hpp>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "dns-cache.h"
+
+namespace libz {
+namespace net {
+
+// DnsConfig is the parsed resolv.conf(5). only the directives which matter for
+// a stub resolver are recognized, the others are ignored silently
+struct DnsConfig {
+  std::vector<asio::ip::udp::endpoint> nameservers;
+  std::vector<std::string> search;
+
+  int ndots{1};
+  int attempts{2};
+  MilliSeconds timeout{MilliSeconds(5000)};
+  bool rotate{false};
+
+  static DnsConfig Parse(std::string_view content);
+  static DnsConfig Load(const std::string& path = "/etc/resolv.conf");
+};
+
+// HostsFile is the parsed hosts(5)
+class HostsFile {
+ public:
+  HostsFile() = default;
+
+  HostsFile(HostsFile&&) = default;
+  HostsFile(const HostsFile&) = default;
+  HostsFile& operator=(HostsFile&&) = default;
+  HostsFile& operator=(const HostsFile&) = default;
+
+  static HostsFile Parse(std::string_view content);
+  static HostsFile Load(const std::string& path = "/etc/hosts");
+
+  // the host is matched case-insensitively
+  const IPAddressList* Find(std::string_view host) const;
+
+  void Add(std::string_view host, std::string_view address);
+
+  std::size_t size() const { return hosts_.size(); }
+
+ private:
+  std::unordered_map<std::string, IPAddressList> hosts_;
+};
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,351 @@
+#include "dns-message.h"
+
+#include <arpa/inet.h>
+
+#include <cctype>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+namespace {
+
+constexpr std::size_t kHeaderSize = 12;
+constexpr std::size_t kMaxNameLength = 255;
+constexpr std::size_t kMaxLabelLength = 63;
+constexpr int kMaxCompressionJumps = 16;
+
+std::string_view TrimDot(std::string_view name) {
+  if (!name.empty() && name.back() == '.') {
+    name.remove_suffix(1);
+  }
+  return name;
+}
+
+void PutU16(std::string* out, std::uint16_t v) {
+  out->push_back(static_cast<char>(v >> 8));
+  out->push_back(static_cast<char>(v & 0xff));
+}
+
+void PutU32(std::string* out, std::uint32_t v) {
+  PutU16(out, static_cast<std::uint16_t>(v >> 16));
+  PutU16(out, static_cast<std::uint16_t>(v & 0xffff));
+}
+
+Error PutName(std::string* out, std::string_view name) {
+  name = TrimDot(name);
+  if (name.size() > kMaxNameLength) {
+    return Err(kErrorDnsMalformed, "name too long: {}", name);
+  }
+
+  while (!name.empty()) {
+    auto dot = name.find('.');
+    auto label = name.substr(0, dot);
+    if (label.empty() || label.size() > kMaxLabelLength) {
+      return Err(kErrorDnsMalformed, "invalid label: {}", name);
+    }
+
+    out->push_back(static_cast<char>(label.size()));
+    out->append(label);
+
+    if (dot == std::string_view::npos) {
+      break;
+    }
+    name.remove_prefix(dot + 1);
+  }
+
+  out->push_back('\0');
+  return {};
+}
+
+class Reader {
+ public:
+  explicit Reader(std::string_view packet) : packet_(packet), pos_(0) {}
+
+  bool U8(std::uint8_t* v) {
+    if (pos_ + 1 > packet_.size()) return false;
+    *v = static_cast<std::uint8_t>(packet_[pos_++]);
+    return true;
+  }
+
+  bool U16(std::uint16_t* v) {
+    if (pos_ + 2 > packet_.size()) return false;
+    *v = static_cast<std::uint16_t>(
+        (static_cast<std::uint8_t>(packet_[pos_]) << 8) |
+        static_cast<std::uint8_t>(packet_[pos_ + 1]));
+    pos_ += 2;
+    return true;
+  }
+
+  bool U32(std::uint32_t* v) {
+    std::uint16_t hi, lo;
+    if (!U16(&hi) || !U16(&lo)) return false;
+    *v = (static_cast<std::uint32_t>(hi) << 16) | lo;
+    return true;
+  }
+
+  bool Bytes(std::size_t n, std::string_view* v) {
+    if (pos_ + n > packet_.size()) return false;
+    *v = packet_.substr(pos_, n);
+    pos_ += n;
+    return true;
+  }
+
+  // decode a possibly compressed name starting at current position
+  bool Name(std::string* name) {
+    name->clear();
+
+    auto pos = pos_;
+    bool jumped = false;
+    int jumps = 0;
+
+    for (;;) {
+      if (pos >= packet_.size()) return false;
+      auto len = static_cast<std::uint8_t>(packet_[pos]);
+
+      if ((len & 0xc0) == 0xc0) {
+        if (pos + 2 > packet_.size() || ++jumps > kMaxCompressionJumps) {
+          return false;
+        }
+
+        auto target = static_cast<std::size_t>(
+            ((len & 0x3f) << 8) | static_cast<std::uint8_t>(packet_[pos + 1]));
+        if (!jumped) {
+          pos_ = pos + 2;
+          jumped = true;
+        }
+        pos = target;
+        continue;
+      }
+
+      if (len & 0xc0) return false;
+
+      ++pos;
+      if (len == 0) break;
+      if (pos + len > packet_.size()) return false;
+
+      if (!name->empty()) name->push_back('.');
+      name->append(packet_.substr(pos, len));
+      if (name->size() > kMaxNameLength) return false;
+
+      pos += len;
+    }
+
+    if (!jumped) {
+      pos_ = pos;
+    }
+    return true;
+  }
+
+  std::size_t pos() const { return pos_; }
+  void set_pos(std::size_t pos) { pos_ = pos; }
+
+ private:
+  std::string_view packet_;
+  std::size_t pos_;
+};
+
+bool ReadRecord(Reader* reader, DnsRecord* record) {
+  std::uint16_t type, rdlength;
+  if (!reader->Name(&record->name) || !reader->U16(&type) ||
+      !reader->U16(&record->klass) || !reader->U32(&record->ttl) ||
+      !reader->U16(&rdlength)) {
+    return false;
+  }
+  record->type = static_cast<DnsType>(type);
+
+  auto rdata_pos = reader->pos();
+  std::string_view rdata;
+  if (!reader->Bytes(rdlength, &rdata)) {
+    return false;
+  }
+
+  char buf[INET6_ADDRSTRLEN];
+  switch (record->type) {
+    case DnsType::kA:
+      if (rdlength != 4 ||
+          !::inet_ntop(AF_INET, rdata.data(), buf, sizeof(buf))) {
+        return false;
+      }
+      record->data = buf;
+      break;
+
+    case DnsType::kAAAA:
+      if (rdlength != 16 ||
+          !::inet_ntop(AF_INET6, rdata.data(), buf, sizeof(buf))) {
+        return false;
+      }
+      record->data = buf;
+      break;
+
+    case DnsType::kCNAME:
+    case DnsType::kNS:
+    case DnsType::kPTR: {
+      auto end = reader->pos();
+      reader->set_pos(rdata_pos);
+      if (!reader->Name(&record->data)) {
+        return false;
+      }
+      reader->set_pos(end);
+      break;
+    }
+
+    default:
+      record->data.assign(rdata);
+      break;
+  }
+
+  return true;
+}
+
+Error PutRecord(std::string* out, const DnsRecord& record) {
+  if (auto e = PutName(out, record.name); e) {
+    return e;
+  }
+
+  PutU16(out, static_cast<std::uint16_t>(record.type));
+  PutU16(out, record.klass);
+  PutU32(out, record.ttl);
+
+  std::string rdata;
+  switch (record.type) {
+    case DnsType::kA:
+    case DnsType::kAAAA: {
+      auto af = record.type == DnsType::kA ? AF_INET : AF_INET6;
+      char buf[16];
+      if (::inet_pton(af, record.data.c_str(), buf) != 1) {
+        return Err(kErrorDnsMalformed, "invalid address: {}", record.data);
+      }
+      rdata.assign(buf, af == AF_INET ? 4 : 16);
+      break;
+    }
+
+    case DnsType::kCNAME:
+    case DnsType::kNS:
+    case DnsType::kPTR:
+      if (auto e = PutName(&rdata, record.data); e) {
+        return e;
+      }
+      break;
+
+    default:
+      rdata = record.data;
+      break;
+  }
+
+  PutU16(out, static_cast<std::uint16_t>(rdata.size()));
+  out->append(rdata);
+  return {};
+}
+
+}  // namespace
+
+bool DnsNameEqual(std::string_view a, std::string_view b) {
+  a = TrimDot(a);
+  b = TrimDot(b);
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Result<std::string> EncodeDnsQuery(std::uint16_t id, std::string_view name,
+                                   DnsType type) {
+  DnsMessage msg;
+  msg.header.id = id;
+  msg.header.flags = DnsHeader::kRD;
+  msg.questions.push_back(DnsQuestion{std::string(name), type, 1});
+
+  return EncodeDnsMessage(msg);
+}
+
+Result<std::string> EncodeDnsMessage(const DnsMessage& msg) {
+  std::string out;
+  out.reserve(512);
+
+  PutU16(&out, msg.header.id);
+  PutU16(&out, msg.header.flags);
+  PutU16(&out, static_cast<std::uint16_t>(msg.questions.size()));
+  PutU16(&out, static_cast<std::uint16_t>(msg.answers.size()));
+  PutU16(&out, static_cast<std::uint16_t>(msg.authorities.size()));
+  PutU16(&out, static_cast<std::uint16_t>(msg.additionals.size()));
+
+  for (const auto& q : msg.questions) {
+    if (auto e = PutName(&out, q.name); e) {
+      return e;
+    }
+    PutU16(&out, static_cast<std::uint16_t>(q.type));
+    PutU16(&out, q.klass);
+  }
+
+  for (const auto* records :
+       {&msg.answers, &msg.authorities, &msg.additionals}) {
+    for (const auto& record : *records) {
+      if (auto e = PutRecord(&out, record); e) {
+        return e;
+      }
+    }
+  }
+
+  return out;
+}
+
+Result<DnsMessage> DecodeDnsMessage(std::string_view packet) {
+  if (packet.size() < kHeaderSize) {
+    return Err(kErrorDnsMalformed, "short packet: {}", packet.size());
+  }
+
+  DnsMessage msg;
+  Reader reader(packet);
+
+  std::uint16_t qdcount, ancount, nscount, arcount;
+  reader.U16(&msg.header.id);
+  reader.U16(&msg.header.flags);
+  reader.U16(&qdcount);
+  reader.U16(&ancount);
+  reader.U16(&nscount);
+  reader.U16(&arcount);
+
+  for (std::uint16_t i = 0; i < qdcount; ++i) {
+    DnsQuestion q;
+    std::uint16_t type;
+    if (!reader.Name(&q.name) || !reader.U16(&type) || !reader.U16(&q.klass)) {
+      return Err(kErrorDnsMalformed, "bad question");
+    }
+    q.type = static_cast<DnsType>(type);
+    msg.questions.push_back(std::move(q));
+  }
+
+  std::pair<std::uint16_t, std::vector<DnsRecord>*> sections[] = {
+      {ancount, &msg.answers},
+      {nscount, &msg.authorities},
+      {arcount, &msg.additionals},
+  };
+
+  for (auto& [count, records] : sections) {
+    for (std::uint16_t i = 0; i < count; ++i) {
+      DnsRecord record;
+      if (!ReadRecord(&reader, &record)) {
+        // a truncated response may be cut in the middle of a record
+        if (msg.header.IsTruncated()) {
+          return msg;
+        }
+        return Err(kErrorDnsMalformed, "bad record");
+      }
+      records->push_back(std::move(record));
+    }
+  }
+
+  return msg;
+}
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/result.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+// the subset of rfc1035 used by a stub resolver
+enum class DnsType : std::uint16_t {
+  kA = 1,
+  kNS = 2,
+  kCNAME = 5,
+  kSOA = 6,
+  kPTR = 12,
+  kTXT = 16,
+  kAAAA = 28,
+};
+
+enum class DnsRcode : std::uint8_t {
+  kNoError = 0,
+  kFormErr = 1,
+  kServFail = 2,
+  kNXDomain = 3,
+  kNotImp = 4,
+  kRefused = 5,
+};
+
+struct DnsHeader {
+  static constexpr std::uint16_t kQR = 0x8000;
+  static constexpr std::uint16_t kTC = 0x0200;
+  static constexpr std::uint16_t kRD = 0x0100;
+  static constexpr std::uint16_t kRA = 0x0080;
+
+  std::uint16_t id{0};
+  std::uint16_t flags{0};
+
+  bool IsResponse() const { return flags & kQR; }
+  bool IsTruncated() const { return flags & kTC; }
+  DnsRcode rcode() const { return static_cast<DnsRcode>(flags & 0x000f); }
+  void set_rcode(DnsRcode rcode) {
+    flags = (flags & 0xfff0) | static_cast<std::uint16_t>(rcode);
+  }
+};
+
+struct DnsQuestion {
+  std::string name;
+  DnsType type{DnsType::kA};
+  std::uint16_t klass{1};
+};
+
+struct DnsRecord {
+  std::string name;
+  DnsType type{DnsType::kA};
+  std::uint16_t klass{1};
+  std::uint32_t ttl{0};
+
+  // A/AAAA: the textual address
+  // CNAME/NS/PTR: the uncompressed domain name
+  // others: the raw rdata
+  std::string data;
+};
+
+struct DnsMessage {
+  DnsHeader header;
+  std::vector<DnsQuestion> questions;
+  std::vector<DnsRecord> answers;
+  std::vector<DnsRecord> authorities;
+  std::vector<DnsRecord> additionals;
+};
+
+// the names are compared case-insensitively, and the trailing dot is ignored
+bool DnsNameEqual(std::string_view a, std::string_view b);
+
+Result<std::string> EncodeDnsQuery(std::uint16_t id, std::string_view name,
+                                   DnsType type);
+
+// names are never compressed in the encoded message
+Result<std::string> EncodeDnsMessage(const DnsMessage& msg);
+
+Result<DnsMessage> DecodeDnsMessage(std::string_view packet);
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,187 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "grpc-bridge.h"
+
+#include <event/io-message-loop.h>
+#include <grpcpp/alarm.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+// the tag of an alarm, it invokes the handler on completion
+class AlarmTag : public GrpcTag {
+ public:
+  explicit AlarmTag(std::function<void(bool)>&& handler)
+      : handler_(std::move(handler)) {}
+
+  void Proceed(bool ok) override { handler_(ok); }
+
+  grpc::Alarm* alarm() { return &alarm_; }
+
+ private:
+  std::function<void(bool)> handler_;
+  grpc::Alarm alarm_;
+};
+
+CATCH_TEST_CASE("tags are batched into the loop", "[grpc-bridge]") {
+  event::IOMessageLoop loop;
+  GrpcCompletionQueueBridge bridge(&loop);
+  bridge.Start();
+
+  constexpr int kNum = 1000;
+  int completed = 0;
+  int failed = 0;
+  bool on_loop = true;
+  std::vector<std::unique_ptr<AlarmTag>> tags;
+
+  loop.Post([&]() {
+    // the deadline is passed, they are ready together
+    auto deadline = std::chrono::system_clock::now();
+    for (int i = 0; i < kNum; ++i) {
+      tags.push_back(std::make_unique<AlarmTag>([&](bool ok) {
+        on_loop = on_loop && loop.IsInMessageLoopThread();
+        if (!ok) {
+          ++failed;
+        }
+        if (++completed == kNum) {
+          loop.Shutdown();
+        }
+      }));
+      tags.back()->alarm()->Set(bridge.cq(), deadline, tags.back().get());
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+  bridge.Shutdown();
+
+  CATCH_REQUIRE(completed == kNum);
+  CATCH_REQUIRE(failed == 0);
+  CATCH_REQUIRE(on_loop);
+
+  const auto& stats = bridge.stats();
+  CATCH_REQUIRE(stats.tags == kNum);
+  CATCH_REQUIRE(stats.batch_size.count() == stats.batches);
+  CATCH_REQUIRE(stats.batch_size.max() <= 256);
+  CATCH_REQUIRE(stats.batches < kNum);
+}
+
+CATCH_TEST_CASE("cancelled and shut down", "[grpc-bridge]") {
+  event::IOMessageLoop loop;
+  GrpcCompletionQueueBridge bridge(&loop);
+  bridge.Start();
+
+  std::vector<bool> results;
+  AlarmTag tag([&](bool ok) {
+    results.push_back(ok);
+    loop.Shutdown();
+  });
+
+  loop.Post([&]() {
+    // the cancelled alarm is completed with !ok
+    tag.alarm()->Set(bridge.cq(),
+                     std::chrono::system_clock::now() + std::chrono::hours(1),
+                     &tag);
+    tag.alarm()->Cancel();
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+
+  CATCH_REQUIRE(results == std::vector<bool>{false});
+
+  bridge.Shutdown();
+  bridge.Shutdown();
+
+  // the bridge which is never started
+  GrpcCompletionQueueBridge idle(&loop);
+  CATCH_REQUIRE(idle.server_cq() == nullptr);
+}
+
+CATCH_TEST_CASE("a queue per loop", "[grpc-bridge]") {
+  constexpr int kLoops = 3;
+  constexpr int kNum = 100;
+
+  // the loops are made within their threads, the group is made after
+  std::vector<event::MessageLoop*> loops(kLoops, nullptr);
+  std::atomic<int> made{0};
+  std::unique_ptr<GrpcBridgeGroup> group;
+  std::atomic<bool> started{false};
+
+  std::vector<int> completed(kLoops, 0);
+  std::vector<int> strays(kLoops, 0);
+  std::vector<bool> matched(kLoops, false);
+  std::vector<std::vector<std::unique_ptr<AlarmTag>>> tags(kLoops);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kLoops; ++i) {
+    threads.emplace_back([&, i]() {
+      event::IOMessageLoop loop;
+      loops[i] = &loop;
+      ++made;
+      while (!started.load()) {
+        std::this_thread::yield();
+      }
+
+      // every loop completes its own tags only
+      loop.Post([&, i]() {
+        auto bridge = group->Current();
+        matched[i] = bridge == group->At(i);
+
+        for (int j = 0; j < kNum; ++j) {
+          tags[i].push_back(std::make_unique<AlarmTag>([&, i](bool) {
+            if (!loop.IsInMessageLoopThread()) {
+              ++strays[i];
+            }
+            if (++completed[i] == kNum) {
+              loop.Shutdown();
+            }
+          }));
+          tags[i].back()->alarm()->Set(bridge->cq(),
+                                       std::chrono::system_clock::now(),
+                                       tags[i].back().get());
+        }
+      });
+
+      auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                      Seconds(10));
+      loop.Run();
+    });
+  }
+
+  while (made.load() < kLoops) {
+    std::this_thread::yield();
+  }
+  group = std::make_unique<GrpcBridgeGroup>(loops);
+  CATCH_REQUIRE(group->size() == kLoops);
+  CATCH_REQUIRE(group->Of(loops[1]) == group->At(1));
+  CATCH_REQUIRE(group->Current() == nullptr);
+  group->Start();
+  started = true;
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  group->Shutdown();
+
+  for (int i = 0; i < kLoops; ++i) {
+    CATCH_REQUIRE(matched[i]);
+    CATCH_REQUIRE(completed[i] == kNum);
+    CATCH_REQUIRE(strays[i] == 0);
+    CATCH_REQUIRE(group->At(i)->stats().tags == kNum);
+  }
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,214 @@
+#include "grpc-bridge.h"
+
+#include <fmt/format.h>
+#include <grpc/support/time.h>
+
+namespace libz {
+namespace net {
+namespace {
+
+const char* GetStatusName(int c) {
+  switch (c) {
+    case grpc::StatusCode::OK:
+      return "ok";
+    case grpc::StatusCode::CANCELLED:
+      return "cancelled";
+    case grpc::StatusCode::UNKNOWN:
+      return "unknown";
+    case grpc::StatusCode::INVALID_ARGUMENT:
+      return "invalid argument";
+    case grpc::StatusCode::DEADLINE_EXCEEDED:
+      return "deadline exceeded";
+    case grpc::StatusCode::NOT_FOUND:
+      return "not found";
+    case grpc::StatusCode::ALREADY_EXISTS:
+      return "already exists";
+    case grpc::StatusCode::PERMISSION_DENIED:
+      return "permission denied";
+    case grpc::StatusCode::RESOURCE_EXHAUSTED:
+      return "resource exhausted";
+    case grpc::StatusCode::FAILED_PRECONDITION:
+      return "failed precondition";
+    case grpc::StatusCode::ABORTED:
+      return "aborted";
+    case grpc::StatusCode::OUT_OF_RANGE:
+      return "out of range";
+    case grpc::StatusCode::UNIMPLEMENTED:
+      return "unimplemented";
+    case grpc::StatusCode::INTERNAL:
+      return "internal";
+    case grpc::StatusCode::UNAVAILABLE:
+      return "unavailable";
+    case grpc::StatusCode::DATA_LOSS:
+      return "data loss";
+    case grpc::StatusCode::UNAUTHENTICATED:
+      return "unauthenticated";
+    default:
+      return "none";
+  }
+}
+
+struct GrpcCategory : public Error::Category {
+  const char* GetName() const override { return "grpc"; }
+  std::string GetInformation(int c) const override {
+    return fmt::format("grpc[{}]", GetStatusName(c));
+  }
+};
+
+}  // namespace
+
+const Error::Category* GrpcCat() {
+  static GrpcCategory kC;
+  return &kC;
+}
+
+Error GrpcErr(const grpc::Status& status) {
+  if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+    return Err(kErrorNetTimeout, "grpc: {}", status.error_message());
+  }
+  return Error{GrpcCat(), status.error_code(), status.error_message()};
+}
+
+grpc::Status GrpcStatus(const Error& e) {
+  if (!e) {
+    return grpc::Status::OK;
+  }
+
+  if (e.category() == GrpcCat()) {
+    return grpc::Status(static_cast<grpc::StatusCode>(e.code()),
+                        e.GetMessage());
+  }
+  if (e.category() == Cat() && e.code() == kErrorNetTimeout) {
+    return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, e.GetMessage());
+  }
+  return grpc::Status(grpc::StatusCode::INTERNAL, e.GetMessage());
+}
+
+GrpcCompletionQueueBridge::GrpcCompletionQueueBridge(event::MessageLoop* loop,
+                                                     const Options& opts)
+    : loop_(loop),
+      opts_(opts),
+      cq_(std::make_unique<grpc::CompletionQueue>()),
+      server_cq_(nullptr),
+      poller_(),
+      shutdown_(false),
+      stats_(),
+      token_(std::make_shared<GrpcCompletionQueueBridge*>(this)) {}
+
+GrpcCompletionQueueBridge::GrpcCompletionQueueBridge(
+    event::MessageLoop* loop, std::unique_ptr<grpc::ServerCompletionQueue> cq,
+    const Options& opts)
+    : loop_(loop),
+      opts_(opts),
+      cq_(),
+      server_cq_(cq.get()),
+      poller_(),
+      shutdown_(false),
+      stats_(),
+      token_(std::make_shared<GrpcCompletionQueueBridge*>(this)) {
+  cq_ = std::move(cq);
+}
+
+void GrpcCompletionQueueBridge::Start() {
+  DCHECK(!poller_);
+  poller_ = std::make_unique<std::thread>([this]() { Poll(); });
+}
+
+void GrpcCompletionQueueBridge::Shutdown() {
+  if (shutdown_.exchange(true)) {
+    return;
+  }
+
+  cq_->Shutdown();
+  if (poller_) {
+    poller_->join();
+    return;
+  }
+
+  // never started, the queue must be drained before it's destroyed
+  void* tag;
+  bool ok;
+  while (cq_->Next(&tag, &ok)) {
+  }
+}
+
+void GrpcCompletionQueueBridge::Poll() {
+  std::vector<Event> batch;
+  batch.reserve(opts_.max_batch);
+
+  void* tag;
+  bool ok;
+  while (cq_->Next(&tag, &ok)) {
+    batch.push_back({tag, ok});
+
+    // the rest which are ready, they are handed to the loop together
+    while (batch.size() < opts_.max_batch &&
+           cq_->AsyncNext(&tag, &ok, gpr_time_0(GPR_CLOCK_MONOTONIC)) ==
+               grpc::CompletionQueue::GOT_EVENT) {
+      batch.push_back({tag, ok});
+    }
+
+    loop_->remote_executor()->Post(
+        [token = std::weak_ptr<GrpcCompletionQueueBridge*>(token_),
+         batch = std::move(batch)]() { Deliver(token, batch); });
+    batch = std::vector<Event>();
+    batch.reserve(opts_.max_batch);
+  }
+}
+
+void GrpcCompletionQueueBridge::Deliver(
+    const std::weak_ptr<GrpcCompletionQueueBridge*>& token,
+    const std::vector<Event>& batch) {
+  // the tags are completed even if the bridge is gone, they own themselves
+  if (auto self = token.lock(); self) {
+    auto& stats = (*self)->stats_;
+    stats.tags += batch.size();
+    stats.batches += 1;
+    stats.batch_size.Record(batch.size());
+  }
+
+  for (auto& event : batch) {
+    static_cast<GrpcTag*>(event.tag)->Proceed(event.ok);
+  }
+}
+
+GrpcBridgeGroup::GrpcBridgeGroup(const std::vector<event::MessageLoop*>& loops,
+                                 const Options& opts) {
+  for (auto loop : loops) {
+    bridges_.push_back(std::make_unique<GrpcCompletionQueueBridge>(loop, opts));
+  }
+}
+
+GrpcBridgeGroup::GrpcBridgeGroup(const std::vector<event::MessageLoop*>& loops,
+                                 grpc::ServerBuilder* builder,
+                                 const Options& opts) {
+  for (auto loop : loops) {
+    bridges_.push_back(std::make_unique<GrpcCompletionQueueBridge>(
+        loop, builder->AddCompletionQueue(), opts));
+  }
+}
+
+void GrpcBridgeGroup::Start() {
+  for (auto& bridge : bridges_) {
+    bridge->Start();
+  }
+}
+
+void GrpcBridgeGroup::Shutdown() {
+  for (auto& bridge : bridges_) {
+    bridge->Shutdown();
+  }
+}
+
+GrpcCompletionQueueBridge* GrpcBridgeGroup::Of(
+    const event::MessageLoop* loop) {
+  for (auto& bridge : bridges_) {
+    if (bridge->loop() == loop) {
+      return bridge.get();
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace net
+}  // namespace libz
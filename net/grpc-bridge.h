@@ -0,0 +1,162 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/histogram.h>
+#include <event/message-loop.h>
+#include <grpcpp/completion_queue.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/support/status.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+// the category of the grpc status, the code is the one of grpc::StatusCode
+const Error::Category* GrpcCat();
+
+// DEADLINE_EXCEEDED is mapped to kErrorNetTimeout, the others are kept in
+// GrpcCat
+Error GrpcErr(const grpc::Status& status);
+
+// the status of the error, the reverse of GrpcErr. the errors of the other
+// categories are INTERNAL
+grpc::Status GrpcStatus(const Error& e);
+
+// GrpcTag is the tag of the async grpc operations which are driven by the
+// bridge, it's completed on the loop of the queue.
+class GrpcTag {
+ public:
+  virtual ~GrpcTag() = default;
+
+  // |ok| is the one of the completion queue
+  virtual void Proceed(bool ok) = 0;
+};
+
+// GrpcCompletionQueueBridge drives a completion queue for a loop. the poller
+// thread blocks on the queue for the first tag, drains the rest which are
+// ready by AsyncNext with the zero deadline, and hands the batch to the loop
+// in one remote post, rather than a post per tag.
+//
+// Notes, the tags must be GrpcTag. the queue should be used by one loop only,
+// so that the rpcs stay on it from start to finish. the bridge must be shut
+// down before the loop, the tags are leaked otherwise. all methods but
+// Start and Shutdown must be invoked within the loop thread
+class GrpcCompletionQueueBridge {
+ public:
+  struct Options {
+    // the most tags handed to the loop in one post
+    std::size_t max_batch{256};
+  };
+
+  struct Stats {
+    std::uint64_t tags{0};
+    std::uint64_t batches{0};
+
+    // the tags per batch
+    Histogram batch_size;
+  };
+
+  // a queue of the client
+  explicit GrpcCompletionQueueBridge(event::MessageLoop* loop)
+      : GrpcCompletionQueueBridge(loop, Options{}) {}
+  GrpcCompletionQueueBridge(event::MessageLoop* loop, const Options& opts);
+
+  // a queue of the server, which is added to the builder
+  GrpcCompletionQueueBridge(event::MessageLoop* loop,
+                            std::unique_ptr<grpc::ServerCompletionQueue> cq,
+                            const Options& opts);
+
+  ~GrpcCompletionQueueBridge() { Shutdown(); }
+
+ public:
+  // start the poller thread
+  void Start();
+
+  // shut the queue down, and wait for the poller to exit, after the tags
+  // left are drained. the server must be shut down before
+  void Shutdown();
+
+  event::MessageLoop* loop() const { return loop_; }
+  grpc::CompletionQueue* cq() const { return cq_.get(); }
+
+  // nullptr if it's the queue of the client
+  grpc::ServerCompletionQueue* server_cq() const { return server_cq_; }
+
+  // the stats are updated within the loop thread
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Event {
+    void* tag;
+    bool ok;
+  };
+
+  void Poll();
+  static void Deliver(const std::weak_ptr<GrpcCompletionQueueBridge*>& token,
+                      const std::vector<Event>& batch);
+
+  event::MessageLoop* loop_;
+  Options opts_;
+
+  std::unique_ptr<grpc::CompletionQueue> cq_;
+  grpc::ServerCompletionQueue* server_cq_;
+
+  std::unique_ptr<std::thread> poller_;
+  std::atomic<bool> shutdown_;
+
+  Stats stats_;
+
+  // the batches posted to the loop hold it weakly
+  std::shared_ptr<GrpcCompletionQueueBridge*> token_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcCompletionQueueBridge);
+};
+
+// GrpcBridgeGroup is the bridges of the loops, one queue per loop, eg. the
+// loops of an IOThreadPool, so that an rpc started on a loop is completed on
+// the same loop and core, and no queue is shared by the loops.
+class GrpcBridgeGroup {
+ public:
+  using Options = GrpcCompletionQueueBridge::Options;
+
+  // the queues of the client
+  explicit GrpcBridgeGroup(const std::vector<event::MessageLoop*>& loops)
+      : GrpcBridgeGroup(loops, Options{}) {}
+  GrpcBridgeGroup(const std::vector<event::MessageLoop*>& loops,
+                  const Options& opts);
+
+  // the queues of the server, they are added to |builder|, which must be
+  // built before Start
+  GrpcBridgeGroup(const std::vector<event::MessageLoop*>& loops,
+                  grpc::ServerBuilder* builder, const Options& opts);
+
+ public:
+  void Start();
+  void Shutdown();
+
+  GrpcCompletionQueueBridge* At(std::size_t i) { return bridges_[i].get(); }
+  std::size_t size() const { return bridges_.size(); }
+
+  // the bridge of |loop|, nullptr if it's not in the group
+  GrpcCompletionQueueBridge* Of(const event::MessageLoop* loop);
+
+  // the bridge of the current loop
+  GrpcCompletionQueueBridge* Current() {
+    return Of(event::MessageLoop::Current());
+  }
+
+ private:
+  std::vector<std::unique_ptr<GrpcCompletionQueueBridge>> bridges_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcBridgeGroup);
+};
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,282 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "grpc-client.h"
+
+#include <event/coroutine.h>
+#include <event/io-message-loop.h>
+#include <google/protobuf/wrappers.pb.h>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/impl/codegen/method_handler.h>
+#include <grpcpp/impl/codegen/proto_utils.h>
+
+#include <atomic>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+using event::IOMessageLoop;
+using event::Notifier;
+using google::protobuf::StringValue;
+
+const char* kEchoMethod = "/libz.test.Echo/Echo";
+
+// the stub of an echo on StringValue, as grpc_cpp_plugin makes it
+class EchoStub {
+ public:
+  explicit EchoStub(const std::shared_ptr<grpc::ChannelInterface>& channel)
+      : channel_(channel),
+        rpcmethod_echo_(kEchoMethod, grpc::internal::RpcMethod::NORMAL_RPC,
+                        channel) {}
+
+  std::unique_ptr<grpc::ClientAsyncResponseReader<StringValue>>
+  PrepareAsyncEcho(grpc::ClientContext* context, const StringValue& request,
+                   grpc::CompletionQueue* cq) {
+    return std::unique_ptr<grpc::ClientAsyncResponseReader<StringValue>>(
+        grpc::internal::ClientAsyncResponseReaderHelper::Create<
+            StringValue, StringValue, grpc::protobuf::MessageLite,
+            grpc::protobuf::MessageLite>(channel_.get(), cq, rpcmethod_echo_,
+                                         context, request));
+  }
+
+ private:
+  std::shared_ptr<grpc::ChannelInterface> channel_;
+  const grpc::internal::RpcMethod rpcmethod_echo_;
+};
+
+// the sync service of the echo. "sleep" is replied after 500ms, and "fail"
+// is failed with NOT_FOUND
+class EchoService : public grpc::Service {
+ public:
+  EchoService() {
+    AddMethod(new grpc::internal::RpcServiceMethod(
+        kEchoMethod, grpc::internal::RpcMethod::NORMAL_RPC,
+        new grpc::internal::RpcMethodHandler<
+            EchoService, StringValue, StringValue, grpc::protobuf::MessageLite,
+            grpc::protobuf::MessageLite>(
+            [](EchoService* s, grpc::ServerContext* ctx,
+               const StringValue* req,
+               StringValue* rsp) { return s->Echo(ctx, req, rsp); },
+            this)));
+  }
+
+  grpc::Status Echo(grpc::ServerContext*, const StringValue* req,
+                    StringValue* rsp) {
+    if (req->value() == "sleep") {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    } else if (req->value() == "fail") {
+      return grpc::Status(grpc::StatusCode::NOT_FOUND, "no echo");
+    }
+    rsp->set_value(req->value());
+    return grpc::Status::OK;
+  }
+};
+
+// the echo server on the loopback, at a port picked by grpc
+class EchoServer {
+ public:
+  EchoServer() {
+    int port = 0;
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                             &port);
+    builder.RegisterService(&service_);
+    server_ = builder.BuildAndStart();
+    CATCH_REQUIRE(server_);
+    CATCH_REQUIRE(port > 0);
+    target_ = "127.0.0.1:" + std::to_string(port);
+  }
+
+  ~EchoServer() { server_->Shutdown(); }
+
+  const std::string& target() const { return target_; }
+
+ private:
+  EchoService service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::string target_;
+};
+
+CATCH_TEST_CASE("unary calls", "[grpc-client]") {
+  EchoServer server;
+  IOMessageLoop loop;
+  GrpcClient<EchoStub> client(&loop, server.target(),
+                              grpc::InsecureChannelCredentials(),
+                              GrpcClient<EchoStub>::Options{});
+  client.Start();
+
+  constexpr int kNum = 100;
+  bool done = false;
+  loop.Post([&]() {
+    [](IOMessageLoop* loop, GrpcClient<EchoStub>* client,
+       bool* done) -> Notifier {
+      // one by one, the arena is reset after every call
+      for (int i = 0; i < kNum; ++i) {
+        auto req = client->Make<StringValue>();
+        req->set_value("hello " + std::to_string(i));
+        auto r = co_await client->Call(&EchoStub::PrepareAsyncEcho, *req);
+        CATCH_REQUIRE(r);
+        auto rsp = r.PassResult();
+        CATCH_REQUIRE(rsp->value() == req->value());
+        CATCH_REQUIRE(rsp->GetArena() != nullptr);
+      }
+
+      auto req = client->Make<StringValue>();
+      req->set_value("fail");
+      auto r = co_await client->Call(&EchoStub::PrepareAsyncEcho, *req);
+      CATCH_REQUIRE(!r);
+      auto e = r.PassError();
+      CATCH_REQUIRE(e.category() == GrpcCat());
+      CATCH_REQUIRE(e.code() == grpc::StatusCode::NOT_FOUND);
+
+      *done = true;
+      loop->Shutdown();
+      co_return {};
+    }(&loop, &client, &done);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+  client.Shutdown();
+
+  CATCH_REQUIRE(done);
+  auto arena = client.arena();
+  CATCH_REQUIRE(arena->alive() == 0);
+  CATCH_REQUIRE(arena->stats().messages == 2 * (kNum + 1));
+  CATCH_REQUIRE(arena->stats().heap_messages == 0);
+  CATCH_REQUIRE(arena->stats().resets == kNum + 1);
+}
+
+CATCH_TEST_CASE("timeout", "[grpc-client]") {
+  EchoServer server;
+  IOMessageLoop loop;
+  GrpcClient<EchoStub> client(&loop, server.target(),
+                              grpc::InsecureChannelCredentials(),
+                              GrpcClient<EchoStub>::Options{});
+  client.Start();
+
+  std::vector<Error> errors;
+  std::vector<event::Promise<GrpcMessage<StringValue>>> promises;
+  loop.Post([&]() {
+    auto req = client.Make<StringValue>();
+    req->set_value("sleep");
+
+    // either the timer of the wheel or the deadline of grpc is the first
+    for (auto timeout : {MilliSeconds(50), MilliSeconds(100)}) {
+      promises.push_back(
+          client.Call(&EchoStub::PrepareAsyncEcho, *req, timeout));
+      promises.back().Then(
+          [&](Result<GrpcMessage<StringValue>>&& r) {
+            CATCH_REQUIRE(!r);
+            errors.push_back(r.PassError());
+            if (errors.size() == 2) {
+              loop.Shutdown();
+            }
+          },
+          nullptr);
+    }
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+  client.Shutdown();
+
+  CATCH_REQUIRE(errors.size() == 2);
+  for (auto& e : errors) {
+    CATCH_REQUIRE(e.category() == Cat());
+    CATCH_REQUIRE(e.code() == kErrorNetTimeout);
+  }
+  CATCH_REQUIRE(client.arena()->alive() == 0);
+}
+
+CATCH_TEST_CASE("a client per loop", "[grpc-client]") {
+  constexpr int kLoops = 3;
+  constexpr int kNum = 20;
+  EchoServer server;
+
+  std::vector<event::MessageLoop*> loops(kLoops, nullptr);
+  std::atomic<int> made{0};
+  std::unique_ptr<GrpcClientGroup<EchoStub>> group;
+  std::atomic<bool> started{false};
+
+  std::vector<int> replied(kLoops, 0);
+  std::vector<int> completed(kLoops, 0);
+  std::vector<bool> matched(kLoops, false);
+  std::vector<std::vector<event::Promise<GrpcMessage<StringValue>>>> promises(
+      kLoops);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kLoops; ++i) {
+    threads.emplace_back([&, i]() {
+      IOMessageLoop loop;
+      loops[i] = &loop;
+      ++made;
+      while (!started.load()) {
+        std::this_thread::yield();
+      }
+
+      loop.Post([&, i]() {
+        auto client = group->Current();
+        matched[i] = client == group->At(i);
+
+        for (int j = 0; j < kNum; ++j) {
+          auto req = client->Make<StringValue>();
+          req->set_value(std::to_string(i));
+          promises[i].push_back(
+              client->Call(&EchoStub::PrepareAsyncEcho, *req));
+          promises[i].back().Then(
+              [&, i](Result<GrpcMessage<StringValue>>&& r) {
+                // the reply is released within the loop
+                auto rsp = r ? r.PassResult() : GrpcMessage<StringValue>();
+                if (rsp && rsp->value() == std::to_string(i) &&
+                    loop.IsInMessageLoopThread()) {
+                  ++replied[i];
+                }
+                if (++completed[i] == kNum) {
+                  loop.Shutdown();
+                }
+              },
+              nullptr);
+        }
+      });
+
+      auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                      Seconds(10));
+      loop.Run();
+    });
+  }
+
+  while (made.load() < kLoops) {
+    std::this_thread::yield();
+  }
+  group = std::make_unique<GrpcClientGroup<EchoStub>>(
+      loops, server.target(), grpc::InsecureChannelCredentials(),
+      GrpcClientGroup<EchoStub>::Options{});
+  CATCH_REQUIRE(group->size() == kLoops);
+  CATCH_REQUIRE(group->At(0)->channel() != group->At(1)->channel());
+  group->Start();
+  started = true;
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  group->Shutdown();
+
+  for (int i = 0; i < kLoops; ++i) {
+    CATCH_REQUIRE(matched[i]);
+    CATCH_REQUIRE(replied[i] == kNum);
+    CATCH_REQUIRE(group->At(i)->arena()->alive() == 0);
+    CATCH_REQUIRE(group->At(i)->bridge()->stats().tags == kNum);
+  }
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,37 @@
+#include "grpc-client.h"
+
+namespace libz {
+namespace net {
+namespace {
+
+google::protobuf::ArenaOptions MkArenaOptions(const GrpcArena::Options& opts,
+                                              char* initial_block) {
+  google::protobuf::ArenaOptions options;
+  options.initial_block = initial_block;
+  options.initial_block_size = opts.initial_block_size;
+  options.max_block_size = opts.max_block_size;
+  return options;
+}
+
+}  // namespace
+
+GrpcArena::GrpcArena(const Options& opts)
+    : opts_(opts),
+      initial_block_(new char[opts.initial_block_size]),
+      arena_(MkArenaOptions(opts, initial_block_.get())),
+      alive_(0),
+      stats_() {}
+
+void GrpcArena::Release() {
+  DCHECK(alive_ > 0);
+  if (--alive_ > 0) {
+    return;
+  }
+
+  // the blocks but the initial one are freed
+  ++stats_.resets;
+  stats_.reset_bytes.Record(arena_.Reset());
+}
+
+}  // namespace net
+}  // namespace libz
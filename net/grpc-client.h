@@ -0,0 +1,351 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/histogram.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+#include <google/protobuf/arena.h>
+#include <grpcpp/channel.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/support/async_unary_call.h>
+#include <grpcpp/support/channel_arguments.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "basic.h"
+#include "grpc-bridge.h"
+
+namespace libz {
+namespace net {
+
+// GrpcArena is the loop local arena of the grpc messages. the arena is reset
+// once no message on it is alive, and the initial block is kept over the
+// resets, so that the messages of the calls are made without malloc in the
+// steady state.
+//
+// Notes, if the messages are alive all the time, the arena is never reset.
+// the messages are made on the heap once the arena holds more than
+// |max_bytes|, until it's reset. all methods must be invoked within the loop
+// thread
+class GrpcArena {
+ public:
+  struct Options {
+    // the block which is kept over the resets
+    std::size_t initial_block_size{64 << 10};
+    std::size_t max_block_size{1 << 20};
+    std::size_t max_bytes{16 << 20};
+  };
+
+  struct Stats {
+    std::uint64_t messages{0};
+    std::uint64_t heap_messages{0};
+    std::uint64_t resets{0};
+
+    // the bytes of the arena at the resets
+    Histogram reset_bytes;
+  };
+
+  GrpcArena() : GrpcArena(Options{}) {}
+  explicit GrpcArena(const Options& opts);
+
+ public:
+  // the message is released by GrpcMessage
+  template <typename T>
+  T* Create() {
+    if (arena_.SpaceAllocated() > opts_.max_bytes) {
+      ++stats_.heap_messages;
+      return google::protobuf::Arena::CreateMessage<T>(nullptr);
+    }
+
+    ++stats_.messages;
+    ++alive_;
+    return google::protobuf::Arena::CreateMessage<T>(&arena_);
+  }
+
+  // a message on the arena is released
+  void Release();
+
+  std::size_t alive() const { return alive_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  Options opts_;
+  std::unique_ptr<char[]> initial_block_;
+  google::protobuf::Arena arena_;
+  std::size_t alive_;
+  Stats stats_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcArena);
+};
+
+// GrpcMessage holds a message made by GrpcArena, it's released to the arena,
+// or deleted if it's on the heap, when the holder is destroyed. it must be
+// destroyed within the loop thread of the arena
+template <typename T>
+class GrpcMessage {
+ public:
+  GrpcMessage() : arena_(nullptr), msg_(nullptr) {}
+  explicit GrpcMessage(GrpcArena* arena)
+      : arena_(arena), msg_(arena->Create<T>()) {}
+
+  GrpcMessage(GrpcMessage&& other)
+      : arena_(other.arena_), msg_(other.msg_) {
+    other.msg_ = nullptr;
+  }
+
+  GrpcMessage& operator=(GrpcMessage&& other) {
+    if (this != &other) {
+      Reset();
+      arena_ = other.arena_;
+      msg_ = other.msg_;
+      other.msg_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~GrpcMessage() { Reset(); }
+
+ public:
+  T* get() const { return msg_; }
+  T* operator->() const { return msg_; }
+  T& operator*() const { return *msg_; }
+  explicit operator bool() const { return msg_ != nullptr; }
+
+ private:
+  void Reset() {
+    if (!msg_) {
+      return;
+    }
+
+    if (msg_->GetArena()) {
+      arena_->Release();
+    } else {
+      delete msg_;
+    }
+    msg_ = nullptr;
+  }
+
+  GrpcArena* arena_;
+  T* msg_;
+
+  DISALLOW_COPY_AND_ASSIGN(GrpcMessage);
+};
+
+// the PrepareAsync method of the unary call of the stub
+template <typename Stub, typename Req, typename Rsp>
+using GrpcUnaryMethod =
+    std::unique_ptr<grpc::ClientAsyncResponseReader<Rsp>> (Stub::*)(
+        grpc::ClientContext*, const Req&, grpc::CompletionQueue*);
+
+// GrpcUnaryCall is the unary call of the async stub, which is completed by
+// the bridge of the loop, the promise is resolved with the response on the
+// arena of the loop. |method| is the PrepareAsync method of the stub, eg.
+// &Greeter::Stub::PrepareAsyncSayHello.
+//
+// the timeout is sent to the server as the deadline of the call, and it's
+// also a timer on the wheel of the loop, which cancels the call once it's
+// fired. either way, the promise is rejected with kErrorNetTimeout.
+//
+// Notes, the request is serialized when the call is started, it's not held
+// by the call. Start must be invoked within the loop thread of the bridge
+template <typename Stub, typename Req, typename Rsp>
+class GrpcUnaryCall : public GrpcTag {
+ public:
+  using Method = GrpcUnaryMethod<Stub, Req, Rsp>;
+
+  static event::Promise<GrpcMessage<Rsp>> Start(
+      Stub* stub, Method method, const Req& req,
+      GrpcCompletionQueueBridge* bridge, GrpcArena* arena,
+      std::optional<MilliSeconds> timeout) {
+    event::Promise<GrpcMessage<Rsp>> p;
+    auto call = new GrpcUnaryCall(p.GetResolver(), arena);
+
+    auto loop = bridge->loop();
+    if (timeout) {
+      call->context_.set_deadline(loop->WallNow() + *timeout);
+      call->timer_ = loop->AddTimerEvent(
+          [call](Error&& e) {
+            if (!e) {
+              call->timed_out_ = true;
+              call->context_.TryCancel();
+            }
+          },
+          *timeout);
+    }
+
+    call->reader_ = (stub->*method)(&call->context_, req, bridge->cq());
+    call->reader_->StartCall();
+    call->reader_->Finish(call->rsp_.get(), &call->status_, call);
+    return p;
+  }
+
+  void Proceed(bool) override {
+    if (status_.ok()) {
+      resolver_.Resolve(std::move(rsp_));
+    } else if (timed_out_) {
+      resolver_.Reject(Err(kErrorNetTimeout, "grpc call timeout"));
+    } else {
+      resolver_.Reject(GrpcErr(status_));
+    }
+    delete this;
+  }
+
+ private:
+  using Resolver = typename event::Promise<GrpcMessage<Rsp>>::ResolverType;
+
+  GrpcUnaryCall(Resolver&& resolver, GrpcArena* arena)
+      : resolver_(std::move(resolver)),
+        context_(),
+        rsp_(arena),
+        status_(),
+        reader_(),
+        timer_(),
+        timed_out_(false) {}
+
+  Resolver resolver_;
+
+  grpc::ClientContext context_;
+  GrpcMessage<Rsp> rsp_;
+  grpc::Status status_;
+  std::unique_ptr<grpc::ClientAsyncResponseReader<Rsp>> reader_;
+
+  event::TimerToken timer_;
+  bool timed_out_;
+};
+
+// GrpcClient is the loop local client of a service, it has its own channel,
+// completion queue and arena, so that nothing is shared by the loops. the
+// channel uses the local subchannel pool, that is, the connections of the
+// loops are apart as well.
+//
+// Notes, the calls must be finished before Shutdown, they're bounded by the
+// timeout. all methods but Start and Shutdown must be invoked within the
+// loop thread
+template <typename Stub>
+class GrpcClient {
+ public:
+  struct Options {
+    // the timeout of the calls, std::nullopt for no deadline
+    std::optional<MilliSeconds> timeout{MilliSeconds(1000)};
+
+    GrpcArena::Options arena;
+    GrpcCompletionQueueBridge::Options bridge;
+  };
+
+  GrpcClient(event::MessageLoop* loop, const std::string& target,
+             const std::shared_ptr<grpc::ChannelCredentials>& creds,
+             const Options& opts)
+      : opts_(opts),
+        channel_(MkChannel(target, creds)),
+        stub_(std::make_unique<Stub>(channel_)),
+        bridge_(loop, opts.bridge),
+        arena_(opts.arena) {}
+
+ public:
+  void Start() { bridge_.Start(); }
+  void Shutdown() { bridge_.Shutdown(); }
+
+  // the message on the arena of the loop, eg. the request
+  template <typename T>
+  GrpcMessage<T> Make() {
+    return GrpcMessage<T>(&arena_);
+  }
+
+  template <typename Req, typename Rsp>
+  event::Promise<GrpcMessage<Rsp>> Call(GrpcUnaryMethod<Stub, Req, Rsp> method,
+                                        const Req& req) {
+    return Call(method, req, opts_.timeout);
+  }
+
+  template <typename Req, typename Rsp>
+  event::Promise<GrpcMessage<Rsp>> Call(GrpcUnaryMethod<Stub, Req, Rsp> method,
+                                        const Req& req,
+                                        std::optional<MilliSeconds> timeout) {
+    return GrpcUnaryCall<Stub, Req, Rsp>::Start(stub_.get(), method, req,
+                                                &bridge_, &arena_, timeout);
+  }
+
+  event::MessageLoop* loop() const { return bridge_.loop(); }
+  const std::shared_ptr<grpc::Channel>& channel() const { return channel_; }
+  Stub* stub() const { return stub_.get(); }
+  GrpcArena* arena() { return &arena_; }
+  GrpcCompletionQueueBridge* bridge() { return &bridge_; }
+
+ private:
+  static std::shared_ptr<grpc::Channel> MkChannel(
+      const std::string& target,
+      const std::shared_ptr<grpc::ChannelCredentials>& creds) {
+    grpc::ChannelArguments args;
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    return grpc::CreateCustomChannel(target, creds, args);
+  }
+
+  Options opts_;
+  std::shared_ptr<grpc::Channel> channel_;
+  std::unique_ptr<Stub> stub_;
+  GrpcCompletionQueueBridge bridge_;
+  GrpcArena arena_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcClient);
+};
+
+// GrpcClientGroup is the clients of the loops, eg. the loops of an
+// IOThreadPool, the call is made by the client of the current loop
+template <typename Stub>
+class GrpcClientGroup {
+ public:
+  using Options = typename GrpcClient<Stub>::Options;
+
+  GrpcClientGroup(const std::vector<event::MessageLoop*>& loops,
+                  const std::string& target,
+                  const std::shared_ptr<grpc::ChannelCredentials>& creds,
+                  const Options& opts) {
+    for (auto loop : loops) {
+      clients_.push_back(
+          std::make_unique<GrpcClient<Stub>>(loop, target, creds, opts));
+    }
+  }
+
+ public:
+  void Start() {
+    for (auto& client : clients_) {
+      client->Start();
+    }
+  }
+
+  void Shutdown() {
+    for (auto& client : clients_) {
+      client->Shutdown();
+    }
+  }
+
+  GrpcClient<Stub>* At(std::size_t i) { return clients_[i].get(); }
+  std::size_t size() const { return clients_.size(); }
+
+  // the client of |loop|, nullptr if it's not in the group
+  GrpcClient<Stub>* Of(const event::MessageLoop* loop) {
+    for (auto& client : clients_) {
+      if (client->loop() == loop) {
+        return client.get();
+      }
+    }
+    return nullptr;
+  }
+
+  // the client of the current loop
+  GrpcClient<Stub>* Current() { return Of(event::MessageLoop::Current()); }
+
+ private:
+  std::vector<std::unique_ptr<GrpcClient<Stub>>> clients_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcClientGroup);
+};
+
+}  // namespace net
+}  // namespace libz
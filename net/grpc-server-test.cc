@@ -0,0 +1,198 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "grpc-server.h"
+
+#include <event/coroutine.h>
+#include <event/io-message-loop.h>
+#include <google/protobuf/wrappers.pb.h>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/impl/codegen/proto_utils.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grpc-client.h"
+
+namespace libz {
+namespace net {
+
+using event::IOMessageLoop;
+using event::Notifier;
+using google::protobuf::StringValue;
+
+const char* kEchoMethod = "/libz.test.Echo/Echo";
+
+// the stub and the async service of an echo on StringValue, as
+// grpc_cpp_plugin makes them
+class EchoStub {
+ public:
+  explicit EchoStub(const std::shared_ptr<grpc::ChannelInterface>& channel)
+      : channel_(channel),
+        rpcmethod_echo_(kEchoMethod, grpc::internal::RpcMethod::NORMAL_RPC,
+                        channel) {}
+
+  std::unique_ptr<grpc::ClientAsyncResponseReader<StringValue>>
+  PrepareAsyncEcho(grpc::ClientContext* context, const StringValue& request,
+                   grpc::CompletionQueue* cq) {
+    return std::unique_ptr<grpc::ClientAsyncResponseReader<StringValue>>(
+        grpc::internal::ClientAsyncResponseReaderHelper::Create<
+            StringValue, StringValue, grpc::protobuf::MessageLite,
+            grpc::protobuf::MessageLite>(channel_.get(), cq, rpcmethod_echo_,
+                                         context, request));
+  }
+
+ private:
+  std::shared_ptr<grpc::ChannelInterface> channel_;
+  const grpc::internal::RpcMethod rpcmethod_echo_;
+};
+
+class EchoService : public grpc::Service {
+ public:
+  EchoService() {
+    AddMethod(new grpc::internal::RpcServiceMethod(
+        kEchoMethod, grpc::internal::RpcMethod::NORMAL_RPC, nullptr));
+    MarkMethodAsync(0);
+  }
+
+  void RequestEcho(grpc::ServerContext* context, StringValue* request,
+                   grpc::ServerAsyncResponseWriter<StringValue>* response,
+                   grpc::CompletionQueue* new_call_cq,
+                   grpc::ServerCompletionQueue* notification_cq, void* tag) {
+    RequestAsyncUnary(0, context, request, response, new_call_cq,
+                      notification_cq, tag);
+  }
+};
+
+using EchoPool = GrpcSessionPool<EchoService, StringValue, StringValue>;
+using EchoMethod = GrpcServerMethod<EchoService, StringValue, StringValue>;
+
+constexpr int kNum = 50;
+constexpr int kConcurrent = 32;
+
+// "fail" is failed with NOT_FOUND, "late" is failed by the timeout error,
+// and the others are echoed, the replies are made on the arena
+Notifier Echo(grpc::ServerContext*, const StringValue* req, StringValue* rsp) {
+  if (req->value() == "fail") {
+    co_return Error{GrpcCat(), grpc::StatusCode::NOT_FOUND, "no echo"};
+  } else if (req->value() == "late") {
+    co_return Err(kErrorNetTimeout, "too late");
+  }
+
+  CATCH_REQUIRE(rsp->GetArena() != nullptr);
+  CATCH_REQUIRE(rsp->GetArena() == req->GetArena());
+  rsp->set_value(req->value());
+  co_return {};
+}
+
+// the calls one by one, and then together
+Notifier Call(GrpcClient<EchoStub>* client, EchoPool* pool) {
+  // one by one, the sessions are taken from the free list
+  for (int i = 0; i < kNum; ++i) {
+    auto req = client->Make<StringValue>();
+    req->set_value("hello " + std::to_string(i));
+    auto r = co_await client->Call(&EchoStub::PrepareAsyncEcho, *req);
+    CATCH_REQUIRE(r);
+    CATCH_REQUIRE(r.GetResult()->value() == req->value());
+  }
+  CATCH_REQUIRE(pool->posted() == 4);
+  CATCH_REQUIRE(pool->stats().sessions <= 4 + 2);
+
+  // together, more sessions are made than the backlog
+  std::vector<event::Promise<GrpcMessage<StringValue>>> promises;
+  auto req = client->Make<StringValue>();
+  req->set_value("together");
+  for (int i = 0; i < kConcurrent; ++i) {
+    promises.push_back(client->Call(&EchoStub::PrepareAsyncEcho, *req));
+  }
+  for (auto& p : promises) {
+    auto r = co_await p;
+    CATCH_REQUIRE(r);
+    CATCH_REQUIRE(r.GetResult()->value() == "together");
+  }
+
+  req->set_value("fail");
+  auto r = co_await client->Call(&EchoStub::PrepareAsyncEcho, *req);
+  CATCH_REQUIRE(!r);
+  CATCH_REQUIRE(r.GetError().category() == GrpcCat());
+  CATCH_REQUIRE(r.GetError().code() == grpc::StatusCode::NOT_FOUND);
+
+  req->set_value("late");
+  r = co_await client->Call(&EchoStub::PrepareAsyncEcho, *req);
+  CATCH_REQUIRE(!r);
+  CATCH_REQUIRE(r.GetError().code() == kErrorNetTimeout);
+  co_return {};
+}
+
+CATCH_TEST_CASE("sessions are recycled", "[grpc-server]") {
+  IOMessageLoop loop;
+
+  EchoService service;
+  grpc::ServerBuilder builder;
+  int port = 0;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &port);
+  builder.RegisterService(&service);
+  GrpcBridgeGroup group({&loop}, &builder, GrpcBridgeGroup::Options{});
+  auto server = builder.BuildAndStart();
+  CATCH_REQUIRE(server);
+  group.Start();
+
+  EchoPool::Options opts;
+  opts.backlog = 4;
+  EchoMethod method(&service, &EchoService::RequestEcho, Echo, &group, opts);
+  CATCH_REQUIRE(method.size() == 1);
+  method.Start();
+
+  GrpcClient<EchoStub> client(&loop, "127.0.0.1:" + std::to_string(port),
+                              grpc::InsecureChannelCredentials(),
+                              GrpcClient<EchoStub>::Options{});
+  client.Start();
+
+  bool done = false;
+  std::thread closer;
+  std::optional<Notifier> calls;
+  loop.Post([&]() {
+    calls.emplace(Call(&client, method.At(0)));
+
+    calls->Then(
+        [&](Error&& e) {
+          CATCH_REQUIRE(!e);
+          done = true;
+
+          // the server is shut down out of the loop, the posted requests
+          // are dropped by the loop
+          closer = std::thread([&]() {
+            server->Shutdown();
+            group.Shutdown();
+            loop.remote_executor()->Post([&]() { loop.Shutdown(); });
+          });
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+  loop.Run();
+  if (closer.joinable()) {
+    closer.join();
+  }
+  client.Shutdown();
+
+  CATCH_REQUIRE(done);
+  auto pool = method.At(0);
+  const auto& stats = pool->stats();
+  CATCH_REQUIRE(pool->posted() == 0);
+  CATCH_REQUIRE(stats.calls == kNum + kConcurrent + 2);
+  CATCH_REQUIRE(stats.sessions + stats.reuses == stats.calls + 4);
+  CATCH_REQUIRE(stats.sessions < stats.calls);
+  CATCH_REQUIRE(pool->free() == stats.sessions - 4);
+  CATCH_REQUIRE(stats.arena_bytes.count() == stats.calls);
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/histogram.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+#include <google/protobuf/arena.h>
+#include <grpcpp/server_context.h>
+#include <grpcpp/support/async_unary_call.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "grpc-bridge.h"
+
+namespace libz {
+namespace net {
+
+template <typename Service, typename Req, typename Rsp>
+class GrpcSessionPool;
+
+// GrpcServerSession is the session of a unary method, it's recycled by the
+// pool once the call is finished. the context and the responder are made
+// per call, since grpc can't reuse them, while the request and the response
+// are on the arena of the session, which is reset on the recycling and
+// keeps its initial block, so that the messages are made without malloc.
+template <typename Service, typename Req, typename Rsp>
+class GrpcServerSession : public GrpcTag {
+ public:
+  using Pool = GrpcSessionPool<Service, Req, Rsp>;
+
+  GrpcServerSession(Pool* pool, std::size_t arena_block_size)
+      : pool_(pool),
+        state_(kRequest),
+        block_(new char[arena_block_size]),
+        arena_(MkArenaOptions(block_.get(), arena_block_size)),
+        req_(nullptr),
+        rsp_(nullptr) {}
+
+ public:
+  // post the request of the method to the queue
+  void Arm() {
+    state_ = kRequest;
+    ctx_.emplace();
+    responder_.emplace(&*ctx_);
+    req_ = google::protobuf::Arena::CreateMessage<Req>(&arena_);
+
+    auto cq = pool_->bridge()->server_cq();
+    (pool_->service()->*pool_->request())(&*ctx_, req_, &*responder_, cq, cq,
+                                          this);
+  }
+
+  void Proceed(bool ok) override {
+    if (state_ == kFinish) {
+      // !ok if the client is gone, the session is recycled either way
+      pool_->Recycle(this);
+      return;
+    }
+
+    if (!ok) {
+      // the server is shut down, the request is not posted again
+      pool_->Drop(this);
+      return;
+    }
+
+    pool_->OnRequest();
+    state_ = kProcess;
+    rsp_ = google::protobuf::Arena::CreateMessage<Rsp>(&arena_);
+    pending_ = pool_->handler()(&*ctx_, req_, rsp_);
+    pending_->Then(
+        [this](Error&& e) {
+          state_ = kFinish;
+          if (e) {
+            responder_->FinishWithError(GrpcStatus(e), this);
+          } else {
+            responder_->Finish(*rsp_, grpc::Status::OK, this);
+          }
+        },
+        nullptr);
+  }
+
+  // the bytes of the arena are returned
+  std::uint64_t Reset() {
+    pending_.reset();
+    responder_.reset();
+    ctx_.reset();
+    req_ = nullptr;
+    rsp_ = nullptr;
+    return arena_.Reset();
+  }
+
+ private:
+  enum State { kRequest = 0, kProcess, kFinish };
+
+  static google::protobuf::ArenaOptions MkArenaOptions(char* block,
+                                                       std::size_t size) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = size;
+    return options;
+  }
+
+  Pool* pool_;
+  State state_;
+
+  std::optional<grpc::ServerContext> ctx_;
+  std::optional<grpc::ServerAsyncResponseWriter<Rsp>> responder_;
+
+  std::unique_ptr<char[]> block_;
+  google::protobuf::Arena arena_;
+  Req* req_;
+  Rsp* rsp_;
+
+  // the handler is held until the session is recycled
+  std::optional<event::Notifier> pending_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcServerSession);
+};
+
+// GrpcSessionPool serves a unary method on the queue of a bridge, eg.
+// &Greeter::AsyncService::RequestSayHello. |backlog| requests are posted to
+// the queue all the time, once a call arrives, another one is posted, so
+// that the calls which arrive together don't wait for the sessions. the
+// finished sessions are kept in the free list of the pool, and they're
+// posted again rather than made.
+//
+// the handler fills the response and settles the notifier, the rejected
+// error is sent by GrpcStatus.
+//
+// Notes, the pool is loop local, the sessions are handled within the loop of
+// the bridge. the pool must be destroyed after the server and the bridge are
+// shut down, and the requests left are dropped by the loop. all methods but
+// Start must be invoked within the loop thread
+template <typename Service, typename Req, typename Rsp>
+class GrpcSessionPool {
+ public:
+  using Session = GrpcServerSession<Service, Req, Rsp>;
+  using Request = void (Service::*)(grpc::ServerContext*, Req*,
+                                    grpc::ServerAsyncResponseWriter<Rsp>*,
+                                    grpc::CompletionQueue*,
+                                    grpc::ServerCompletionQueue*, void*);
+  using Handler =
+      std::function<event::Notifier(grpc::ServerContext*, const Req*, Rsp*)>;
+
+  struct Options {
+    // the requests posted to the queue
+    std::size_t backlog{16};
+
+    // the most sessions kept in the free list
+    std::size_t max_free{1024};
+
+    // the initial block of the arena of a session
+    std::size_t arena_block_size{4096};
+  };
+
+  struct Stats {
+    std::uint64_t calls{0};
+    std::uint64_t sessions{0};
+    std::uint64_t reuses{0};
+
+    // the bytes of the arena per call
+    Histogram arena_bytes;
+  };
+
+  GrpcSessionPool(Service* service, Request request, Handler&& handler,
+                  GrpcCompletionQueueBridge* bridge, const Options& opts)
+      : service_(service),
+        request_(request),
+        handler_(std::move(handler)),
+        bridge_(bridge),
+        opts_(opts),
+        posted_(0),
+        stats_(),
+        token_(std::make_shared<GrpcSessionPool*>(this)) {}
+
+ public:
+  // post the backlog within the loop, it's thread safe
+  void Start() {
+    bridge_->loop()->remote_executor()->Post(
+        [token = std::weak_ptr<GrpcSessionPool*>(token_)]() {
+          if (auto self = token.lock(); self) {
+            (*self)->Fill();
+          }
+        });
+  }
+
+  // the requests posted, they're done once the server is shut down
+  std::size_t posted() const { return posted_; }
+  std::size_t free() const { return free_.size(); }
+  const Stats& stats() const { return stats_; }
+
+  Service* service() const { return service_; }
+  Request request() const { return request_; }
+  const Handler& handler() const { return handler_; }
+  GrpcCompletionQueueBridge* bridge() const { return bridge_; }
+
+ private:
+  friend Session;
+
+  void Fill() {
+    while (posted_ < opts_.backlog) {
+      Post();
+    }
+  }
+
+  void Post() {
+    std::unique_ptr<Session> session;
+    if (free_.empty()) {
+      ++stats_.sessions;
+      session = std::make_unique<Session>(this, opts_.arena_block_size);
+    } else {
+      ++stats_.reuses;
+      session = std::move(free_.back());
+      free_.pop_back();
+    }
+
+    ++posted_;
+    session.release()->Arm();
+  }
+
+  // a call arrives on the posted session
+  void OnRequest() {
+    --posted_;
+    ++stats_.calls;
+    Post();
+  }
+
+  void Recycle(Session* s) {
+    std::unique_ptr<Session> session(s);
+    stats_.arena_bytes.Record(session->Reset());
+    if (free_.size() < opts_.max_free) {
+      free_.push_back(std::move(session));
+    }
+  }
+
+  void Drop(Session* s) {
+    --posted_;
+    delete s;
+  }
+
+  Service* service_;
+  Request request_;
+  Handler handler_;
+  GrpcCompletionQueueBridge* bridge_;
+  Options opts_;
+
+  std::size_t posted_;
+  std::vector<std::unique_ptr<Session>> free_;
+  Stats stats_;
+
+  std::shared_ptr<GrpcSessionPool*> token_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcSessionPool);
+};
+
+// GrpcServerMethod serves a unary method on the queues of the bridge group,
+// a pool per loop, eg.
+//
+//   GrpcServerMethod<Greeter::AsyncService, HelloRequest, HelloReply> hello(
+//       &service, &Greeter::AsyncService::RequestSayHello, handler, group,
+//       {});
+//   hello.Start();
+template <typename Service, typename Req, typename Rsp>
+class GrpcServerMethod {
+ public:
+  using Pool = GrpcSessionPool<Service, Req, Rsp>;
+  using Request = typename Pool::Request;
+  using Handler = typename Pool::Handler;
+  using Options = typename Pool::Options;
+
+  GrpcServerMethod(Service* service, Request request, const Handler& handler,
+                   GrpcBridgeGroup* group, const Options& opts) {
+    for (std::size_t i = 0; i < group->size(); ++i) {
+      pools_.push_back(std::make_unique<Pool>(
+          service, request, Handler(handler), group->At(i), opts));
+    }
+  }
+
+ public:
+  void Start() {
+    for (auto& pool : pools_) {
+      pool->Start();
+    }
+  }
+
+  Pool* At(std::size_t i) { return pools_[i].get(); }
+  std::size_t size() const { return pools_.size(); }
+
+ private:
+  std::vector<std::unique_ptr<Pool>> pools_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcServerMethod);
+};
+
+}  // namespace net
+}  // namespace libz
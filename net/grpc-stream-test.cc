@@ -0,0 +1,217 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "grpc-stream.h"
+
+#include <event/io-message-loop.h>
+#include <google/protobuf/wrappers.pb.h>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/impl/codegen/proto_utils.h>
+#include <grpcpp/support/sync_stream.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+using event::IOMessageLoop;
+using event::Notifier;
+using google::protobuf::StringValue;
+
+const char* kListMethod = "/libz.test.Stream/List";
+const char* kChatMethod = "/libz.test.Stream/Chat";
+
+// the async service of a server streaming and a bidi streaming method, as
+// grpc_cpp_plugin makes them
+class StreamService : public grpc::Service {
+ public:
+  StreamService() {
+    AddMethod(new grpc::internal::RpcServiceMethod(
+        kListMethod, grpc::internal::RpcMethod::SERVER_STREAMING, nullptr));
+    AddMethod(new grpc::internal::RpcServiceMethod(
+        kChatMethod, grpc::internal::RpcMethod::BIDI_STREAMING, nullptr));
+    MarkMethodAsync(0);
+    MarkMethodAsync(1);
+  }
+
+  void RequestList(grpc::ServerContext* context, StringValue* request,
+                   grpc::ServerAsyncWriter<StringValue>* writer,
+                   grpc::CompletionQueue* new_call_cq,
+                   grpc::ServerCompletionQueue* notification_cq, void* tag) {
+    RequestAsyncServerStreaming(0, context, request, writer, new_call_cq,
+                                notification_cq, tag);
+  }
+
+  void RequestChat(
+      grpc::ServerContext* context,
+      grpc::ServerAsyncReaderWriter<StringValue, StringValue>* stream,
+      grpc::CompletionQueue* new_call_cq,
+      grpc::ServerCompletionQueue* notification_cq, void* tag) {
+    RequestAsyncBidiStreaming(1, context, stream, new_call_cq,
+                              notification_cq, tag);
+  }
+};
+
+using ListMethod =
+    GrpcServerStreamMethod<StreamService, StringValue, StringValue>;
+using ChatMethod =
+    GrpcBidiStreamMethod<StreamService, StringValue, StringValue>;
+using ChatStream = GrpcBidiStream<StringValue, StringValue>;
+
+constexpr int kNum = 200;
+
+// the numbers below the request, "fail" is failed with NOT_FOUND after a
+// message
+GrpcProducer<StringValue> List(grpc::ServerContext*, const StringValue* req) {
+  if (req->value() == "fail") {
+    StringValue msg;
+    msg.set_value("one");
+    co_yield msg;
+    co_return Error{GrpcCat(), grpc::StatusCode::NOT_FOUND, "no more"};
+  }
+
+  int n = std::stoi(req->value());
+  for (int i = 0; i < n; ++i) {
+    StringValue msg;
+    msg.set_value(std::to_string(i));
+    if (!(co_yield std::move(msg))) {
+      co_return Err(kErrorNetClosed, "stream is broken");
+    }
+  }
+  co_return {};
+}
+
+// every message is echoed, till the client is half closed
+Notifier Chat(ChatStream* stream) {
+  while (true) {
+    auto r = co_await stream->Read();
+    if (!r) {
+      CATCH_REQUIRE(r.GetError().code() == kErrorNetClosed);
+      co_return {};
+    }
+
+    auto e = co_await stream->Write(r.PassResult());
+    if (e) {
+      co_return e;
+    }
+  }
+}
+
+void ListOf(grpc::Channel* channel, const std::string& value,
+            std::vector<std::string>* msgs, grpc::Status* status) {
+  grpc::ClientContext ctx;
+  StringValue req;
+  req.set_value(value);
+  std::unique_ptr<grpc::ClientReader<StringValue>> reader(
+      grpc::internal::ClientReaderFactory<StringValue>::Create(
+          channel,
+          grpc::internal::RpcMethod(
+              kListMethod, grpc::internal::RpcMethod::SERVER_STREAMING),
+          &ctx, req));
+
+  StringValue msg;
+  while (reader->Read(&msg)) {
+    msgs->push_back(msg.value());
+  }
+  *status = reader->Finish();
+}
+
+CATCH_TEST_CASE("streams", "[grpc-stream]") {
+  IOMessageLoop loop;
+
+  StreamService service;
+  grpc::ServerBuilder builder;
+  int port = 0;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &port);
+  builder.RegisterService(&service);
+  GrpcBridgeGroup group({&loop}, &builder, GrpcBridgeGroup::Options{});
+  auto server = builder.BuildAndStart();
+  CATCH_REQUIRE(server);
+  group.Start();
+
+  // the producer waits after 2 messages are queued
+  ListMethod::Options opts;
+  opts.backlog = 2;
+  opts.max_pending_writes = 2;
+  ListMethod list(&service, &StreamService::RequestList, List, &group, opts);
+  ChatMethod chat(&service, &StreamService::RequestChat, Chat, &group,
+                  ChatMethod::Options{});
+  list.Start();
+  chat.Start();
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+
+  // the blocking clients, the server is shut down after them
+  bool done = false;
+  std::thread client([&]() {
+    auto channel = grpc::CreateChannel("127.0.0.1:" + std::to_string(port),
+                                       grpc::InsecureChannelCredentials());
+
+    std::vector<std::string> msgs;
+    grpc::Status status;
+    ListOf(channel.get(), std::to_string(kNum), &msgs, &status);
+    CATCH_REQUIRE(status.ok());
+    CATCH_REQUIRE(msgs.size() == kNum);
+    for (int i = 0; i < kNum; ++i) {
+      CATCH_REQUIRE(msgs[i] == std::to_string(i));
+    }
+
+    msgs.clear();
+    ListOf(channel.get(), "fail", &msgs, &status);
+    CATCH_REQUIRE(status.error_code() == grpc::StatusCode::NOT_FOUND);
+    CATCH_REQUIRE(msgs.size() == 1);
+    CATCH_REQUIRE(msgs[0] == "one");
+
+    grpc::ClientContext ctx;
+    std::unique_ptr<grpc::ClientReaderWriter<StringValue, StringValue>> rw(
+        grpc::internal::ClientReaderWriterFactory<
+            StringValue, StringValue>::Create(channel.get(),
+                                              grpc::internal::RpcMethod(
+                                                  kChatMethod,
+                                                  grpc::internal::RpcMethod::
+                                                      BIDI_STREAMING),
+                                              &ctx));
+    for (int i = 0; i < kNum; ++i) {
+      StringValue msg;
+      msg.set_value("hello " + std::to_string(i));
+      CATCH_REQUIRE(rw->Write(msg));
+
+      StringValue reply;
+      CATCH_REQUIRE(rw->Read(&reply));
+      CATCH_REQUIRE(reply.value() == msg.value());
+    }
+    CATCH_REQUIRE(rw->WritesDone());
+    CATCH_REQUIRE(rw->Finish().ok());
+    done = true;
+
+    server->Shutdown();
+    group.Shutdown();
+    loop.remote_executor()->Post([&]() { loop.Shutdown(); });
+  });
+
+  loop.Run();
+  client.join();
+
+  CATCH_REQUIRE(done);
+  CATCH_REQUIRE(list.posted(0) == 0);
+  CATCH_REQUIRE(chat.posted(0) == 0);
+
+  const auto& stats = list.stats(0);
+  CATCH_REQUIRE(stats.streams == 2);
+  CATCH_REQUIRE(stats.messages == kNum + 1);
+  CATCH_REQUIRE(stats.max_pending <= 2);
+  CATCH_REQUIRE(stats.waits > 0);
+  CATCH_REQUIRE(chat.stats(0).streams == 1);
+  CATCH_REQUIRE(chat.stats(0).messages == kNum);
+  CATCH_REQUIRE(chat.stats(0).max_pending <= 64);
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,617 @@
+#pragma once
+
+#include <base/common.h>
+#include <event/coroutine.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+#include <grpcpp/server_context.h>
+#include <grpcpp/support/async_stream.h>
+
+#ifdef ENABLE_CO
+
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "grpc-bridge.h"
+
+namespace libz {
+namespace net {
+
+template <typename Session>
+class GrpcStreamMethod;
+
+namespace _ {
+
+// the tag of an operation of a stream, the stream has a tag per kind of
+// operation, since the read and the write are in flight together
+template <typename S>
+class GrpcOpTag : public GrpcTag {
+ public:
+  GrpcOpTag(S* s, void (S::*fn)(bool)) : s_(s), fn_(fn) {}
+
+  void Proceed(bool ok) override { (s_->*fn_)(ok); }
+
+ private:
+  S* s_;
+  void (S::*fn_)(bool);
+};
+
+// GrpcWriteQueue is the writes of a stream. grpc allows one write in flight
+// per stream, the messages are queued behind it, and the producer waits
+// once |max_pending| messages are queued, so that the memory of a stream is
+// bounded. the status is sent after the messages queued.
+template <typename Rsp>
+class GrpcWriteQueue {
+ public:
+  using WriteFn = std::function<void(const Rsp&, void*)>;
+  using FinishFn = std::function<void(const grpc::Status&, void*)>;
+
+  GrpcWriteQueue(WriteFn&& write, FinishFn&& finish, std::size_t max_pending,
+                 std::function<void()>&& on_finished)
+      : write_(std::move(write)),
+        finish_(std::move(finish)),
+        max_pending_(max_pending),
+        on_finished_(std::move(on_finished)),
+        write_tag_(this, &GrpcWriteQueue::OnWrite),
+        finish_tag_(this, &GrpcWriteQueue::OnFinish) {}
+
+ public:
+  // false if the stream is broken, the message is dropped
+  bool Push(Rsp&& msg) {
+    if (broken_) {
+      return false;
+    }
+
+    pending_.push_back(std::move(msg));
+    ++messages_;
+    max_queued_ = std::max(max_queued_, pending_.size());
+    Kick();
+    return true;
+  }
+
+  bool full() const { return pending_.size() >= max_pending_; }
+
+  // the write failed, eg. the client is gone
+  bool broken() const { return broken_; }
+
+  // |waiter| is invoked once the queue is not full, or it's broken
+  void Wait(std::function<void()>&& waiter) {
+    ++waits_;
+    waiter_ = std::move(waiter);
+  }
+
+  // send |status| after the messages queued
+  void Finish(grpc::Status&& status) {
+    DCHECK(!finishing_);
+    finishing_ = true;
+    status_ = std::move(status);
+    Kick();
+  }
+
+  std::uint64_t messages() const { return messages_; }
+  std::uint64_t waits() const { return waits_; }
+  std::size_t max_queued() const { return max_queued_; }
+
+ private:
+  void Kick() {
+    if (writing_) {
+      return;
+    }
+
+    if (!pending_.empty()) {
+      writing_ = true;
+      write_(pending_.front(), &write_tag_);
+    } else if (finishing_) {
+      writing_ = true;
+      finish_(status_, &finish_tag_);
+    }
+  }
+
+  void OnWrite(bool ok) {
+    writing_ = false;
+    if (ok) {
+      pending_.pop_front();
+    } else {
+      broken_ = true;
+      pending_.clear();
+    }
+
+    if (waiter_ && (broken_ || !full())) {
+      auto waiter = std::move(waiter_);
+      waiter_ = nullptr;
+      waiter();
+    }
+    Kick();
+  }
+
+  void OnFinish(bool) { on_finished_(); }
+
+  WriteFn write_;
+  FinishFn finish_;
+  std::size_t max_pending_;
+  std::function<void()> on_finished_;
+
+  std::deque<Rsp> pending_;
+  std::function<void()> waiter_;
+  bool writing_{false};
+  bool broken_{false};
+  bool finishing_{false};
+  grpc::Status status_;
+
+  std::uint64_t messages_{0};
+  std::uint64_t waits_{0};
+  std::size_t max_queued_{0};
+
+  GrpcOpTag<GrpcWriteQueue> write_tag_;
+  GrpcOpTag<GrpcWriteQueue> finish_tag_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcWriteQueue);
+};
+
+}  // namespace _
+
+// GrpcProducer is the coroutine of the server streaming handler. the
+// messages are co_yield-ed to the stream, and the error is co_return-ed,
+// which is sent by GrpcStatus, eg.
+//
+//   GrpcProducer<Row> Export(grpc::ServerContext*, const Query* q) {
+//     for (auto& row : rows) {
+//       if (!(co_yield row)) {
+//         co_return Err(kErrorNetClosed);
+//       }
+//     }
+//     co_return {};
+//   }
+//
+// co_yield suspends the producer while the write queue of the stream is
+// full, and it's false once the stream is broken. the producer can
+// co_await the promises as well. it starts once it's bound to the stream.
+template <typename Rsp>
+class GrpcProducer {
+ public:
+  class promise_type {
+   public:
+    GrpcProducer get_return_object() noexcept {
+      return GrpcProducer(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_always final_suspend() const noexcept { return {}; }
+
+    template <typename U>
+    auto yield_value(U&& msg) {
+      queue_->Push(Rsp(std::forward<U>(msg)));
+      return YieldAwaiter{queue_};
+    }
+
+    void return_value(Error&& e) noexcept { queue_->Finish(GrpcStatus(e)); }
+    void return_value(const Error& e) noexcept {
+      queue_->Finish(GrpcStatus(e));
+    }
+
+    void unhandled_exception() noexcept {
+      queue_->Finish(grpc::Status(grpc::StatusCode::INTERNAL,
+                                  "coroutine exception"));
+    }
+
+   private:
+    friend GrpcProducer;
+    _::GrpcWriteQueue<Rsp>* queue_{nullptr};
+  };
+
+  GrpcProducer() = default;
+  GrpcProducer(GrpcProducer&& other) : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+  GrpcProducer& operator=(GrpcProducer&& other) {
+    if (this != &other) {
+      Reset();
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~GrpcProducer() { Reset(); }
+
+ public:
+  // bind the producer to |queue|, and run it to the first suspension
+  void Start(_::GrpcWriteQueue<Rsp>* queue) {
+    handle_.promise().queue_ = queue;
+    handle_.resume();
+  }
+
+ private:
+  struct YieldAwaiter {
+    _::GrpcWriteQueue<Rsp>* queue;
+
+    bool await_ready() const noexcept {
+      return queue->broken() || !queue->full();
+    }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      queue->Wait([handle]() { handle.resume(); });
+    }
+    bool await_resume() const noexcept { return !queue->broken(); }
+  };
+
+  explicit GrpcProducer(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  void Reset() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(GrpcProducer);
+};
+
+// GrpcBidiStream is the bidi stream of the server, which is handed to the
+// handler, eg.
+//
+//   Notifier Chat(GrpcBidiStream<Req, Rsp>* stream) {
+//     while (true) {
+//       auto r = co_await stream->Read();
+//       if (!r) {
+//         co_return {};  // the client is half closed
+//       }
+//       auto e = co_await stream->Write(MkReply(r.GetResult()));
+//       if (e) {
+//         co_return e;
+//       }
+//     }
+//   }
+//
+// the settled notifier of the handler finishes the stream by GrpcStatus.
+//
+// Notes, a read is in flight at a time. the write is settled once the
+// message is queued, and it waits while the queue is full, so it should be
+// awaited before the next one. they're rejected with kErrorNetClosed once
+// the stream is closed
+template <typename Req, typename Rsp>
+class GrpcBidiStream {
+ public:
+  // rejected with kErrorNetClosed once the client is half closed
+  event::Promise<Req> Read() {
+    event::Promise<Req> p;
+    if (eof_) {
+      p.Reject(Err(kErrorNetClosed, "grpc stream is half closed"));
+      return p;
+    }
+
+    DCHECK(!reading_);
+    reading_ = true;
+    reader_ = p.GetResolver();
+    rw_.Read(&read_msg_, &read_tag_);
+    return p;
+  }
+
+  event::Notifier Write(Rsp&& msg) {
+    event::Notifier n;
+    auto resolver = n.GetResolver();
+    if (!queue_.Push(std::move(msg))) {
+      resolver.Reject(Err(kErrorNetClosed, "grpc stream is broken"));
+    } else if (!queue_.full()) {
+      resolver.Resolve();
+    } else {
+      queue_.Wait([this, resolver]() mutable {
+        if (queue_.broken()) {
+          resolver.Reject(Err(kErrorNetClosed, "grpc stream is broken"));
+        } else {
+          resolver.Resolve();
+        }
+      });
+    }
+    return n;
+  }
+
+  grpc::ServerContext* context() { return &ctx_; }
+
+ protected:
+  explicit GrpcBidiStream(std::size_t max_pending_writes)
+      : rw_(&ctx_),
+        read_tag_(this, &GrpcBidiStream::OnRead),
+        queue_([this](const Rsp& msg, void* tag) { rw_.Write(msg, tag); },
+               [this](const grpc::Status& status, void* tag) {
+                 rw_.Finish(status, tag);
+               },
+               max_pending_writes, [this]() { OnFinished(); }) {}
+
+  virtual ~GrpcBidiStream() = default;
+
+  void OnRead(bool ok) {
+    reading_ = false;
+    auto reader = std::move(reader_);
+    if (ok) {
+      reader.Resolve(std::move(read_msg_));
+    } else {
+      eof_ = true;
+      reader.Reject(Err(kErrorNetClosed, "grpc stream is half closed"));
+    }
+    MaybeDelete();
+  }
+
+  virtual void OnFinished() {
+    finished_ = true;
+    MaybeDelete();
+  }
+
+  // the read which is in flight is failed after the finish
+  void MaybeDelete() {
+    if (finished_ && !reading_) {
+      delete this;
+    }
+  }
+
+  grpc::ServerContext ctx_;
+  grpc::ServerAsyncReaderWriter<Rsp, Req> rw_;
+
+  bool reading_{false};
+  bool eof_{false};
+  bool finished_{false};
+  Req read_msg_;
+  typename event::Promise<Req>::ResolverType reader_;
+  _::GrpcOpTag<GrpcBidiStream> read_tag_;
+
+  _::GrpcWriteQueue<Rsp> queue_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcBidiStream);
+};
+
+namespace _ {
+
+// the session of a server streaming method, it deletes itself once the
+// status is sent
+template <typename Service, typename Req, typename Rsp>
+class GrpcServerStreamSession {
+ public:
+  using Method = GrpcStreamMethod<GrpcServerStreamSession>;
+  using ServiceType = Service;
+  using Request = void (Service::*)(grpc::ServerContext*, Req*,
+                                    grpc::ServerAsyncWriter<Rsp>*,
+                                    grpc::CompletionQueue*,
+                                    grpc::ServerCompletionQueue*, void*);
+  using Handler =
+      std::function<GrpcProducer<Rsp>(grpc::ServerContext*, const Req*)>;
+
+  GrpcServerStreamSession(Method* method, std::size_t queue_index)
+      : method_(method),
+        queue_index_(queue_index),
+        writer_(&ctx_),
+        request_tag_(this, &GrpcServerStreamSession::OnRequest),
+        queue_([this](const Rsp& msg, void* tag) { writer_.Write(msg, tag); },
+               [this](const grpc::Status& status, void* tag) {
+                 writer_.Finish(status, tag);
+               },
+               method->options().max_pending_writes, [this]() {
+                 method_->OnFinished(queue_index_, queue_);
+                 delete this;
+               }) {}
+
+  void Arm(grpc::ServerCompletionQueue* cq) {
+    (method_->service()->*method_->request())(&ctx_, &req_, &writer_, cq, cq,
+                                              &request_tag_);
+  }
+
+ private:
+  void OnRequest(bool ok) {
+    if (!method_->OnRequest(queue_index_, ok)) {
+      delete this;
+      return;
+    }
+
+    producer_ = method_->handler()(&ctx_, &req_);
+    producer_.Start(&queue_);
+  }
+
+  Method* method_;
+  std::size_t queue_index_;
+
+  grpc::ServerContext ctx_;
+  Req req_;
+  grpc::ServerAsyncWriter<Rsp> writer_;
+  GrpcOpTag<GrpcServerStreamSession> request_tag_;
+
+  _::GrpcWriteQueue<Rsp> queue_;
+  GrpcProducer<Rsp> producer_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcServerStreamSession);
+};
+
+// the session of a bidi streaming method
+template <typename Service, typename Req, typename Rsp>
+class GrpcBidiStreamSession : public GrpcBidiStream<Req, Rsp> {
+ public:
+  using Method = GrpcStreamMethod<GrpcBidiStreamSession>;
+  using ServiceType = Service;
+  using Request = void (Service::*)(grpc::ServerContext*,
+                                    grpc::ServerAsyncReaderWriter<Rsp, Req>*,
+                                    grpc::CompletionQueue*,
+                                    grpc::ServerCompletionQueue*, void*);
+  using Handler = std::function<event::Notifier(GrpcBidiStream<Req, Rsp>*)>;
+
+  GrpcBidiStreamSession(Method* method, std::size_t queue_index)
+      : GrpcBidiStream<Req, Rsp>(method->options().max_pending_writes),
+        method_(method),
+        queue_index_(queue_index),
+        request_tag_(this, &GrpcBidiStreamSession::OnRequest) {}
+
+  void Arm(grpc::ServerCompletionQueue* cq) {
+    (method_->service()->*method_->request())(&this->ctx_, &this->rw_, cq, cq,
+                                              &request_tag_);
+  }
+
+ private:
+  void OnRequest(bool ok) {
+    if (!method_->OnRequest(queue_index_, ok)) {
+      delete this;
+      return;
+    }
+
+    // the handler is held until it's settled
+    handler_ = method_->handler()(this);
+    handler_->Then(
+        [this](Error&& e) { this->queue_.Finish(GrpcStatus(e)); }, nullptr);
+  }
+
+  void OnFinished() override {
+    method_->OnFinished(queue_index_, this->queue_);
+    GrpcBidiStream<Req, Rsp>::OnFinished();
+  }
+
+  Method* method_;
+  std::size_t queue_index_;
+  GrpcOpTag<GrpcBidiStreamSession> request_tag_;
+  std::optional<event::Notifier> handler_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcBidiStreamSession);
+};
+
+}  // namespace _
+
+// GrpcStreamMethod serves a streaming method on the queues of the bridge
+// group. |backlog| requests are posted to every queue, once a stream
+// arrives, another one is posted. the sessions are made per stream, which
+// is long lived, and they delete themselves once the status is sent.
+//
+// Notes, the sessions are handled within the loop of the queue. the method
+// must be destroyed after the server and the bridges are shut down, and
+// the requests left are dropped by the loops
+template <typename Session>
+class GrpcStreamMethod {
+ public:
+  using Service = typename Session::ServiceType;
+  using Request = typename Session::Request;
+  using Handler = typename Session::Handler;
+
+  struct Options {
+    // the requests posted to a queue
+    std::size_t backlog{4};
+
+    // the messages queued per stream
+    std::size_t max_pending_writes{64};
+  };
+
+  struct Stats {
+    std::uint64_t streams{0};
+
+    // the messages written, and the times the writer waited for a full
+    // queue
+    std::uint64_t messages{0};
+    std::uint64_t waits{0};
+
+    // the most messages queued by a stream
+    std::size_t max_pending{0};
+  };
+
+  GrpcStreamMethod(Service* service, Request request, const Handler& handler,
+                   GrpcBridgeGroup* group, const Options& opts)
+      : service_(service),
+        request_(request),
+        handler_(handler),
+        opts_(opts),
+        token_(std::make_shared<GrpcStreamMethod*>(this)) {
+    for (std::size_t i = 0; i < group->size(); ++i) {
+      queues_.push_back(std::make_unique<Queue>(group->At(i)));
+    }
+  }
+
+ public:
+  // post the backlog within the loops, it's thread safe
+  void Start() {
+    for (std::size_t i = 0; i < queues_.size(); ++i) {
+      queues_[i]->bridge->loop()->remote_executor()->Post(
+          [token = std::weak_ptr<GrpcStreamMethod*>(token_), i]() {
+            if (auto self = token.lock(); self) {
+              (*self)->Fill(i);
+            }
+          });
+    }
+  }
+
+  // the requests posted to the queue |i|, within its loop
+  std::size_t posted(std::size_t i) const { return queues_[i]->posted; }
+  const Stats& stats(std::size_t i) const { return queues_[i]->stats; }
+  std::size_t size() const { return queues_.size(); }
+
+  Service* service() const { return service_; }
+  Request request() const { return request_; }
+  const Handler& handler() const { return handler_; }
+  const Options& options() const { return opts_; }
+
+ private:
+  friend Session;
+
+  struct Queue {
+    explicit Queue(GrpcCompletionQueueBridge* bridge)
+        : bridge(bridge), posted(0), stats() {}
+
+    GrpcCompletionQueueBridge* bridge;
+    std::size_t posted;
+    Stats stats;
+  };
+
+  void Fill(std::size_t i) {
+    while (queues_[i]->posted < opts_.backlog) {
+      ++queues_[i]->posted;
+      (new Session(this, i))->Arm(queues_[i]->bridge->server_cq());
+    }
+  }
+
+  // a stream arrives, or the request is done by the shutdown if !ok
+  bool OnRequest(std::size_t i, bool ok) {
+    auto& queue = *queues_[i];
+    --queue.posted;
+    if (!ok) {
+      return false;
+    }
+
+    ++queue.stats.streams;
+    Fill(i);
+    return true;
+  }
+
+  // the status of a stream is sent
+  template <typename WriteQueue>
+  void OnFinished(std::size_t i, const WriteQueue& q) {
+    auto& stats = queues_[i]->stats;
+    stats.messages += q.messages();
+    stats.waits += q.waits();
+    stats.max_pending = std::max(stats.max_pending, q.max_queued());
+  }
+
+  Service* service_;
+  Request request_;
+  Handler handler_;
+  Options opts_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  std::shared_ptr<GrpcStreamMethod*> token_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(GrpcStreamMethod);
+};
+
+// eg. &Greeter::AsyncService::RequestSayHelloStreamReply
+template <typename Service, typename Req, typename Rsp>
+using GrpcServerStreamMethod =
+    GrpcStreamMethod<_::GrpcServerStreamSession<Service, Req, Rsp>>;
+
+// eg. &Greeter::AsyncService::RequestSayHelloBidiStream
+template <typename Service, typename Req, typename Rsp>
+using GrpcBidiStreamMethod =
+    GrpcStreamMethod<_::GrpcBidiStreamSession<Service, Req, Rsp>>;
+
+}  // namespace net
+}  // namespace libz
+
+#endif  // ENABLE_CO
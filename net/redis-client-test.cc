@@ -0,0 +1,305 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "redis-client.h"
+
+#include <event/io-message-loop.h>
+
+#include <asio/write.hpp>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+
+// a small stand-in of the redis server, which runs on the same loop
+class FakeRedis {
+ public:
+  explicit FakeRedis(event::MessageLoop* loop)
+      : acceptor_(*loop->proactor(),
+                  tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0)) {
+    Accept();
+  }
+
+  std::uint16_t port() const { return acceptor_.local_endpoint().port(); }
+
+  std::size_t accepted{0};
+  std::size_t reads{0};
+  std::map<std::string, std::string, std::less<>> data;
+
+ private:
+  struct Session : public std::enable_shared_from_this<Session> {
+    Session(FakeRedis* server, tcp::socket&& socket)
+        : server(server), socket(std::move(socket)) {}
+
+    void Read() {
+      auto [buf, size] = parser.Prepare();
+      socket.async_read_some(
+          asio::buffer(buf, size),
+          [self = shared_from_this()](const asio::error_code& ec,
+                                      std::size_t n) {
+            if (ec) {
+              return;
+            }
+
+            ++self->server->reads;
+            self->parser.Commit(n);
+            for (;;) {
+              RespValue command;
+              auto r = self->parser.Parse(&command);
+              CATCH_REQUIRE(r);
+              if (!r.GetResult()) {
+                break;
+              }
+              self->Execute(command);
+            }
+
+            asio::async_write(self->socket, asio::buffer(self->out),
+                              [self](const asio::error_code& ec, std::size_t) {
+                                self->out.clear();
+                                if (!ec) {
+                                  self->Read();
+                                }
+                              });
+          });
+    }
+
+    void Reply(RespType type, std::string_view str = {},
+               std::int64_t integer = 0) {
+      RespValue value;
+      value.type = type;
+      value.str = str;
+      value.integer = integer;
+      EncodeValue(value, resp3, &out);
+    }
+
+    void Execute(const RespValue& command) {
+      auto& args = command.elements;
+      auto& data = server->data;
+      auto name = args[0].str;
+
+      if (name == "HELLO") {
+        resp3 = args.size() > 1 && args[1].str == "3";
+        RespValue value;
+        value.type = RespType::kMap;
+        value.elements.resize(2);
+        value.elements[0].type = RespType::kSimpleString;
+        value.elements[0].str = "proto";
+        value.elements[1].type = RespType::kInteger;
+        value.elements[1].integer = resp3 ? 3 : 2;
+        EncodeValue(value, resp3, &out);
+      } else if (name == "PING") {
+        Reply(RespType::kSimpleString, "PONG");
+      } else if (name == "SET") {
+        data[std::string(args[1].str)] = args[2].str;
+        Reply(RespType::kSimpleString, "OK");
+      } else if (name == "GET") {
+        auto it = data.find(args[1].str);
+        if (it == data.end()) {
+          Reply(RespType::kNull);
+        } else {
+          Reply(RespType::kBulkString, it->second);
+        }
+      } else if (name == "INCR") {
+        auto& v = data[std::string(args[1].str)];
+        v = std::to_string(std::atoll(v.c_str()) + 1);
+        Reply(RespType::kInteger, {}, std::atoll(v.c_str()));
+      } else if (name == "NOTIFY") {
+        RespValue value;
+        value.type = RespType::kPush;
+        value.elements.resize(1);
+        value.elements[0].type = RespType::kBulkString;
+        value.elements[0].str = args[1].str;
+        EncodeValue(value, resp3, &out);
+        Reply(RespType::kSimpleString, "OK");
+      } else if (name == "QUIT") {
+        asio::error_code ignored;
+        socket.shutdown(tcp::socket::shutdown_both, ignored);
+      } else {
+        Reply(RespType::kError, "ERR unknown command");
+      }
+    }
+
+    FakeRedis* server;
+    tcp::socket socket;
+    RespParser parser;
+    std::string out;
+    bool resp3{false};
+  };
+
+  void Accept() {
+    acceptor_.async_accept([this](const asio::error_code& ec, tcp::socket s) {
+      if (ec) {
+        return;
+      }
+
+      ++accepted;
+      std::make_shared<Session>(this, std::move(s))->Read();
+      Accept();
+    });
+  }
+
+  tcp::acceptor acceptor_;
+};
+
+CATCH_TEST_CASE("pipelining", "[redis-client]") {
+  event::IOMessageLoop loop;
+  FakeRedis server(&loop);
+
+  RedisConnection conn(&loop);
+
+  constexpr int kNum = 1000;
+  int done = 0;
+  std::optional<Error> error;
+  std::vector<event::Promise<RespValue>> promises;
+
+  loop.Post([&]() {
+    // the commands are buffered until the socket is attached
+    tcp::socket socket(*loop.proactor());
+    socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"),
+                                 server.port()));
+
+    for (int i = 0; i < kNum; ++i) {
+      promises.push_back(conn.Command({"INCR", "counter"}));
+      promises.back().Then(
+          [&, i](Result<RespValue>&& r) {
+            CATCH_REQUIRE(r);
+            CATCH_REQUIRE(r.GetResult().integer == i + 1);
+            ++done;
+          },
+          nullptr);
+    }
+
+    promises.push_back(conn.Command({"NOPE"}));
+    promises.back().Then(
+        [&](Result<RespValue>&& r) {
+          CATCH_REQUIRE(!r);
+          error = r.PassError();
+        },
+        nullptr);
+
+    std::string key = "key";
+    promises.push_back(conn.Command(std::vector<std::string_view>{"GET", key}));
+    promises.back().Then(
+        [&](Result<RespValue>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult().IsNull());
+          loop.Shutdown();
+        },
+        nullptr);
+
+    conn.Attach(std::move(socket));
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(done == kNum);
+  CATCH_REQUIRE(error);
+  CATCH_REQUIRE(error->code() == kErrorRedisReply);
+  CATCH_REQUIRE(conn.inflight() == 0);
+
+  // the commands of one iteration are sent in a single write
+  CATCH_REQUIRE(conn.stats().commands == kNum + 2);
+  CATCH_REQUIRE(conn.stats().writes == 1);
+}
+
+CATCH_TEST_CASE("resp3", "[redis-client]") {
+  event::IOMessageLoop loop;
+  FakeRedis server(&loop);
+
+  RedisConnection::Options opts;
+  opts.resp3 = true;
+  RedisConnection conn(&loop, opts);
+
+  std::vector<std::string> pushed;
+  conn.SetPushHandler([&](RespValue&& value) {
+    pushed.emplace_back(value.elements[0].str);
+  });
+
+  std::optional<event::Promise<RespValue>> promise;
+  loop.Post([&]() {
+    tcp::socket socket(*loop.proactor());
+    socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"),
+                                 server.port()));
+    conn.Attach(std::move(socket));
+
+    promise.emplace(conn.Command({"NOTIFY", "hello"}));
+    promise->Then(
+        [&](Result<RespValue>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult().str == "OK");
+          loop.Shutdown();
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(pushed == std::vector<std::string>{"hello"});
+}
+
+CATCH_TEST_CASE("pool", "[redis-client]") {
+  event::IOMessageLoop loop;
+  FakeRedis server(&loop);
+
+  RedisPool::Options opts;
+  opts.addresses = {"127.0.0.1"};
+  opts.port = server.port();
+  opts.connections = 1;
+  RedisPool pool(&loop, opts);
+
+  std::vector<event::Promise<RespValue>> promises;
+  std::vector<std::string> values;
+  std::optional<Error> closed;
+
+  auto expect = [&](event::Promise<RespValue>&& promise,
+                    std::function<void(Result<RespValue>&&)>&& cb) {
+    promises.push_back(std::move(promise));
+    promises.back().Then(std::move(cb), nullptr);
+  };
+
+  loop.Post([&]() {
+    expect(pool.Command({"SET", "a", "1"}), [](Result<RespValue>&& r) {
+      CATCH_REQUIRE(r);
+    });
+    expect(pool.Command({"GET", "a"}), [&](Result<RespValue>&& r) {
+      CATCH_REQUIRE(r);
+      values.emplace_back(r.GetResult().str);
+
+      // the server closes the connection without a reply
+      expect(pool.Command({"QUIT"}), [&](Result<RespValue>&& r) {
+        CATCH_REQUIRE(!r);
+        closed = r.PassError();
+
+        // the broken connection is replaced on the next use
+        expect(pool.Command({"PING"}), [&](Result<RespValue>&& r) {
+          CATCH_REQUIRE(r);
+          values.emplace_back(r.GetResult().str);
+          loop.Shutdown();
+        });
+      });
+    });
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(values == std::vector<std::string>{"1", "PONG"});
+  CATCH_REQUIRE(closed);
+  CATCH_REQUIRE(closed->code() == kErrorNetClosed);
+  CATCH_REQUIRE(server.accepted == 2);
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,279 @@
+#include "redis-client.h"
+
+#include <asio/post.hpp>
+#include <asio/write.hpp>
+#include <deque>
+#include <string>
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+
+struct RedisConnection::State : public std::enable_shared_from_this<State> {
+  State(event::MessageLoop* loop, const Options& opts)
+      : loop(loop), parser(opts.parser), hello_pending(opts.resp3) {}
+
+  void Send(const std::string_view* args, std::size_t n);
+  void Flush();
+
+  void Read();
+  void Dispatch(RespValue&& value);
+
+  // reject the pending commands, only the first error is kept
+  void Fail(Error&& e);
+
+  event::MessageLoop* loop;
+  std::optional<tcp::socket> socket;
+  RespParser parser;
+  PushHandler push_handler;
+
+  // the replies arrive in the order of the commands
+  std::deque<event::PromiseResolver<RespValue>> waiting;
+  bool hello_pending;
+
+  // the commands are appended to |pending| while |writing| is in flight
+  std::string pending;
+  std::string writing;
+  bool flush_scheduled{false};
+  bool write_inflight{false};
+
+  bool closed{false};
+  Stats stats;
+};
+
+void RedisConnection::State::Send(const std::string_view* args,
+                                  std::size_t n) {
+  EncodeCommand(args, n, &pending);
+
+  // the commands of this loop iteration are flushed together
+  if (!flush_scheduled && !write_inflight) {
+    flush_scheduled = true;
+    asio::post(*loop->proactor(), [self = shared_from_this()]() {
+      self->flush_scheduled = false;
+      self->Flush();
+    });
+  }
+}
+
+void RedisConnection::State::Flush() {
+  if (closed || !socket || write_inflight || pending.empty()) {
+    return;
+  }
+
+  write_inflight = true;
+  writing.swap(pending);
+  ++stats.writes;
+
+  asio::async_write(*socket, asio::buffer(writing),
+                    [self = shared_from_this()](const asio::error_code& ec,
+                                                std::size_t) {
+                      self->write_inflight = false;
+                      self->writing.clear();
+                      if (ec) {
+                        self->Fail(
+                            Error::MkBoostError(ec.value(), ec.message()));
+                        return;
+                      }
+
+                      self->Flush();
+                    });
+}
+
+void RedisConnection::State::Read() {
+  auto [buf, size] = parser.Prepare();
+  socket->async_read_some(
+      asio::buffer(buf, size),
+      [self = shared_from_this()](const asio::error_code& ec, std::size_t n) {
+        if (ec) {
+          self->Fail(ec == asio::error::eof
+                         ? Err(kErrorNetClosed)
+                         : Error::MkBoostError(ec.value(), ec.message()));
+          return;
+        }
+
+        self->parser.Commit(n);
+        for (;;) {
+          RespValue value;
+          auto r = self->parser.Parse(&value);
+          if (!r) {
+            self->Fail(r.PassError());
+            return;
+          } else if (!r.GetResult()) {
+            break;
+          }
+
+          self->Dispatch(std::move(value));
+          if (self->closed) {
+            return;
+          }
+        }
+
+        self->Read();
+      });
+}
+
+void RedisConnection::State::Dispatch(RespValue&& value) {
+  // the push isn't a reply of any command
+  if (value.type == RespType::kPush) {
+    if (push_handler) {
+      push_handler(std::move(value));
+    }
+    return;
+  }
+
+  if (hello_pending) {
+    hello_pending = false;
+    if (value.IsError()) {
+      Fail(Err(kErrorRedisReply, "{}", value.str));
+    }
+    return;
+  }
+
+  if (waiting.empty()) {
+    Fail(Err(kErrorRespMalformed, "unexpected reply"));
+    return;
+  }
+
+  auto resolver = std::move(waiting.front());
+  waiting.pop_front();
+
+  if (value.IsError()) {
+    resolver.Reject(Err(kErrorRedisReply, "{}", value.str));
+  } else {
+    resolver.Resolve(std::move(value));
+  }
+}
+
+void RedisConnection::State::Fail(Error&& e) {
+  if (closed) {
+    return;
+  }
+
+  closed = true;
+  if (socket) {
+    asio::error_code ignored;
+    socket->close(ignored);
+  }
+
+  // the callbacks may issue new commands, which are rejected immediately
+  auto pending_commands = std::move(waiting);
+  waiting.clear();
+  for (auto& resolver : pending_commands) {
+    resolver.Reject(Error(e));
+  }
+}
+
+RedisConnection::RedisConnection(event::MessageLoop* loop,
+                                 const Options& opts)
+    : state_(std::make_shared<State>(loop, opts)) {
+  if (opts.resp3) {
+    std::string_view hello[] = {"HELLO", "3"};
+    state_->Send(hello, 2);
+  }
+}
+
+RedisConnection::~RedisConnection() { Close(); }
+
+void RedisConnection::Attach(tcp::socket&& socket) {
+  if (state_->closed || state_->socket) {
+    return;
+  }
+
+  asio::error_code ignored;
+  socket.set_option(tcp::no_delay(true), ignored);
+
+  state_->socket.emplace(std::move(socket));
+  state_->Read();
+  state_->Flush();
+}
+
+event::Promise<RespValue> RedisConnection::Command(
+    std::initializer_list<std::string_view> args) {
+  return Command(args.begin(), args.size());
+}
+
+event::Promise<RespValue> RedisConnection::Command(
+    const std::vector<std::string_view>& args) {
+  return Command(args.data(), args.size());
+}
+
+event::Promise<RespValue> RedisConnection::Command(
+    const std::string_view* args, std::size_t n) {
+  if (state_->closed) {
+    return event::MkRejectedPromise<RespValue>(Err(kErrorNetClosed));
+  }
+
+  event::Promise<RespValue> promise;
+  state_->waiting.push_back(promise.GetResolver());
+  state_->Send(args, n);
+  ++state_->stats.commands;
+
+  return promise;
+}
+
+void RedisConnection::SetPushHandler(PushHandler&& handler) {
+  state_->push_handler = std::move(handler);
+}
+
+void RedisConnection::Abort(Error&& e) { state_->Fail(std::move(e)); }
+
+bool RedisConnection::is_open() const { return !state_->closed; }
+
+bool RedisConnection::is_attached() const {
+  return state_->socket.has_value();
+}
+
+std::size_t RedisConnection::inflight() const {
+  return state_->waiting.size();
+}
+
+const RedisConnection::Stats& RedisConnection::stats() const {
+  return state_->stats;
+}
+
+RedisPool::RedisPool(event::MessageLoop* loop, const Options& opts)
+    : loop_(loop),
+      opts_(opts),
+      connector_(loop, opts.connector),
+      connections_(std::max<std::size_t>(opts.connections, 1)),
+      next_(0) {}
+
+RedisPool::~RedisPool() { connections_.clear(); }
+
+event::Promise<RespValue> RedisPool::Command(
+    std::initializer_list<std::string_view> args) {
+  return Get()->Command(args);
+}
+
+event::Promise<RespValue> RedisPool::Command(
+    const std::vector<std::string_view>& args) {
+  return Get()->Command(args);
+}
+
+RedisConnection* RedisPool::Get() {
+  auto& conn = connections_[next_++ % connections_.size()];
+  if (conn && conn->is_open()) {
+    return conn.get();
+  }
+
+  conn = std::make_shared<RedisConnection>(loop_, opts_.connection);
+  connector_.Connect(
+      opts_.addresses, opts_.port, opts_.connect_timeout,
+      [weak = std::weak_ptr<RedisConnection>(conn)](
+          Result<tcp::socket>&& r) {
+        auto conn = weak.lock();
+        if (!conn) {
+          return;
+        } else if (!r) {
+          conn->Abort(r.PassError());
+        } else {
+          conn->Attach(r.PassResult());
+        }
+      });
+
+  return conn.get();
+}
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+
+#include <asio/ip/tcp.hpp>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "basic.h"
+#include "connector.h"
+#include "dns-cache.h"
+#include "resp.h"
+
+namespace libz {
+namespace net {
+
+// RedisConnection sends the commands over one connection, and the replies are
+// matched to the commands in order. the commands issued within one loop
+// iteration are pipelined into a single write, and the replies are parsed
+// incrementally without copying.
+//
+// the commands issued before the socket is attached are buffered, and they
+// are written once it's attached. with resp3, HELLO 3 is sent first.
+//
+// Notes, the error reply is rejected with kErrorRedisReply, and the errors
+// nested in an array, eg. the reply of EXEC, are kept as values. the push
+// values of RESP3 are handed to the push handler. all methods must be invoked
+// within the loop thread
+class RedisConnection {
+ public:
+  using PushHandler = std::function<void(RespValue&&)>;
+
+  struct Options {
+    bool resp3{false};
+    RespParser::Options parser;
+  };
+
+  struct Stats {
+    std::uint64_t commands{0};
+
+    // the writes issued to the socket, fewer than the commands if pipelined
+    std::uint64_t writes{0};
+  };
+
+  explicit RedisConnection(event::MessageLoop* loop)
+      : RedisConnection(loop, Options{}) {}
+  RedisConnection(event::MessageLoop* loop, const Options& opts);
+
+  // the pending commands are rejected with kErrorNetClosed
+  ~RedisConnection();
+
+ public:
+  // start the io on the connected socket
+  void Attach(asio::ip::tcp::socket&& socket);
+
+  event::Promise<RespValue> Command(
+      std::initializer_list<std::string_view> args);
+  event::Promise<RespValue> Command(const std::vector<std::string_view>& args);
+
+  void SetPushHandler(PushHandler&& handler);
+
+  // close the connection, and reject the pending commands with |e|
+  void Abort(Error&& e);
+  void Close() { Abort(Err(kErrorNetClosed)); }
+
+  bool is_open() const;
+  bool is_attached() const;
+
+  std::size_t inflight() const;
+  const Stats& stats() const;
+
+ private:
+  event::Promise<RespValue> Command(const std::string_view* args,
+                                    std::size_t n);
+
+  struct State;
+  std::shared_ptr<State> state_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(RedisConnection);
+};
+
+// RedisPool is the loop local pool of the connections to one server. the
+// commands are spread over the connections in turn, the connection is made
+// lazily on the first use, and the broken one is replaced on the next use.
+//
+// Notes, every loop has its own pool, so that no lock is involved. all
+// methods must be invoked within the loop thread
+class RedisPool {
+ public:
+  struct Options {
+    IPAddressList addresses;
+    std::uint16_t port{6379};
+
+    std::size_t connections{4};
+    std::optional<MilliSeconds> connect_timeout{MilliSeconds(1000)};
+
+    RedisConnection::Options connection;
+    Connector::Options connector;
+  };
+
+  RedisPool(event::MessageLoop* loop, const Options& opts);
+
+  // the pending commands are rejected
+  ~RedisPool();
+
+ public:
+  event::Promise<RespValue> Command(
+      std::initializer_list<std::string_view> args);
+  event::Promise<RespValue> Command(const std::vector<std::string_view>& args);
+
+  // the connection of the next turn. the commands which must be sent over the
+  // same connection, eg. MULTI and EXEC, are issued on it directly
+  RedisConnection* Get();
+
+  std::size_t size() const { return connections_.size(); }
+  const Options& options() const { return opts_; }
+
+ private:
+  event::MessageLoop* loop_;
+  Options opts_;
+  Connector connector_;
+
+  std::vector<std::shared_ptr<RedisConnection>> connections_;
+  std::size_t next_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(RedisPool);
+};
+
+}  // namespace net
+}  // namespace libz
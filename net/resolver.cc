@@ -0,0 +1,190 @@
+#include "resolver.h"
+
+#include <asio/ip/tcp.hpp>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+using asio::ip::tcp;
+
+struct Resolver::State {
+  struct Waiter {
+    event::Promise<IPAddressList>::ResolverType resolver;
+    std::shared_ptr<event::_::Cancelable> timer;
+  };
+
+  State(event::MessageLoop* loop, const DnsCache::Options& opts)
+      : loop(loop), cache(opts), inflight(), dns_client() {}
+
+  event::MessageLoop* loop;
+  DnsCache cache;
+
+  // the presence of host means that a lookup is in flight. the waiters may be
+  // empty if it's a background refresh
+  std::unordered_map<std::string, std::vector<Waiter>> inflight;
+
+  // only for kStub backend
+  std::unique_ptr<DnsClient> dns_client;
+};
+
+Resolver::Resolver(event::MessageLoop* loop, const Options& opts)
+    : loop_(loop), state_(std::make_shared<State>(loop, opts.cache)) {
+  if (opts.backend == Backend::kStub) {
+    if (opts.stub) {
+      state_->dns_client = std::make_unique<DnsClient>(
+          loop, DnsClient::Options{*opts.stub});
+    } else {
+      state_->dns_client = std::make_unique<DnsClient>(loop);
+    }
+  }
+}
+
+Resolver::~Resolver() {
+  for (auto& [host, waiters] : state_->inflight) {
+    for (auto& waiter : waiters) {
+      if (waiter.timer) {
+        waiter.timer->CancelEvent();
+      }
+      waiter.resolver.Reject(Err(kErrorNetCancelled, "resolver destroyed"));
+    }
+  }
+}
+
+DnsCache* Resolver::cache() { return &state_->cache; }
+
+event::Promise<IPAddressList> Resolver::Resolve(
+    std::string_view host, std::optional<MilliSeconds> timeout) {
+  std::string key(host);
+  auto now = loop_->MonoNow();
+
+  if (auto entry = state_->cache.Lookup(key, now); entry) {
+    if (entry->IsNegative()) {
+      return event::MkRejectedPromise<IPAddressList>(Error{entry->error});
+    }
+
+    if (state_->cache.ShouldRefresh(*entry, now) &&
+        state_->inflight.count(key) == 0) {
+      state_->inflight[key];
+      StartLookup(state_, key);
+    }
+
+    return event::MkResolvedPromise(IPAddressList{entry->addresses});
+  }
+
+  event::Promise<IPAddressList> promise;
+  State::Waiter waiter{promise.GetResolver(), nullptr};
+
+  if (timeout) {
+    auto token = loop_->AddTimerEvent(
+        [resolver = promise.GetResolver()](Error&& e) mutable {
+          if (e) {
+            resolver.Reject(std::move(e));
+          } else {
+            resolver.Reject(Err(kErrorNetTimeout, "resolve timeout"));
+          }
+        },
+        *timeout);
+    waiter.timer = token.AsCancelable();
+  }
+
+  auto [itr, first] = state_->inflight.try_emplace(key);
+  itr->second.push_back(std::move(waiter));
+  if (first) {
+    StartLookup(state_, key);
+  }
+
+  return promise;
+}
+
+void Resolver::StartLookup(const std::shared_ptr<State>& state,
+                           const std::string& host) {
+  if (state->dns_client) {
+    state->dns_client->LookupHost(
+        host,
+        [weak_state = std::weak_ptr(state), host](Result<DnsAnswer>&& r) {
+          auto state = weak_state.lock();
+          if (!state) {
+            return;
+          }
+
+          if (!r) {
+            FinishLookup(state.get(), host, r.PassError());
+            return;
+          }
+
+          auto answer = r.PassResult();
+          FinishLookup(state.get(), host, std::move(answer.addresses),
+                       answer.ttl);
+        });
+    return;
+  }
+
+  auto resolver = std::make_shared<tcp::resolver>(*state->loop->proactor());
+
+  resolver->async_resolve(
+      host, "",
+      [_ = resolver, weak_state = std::weak_ptr(state), host](
+          const asio::error_code& ec, tcp::resolver::results_type results) {
+        auto state = weak_state.lock();
+        if (!state) {
+          return;
+        }
+
+        if (ec) {
+          FinishLookup(state.get(), host,
+                       Error::MkBoostError(ec.value(), ec.message()));
+          return;
+        }
+
+        asio::error_code err;
+        IPAddressList addr_list;
+        for (const auto& entry : results) {
+          if (auto ip = entry.endpoint().address().to_string(err); !err) {
+            addr_list.push_back(std::move(ip));
+          }
+        }
+
+        if (addr_list.empty()) {
+          FinishLookup(state.get(), host, Err(kErrorNetNoAddress, "{}", host));
+        } else {
+          FinishLookup(state.get(), host, std::move(addr_list));
+        }
+      });
+}
+
+void Resolver::FinishLookup(State* state, const std::string& host,
+                            Result<IPAddressList>&& r,
+                            std::optional<Seconds> ttl) {
+  std::vector<State::Waiter> waiters;
+  if (auto itr = state->inflight.find(host); itr != state->inflight.end()) {
+    waiters = std::move(itr->second);
+    state->inflight.erase(itr);
+  }
+
+  auto now = state->loop->MonoNow();
+  if (r && ttl) {
+    state->cache.Insert(host, IPAddressList{r.GetResult()}, *ttl, now);
+  } else if (r) {
+    state->cache.Insert(host, IPAddressList{r.GetResult()}, now);
+  } else if (auto entry = state->cache.Peek(host, now);
+             !entry || entry->IsNegative()) {
+    // a failed background refresh doesn't evict the entry still alive
+    state->cache.InsertNegative(host, Error{r.GetError()}, now);
+  }
+
+  for (auto& waiter : waiters) {
+    if (waiter.timer) {
+      waiter.timer->CancelEvent();
+    }
+
+    if (r) {
+      waiter.resolver.Resolve(IPAddressList{r.GetResult()});
+    } else {
+      waiter.resolver.Reject(Error{r.GetError()});
+    }
+  }
+}
+
+}  // namespace net
+}  // namespace libz
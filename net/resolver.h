@@ -0,0 +1,78 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "basic.h"
+#include "dns-cache.h"
+#include "dns-client.h"
+
+namespace libz {
+namespace net {
+
+// Resolver translates the host name into ip addresses. the answers are kept in
+// a DnsCache, and the concurrent lookups of the same host are deduplicated, so
+// that there is at most one in-flight lookup per host. besides, the hot entries
+// are refreshed in background before they expire.
+//
+// the lookups are done by getaddrinfo on the asio private resolver thread by
+// default. with the kStub backend, they are done by the DnsClient on the loop
+// itself, and the cached entries honor the record ttl.
+//
+// Notes, the resolver is bound to a message loop, and all methods must be
+// invoked within the loop thread. usually, there is one resolver per loop
+class Resolver {
+ public:
+  enum class Backend {
+    kSystem,
+    kStub,
+  };
+
+  struct Options {
+    Backend backend{Backend::kSystem};
+    DnsCache::Options cache;
+
+    // used by kStub backend, the system resolv.conf and hosts are loaded if
+    // it's empty
+    std::optional<DnsClient::Options> stub;
+  };
+
+  explicit Resolver(event::MessageLoop* loop) : Resolver(loop, Options{}) {}
+  Resolver(event::MessageLoop* loop, const Options& opts);
+
+  ~Resolver();
+
+ public:
+  // the timeout only applies to the caller, the underlaying lookup keeps
+  // running and its answer will be cached for the subsequent callers
+  event::Promise<IPAddressList> Resolve(
+      std::string_view host, std::optional<MilliSeconds> timeout = {});
+
+  DnsCache* cache();
+
+ private:
+  struct State;
+
+  static void StartLookup(const std::shared_ptr<State>& state,
+                          const std::string& host);
+  static void FinishLookup(State* state, const std::string& host,
+                           Result<IPAddressList>&& r,
+                           std::optional<Seconds> ttl = {});
+
+ private:
+  event::MessageLoop* loop_;
+  std::shared_ptr<State> state_;
+
+  DISALLOW_COPY_AND_ASSIGN(Resolver);
+};
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,195 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "resp.h"
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+// feed the bytes into the parser, |step| bytes at a time
+std::vector<RespValue> Feed(RespParser* parser, std::string_view data,
+                            std::size_t step) {
+  std::vector<RespValue> values;
+  for (std::size_t i = 0; i < data.size(); i += step) {
+    auto n = std::min(step, data.size() - i);
+    auto [buf, size] = parser->Prepare(n);
+    CATCH_REQUIRE(size >= n);
+    std::memcpy(buf, data.data() + i, n);
+    parser->Commit(n);
+
+    RespValue value;
+    for (;;) {
+      auto r = parser->Parse(&value);
+      CATCH_REQUIRE(r);
+      if (!r.GetResult()) {
+        break;
+      }
+      values.push_back(std::move(value));
+    }
+  }
+  return values;
+}
+
+Result<bool> ParseAll(std::string_view data) {
+  RespParser parser;
+  auto [buf, size] = parser.Prepare(data.size());
+  std::memcpy(buf, data.data(), data.size());
+  parser.Commit(data.size());
+
+  RespValue value;
+  return parser.Parse(&value);
+}
+
+CATCH_TEST_CASE("resp2", "[resp]") {
+  std::string data =
+      "+OK\r\n"
+      "-ERR wrong type\r\n"
+      ":-42\r\n"
+      "$5\r\nhello\r\n"
+      "$0\r\n\r\n"
+      "$-1\r\n"
+      "*-1\r\n"
+      "*0\r\n"
+      "*3\r\n:1\r\n*2\r\n$1\r\na\r\n+b\r\n$3\r\nc\r\n\r\n";
+
+  for (std::size_t step : {1, 3, 1 << 10}) {
+    RespParser::Options opts;
+    opts.buffer_size = 8;
+    RespParser parser(opts);
+
+    auto values = Feed(&parser, data, step);
+    CATCH_REQUIRE(values.size() == 9);
+    CATCH_REQUIRE(parser.buffered() == 0);
+
+    CATCH_REQUIRE(values[0].type == RespType::kSimpleString);
+    CATCH_REQUIRE(values[0].str == "OK");
+    CATCH_REQUIRE(values[1].IsError());
+    CATCH_REQUIRE(values[1].str == "ERR wrong type");
+    CATCH_REQUIRE(values[2].integer == -42);
+    CATCH_REQUIRE(values[3].type == RespType::kBulkString);
+    CATCH_REQUIRE(values[3].str == "hello");
+    CATCH_REQUIRE(values[4].str.empty());
+    CATCH_REQUIRE(values[5].IsNull());
+    CATCH_REQUIRE(values[6].IsNull());
+    CATCH_REQUIRE(values[7].type == RespType::kArray);
+    CATCH_REQUIRE(values[7].elements.empty());
+
+    // the nested value spans the buffers, and it keeps them alive
+    auto& nested = values[8];
+    CATCH_REQUIRE(nested.elements.size() == 3);
+    CATCH_REQUIRE(nested.elements[0].integer == 1);
+    CATCH_REQUIRE(nested.elements[1].elements.size() == 2);
+    CATCH_REQUIRE(nested.elements[1].elements[0].str == "a");
+    CATCH_REQUIRE(nested.elements[1].elements[1].str == "b");
+    CATCH_REQUIRE(nested.elements[2].str == "c\r\n");
+    CATCH_REQUIRE(nested.buffer);
+  }
+}
+
+CATCH_TEST_CASE("resp3", "[resp]") {
+  std::string data =
+      "_\r\n"
+      ",3.5\r\n"
+      ",-inf\r\n"
+      "#t\r\n"
+      "(3492890328409238509324850943850943825024385\r\n"
+      "!9\r\nERR oops!\r\n"
+      "=8\r\ntxt:text\r\n"
+      "%2\r\n+a\r\n:1\r\n+b\r\n:2\r\n"
+      "~1\r\n+x\r\n"
+      "|1\r\n+ttl\r\n:3600\r\n$3\r\nval\r\n"
+      ">2\r\n+message\r\n+hi\r\n";
+
+  for (std::size_t step : {1, 1 << 10}) {
+    RespParser parser;
+    auto values = Feed(&parser, data, step);
+    CATCH_REQUIRE(values.size() == 11);
+
+    CATCH_REQUIRE(values[0].IsNull());
+    CATCH_REQUIRE(values[1].number == 3.5);
+    CATCH_REQUIRE(values[2].number < 0);
+    CATCH_REQUIRE(values[3].type == RespType::kBoolean);
+    CATCH_REQUIRE(values[3].integer == 1);
+    CATCH_REQUIRE(values[4].type == RespType::kBigNumber);
+    CATCH_REQUIRE(values[5].IsError());
+    CATCH_REQUIRE(values[5].str == "ERR oops!");
+    CATCH_REQUIRE(values[6].type == RespType::kVerbatim);
+    CATCH_REQUIRE(values[6].str == "text");
+
+    CATCH_REQUIRE(values[7].type == RespType::kMap);
+    CATCH_REQUIRE(values[7].elements.size() == 4);
+    CATCH_REQUIRE(values[7].elements[2].str == "b");
+    CATCH_REQUIRE(values[7].elements[3].integer == 2);
+
+    CATCH_REQUIRE(values[8].type == RespType::kSet);
+
+    // the attribute is dropped
+    CATCH_REQUIRE(values[9].str == "val");
+    CATCH_REQUIRE(values[10].type == RespType::kPush);
+    CATCH_REQUIRE(values[10].elements[1].str == "hi");
+  }
+}
+
+CATCH_TEST_CASE("large bulk string", "[resp]") {
+  std::string payload(1 << 20, 'x');
+  std::string data;
+  EncodeCommand({"SET", "key", payload}, &data);
+
+  RespParser parser;
+  auto values = Feed(&parser, data, 1000);
+  CATCH_REQUIRE(values.size() == 1);
+  CATCH_REQUIRE(values[0].elements.size() == 3);
+  CATCH_REQUIRE(values[0].elements[0].str == "SET");
+  CATCH_REQUIRE(values[0].elements[2].str == payload);
+}
+
+CATCH_TEST_CASE("encode", "[resp]") {
+  std::string data =
+      "*4\r\n:1\r\n$-1\r\n%1\r\n+k\r\n,1.5\r\n~2\r\n#f\r\n=5\r\ntxt:a\r\n";
+
+  RespParser parser;
+  auto values = Feed(&parser, data, data.size());
+  CATCH_REQUIRE(values.size() == 1);
+
+  std::string resp3;
+  EncodeValue(values[0], true, &resp3);
+  CATCH_REQUIRE(resp3 ==
+                "*4\r\n:1\r\n_\r\n%1\r\n+k\r\n,1.5\r\n~2\r\n#f\r\n=5\r\ntxt:a"
+                "\r\n");
+
+  std::string resp2;
+  EncodeValue(values[0], false, &resp2);
+  CATCH_REQUIRE(resp2 ==
+                "*4\r\n:1\r\n$-1\r\n*2\r\n+k\r\n$3\r\n1.5\r\n*2\r\n:0\r\n$1\r\n"
+                "a\r\n");
+}
+
+CATCH_TEST_CASE("malformed", "[resp]") {
+  CATCH_REQUIRE(!ParseAll("?\r\n"));
+  CATCH_REQUIRE(!ParseAll("\r\n"));
+  CATCH_REQUIRE(!ParseAll(":12a\r\n"));
+  CATCH_REQUIRE(!ParseAll("#x\r\n"));
+  CATCH_REQUIRE(!ParseAll("$-2\r\n"));
+  CATCH_REQUIRE(!ParseAll("$3\r\nabcd\r\n"));
+  CATCH_REQUIRE(!ParseAll("*-5\r\n"));
+  CATCH_REQUIRE(!ParseAll(std::string(100, '*') + "\r\n"));
+
+  std::string deep;
+  for (int i = 0; i < 100; ++i) {
+    deep += "*1\r\n";
+  }
+  CATCH_REQUIRE(!ParseAll(deep));
+
+  // incomplete
+  auto r = ParseAll("$5\r\nhel");
+  CATCH_REQUIRE(r);
+  CATCH_REQUIRE(!r.GetResult());
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,353 @@
+#include "resp.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <limits>
+
+namespace libz {
+namespace net {
+
+namespace {
+
+// the longest line without the bulk string
+constexpr std::size_t kMaxLine = 64 << 10;
+
+bool ParseInteger(std::string_view s, std::int64_t* value) {
+  auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), *value);
+  return ec == std::errc() && p == s.data() + s.size();
+}
+
+bool ParseDouble(std::string_view s, double* value) {
+  // from_chars doesn't accept the leading '+' and "inf"s are spelled out
+  if (s == "inf" || s == "+inf") {
+    *value = std::numeric_limits<double>::infinity();
+    return true;
+  } else if (s == "-inf") {
+    *value = -std::numeric_limits<double>::infinity();
+    return true;
+  }
+
+  auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), *value);
+  return ec == std::errc() && p == s.data() + s.size();
+}
+
+}  // namespace
+
+RespParser::RespParser(const Options& opts)
+    : opts_(opts),
+      buffer_(),
+      begin_(0),
+      end_(0),
+      expected_(0),
+      stack_(),
+      spanned_() {}
+
+std::pair<char*, std::size_t> RespParser::Prepare(std::size_t min_size) {
+  auto wanted = std::max({opts_.buffer_size, buffered() + min_size,
+                          expected_ + min_size});
+
+  if (!buffer_) {
+    buffer_ = std::make_shared<std::string>(wanted, '\0');
+  } else if (buffer_->size() - end_ < min_size) {
+    if (buffer_.use_count() == 1 && stack_.empty()) {
+      // nobody refers to the parsed bytes, compact in place
+      std::memmove(buffer_->data(), buffer_->data() + begin_, buffered());
+      if (buffer_->size() < wanted) {
+        buffer_->resize(wanted);
+      }
+    } else {
+      // only the unparsed tail is copied, the unfinished value keeps the
+      // previous buffer
+      auto buffer = std::make_shared<std::string>(wanted, '\0');
+      std::memcpy(buffer->data(), buffer_->data() + begin_, buffered());
+      if (!stack_.empty()) {
+        spanned_.push_back(std::move(buffer_));
+      }
+      buffer_ = std::move(buffer);
+    }
+
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
+  return {buffer_->data() + end_, buffer_->size() - end_};
+}
+
+void RespParser::Commit(std::size_t n) {
+  DCHECK(buffer_ && end_ + n <= buffer_->size());
+  end_ += n;
+}
+
+Result<bool> RespParser::Parse(RespValue* out) {
+  while (buffered() > 0) {
+    std::string_view in(buffer_->data() + begin_, buffered());
+    auto eol = in.find("\r\n");
+    if (eol == std::string_view::npos) {
+      if (in.size() > kMaxLine) {
+        return Err(kErrorRespMalformed, "line too long");
+      }
+      return false;
+    } else if (eol == 0) {
+      return Err(kErrorRespMalformed, "empty line");
+    }
+
+    auto kind = in[0];
+    auto line = in.substr(1, eol - 1);
+    auto consumed = eol + 2;
+
+    RespValue value;
+    std::size_t count = 0;
+    bool aggregate = false;
+
+    switch (kind) {
+      case '+':
+        value.type = RespType::kSimpleString;
+        value.str = line;
+        break;
+      case '-':
+        value.type = RespType::kError;
+        value.str = line;
+        break;
+      case ':':
+        value.type = RespType::kInteger;
+        value.str = line;
+        if (!ParseInteger(line, &value.integer)) {
+          return Err(kErrorRespMalformed, "bad integer");
+        }
+        break;
+      case ',':
+        value.type = RespType::kDouble;
+        value.str = line;
+        if (!ParseDouble(line, &value.number)) {
+          return Err(kErrorRespMalformed, "bad double");
+        }
+        break;
+      case '#':
+        if (line != "t" && line != "f") {
+          return Err(kErrorRespMalformed, "bad boolean");
+        }
+        value.type = RespType::kBoolean;
+        value.integer = line == "t";
+        break;
+      case '(':
+        value.type = RespType::kBigNumber;
+        value.str = line;
+        break;
+      case '_':
+        value.type = RespType::kNull;
+        break;
+      case '$':
+      case '!':
+      case '=': {
+        std::int64_t len = 0;
+        if (!ParseInteger(line, &len) || len < -1 ||
+            len > static_cast<std::int64_t>(opts_.max_bulk_size)) {
+          return Err(kErrorRespMalformed, "bad bulk length");
+        }
+
+        if (len == -1) {
+          value.type = RespType::kNull;
+          break;
+        }
+
+        if (in.size() < consumed + len + 2) {
+          expected_ = consumed + len + 2;
+          return false;
+        } else if (in.substr(consumed + len, 2) != "\r\n") {
+          return Err(kErrorRespMalformed, "bad bulk string");
+        }
+
+        value.str = in.substr(consumed, len);
+        consumed += len + 2;
+
+        if (kind == '$') {
+          value.type = RespType::kBulkString;
+        } else if (kind == '!') {
+          value.type = RespType::kError;
+        } else {
+          // the format, eg. "txt:", is stripped
+          if (value.str.size() < 4 || value.str[3] != ':') {
+            return Err(kErrorRespMalformed, "bad verbatim string");
+          }
+          value.type = RespType::kVerbatim;
+          value.str.remove_prefix(4);
+        }
+        break;
+      }
+      case '*':
+      case '~':
+      case '%':
+      case '>':
+      case '|': {
+        std::int64_t n = 0;
+        if (!ParseInteger(line, &n) || n < -1 ||
+            n > static_cast<std::int64_t>(opts_.max_elements)) {
+          return Err(kErrorRespMalformed, "bad aggregate length");
+        }
+
+        if (n == -1) {
+          value.type = RespType::kNull;
+          break;
+        }
+
+        value.type = kind == '*'   ? RespType::kArray
+                     : kind == '~' ? RespType::kSet
+                     : kind == '>' ? RespType::kPush
+                                   : RespType::kMap;
+        count = (kind == '%' || kind == '|') ? 2 * n : n;
+        aggregate = true;
+        break;
+      }
+      default:
+        return Err(kErrorRespMalformed, "bad type: {}", kind);
+    }
+
+    begin_ += consumed;
+    expected_ = 0;
+
+    if (count > 0) {
+      if (stack_.size() >= opts_.max_depth) {
+        return Err(kErrorRespMalformed, "too deep");
+      }
+
+      value.elements.reserve(std::min<std::size_t>(count, 1024));
+      stack_.push_back(Aggregate{std::move(value), count, kind == '|'});
+      continue;
+    } else if (aggregate && kind == '|') {
+      continue;
+    }
+
+    if (Complete(std::move(value), out)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool RespParser::Complete(RespValue&& value, RespValue* out) {
+  for (;;) {
+    if (stack_.empty()) {
+      *out = std::move(value);
+      if (spanned_.empty()) {
+        out->buffer = buffer_;
+      } else {
+        spanned_.push_back(buffer_);
+        out->buffer =
+            std::make_shared<std::vector<Buffer>>(std::move(spanned_));
+        spanned_.clear();
+      }
+      return true;
+    }
+
+    auto& top = stack_.back();
+    top.value.elements.push_back(std::move(value));
+    if (--top.remaining > 0) {
+      return false;
+    }
+
+    // the attribute is dropped, and the value it describes follows
+    auto attribute = top.attribute;
+    value = std::move(top.value);
+    stack_.pop_back();
+    if (attribute) {
+      return false;
+    }
+  }
+}
+
+void EncodeCommand(const std::string_view* args, std::size_t n,
+                   std::string* out) {
+  auto it = std::back_inserter(*out);
+  fmt::format_to(it, "*{}\r\n", n);
+  for (std::size_t i = 0; i < n; ++i) {
+    fmt::format_to(it, "${}\r\n", args[i].size());
+    out->append(args[i]);
+    out->append("\r\n");
+  }
+}
+
+void EncodeValue(const RespValue& value, bool resp3, std::string* out) {
+  auto it = std::back_inserter(*out);
+  auto bulk = [&](std::string_view s) {
+    fmt::format_to(it, "${}\r\n", s.size());
+    out->append(s);
+    out->append("\r\n");
+  };
+
+  switch (value.type) {
+    case RespType::kSimpleString:
+      fmt::format_to(it, "+{}\r\n", value.str);
+      break;
+    case RespType::kError:
+      fmt::format_to(it, "-{}\r\n", value.str);
+      break;
+    case RespType::kInteger:
+      fmt::format_to(it, ":{}\r\n", value.integer);
+      break;
+    case RespType::kBulkString:
+      bulk(value.str);
+      break;
+    case RespType::kNull:
+      out->append(resp3 ? "_\r\n" : "$-1\r\n");
+      break;
+    case RespType::kDouble:
+      if (resp3) {
+        fmt::format_to(it, ",{}\r\n", value.number);
+      } else {
+        bulk(fmt::format("{}", value.number));
+      }
+      break;
+    case RespType::kBoolean:
+      if (resp3) {
+        out->append(value.integer ? "#t\r\n" : "#f\r\n");
+      } else {
+        fmt::format_to(it, ":{}\r\n", value.integer ? 1 : 0);
+      }
+      break;
+    case RespType::kBigNumber:
+      if (resp3) {
+        fmt::format_to(it, "({}\r\n", value.str);
+      } else {
+        bulk(value.str);
+      }
+      break;
+    case RespType::kVerbatim:
+      if (resp3) {
+        fmt::format_to(it, "={}\r\ntxt:", value.str.size() + 4);
+        out->append(value.str);
+        out->append("\r\n");
+      } else {
+        bulk(value.str);
+      }
+      break;
+    case RespType::kArray:
+    case RespType::kMap:
+    case RespType::kSet:
+    case RespType::kPush: {
+      auto n = value.elements.size();
+      char kind = '*';
+      if (resp3 && value.type == RespType::kMap) {
+        kind = '%';
+        n /= 2;
+      } else if (resp3 && value.type == RespType::kSet) {
+        kind = '~';
+      } else if (resp3 && value.type == RespType::kPush) {
+        kind = '>';
+      }
+
+      fmt::format_to(it, "{}{}\r\n", kind, n);
+      for (auto& element : value.elements) {
+        EncodeValue(element, resp3, out);
+      }
+      break;
+    }
+  }
+}
+
+}  // namespace net
+}  // namespace libz
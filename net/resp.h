@@ -0,0 +1,140 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <base/result.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+// the types of RESP2 and RESP3. the blob error of RESP3 is kError, and the
+// null bulk string and array of RESP2 are kNull
+enum class RespType : std::uint8_t {
+  kSimpleString,
+  kError,
+  kInteger,
+  kBulkString,
+  kArray,
+  kNull,
+  kDouble,
+  kBoolean,
+  kBigNumber,
+  kVerbatim,
+  kMap,
+  kSet,
+  kPush,
+};
+
+// the strings are views into the receive buffer, and the top level value
+// holds the buffers alive, so that it's passed around without copying.
+//
+// Notes, the map is flattened into the elements as key, value, key, value.
+// the attributes of RESP3 are dropped
+struct RespValue {
+  RespType type{RespType::kNull};
+
+  // the strings, the errors, and the text of the numbers
+  std::string_view str;
+
+  // the integer, and the boolean
+  std::int64_t integer{0};
+  double number{0};
+
+  std::vector<RespValue> elements;
+
+  // only set on the top level value
+  std::shared_ptr<const void> buffer;
+
+  bool IsNull() const { return type == RespType::kNull; }
+  bool IsError() const { return type == RespType::kError; }
+  bool IsString() const {
+    return type == RespType::kSimpleString || type == RespType::kBulkString ||
+           type == RespType::kVerbatim;
+  }
+};
+
+// RespParser parses the values incrementally from the received bytes. the
+// bytes are received into the buffer of the parser directly, see Prepare and
+// Commit, and the parsed values refer to the buffer.
+//
+// the nested value is parsed element by element, the parsed elements are
+// kept across the reads, so that a large array isn't parsed again when more
+// bytes arrive
+class RespParser {
+ public:
+  struct Options {
+    std::size_t max_bulk_size{512 << 20};
+    std::size_t max_elements{1 << 20};
+    std::size_t max_depth{64};
+
+    // the minimum size of a receive buffer
+    std::size_t buffer_size{16 << 10};
+  };
+
+  RespParser() : RespParser(Options{}) {}
+  explicit RespParser(const Options& opts);
+
+ public:
+  // the writable space of the receive buffer, at least |min_size| bytes. the
+  // buffer is reused unless some values still refer to it, or else the
+  // unparsed tail is moved into a new buffer
+  std::pair<char*, std::size_t> Prepare(std::size_t min_size = 1);
+  void Commit(std::size_t n);
+
+  // parse the next value. it's false if more bytes are needed, or
+  // kErrorRespMalformed if the bytes are malformed
+  Result<bool> Parse(RespValue* value);
+
+  std::size_t buffered() const { return end_ - begin_; }
+  const Options& options() const { return opts_; }
+
+ private:
+  using Buffer = std::shared_ptr<std::string>;
+
+  struct Aggregate {
+    RespValue value;
+    std::size_t remaining;
+    bool attribute;
+  };
+
+  // add the parsed value into its parent, true if the top level value is done
+  bool Complete(RespValue&& value, RespValue* out);
+
+  Options opts_;
+
+  // the bytes in [begin_, end_) are received and not parsed yet
+  Buffer buffer_;
+  std::size_t begin_;
+  std::size_t end_;
+
+  // the size of the incomplete bulk string at |begin_|
+  std::size_t expected_;
+
+  // the unfinished nested values, and the previous buffers they refer to
+  std::vector<Aggregate> stack_;
+  std::vector<Buffer> spanned_;
+};
+
+// append a command as an array of bulk strings
+void EncodeCommand(const std::string_view* args, std::size_t n,
+                   std::string* out);
+
+inline void EncodeCommand(std::initializer_list<std::string_view> args,
+                          std::string* out) {
+  EncodeCommand(args.begin(), args.size(), out);
+}
+
+// append the value in RESP3, or in RESP2 without the types of RESP3
+void EncodeValue(const RespValue& value, bool resp3, std::string* out);
+
+}  // namespace net
+}  // namespace libz
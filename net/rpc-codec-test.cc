@@ -0,0 +1,166 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "rpc-codec.h"
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+// feed the bytes into the codec, |step| bytes at a time
+std::vector<RpcFrame> Feed(RpcCodec* codec, std::string_view data,
+                           std::size_t step) {
+  std::vector<RpcFrame> frames;
+  for (std::size_t i = 0; i < data.size(); i += step) {
+    auto n = std::min(step, data.size() - i);
+    auto [buf, size] = codec->Prepare(n);
+    CATCH_REQUIRE(size >= n);
+    std::memcpy(buf, data.data() + i, n);
+    codec->Commit(n);
+
+    RpcFrame frame;
+    for (;;) {
+      auto r = codec->Decode(&frame);
+      CATCH_REQUIRE(r);
+      if (!r.GetResult()) {
+        break;
+      }
+      frames.push_back(std::move(frame));
+    }
+  }
+  return frames;
+}
+
+CATCH_TEST_CASE("varint", "[rpc-codec]") {
+  for (std::uint64_t value : {0ul, 1ul, 127ul, 128ul, 300ul, 1ul << 35,
+                              ~std::uint64_t{0}}) {
+    std::string out;
+    PutVarint(value, &out);
+
+    std::uint64_t decoded = 0;
+    CATCH_REQUIRE(GetVarint(out, &decoded) == static_cast<int>(out.size()));
+    CATCH_REQUIRE(decoded == value);
+    CATCH_REQUIRE(GetVarint(std::string_view(out).substr(0, out.size() - 1),
+                            &decoded) == 0);
+  }
+
+  std::uint64_t decoded = 0;
+  CATCH_REQUIRE(GetVarint(std::string(11, '\x80'), &decoded) == -1);
+}
+
+CATCH_TEST_CASE("frames", "[rpc-codec]") {
+  for (auto prefix : {RpcCodec::Prefix::kVarint, RpcCodec::Prefix::kFixed32}) {
+    RpcCodec::Options opts;
+    opts.prefix = prefix;
+    opts.buffer_size = 64;
+
+    std::string data;
+    RpcCodec encoder(opts);
+    for (std::uint64_t i = 0; i < 100; ++i) {
+      encoder.Encode(static_cast<RpcFrameType>(i % 3), i, i * 7,
+                     std::string(i * 3, 'a' + i % 26), &data);
+    }
+
+    // the frames span the buffers in every way
+    for (std::size_t step : {1, 7, 64, 1000, 1 << 20}) {
+      RpcCodec codec(opts);
+      auto frames = Feed(&codec, data, step);
+      CATCH_REQUIRE(frames.size() == 100);
+      CATCH_REQUIRE(codec.buffered() == 0);
+
+      for (std::uint64_t i = 0; i < frames.size(); ++i) {
+        auto& frame = frames[i];
+        CATCH_REQUIRE(frame.type == static_cast<RpcFrameType>(i % 3));
+        CATCH_REQUIRE(frame.id == i);
+        CATCH_REQUIRE(frame.method == i * 7);
+        CATCH_REQUIRE(frame.payload == std::string(i * 3, 'a' + i % 26));
+
+        // the payload refers to the receive buffer
+        CATCH_REQUIRE(frame.payload.data() >= frame.buffer->data());
+        CATCH_REQUIRE(frame.payload.data() + frame.payload.size() <=
+                      frame.buffer->data() + frame.buffer->size());
+      }
+    }
+  }
+}
+
+CATCH_TEST_CASE("buffer reuse", "[rpc-codec]") {
+  RpcCodec codec;
+
+  std::string data;
+  codec.Encode(RpcFrameType::kRequest, 1, 2, "hello", &data);
+
+  auto frames = Feed(&codec, data, data.size());
+  CATCH_REQUIRE(frames.size() == 1);
+  auto buffer = frames[0].buffer;
+
+  // the tail of the buffer is used while it has space
+  frames = Feed(&codec, data, data.size());
+  CATCH_REQUIRE(frames[0].buffer == buffer);
+
+  auto within = [](const std::string* buffer, const char* p) {
+    return p >= buffer->data() && p < buffer->data() + buffer->size();
+  };
+
+  // the buffer referred to by the frames isn't overwritten
+  auto space = codec.Prepare().second;
+  auto [buf, size] = codec.Prepare(space + 1);
+  CATCH_REQUIRE(!within(buffer.get(), buf));
+  CATCH_REQUIRE(size >= space + 1);
+  CATCH_REQUIRE(frames[0].payload == "hello");
+
+  // or else it's compacted in place
+  frames.clear();
+  buffer.reset();
+  frames = Feed(&codec, data, data.size());
+  auto raw = frames[0].buffer.get();
+  frames.clear();
+
+  space = codec.Prepare().second;
+  auto reused = codec.Prepare(space + 1).first;
+  CATCH_REQUIRE(within(raw, reused));
+}
+
+CATCH_TEST_CASE("malformed", "[rpc-codec]") {
+  RpcCodec::Options opts;
+  opts.max_frame_size = 16;
+
+  auto decode = [&](const std::string& data) {
+    RpcCodec codec(opts);
+    auto [buf, size] = codec.Prepare(data.size());
+    std::memcpy(buf, data.data(), data.size());
+    codec.Commit(data.size());
+
+    RpcFrame frame;
+    return codec.Decode(&frame);
+  };
+
+  std::string data;
+  RpcCodec(opts).Encode(RpcFrameType::kRequest, 1, 2, "", &data);
+  CATCH_REQUIRE(decode(data).GetResult());
+
+  // incomplete
+  CATCH_REQUIRE(!decode(data.substr(0, 2)).GetResult());
+
+  // too large
+  data.clear();
+  RpcCodec(opts).Encode(RpcFrameType::kRequest, 1, 2, std::string(16, 'x'),
+                        &data);
+  CATCH_REQUIRE(!decode(data));
+
+  // bad type
+  CATCH_REQUIRE(!decode(std::string("\x03\x07\x01\x02", 4)));
+
+  // bad header
+  CATCH_REQUIRE(!decode(std::string("\x02\x00\x80", 3)));
+
+  // empty body
+  CATCH_REQUIRE(!decode(std::string("\x00", 1)));
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,177 @@
+#include "rpc-codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace libz {
+namespace net {
+
+namespace {
+
+constexpr int kMaxVarintBytes = 10;
+constexpr std::size_t kFixed32Bytes = 4;
+
+}  // namespace
+
+void PutVarint(std::uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+int GetVarint(std::string_view in, std::uint64_t* value) {
+  std::uint64_t result = 0;
+  for (int i = 0; i < kMaxVarintBytes; ++i) {
+    if (static_cast<std::size_t>(i) >= in.size()) {
+      return 0;
+    }
+
+    auto byte = static_cast<std::uint8_t>(in[i]);
+    result |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+    if (!(byte & 0x80)) {
+      *value = result;
+      return i + 1;
+    }
+  }
+
+  return -1;
+}
+
+RpcCodec::RpcCodec(const Options& opts)
+    : opts_(opts), buffer_(), begin_(0), end_(0), expected_(0) {}
+
+void RpcCodec::Encode(RpcFrameType type, std::uint64_t id,
+                      std::uint64_t method, std::string_view payload,
+                      std::string* out) const {
+  // the header is encoded first to learn the body length
+  char header[1 + 2 * kMaxVarintBytes];
+  std::string ids;
+  ids.reserve(2 * kMaxVarintBytes);
+  PutVarint(id, &ids);
+  PutVarint(method, &ids);
+
+  header[0] = static_cast<char>(type);
+  std::memcpy(header + 1, ids.data(), ids.size());
+  auto header_size = 1 + ids.size();
+
+  auto length = header_size + payload.size();
+  out->reserve(out->size() + kMaxVarintBytes + length);
+
+  if (opts_.prefix == Prefix::kVarint) {
+    PutVarint(length, out);
+  } else {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      out->push_back(static_cast<char>((length >> shift) & 0xff));
+    }
+  }
+
+  out->append(header, header_size);
+  out->append(payload);
+}
+
+std::pair<char*, std::size_t> RpcCodec::Prepare(std::size_t min_size) {
+  auto wanted = std::max({opts_.buffer_size, buffered() + min_size,
+                          expected_ + min_size});
+
+  if (!buffer_) {
+    buffer_ = std::make_shared<std::string>(wanted, '\0');
+  } else if (buffer_->size() - end_ < min_size) {
+    if (buffer_.use_count() == 1) {
+      // nobody refers to the decoded bytes, compact in place
+      std::memmove(buffer_->data(), buffer_->data() + begin_, buffered());
+      if (buffer_->size() < wanted) {
+        buffer_->resize(wanted);
+      }
+    } else {
+      // only the undecoded tail is copied
+      auto buffer = std::make_shared<std::string>(wanted, '\0');
+      std::memcpy(buffer->data(), buffer_->data() + begin_, buffered());
+      buffer_ = std::move(buffer);
+    }
+
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
+  return {buffer_->data() + end_, buffer_->size() - end_};
+}
+
+void RpcCodec::Commit(std::size_t n) {
+  DCHECK(buffer_ && end_ + n <= buffer_->size());
+  end_ += n;
+}
+
+int RpcCodec::DecodePrefix(std::uint64_t* length) const {
+  std::string_view in(buffer_->data() + begin_, buffered());
+  if (opts_.prefix == Prefix::kVarint) {
+    return GetVarint(in, length);
+  }
+
+  if (in.size() < kFixed32Bytes) {
+    return 0;
+  }
+
+  *length = 0;
+  for (std::size_t i = 0; i < kFixed32Bytes; ++i) {
+    *length = (*length << 8) | static_cast<std::uint8_t>(in[i]);
+  }
+  return kFixed32Bytes;
+}
+
+Result<bool> RpcCodec::Decode(RpcFrame* frame) {
+  if (buffered() == 0) {
+    return false;
+  }
+
+  std::uint64_t length = 0;
+  auto prefix = DecodePrefix(&length);
+  if (prefix < 0) {
+    return Err(kErrorRpcMalformed, "bad length prefix");
+  } else if (prefix == 0) {
+    return false;
+  }
+
+  if (length == 0 || length > opts_.max_frame_size) {
+    return Err(kErrorRpcMalformed, "bad frame size: {}", length);
+  }
+
+  if (buffered() < prefix + length) {
+    expected_ = prefix + length;
+    return false;
+  }
+
+  std::string_view body(buffer_->data() + begin_ + prefix, length);
+
+  auto type = static_cast<std::uint8_t>(body[0]);
+  if (type > static_cast<std::uint8_t>(RpcFrameType::kError)) {
+    return Err(kErrorRpcMalformed, "bad frame type: {}", type);
+  }
+  body.remove_prefix(1);
+
+  std::uint64_t id = 0;
+  std::uint64_t method = 0;
+  auto n = GetVarint(body, &id);
+  if (n > 0) {
+    body.remove_prefix(n);
+    n = GetVarint(body, &method);
+  }
+  if (n <= 0) {
+    return Err(kErrorRpcMalformed, "bad frame header");
+  }
+  body.remove_prefix(n);
+
+  frame->type = static_cast<RpcFrameType>(type);
+  frame->id = id;
+  frame->method = method;
+  frame->payload = body;
+  frame->buffer = buffer_;
+
+  begin_ += prefix + length;
+  expected_ = 0;
+  return true;
+}
+
+}  // namespace net
+}  // namespace libz
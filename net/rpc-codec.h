@@ -0,0 +1,107 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <base/result.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+// the wire format of a frame:
+//
+//   frame  := length body
+//   body   := type(u8) id(varint) method(varint) payload
+//
+// the length of the body is a varint, or a big endian u32 with kFixed32.
+// a request is answered by a response or an error with the same id, and the
+// payload of an error is the message
+enum class RpcFrameType : std::uint8_t {
+  kRequest = 0,
+  kResponse = 1,
+  kError = 2,
+};
+
+// the receive buffer shared by the decoded frames
+using RpcBuffer = std::shared_ptr<std::string>;
+
+// the payload is a view into the receive buffer, and the frame holds the
+// buffer alive, so that it can be passed around without copying
+struct RpcFrame {
+  RpcFrameType type{RpcFrameType::kRequest};
+  std::uint64_t id{0};
+  std::uint64_t method{0};
+  std::string_view payload;
+
+  RpcBuffer buffer;
+};
+
+class RpcCodec {
+ public:
+  enum class Prefix {
+    kVarint,
+    kFixed32,
+  };
+
+  struct Options {
+    Prefix prefix{Prefix::kVarint};
+
+    // the larger frames are treated as malformed
+    std::size_t max_frame_size{16 << 20};
+
+    // the minimum size of a receive buffer
+    std::size_t buffer_size{64 << 10};
+  };
+
+  RpcCodec() : RpcCodec(Options{}) {}
+  explicit RpcCodec(const Options& opts);
+
+ public:
+  // append the encoded frame to |out|
+  void Encode(RpcFrameType type, std::uint64_t id, std::uint64_t method,
+              std::string_view payload, std::string* out) const;
+
+  // the writable space of the receive buffer, at least |min_size| bytes. the
+  // buffer is reused unless some decoded frames still refer to it, or else
+  // the undecoded tail is moved into a new buffer
+  std::pair<char*, std::size_t> Prepare(std::size_t min_size = 1);
+  void Commit(std::size_t n);
+
+  // decode the next frame from the received bytes. it's false if more bytes
+  // are needed, or kErrorRpcMalformed if the frame is malformed
+  Result<bool> Decode(RpcFrame* frame);
+
+  std::size_t buffered() const { return end_ - begin_; }
+  const Options& options() const { return opts_; }
+
+ private:
+  // the body length, and the bytes of the prefix. zero if more bytes are
+  // needed, and -1 if it's malformed
+  int DecodePrefix(std::uint64_t* length) const;
+
+  Options opts_;
+
+  // the bytes in [begin_, end_) are received and not decoded yet
+  RpcBuffer buffer_;
+  std::size_t begin_;
+  std::size_t end_;
+
+  // the size of the incomplete frame at |begin_|, if its prefix is received
+  std::size_t expected_;
+};
+
+// the varint of protobuf, 7 bits per byte, the least significant group first
+void PutVarint(std::uint64_t value, std::string* out);
+
+// return the bytes consumed, zero if more bytes are needed, or -1 if it's
+// longer than 10 bytes
+int GetVarint(std::string_view in, std::uint64_t* value);
+
+}  // namespace net
+}  // namespace libz
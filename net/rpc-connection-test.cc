@@ -0,0 +1,142 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "rpc-connection.h"
+
+#include <event/io-message-loop.h>
+
+#include <asio/local/connect_pair.hpp>
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+namespace libz {
+namespace net {
+
+using Socket = asio::local::stream_protocol::socket;
+
+std::pair<std::unique_ptr<UnixRpcConnection>,
+          std::unique_ptr<UnixRpcConnection>>
+MkPair(event::MessageLoop* loop) {
+  Socket a(*loop->proactor()), b(*loop->proactor());
+  asio::local::connect_pair(a, b);
+  return {std::make_unique<UnixRpcConnection>(loop, std::move(a)),
+          std::make_unique<UnixRpcConnection>(loop, std::move(b))};
+}
+
+constexpr std::uint64_t kEcho = 1;
+constexpr std::uint64_t kFail = 2;
+
+CATCH_TEST_CASE("multiplexed calls", "[rpc-connection]") {
+  event::IOMessageLoop loop;
+  auto [client, server] = MkPair(&loop);
+
+  // the requests are answered in the reverse order
+  std::vector<RpcFrame> requests;
+  server->SetRequestHandler([&](RpcFrame&& frame) {
+    if (frame.method == kFail) {
+      server->ReplyError(frame, "failed");
+      return;
+    }
+
+    requests.push_back(std::move(frame));
+    if (requests.size() == 100) {
+      for (auto it = requests.rbegin(); it != requests.rend(); ++it) {
+        server->Reply(*it, it->payload);
+      }
+      requests.clear();
+    }
+  });
+
+  std::vector<std::string> responses(100);
+  std::size_t done = 0;
+  std::optional<Error> failed;
+
+  std::vector<event::Promise<RpcFrame>> promises;
+  loop.Post([&]() {
+    client->Start();
+    server->Start();
+
+    for (std::size_t i = 0; i < responses.size(); ++i) {
+      promises.push_back(client->Call(kEcho, std::to_string(i)));
+      promises.back().Then(
+          [&, i](Result<RpcFrame>&& r) {
+            CATCH_REQUIRE(r);
+            responses[i] = r.GetResult().payload;
+            if (++done == responses.size()) {
+              loop.Shutdown();
+            }
+          },
+          nullptr);
+    }
+
+    promises.push_back(client->Call(kFail, ""));
+    promises.back().Then(
+        [&](Result<RpcFrame>&& r) {
+          CATCH_REQUIRE(!r);
+          failed = r.PassError();
+        },
+        nullptr);
+
+    CATCH_REQUIRE(client->inflight() == 101);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(done == responses.size());
+  for (std::size_t i = 0; i < responses.size(); ++i) {
+    CATCH_REQUIRE(responses[i] == std::to_string(i));
+  }
+
+  CATCH_REQUIRE(failed);
+  CATCH_REQUIRE(failed->code() == kErrorRpcRemote);
+  CATCH_REQUIRE(client->inflight() == 0);
+
+  // the calls of one iteration are coalesced into a single write
+  CATCH_REQUIRE(client->stats().calls == 101);
+  CATCH_REQUIRE(client->stats().writes == 1);
+  CATCH_REQUIRE(server->stats().requests == 101);
+}
+
+CATCH_TEST_CASE("closed", "[rpc-connection]") {
+  event::IOMessageLoop loop;
+  auto [client, server] = MkPair(&loop);
+
+  std::optional<Error> error;
+  std::optional<event::Promise<RpcFrame>> promise;
+
+  // the server never replies, and the pending call is rejected on close
+  server->SetRequestHandler([&](RpcFrame&&) { server->Close(); });
+
+  loop.Post([&]() {
+    client->Start();
+    server->Start();
+
+    promise.emplace(client->Call(kEcho, "hello"));
+    promise->Then(
+        [&](Result<RpcFrame>&& r) {
+          CATCH_REQUIRE(!r);
+          error = r.PassError();
+          loop.Shutdown();
+        },
+        nullptr);
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(error);
+  CATCH_REQUIRE(error->code() == kErrorNetClosed);
+  CATCH_REQUIRE(!client->is_open());
+
+  auto late = client->Call(kEcho, "hello");
+  CATCH_REQUIRE(late.IsPreRejected());
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
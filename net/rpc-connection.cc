@@ -0,0 +1,256 @@
+#include "rpc-connection.h"
+
+#include <asio/post.hpp>
+#include <asio/write.hpp>
+#include <string>
+#include <unordered_map>
+
+namespace libz {
+namespace net {
+
+template <typename Socket>
+struct RpcConnection<Socket>::State
+    : public std::enable_shared_from_this<State> {
+  State(event::MessageLoop* loop, Socket&& socket, const Options& opts)
+      : loop(loop), socket(std::move(socket)), codec(opts.codec) {}
+
+  void Send(RpcFrameType type, std::uint64_t id, std::uint64_t method,
+            std::string_view payload);
+  void Flush();
+
+  void Read();
+  void Dispatch(RpcFrame&& frame);
+
+  // reject the pending calls, only the first error is kept
+  void Fail(Error&& e);
+
+  event::MessageLoop* loop;
+  Socket socket;
+  RpcCodec codec;
+  RequestHandler handler;
+
+  std::uint64_t next_id{1};
+  std::unordered_map<std::uint64_t, event::PromiseResolver<RpcFrame>> calls;
+
+  // the frames are appended to |pending| while |writing| is in flight
+  std::string pending;
+  std::string writing;
+  bool flush_scheduled{false};
+  bool write_inflight{false};
+
+  bool started{false};
+  bool closed{false};
+  Stats stats;
+};
+
+template <typename Socket>
+void RpcConnection<Socket>::State::Send(RpcFrameType type, std::uint64_t id,
+                                        std::uint64_t method,
+                                        std::string_view payload) {
+  codec.Encode(type, id, method, payload, &pending);
+
+  // the frames of this loop iteration are flushed together
+  if (!flush_scheduled && !write_inflight) {
+    flush_scheduled = true;
+    asio::post(socket.get_executor(),
+               [self = this->shared_from_this()]() {
+                 self->flush_scheduled = false;
+                 self->Flush();
+               });
+  }
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::State::Flush() {
+  if (closed || write_inflight || pending.empty()) {
+    return;
+  }
+
+  write_inflight = true;
+  writing.swap(pending);
+  ++stats.writes;
+
+  asio::async_write(
+      socket, asio::buffer(writing),
+      [self = this->shared_from_this()](const asio::error_code& ec,
+                                        std::size_t) {
+        self->write_inflight = false;
+        self->writing.clear();
+        if (ec) {
+          self->Fail(Error::MkBoostError(ec.value(), ec.message()));
+          return;
+        }
+
+        self->Flush();
+      });
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::State::Read() {
+  auto [buf, size] = codec.Prepare();
+  socket.async_read_some(
+      asio::buffer(buf, size),
+      [self = this->shared_from_this()](const asio::error_code& ec,
+                                        std::size_t n) {
+        if (ec) {
+          self->Fail(ec == asio::error::eof
+                         ? Err(kErrorNetClosed)
+                         : Error::MkBoostError(ec.value(), ec.message()));
+          return;
+        }
+
+        self->codec.Commit(n);
+        for (;;) {
+          RpcFrame frame;
+          auto r = self->codec.Decode(&frame);
+          if (!r) {
+            self->Fail(r.PassError());
+            return;
+          } else if (!r.GetResult()) {
+            break;
+          }
+
+          self->Dispatch(std::move(frame));
+          if (self->closed) {
+            return;
+          }
+        }
+
+        self->Read();
+      });
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::State::Dispatch(RpcFrame&& frame) {
+  if (frame.type == RpcFrameType::kRequest) {
+    ++stats.requests;
+    if (handler) {
+      handler(std::move(frame));
+    } else {
+      Send(RpcFrameType::kError, frame.id, frame.method, "no request handler");
+    }
+    return;
+  }
+
+  // the late response of an unknown call is dropped
+  auto it = calls.find(frame.id);
+  if (it == calls.end()) {
+    return;
+  }
+
+  auto resolver = std::move(it->second);
+  calls.erase(it);
+
+  if (frame.type == RpcFrameType::kResponse) {
+    resolver.Resolve(std::move(frame));
+  } else {
+    resolver.Reject(Err(kErrorRpcRemote, "{}", frame.payload));
+  }
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::State::Fail(Error&& e) {
+  if (closed) {
+    return;
+  }
+
+  closed = true;
+  asio::error_code ignored;
+  socket.close(ignored);
+
+  // the callbacks may issue new calls, which are rejected immediately
+  auto pending_calls = std::move(calls);
+  calls.clear();
+  for (auto& [id, resolver] : pending_calls) {
+    resolver.Reject(Error(e));
+  }
+}
+
+template <typename Socket>
+RpcConnection<Socket>::RpcConnection(event::MessageLoop* loop,
+                                     Socket&& socket, const Options& opts)
+    : state_(std::make_shared<State>(loop, std::move(socket), opts)) {}
+
+template <typename Socket>
+RpcConnection<Socket>::~RpcConnection() {
+  Close();
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::SetRequestHandler(RequestHandler&& handler) {
+  state_->handler = std::move(handler);
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::Start() {
+  if (state_->started || state_->closed) {
+    return;
+  }
+
+  state_->started = true;
+  state_->Read();
+}
+
+template <typename Socket>
+event::Promise<RpcFrame> RpcConnection<Socket>::Call(
+    std::uint64_t method, std::string_view payload) {
+  if (state_->closed) {
+    return event::MkRejectedPromise<RpcFrame>(Err(kErrorNetClosed));
+  }
+
+  auto id = state_->next_id++;
+  event::Promise<RpcFrame> promise;
+  state_->calls.emplace(id, promise.GetResolver());
+  state_->Send(RpcFrameType::kRequest, id, method, payload);
+  ++state_->stats.calls;
+
+  return promise;
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::Reply(const RpcFrame& request,
+                                  std::string_view payload) {
+  if (!state_->closed) {
+    state_->Send(RpcFrameType::kResponse, request.id, request.method, payload);
+  }
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::ReplyError(const RpcFrame& request,
+                                       std::string_view message) {
+  if (!state_->closed) {
+    state_->Send(RpcFrameType::kError, request.id, request.method, message);
+  }
+}
+
+template <typename Socket>
+void RpcConnection<Socket>::Close() {
+  state_->Fail(Err(kErrorNetClosed));
+}
+
+template <typename Socket>
+bool RpcConnection<Socket>::is_open() const {
+  return !state_->closed;
+}
+
+template <typename Socket>
+std::size_t RpcConnection<Socket>::inflight() const {
+  return state_->calls.size();
+}
+
+template <typename Socket>
+const typename RpcConnection<Socket>::Stats& RpcConnection<Socket>::stats()
+    const {
+  return state_->stats;
+}
+
+template <typename Socket>
+event::MessageLoop* RpcConnection<Socket>::loop() const {
+  return state_->loop;
+}
+
+template class RpcConnection<asio::ip::tcp::socket>;
+template class RpcConnection<asio::local::stream_protocol::socket>;
+
+}  // namespace net
+}  // namespace libz
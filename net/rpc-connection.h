@@ -0,0 +1,94 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+
+#include <asio/ip/tcp.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "basic.h"
+#include "rpc-codec.h"
+
+namespace libz {
+namespace net {
+
+// RpcConnection multiplexes the calls of both directions over one stream
+// socket. every call is assigned an id, and the promise is kept in a table
+// until the response with the same id arrives, so that many calls are in
+// flight at the same time and they may be answered out of order.
+//
+// the frames written within one loop iteration are coalesced into a single
+// write, and the received frames refer to the receive buffer without copying.
+//
+// Notes, all methods must be invoked within the loop thread. there is no
+// deadline of a call, the caller may race it with a timer. the pending calls
+// are rejected with kErrorNetClosed once the connection is closed
+template <typename Socket>
+class RpcConnection {
+ public:
+  using RequestHandler = std::function<void(RpcFrame&&)>;
+
+  struct Options {
+    RpcCodec::Options codec;
+  };
+
+  struct Stats {
+    std::uint64_t calls{0};
+    std::uint64_t requests{0};
+
+    // the writes issued to the socket, fewer than the frames if coalesced
+    std::uint64_t writes{0};
+  };
+
+  RpcConnection(event::MessageLoop* loop, Socket&& socket)
+      : RpcConnection(loop, std::move(socket), Options{}) {}
+  RpcConnection(event::MessageLoop* loop, Socket&& socket,
+                const Options& opts);
+
+  ~RpcConnection();
+
+ public:
+  // the requests of the peer are handed to the handler, which answers them
+  // by Reply or ReplyError, now or later
+  void SetRequestHandler(RequestHandler&& handler);
+
+  // start reading the socket
+  void Start();
+
+  // it's resolved with the response frame, or rejected with kErrorRpcRemote
+  // if the peer replied an error
+  event::Promise<RpcFrame> Call(std::uint64_t method,
+                                std::string_view payload);
+
+  void Reply(const RpcFrame& request, std::string_view payload);
+  void ReplyError(const RpcFrame& request, std::string_view message);
+
+  void Close();
+  bool is_open() const;
+
+  std::size_t inflight() const;
+  const Stats& stats() const;
+
+  event::MessageLoop* loop() const;
+
+ private:
+  struct State;
+  std::shared_ptr<State> state_;
+
+  DISALLOW_COPY_MOVE_AND_ASSIGN(RpcConnection);
+};
+
+using TcpRpcConnection = RpcConnection<asio::ip::tcp::socket>;
+using UnixRpcConnection = RpcConnection<asio::local::stream_protocol::socket>;
+
+extern template class RpcConnection<asio::ip::tcp::socket>;
+extern template class RpcConnection<asio::local::stream_protocol::socket>;
+
+}  // namespace net
+}  // namespace libz
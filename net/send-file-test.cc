@@ -0,0 +1,169 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "send-file.h"
+
+#include <event/io-message-loop.h>
+#include <unistd.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace libz {
+namespace net {
+
+UniqueFd MkTempFile(const std::string& content) {
+  char path[] = "/tmp/libz-send-file-XXXXXX";
+  UniqueFd fd(::mkstemp(path));
+  CATCH_REQUIRE(fd);
+  ::unlink(path);
+
+  CATCH_REQUIRE(::write(fd.get(), content.data(), content.size()) ==
+                static_cast<ssize_t>(content.size()));
+  return fd;
+}
+
+std::string MkContent(std::size_t size) {
+  std::string content(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    content[i] = 'a' + i % 26;
+  }
+  return content;
+}
+
+// read until the end of file, then shutdown the loop
+struct Drainer {
+  Drainer(event::MessageLoop* loop, UnixStreamSocket* socket)
+      : loop(loop), socket(socket), buffer(64 << 10, '\0') {}
+
+  void Start() {
+    promise.emplace(socket->Read(buffer.data(), buffer.size()));
+    promise->Then(
+        [this](Result<std::size_t>&& r) {
+          CATCH_REQUIRE(r);
+          auto n = r.PassResult();
+          if (n == 0) {
+            loop->Shutdown();
+            return;
+          }
+
+          received.append(buffer.data(), n);
+          Start();
+        },
+        loop->executor());
+  }
+
+  event::MessageLoop* loop;
+  UnixStreamSocket* socket;
+  std::string buffer;
+  std::string received;
+  std::optional<event::Promise<std::size_t>> promise;
+};
+
+CATCH_TEST_CASE("sendfile", "[send-file]") {
+  event::IOMessageLoop loop;
+
+  auto pair = UnixStreamSocket::Pair(&loop);
+  CATCH_REQUIRE(pair);
+  auto [client, server] = pair.PassResult();
+
+  // larger than the socket buffer and the step quota
+  auto content = MkContent(10 << 20);
+  auto file = MkTempFile(content);
+
+  Drainer drainer(&loop, &server);
+  std::optional<event::Promise<std::size_t>> sent;
+
+  loop.Post([&]() {
+    sent.emplace(SendFile(client.socket(), file.get(), 100, content.size()));
+    CATCH_REQUIRE(sent->IsEmpty());
+    sent->Then(
+        [&](Result<std::size_t>&& r) {
+          // short of the end of file
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult() == content.size() - 100);
+          client.Close();
+        },
+        loop.executor());
+
+    drainer.Start();
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(drainer.received == content.substr(100));
+
+  // the file offset isn't changed
+  CATCH_REQUIRE(::lseek(file.get(), 0, SEEK_CUR) ==
+                static_cast<off_t>(content.size()));
+}
+
+CATCH_TEST_CASE("splice", "[send-file]") {
+  event::IOMessageLoop loop;
+
+  auto pair = UnixStreamSocket::Pair(&loop);
+  CATCH_REQUIRE(pair);
+  auto [client, server] = pair.PassResult();
+
+  int fds[2];
+  CATCH_REQUIRE(::pipe2(fds, O_NONBLOCK) == 0);
+  UniqueFd reader(fds[0]);
+  UniqueFd writer(fds[1]);
+
+  auto content = MkContent(1 << 20);
+  std::size_t written = 0;
+
+  Drainer drainer(&loop, &server);
+  std::optional<event::Promise<std::size_t>> sent;
+
+  // feed the pipe in pieces, the transfer waits for the source in between
+  std::function<void()> feed = [&]() {
+    auto n = ::write(writer.get(), content.data() + written,
+                     std::min<std::size_t>(content.size() - written, 4096));
+    if (n > 0) {
+      written += n;
+    }
+
+    if (written < content.size()) {
+      loop.RunAfter([&](Error&&) { feed(); }, MilliSeconds(1));
+    }
+  };
+
+  loop.Post([&]() {
+    sent.emplace(SendFile(client.socket(), reader.get(), 0, content.size()));
+    sent->Then(
+        [&](Result<std::size_t>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult() == content.size());
+          client.Close();
+        },
+        loop.executor());
+
+    drainer.Start();
+    feed();
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(10));
+
+  loop.Run();
+
+  CATCH_REQUIRE(drainer.received == content);
+}
+
+CATCH_TEST_CASE("bad source", "[send-file]") {
+  event::IOMessageLoop loop;
+
+  auto pair = UnixStreamSocket::Pair(&loop);
+  CATCH_REQUIRE(pair);
+  auto [client, server] = pair.PassResult();
+
+  auto promise = SendFile(client.socket(), -1, 0, 1);
+  CATCH_REQUIRE(promise.IsPreRejected());
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
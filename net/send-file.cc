@@ -0,0 +1,135 @@
+#include "send-file.h"
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace libz {
+namespace net {
+namespace _ {
+
+namespace {
+
+bool IsWouldBlock(int err) { return err == EAGAIN || err == EWOULDBLOCK; }
+
+// the default capacity of a pipe
+constexpr std::size_t kPipeSize = 64 << 10;
+
+}  // namespace
+
+Result<std::shared_ptr<FileTransfer>> FileTransfer::Make(int out, int in,
+                                                         std::uint64_t offset,
+                                                         std::size_t len) {
+  struct stat st;
+  if (::fstat(in, &st) < 0) {
+    return Error::MkSysError(errno);
+  }
+
+  auto transfer = std::make_shared<FileTransfer>(out, in, offset, len);
+  if (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)) {
+    return transfer;
+  }
+
+  int fds[2];
+  if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+    return Error::MkSysError(errno);
+  }
+
+  transfer->spliced_ = true;
+  transfer->pipe_read_.Reset(fds[0]);
+  transfer->pipe_write_.Reset(fds[1]);
+  return transfer;
+}
+
+FileTransfer::Status FileTransfer::Step(int* err) {
+  std::size_t quota = kStepQuota;
+  return spliced_ ? Splice(&quota, err) : SendFile(&quota, err);
+}
+
+FileTransfer::Status FileTransfer::SendFile(std::size_t* quota, int* err) {
+  while (remaining_ > 0) {
+    if (*quota == 0) {
+      return kYield;
+    }
+
+    auto off = static_cast<off_t>(offset_);
+    auto n = ::sendfile(out_, in_, &off, std::min(remaining_, *quota));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (IsWouldBlock(errno)) {
+        return kWaitWrite;
+      }
+
+      *err = errno;
+      return kError;
+    } else if (n == 0) {
+      // the end of file
+      break;
+    }
+
+    offset_ += n;
+    remaining_ -= n;
+    sent_ += n;
+    *quota -= std::min<std::size_t>(n, *quota);
+  }
+
+  return kDone;
+}
+
+FileTransfer::Status FileTransfer::Splice(std::size_t* quota, int* err) {
+  while (remaining_ > 0 || piped_ > 0) {
+    if (*quota == 0) {
+      return kYield;
+    }
+
+    // fill the pipe once it's drained
+    if (piped_ == 0) {
+      auto n = ::splice(in_, nullptr, pipe_write_.get(), nullptr,
+                        std::min(remaining_, kPipeSize),
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        } else if (IsWouldBlock(errno)) {
+          return kWaitRead;
+        }
+
+        *err = errno;
+        return kError;
+      } else if (n == 0) {
+        break;
+      }
+
+      piped_ = n;
+      remaining_ -= n;
+    }
+
+    auto n = ::splice(pipe_read_.get(), nullptr, out_, nullptr, piped_,
+                      SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (IsWouldBlock(errno)) {
+        return kWaitWrite;
+      }
+
+      *err = errno;
+      return kError;
+    }
+
+    piped_ -= n;
+    sent_ += n;
+    *quota -= std::min<std::size_t>(n, *quota);
+  }
+
+  return kDone;
+}
+
+}  // namespace _
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/promise.h>
+
+#include <asio/post.hpp>
+#include <asio/posix/stream_descriptor.hpp>
+#include <cstdint>
+#include <fcntl.h>
+#include <memory>
+#include <optional>
+
+#include "basic.h"
+#include "unix-socket.h"
+
+namespace libz {
+namespace net {
+
+namespace _ {
+
+// FileTransfer moves the bytes from a file to a socket within the kernel. the
+// regular file is sent with sendfile, and the other sources, eg. pipes and
+// sockets, are spliced through a pipe.
+class FileTransfer {
+ public:
+  enum Status {
+    kDone,
+    kError,
+    kWaitWrite,
+    kWaitRead,
+
+    // the quota of one step is used up, so that a large file won't starve
+    // the others on the loop
+    kYield,
+  };
+
+  static constexpr std::size_t kStepQuota = 4 << 20;
+
+  static Result<std::shared_ptr<FileTransfer>> Make(int out, int in,
+                                                    std::uint64_t offset,
+                                                    std::size_t len);
+
+  FileTransfer(int out, int in, std::uint64_t offset, std::size_t len)
+      : out_(out), in_(in), offset_(offset), remaining_(len) {}
+
+ public:
+  Status Step(int* err);
+
+  bool spliced() const { return spliced_; }
+  std::size_t sent() const { return sent_; }
+
+  // the readiness of the non-file source
+  std::optional<asio::posix::stream_descriptor>& source() { return source_; }
+
+ private:
+  Status SendFile(std::size_t* quota, int* err);
+  Status Splice(std::size_t* quota, int* err);
+
+  int out_;
+  int in_;
+  std::uint64_t offset_;
+  std::size_t remaining_;
+  std::size_t sent_{0};
+
+  bool spliced_{false};
+  UniqueFd pipe_read_;
+  UniqueFd pipe_write_;
+  std::size_t piped_{0};
+
+  std::optional<asio::posix::stream_descriptor> source_;
+};
+
+template <typename Socket>
+void RunFileTransfer(Socket* socket, std::shared_ptr<FileTransfer> transfer,
+                     event::PromiseResolver<std::size_t> resolver) {
+  auto next = [socket, transfer,
+               resolver](const asio::error_code& ec) mutable {
+    if (ec) {
+      resolver.Reject(Error::MkBoostError(ec.value(), ec.message()));
+      return;
+    }
+
+    RunFileTransfer(socket, std::move(transfer), std::move(resolver));
+  };
+
+  int err = 0;
+  switch (transfer->Step(&err)) {
+    case FileTransfer::kDone:
+      resolver.Resolve(transfer->sent());
+      break;
+    case FileTransfer::kError:
+      resolver.Reject(Error::MkSysError(err));
+      break;
+    case FileTransfer::kWaitWrite:
+      socket->async_wait(Socket::wait_write, std::move(next));
+      break;
+    case FileTransfer::kWaitRead:
+      transfer->source()->async_wait(asio::posix::stream_descriptor::wait_read,
+                                     std::move(next));
+      break;
+    case FileTransfer::kYield:
+      asio::post(socket->get_executor(),
+                 [next = std::move(next)]() mutable { next({}); });
+      break;
+  }
+}
+
+}  // namespace _
+
+// SendFile writes |len| bytes of |fd| from |offset| to the stream socket, the
+// bytes never enter the user space. it's resolved with the bytes sent, which
+// is less than |len| if the end of file is reached first.
+//
+// the offset of a regular file isn't changed. for the other sources, eg. a
+// pipe, the offset is ignored, and they should be in non-blocking mode.
+//
+// Notes, the socket is switched to the native non-blocking mode, and both the
+// socket and |fd| must outlive the operation. like asio::async_write, the
+// next write should wait for it
+template <typename Socket>
+event::Promise<std::size_t> SendFile(Socket& socket, int fd,
+                                     std::uint64_t offset, std::size_t len) {
+  asio::error_code ec;
+  socket.native_non_blocking(true, ec);
+  if (ec) {
+    return event::MkRejectedPromise<std::size_t>(
+        Error::MkBoostError(ec.value(), ec.message()));
+  }
+
+  auto r = _::FileTransfer::Make(socket.native_handle(), fd, offset, len);
+  if (!r) {
+    return event::MkRejectedPromise<std::size_t>(r.PassError());
+  }
+
+  auto transfer = r.PassResult();
+  if (transfer->spliced()) {
+    // watch a duplicate, the descriptor is closed along with the transfer
+    auto dup = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dup < 0) {
+      return event::MkRejectedPromise<std::size_t>(Error::MkSysError(errno));
+    }
+    transfer->source().emplace(socket.get_executor(), dup);
+  }
+
+  event::Promise<std::size_t> promise;
+  _::RunFileTransfer(&socket, std::move(transfer), promise.GetResolver());
+  return promise;
+}
+
+}  // namespace net
+}  // namespace libz
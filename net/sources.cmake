@@ -0,0 +1,50 @@
+set(NET_SRC_PREFIX ${CMAKE_SOURCE_DIR}/net)
+
+set(NET_SRC
+  ${NET_SRC_PREFIX}/basic.cc
+  ${NET_SRC_PREFIX}/dns-cache.cc
+  ${NET_SRC_PREFIX}/dns-message.cc
+  ${NET_SRC_PREFIX}/dns-config.cc
+  ${NET_SRC_PREFIX}/dns-client.cc
+  ${NET_SRC_PREFIX}/resolver.cc
+  ${NET_SRC_PREFIX}/connector.cc
+  ${NET_SRC_PREFIX}/batch-udp-socket.cc
+  ${NET_SRC_PREFIX}/unix-socket.cc
+  ${NET_SRC_PREFIX}/send-file.cc
+  ${NET_SRC_PREFIX}/rpc-codec.cc
+  ${NET_SRC_PREFIX}/rpc-connection.cc
+  ${NET_SRC_PREFIX}/resp.cc
+  ${NET_SRC_PREFIX}/redis-client.cc
+)
+
+if(ENABLE_GRPC)
+  list(APPEND NET_SRC
+    ${NET_SRC_PREFIX}/grpc-bridge.cc
+    ${NET_SRC_PREFIX}/grpc-client.cc
+  )
+endif(ENABLE_GRPC)
+
+if(BUILD_TESTS)
+  set(ld_libs net event base fmt)
+
+  add_tc(NAME "${NET_SRC_PREFIX}/dns-cache-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/dns-client-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/connector-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/batch-udp-socket-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/unix-socket-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/send-file-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/rpc-codec-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/rpc-connection-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/resp-test.cc" LIBS ${ld_libs})
+  add_tc(NAME "${NET_SRC_PREFIX}/redis-client-test.cc" LIBS ${ld_libs})
+
+if (ENABLE_GRPC)
+  add_tc(NAME "${NET_SRC_PREFIX}/grpc-bridge-test.cc" LIBS ${ld_libs} gRPC::grpc++)
+  add_tc(NAME "${NET_SRC_PREFIX}/grpc-client-test.cc" LIBS ${ld_libs} gRPC::grpc++)
+  add_tc(NAME "${NET_SRC_PREFIX}/grpc-server-test.cc" LIBS ${ld_libs} gRPC::grpc++)
+if (ENABLE_CO)
+  add_tc(NAME "${NET_SRC_PREFIX}/grpc-stream-test.cc" LIBS ${ld_libs} gRPC::grpc++)
+endif(ENABLE_CO)
+endif(ENABLE_GRPC)
+
+endif(BUILD_TESTS)
@@ -0,0 +1,229 @@
+#define CATCH_CONFIG_PREFIX_ALL
+#include "unix-socket.h"
+
+#include <event/io-message-loop.h>
+#include <unistd.h>
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+namespace libz {
+namespace net {
+
+CATCH_TEST_CASE("stream", "[unix]") {
+  event::IOMessageLoop loop;
+
+  auto pair = UnixStreamSocket::Pair(&loop);
+  CATCH_REQUIRE(pair);
+  auto [client, server] = pair.PassResult();
+
+  // larger than the socket buffer, so that the write is pending
+  std::string payload(8 << 20, 'x');
+  std::string received;
+  std::string buffer(64 << 10, '\0');
+
+  std::vector<event::Promise<std::size_t>> promises;
+  std::function<void()> read = [&]() {
+    promises.push_back(server.Read(buffer.data(), buffer.size()));
+    promises.back().Then(
+        [&](Result<std::size_t>&& r) {
+          CATCH_REQUIRE(r);
+          auto n = r.PassResult();
+          if (n == 0) {
+            loop.Shutdown();
+            return;
+          }
+
+          received.append(buffer.data(), n);
+          read();
+        },
+        loop.executor());
+  };
+
+  loop.Post([&]() {
+    promises.push_back(client.Write(payload));
+    CATCH_REQUIRE(promises.back().IsEmpty());
+    promises.back().Then(
+        [&](Result<std::size_t>&& r) {
+          CATCH_REQUIRE(r);
+          CATCH_REQUIRE(r.GetResult() == payload.size());
+          client.Close();
+        },
+        loop.executor());
+
+    read();
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(received == payload);
+}
+
+CATCH_TEST_CASE("seqpacket", "[unix]") {
+  event::IOMessageLoop loop;
+
+  auto pair = UnixSeqPacketSocket::Pair(&loop);
+  CATCH_REQUIRE(pair);
+  auto [client, server] = pair.PassResult();
+
+  std::vector<std::string> received;
+  std::string buffer(16, '\0');
+  std::vector<event::Promise<std::size_t>> promises;
+
+  std::function<void()> read = [&]() {
+    promises.push_back(server.Read(buffer.data(), buffer.size()));
+    promises.back().Then(
+        [&](Result<std::size_t>&& r) {
+          if (received.size() == 3) {
+            // the larger message is truncated
+            CATCH_REQUIRE(!r);
+            CATCH_REQUIRE(r.GetError().code() == kErrorNetTruncated);
+            loop.Shutdown();
+            return;
+          }
+
+          CATCH_REQUIRE(r);
+          received.emplace_back(buffer.data(), r.GetResult());
+          read();
+        },
+        loop.executor());
+  };
+
+  loop.Post([&]() {
+    // the message boundaries are kept
+    for (auto msg : {"hello", "world", "0123456789"}) {
+      promises.push_back(client.Write(msg));
+      CATCH_REQUIRE(promises.back().IsPreFulfilled());
+    }
+    promises.push_back(client.Write(std::string(32, 'x')));
+
+    read();
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(received ==
+                std::vector<std::string>{"hello", "world", "0123456789"});
+}
+
+CATCH_TEST_CASE("fd passing", "[unix]") {
+  event::IOMessageLoop loop;
+
+  auto pair = UnixSeqPacketSocket::Pair(&loop);
+  CATCH_REQUIRE(pair);
+  auto [client, server] = pair.PassResult();
+
+  int fds[2];
+  CATCH_REQUIRE(::pipe(fds) == 0);
+  UniqueFd reader(fds[0]);
+  UniqueFd writer(fds[1]);
+
+  std::optional<event::Promise<std::size_t>> sent;
+  std::optional<event::Promise<UnixMessage>> received;
+  std::string piped;
+
+  loop.Post([&]() {
+    // the receive is pending before the fds are sent
+    received.emplace(server.ReceiveFds(64));
+    received->Then(
+        [&](Result<UnixMessage>&& r) {
+          CATCH_REQUIRE(r);
+          auto msg = r.PassResult();
+          CATCH_REQUIRE(msg.data == "pipe");
+          CATCH_REQUIRE(msg.fds.size() == 1);
+
+          // write through the received end of the pipe
+          CATCH_REQUIRE(::write(msg.fds[0].get(), "ping", 4) == 4);
+          piped.resize(4);
+          CATCH_REQUIRE(::read(reader.get(), piped.data(), 4) == 4);
+
+          loop.Shutdown();
+        },
+        loop.executor());
+
+    sent.emplace(client.SendFds("pipe", {writer.get()}));
+    CATCH_REQUIRE(sent->IsPreFulfilled());
+
+    // the peer has its own duplicate
+    writer.Reset();
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(piped == "ping");
+  CATCH_REQUIRE(client.SendFds("", {reader.get()}).IsPreRejected());
+}
+
+CATCH_TEST_CASE("acceptor", "[unix]") {
+  event::IOMessageLoop loop;
+
+  auto path = fmt::format("/tmp/libz-unix-test-{}.sock", ::getpid());
+  UnixStreamAcceptor acceptor(&loop);
+  CATCH_REQUIRE(!acceptor.Listen(path));
+  CATCH_REQUIRE(::access(path.c_str(), F_OK) == 0);
+
+  // no file for the abstract namespace
+  UnixStreamAcceptor abstract(&loop);
+  CATCH_REQUIRE(!abstract.Listen("@" + path + ".abstract"));
+  CATCH_REQUIRE(::access((path + ".abstract").c_str(), F_OK) != 0);
+
+  std::optional<event::Promise<UnixStreamSocket>> accepted;
+  std::optional<event::Promise<UnixStreamSocket>> connected;
+  std::optional<UnixStreamSocket> server;
+  std::optional<UnixStreamSocket> client;
+
+  std::string buffer(16, '\0');
+  std::optional<event::Promise<std::size_t>> read;
+
+  loop.Post([&]() {
+    accepted.emplace(acceptor.Accept());
+    accepted->Then(
+        [&](Result<UnixStreamSocket>&& r) {
+          CATCH_REQUIRE(r);
+          server.emplace(r.PassResult());
+
+          read.emplace(server->Read(buffer.data(), buffer.size()));
+          read->Then(
+              [&](Result<std::size_t>&& r) {
+                CATCH_REQUIRE(r);
+                buffer.resize(r.GetResult());
+                loop.Shutdown();
+              },
+              loop.executor());
+        },
+        loop.executor());
+
+    connected.emplace(UnixStreamSocket::Connect(&loop, path));
+    connected->Then(
+        [&](Result<UnixStreamSocket>&& r) {
+          CATCH_REQUIRE(r);
+          client.emplace(r.PassResult());
+          CATCH_REQUIRE(client->Write("hello").IsPreFulfilled());
+        },
+        loop.executor());
+  });
+
+  auto guard = loop.AddTimerEvent([&](Error&&) { loop.Shutdown(); },
+                                  Seconds(5));
+
+  loop.Run();
+
+  CATCH_REQUIRE(buffer == "hello");
+
+  acceptor.Close();
+  CATCH_REQUIRE(::access(path.c_str(), F_OK) != 0);
+}
+
+}  // namespace net
+}  // namespace libz
+
+int main(int argc, char* argv[]) { return Catch::Session().run(argc, argv); }
@@ -0,0 +1,479 @@
+#include "unix-socket.h"
+
+#include <asio/local/connect_pair.hpp>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace libz {
+namespace net {
+
+namespace {
+
+union ControlBuffer {
+  char data[CMSG_SPACE(sizeof(int) * kMaxUnixFds)];
+  cmsghdr align;
+};
+
+bool IsAbstract(std::string_view path) {
+  return !path.empty() && path[0] == '@';
+}
+
+// the name of the abstract namespace starts with '\0'
+std::string ToSocketPath(std::string_view path) {
+  std::string result(path);
+  if (IsAbstract(path)) {
+    result[0] = '\0';
+  }
+  return result;
+}
+
+bool IsWouldBlock(int err) { return err == EAGAIN || err == EWOULDBLOCK; }
+
+Error ToError(const asio::error_code& ec) {
+  return Error::MkBoostError(ec.value(), ec.message());
+}
+
+// the message is truncated, see RecvMsg
+Error ToReceiveError(int err) {
+  return err == EMSGSIZE ? Err(kErrorNetTruncated) : Error::MkSysError(err);
+}
+
+// return the bytes sent, or -errno
+ssize_t SendMsg(int fd, std::string_view data, const int* fds,
+                std::size_t nfds) {
+  iovec iov{const_cast<char*>(data.data()), data.size()};
+
+  msghdr hdr{};
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+
+  ControlBuffer control;
+  if (nfds > 0) {
+    hdr.msg_control = control.data;
+    hdr.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+    auto cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+  }
+
+  for (;;) {
+    auto n = ::sendmsg(fd, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return n < 0 ? -errno : n;
+  }
+}
+
+// return the bytes received, or -errno. the fds are collected if |fds| isn't
+// null, and -EMSGSIZE is returned if the data or fds are truncated
+ssize_t RecvMsg(int fd, char* buf, std::size_t size,
+                std::vector<UniqueFd>* fds) {
+  iovec iov{buf, size};
+
+  msghdr hdr{};
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+
+  ControlBuffer control;
+  if (fds) {
+    hdr.msg_control = control.data;
+    hdr.msg_controllen = sizeof(control.data);
+  }
+
+  ssize_t n;
+  do {
+    n = ::recvmsg(fd, &hdr, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0) {
+    return -errno;
+  }
+
+  if (fds) {
+    for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+         cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        continue;
+      }
+
+      auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (std::size_t i = 0; i < count; ++i) {
+        int received;
+        std::memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int),
+                    sizeof(int));
+        fds->emplace_back(received);
+      }
+    }
+  }
+
+  // the received fds are closed along with |fds|
+  if ((hdr.msg_flags & MSG_TRUNC) || (fds && (hdr.msg_flags & MSG_CTRUNC))) {
+    return -EMSGSIZE;
+  }
+
+  return n;
+}
+
+// wait for the readiness, then invoke |f| until it returns true, that is, the
+// operation is done. the error of waiting is passed to |f| as well
+template <typename Socket, typename F>
+void RunWhenReady(std::shared_ptr<Socket> socket,
+                  asio::socket_base::wait_type wait, F&& f) {
+  auto ptr = socket.get();
+  ptr->async_wait(wait, [socket = std::move(socket), wait,
+                         f = std::move(f)](const asio::error_code& ec) mutable {
+    if (!f(ec, *socket)) {
+      RunWhenReady(std::move(socket), wait, std::move(f));
+    }
+  });
+}
+
+template <typename Socket>
+event::Promise<std::size_t> DoSend(const std::shared_ptr<Socket>& socket,
+                                   bool stream, std::string_view data,
+                                   const std::vector<int>& fds) {
+  auto n = SendMsg(socket->native_handle(), data, fds.data(), fds.size());
+  if (n < 0 && !IsWouldBlock(-n)) {
+    return event::MkRejectedPromise<std::size_t>(Error::MkSysError(-n));
+  }
+
+  std::size_t sent = n < 0 ? 0 : n;
+  if (n >= 0 && (!stream || sent == data.size())) {
+    return event::MkResolvedPromise(sent);
+  }
+
+  // the fds go with the first byte, they are pending only if nothing is sent.
+  // and they are duplicated, since the caller may close them at any time
+  std::vector<UniqueFd> pending_fds;
+  if (sent == 0) {
+    for (auto fd : fds) {
+      UniqueFd dup(::fcntl(fd, F_DUPFD_CLOEXEC, 0));
+      if (!dup) {
+        auto err = Error::MkSysError(errno);
+        return event::MkRejectedPromise<std::size_t>(std::move(err));
+      }
+      pending_fds.push_back(std::move(dup));
+    }
+  }
+
+  event::Promise<std::size_t> promise;
+  RunWhenReady(
+      socket, asio::socket_base::wait_write,
+      [stream, sent, buffer = std::string(data.substr(sent)), offset = std::size_t{0},
+       pending_fds = std::move(pending_fds),
+       resolver = promise.GetResolver()](const asio::error_code& ec,
+                                         Socket& socket) mutable {
+        if (ec) {
+          resolver.Reject(ToError(ec));
+          return true;
+        }
+
+        std::vector<int> fds;
+        for (const auto& fd : pending_fds) {
+          fds.push_back(fd.get());
+        }
+
+        auto rest = std::string_view(buffer).substr(offset);
+        auto n = SendMsg(socket.native_handle(), rest, fds.data(), fds.size());
+        if (n < 0 && IsWouldBlock(-n)) {
+          return false;
+        } else if (n < 0) {
+          resolver.Reject(Error::MkSysError(-n));
+          return true;
+        }
+
+        pending_fds.clear();
+        sent += n;
+        offset += n;
+        if (!stream || offset == buffer.size()) {
+          resolver.Resolve(sent);
+          return true;
+        }
+
+        return false;
+      });
+
+  return promise;
+}
+
+template <typename Socket>
+event::Promise<std::size_t> DoRead(const std::shared_ptr<Socket>& socket,
+                                   char* buf, std::size_t size) {
+  auto n = RecvMsg(socket->native_handle(), buf, size, nullptr);
+  if (n >= 0) {
+    return event::MkResolvedPromise(static_cast<std::size_t>(n));
+  } else if (!IsWouldBlock(-n)) {
+    return event::MkRejectedPromise<std::size_t>(ToReceiveError(-n));
+  }
+
+  event::Promise<std::size_t> promise;
+  RunWhenReady(socket, asio::socket_base::wait_read,
+               [buf, size, resolver = promise.GetResolver()](
+                   const asio::error_code& ec, Socket& socket) mutable {
+                 if (ec) {
+                   resolver.Reject(ToError(ec));
+                   return true;
+                 }
+
+                 auto n = RecvMsg(socket.native_handle(), buf, size, nullptr);
+                 if (n < 0 && IsWouldBlock(-n)) {
+                   return false;
+                 } else if (n < 0) {
+                   resolver.Reject(ToReceiveError(-n));
+                 } else {
+                   resolver.Resolve(static_cast<std::size_t>(n));
+                 }
+                 return true;
+               });
+
+  return promise;
+}
+
+// return true if it's done, the message is resolved or rejected
+bool ReceiveMessage(int fd, std::size_t max_size,
+                    event::PromiseResolver<UnixMessage>& resolver) {
+  UnixMessage msg;
+  msg.data.resize(max_size);
+
+  auto n = RecvMsg(fd, msg.data.data(), msg.data.size(), &msg.fds);
+  if (n < 0 && IsWouldBlock(-n)) {
+    return false;
+  } else if (n < 0) {
+    resolver.Reject(ToReceiveError(-n));
+    return true;
+  }
+
+  msg.data.resize(n);
+  resolver.Resolve(std::move(msg));
+  return true;
+}
+
+}  // namespace
+
+void UniqueFd::Reset(int fd) {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  fd_ = fd;
+}
+
+template <typename Protocol>
+UnixSocket<Protocol>::UnixSocket(event::MessageLoop* loop)
+    : loop_(loop), socket_(std::make_shared<Socket>(*loop->proactor())) {}
+
+template <typename Protocol>
+UnixSocket<Protocol>::UnixSocket(event::MessageLoop* loop, Socket&& socket)
+    : loop_(loop), socket_(std::make_shared<Socket>(std::move(socket))) {}
+
+template <typename Protocol>
+UnixSocket<Protocol>& UnixSocket<Protocol>::operator=(UnixSocket&& other) {
+  if (this != &other) {
+    Close();
+    loop_ = other.loop_;
+    socket_ = std::move(other.socket_);
+  }
+  return *this;
+}
+
+template <typename Protocol>
+UnixSocket<Protocol>::~UnixSocket() {
+  Close();
+}
+
+template <typename Protocol>
+Result<std::pair<UnixSocket<Protocol>, UnixSocket<Protocol>>>
+UnixSocket<Protocol>::Pair(event::MessageLoop* loop) {
+  UnixSocket first(loop);
+  UnixSocket second(loop);
+
+  asio::error_code ec;
+  asio::local::connect_pair(*first.socket_, *second.socket_, ec);
+  if (ec) {
+    return ToError(ec);
+  }
+
+  return std::make_pair(std::move(first), std::move(second));
+}
+
+template <typename Protocol>
+event::Promise<UnixSocket<Protocol>> UnixSocket<Protocol>::Connect(
+    event::MessageLoop* loop, std::string_view path) {
+  event::Promise<UnixSocket> promise;
+
+  auto socket = std::make_shared<Socket>(*loop->proactor());
+  socket->async_connect(
+      Endpoint(ToSocketPath(path)),
+      [loop, socket, resolver = promise.GetResolver()](
+          const asio::error_code& ec) mutable {
+        if (ec) {
+          resolver.Reject(ToError(ec));
+          return;
+        }
+
+        resolver.Resolve(UnixSocket(loop, std::move(*socket)));
+      });
+
+  return promise;
+}
+
+template <typename Protocol>
+event::Promise<std::size_t> UnixSocket<Protocol>::Read(char* buf,
+                                                       std::size_t size) {
+  if (!is_open()) {
+    return event::MkRejectedPromise<std::size_t>(Error::MkSysError(EBADF));
+  }
+
+  return DoRead(socket_, buf, size);
+}
+
+template <typename Protocol>
+event::Promise<std::size_t> UnixSocket<Protocol>::Write(
+    std::string_view data) {
+  return SendFds(data, {});
+}
+
+template <typename Protocol>
+event::Promise<std::size_t> UnixSocket<Protocol>::SendFds(
+    std::string_view data, const std::vector<int>& fds) {
+  if (!is_open()) {
+    return event::MkRejectedPromise<std::size_t>(Error::MkSysError(EBADF));
+  }
+
+  if (fds.size() > kMaxUnixFds || (data.empty() && !fds.empty())) {
+    return event::MkRejectedPromise<std::size_t>(Error::MkSysError(EINVAL));
+  }
+
+  auto stream = Protocol().type() == SOCK_STREAM;
+  return DoSend(socket_, stream, data, fds);
+}
+
+template <typename Protocol>
+event::Promise<UnixMessage> UnixSocket<Protocol>::ReceiveFds(
+    std::size_t max_size) {
+  if (!is_open()) {
+    return event::MkRejectedPromise<UnixMessage>(Error::MkSysError(EBADF));
+  }
+
+  event::Promise<UnixMessage> promise;
+  auto resolver = promise.GetResolver();
+  if (ReceiveMessage(socket_->native_handle(), max_size, resolver)) {
+    return promise;
+  }
+
+  RunWhenReady(socket_, asio::socket_base::wait_read,
+               [max_size, resolver](const asio::error_code& ec,
+                                    Socket& socket) mutable {
+                 if (ec) {
+                   resolver.Reject(ToError(ec));
+                   return true;
+                 }
+
+                 return ReceiveMessage(socket.native_handle(), max_size,
+                                       resolver);
+               });
+
+  return promise;
+}
+
+template <typename Protocol>
+void UnixSocket<Protocol>::Close() {
+  if (socket_) {
+    asio::error_code ec;
+    socket_->close(ec);
+  }
+}
+
+template <typename Protocol>
+bool UnixSocket<Protocol>::is_open() const {
+  return socket_ && socket_->is_open();
+}
+
+template <typename Protocol>
+UnixAcceptor<Protocol>::UnixAcceptor(event::MessageLoop* loop)
+    : loop_(loop), acceptor_(*loop->proactor()), path_() {}
+
+template <typename Protocol>
+UnixAcceptor<Protocol>::~UnixAcceptor() {
+  Close();
+}
+
+template <typename Protocol>
+Error UnixAcceptor<Protocol>::Listen(std::string_view path, int backlog) {
+  auto socket_path = ToSocketPath(path);
+
+  // remove the socket file left by the previous process
+  struct stat st;
+  if (!IsAbstract(path) && ::stat(socket_path.c_str(), &st) == 0 &&
+      S_ISSOCK(st.st_mode)) {
+    ::unlink(socket_path.c_str());
+  }
+
+  asio::error_code ec;
+  acceptor_.open(Protocol(), ec);
+  if (!ec) {
+    acceptor_.bind(typename Protocol::endpoint(socket_path), ec);
+  }
+  if (!ec) {
+    acceptor_.listen(backlog, ec);
+  }
+
+  if (ec) {
+    acceptor_.close(ec);
+    return ToError(ec);
+  }
+
+  path_ = std::string(path);
+  return {};
+}
+
+template <typename Protocol>
+event::Promise<UnixSocket<Protocol>> UnixAcceptor<Protocol>::Accept(
+    event::MessageLoop* loop) {
+  if (loop == nullptr) {
+    loop = loop_;
+  }
+
+  event::Promise<UnixSocket<Protocol>> promise;
+
+  auto socket = std::make_shared<typename Protocol::socket>(*loop->proactor());
+  acceptor_.async_accept(
+      *socket, [loop, socket, resolver = promise.GetResolver()](
+                   const asio::error_code& ec) mutable {
+        if (ec) {
+          resolver.Reject(ToError(ec));
+          return;
+        }
+
+        resolver.Resolve(UnixSocket<Protocol>(loop, std::move(*socket)));
+      });
+
+  return promise;
+}
+
+template <typename Protocol>
+void UnixAcceptor<Protocol>::Close() {
+  asio::error_code ec;
+  acceptor_.close(ec);
+
+  if (!path_.empty() && !IsAbstract(path_)) {
+    ::unlink(path_.c_str());
+  }
+  path_.clear();
+}
+
+template class UnixSocket<asio::local::stream_protocol>;
+template class UnixSocket<asio::local::seq_packet_protocol>;
+template class UnixAcceptor<asio::local::stream_protocol>;
+template class UnixAcceptor<asio::local::seq_packet_protocol>;
+
+}  // namespace net
+}  // namespace libz
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <base/common.h>
+#include <base/error.h>
+#include <event/message-loop.h>
+#include <event/promise.h>
+
+#include <asio/local/seq_packet_protocol.hpp>
+#include <asio/local/stream_protocol.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "basic.h"
+
+namespace libz {
+namespace net {
+
+// UniqueFd owns a file descriptor, and closes it on destruction
+class UniqueFd {
+ public:
+  UniqueFd() : fd_(-1) {}
+  explicit UniqueFd(int fd) : fd_(fd) {}
+  ~UniqueFd() { Reset(); }
+
+  UniqueFd(UniqueFd&& other) : fd_(other.Release()) {}
+  UniqueFd& operator=(UniqueFd&& other) {
+    if (this != &other) {
+      Reset(other.Release());
+    }
+    return *this;
+  }
+
+ public:
+  int get() const { return fd_; }
+  explicit operator bool() const { return fd_ >= 0; }
+
+  // give up the ownership without closing it
+  int Release() { return std::exchange(fd_, -1); }
+  void Reset(int fd = -1);
+
+ private:
+  int fd_;
+
+  DISALLOW_COPY_AND_ASSIGN(UniqueFd);
+};
+
+// the fds within one message, the kernel caps it at 253
+constexpr std::size_t kMaxUnixFds = 64;
+
+// a message with the file descriptors attached by the peer
+struct UnixMessage {
+  std::string data;
+  std::vector<UniqueFd> fds;
+};
+
+// UnixSocket is a unix domain socket with the promise based io, the same as
+// what the tcp sockets do with the coroutines. both the stream and seqpacket
+// protocols are supported, the latter keeps the message boundaries.
+//
+// the file descriptors can be passed to the peer with SCM_RIGHTS, eg. an
+// acceptor process hands the accepted connections to the worker processes
+// without proxying the bytes.
+//
+// the path with a leading '@' is in the linux abstract namespace.
+//
+// Notes, the socket is bound to a message loop, and all methods must be
+// invoked within the loop thread. the buffers of the pending read are owned
+// by the caller, and must outlive it
+template <typename Protocol>
+class UnixSocket {
+ public:
+  using Socket = typename Protocol::socket;
+  using Endpoint = typename Protocol::endpoint;
+
+  explicit UnixSocket(event::MessageLoop* loop);
+  UnixSocket(event::MessageLoop* loop, Socket&& socket);
+
+  UnixSocket(UnixSocket&&) = default;
+  UnixSocket& operator=(UnixSocket&& other);
+
+  // the pending operations are rejected
+  ~UnixSocket();
+
+ public:
+  // a pair of the connected sockets, eg. for the forked worker
+  static Result<std::pair<UnixSocket, UnixSocket>> Pair(
+      event::MessageLoop* loop);
+
+  static event::Promise<UnixSocket> Connect(event::MessageLoop* loop,
+                                            std::string_view path);
+
+  // read some bytes, or a message of seqpacket. zero means the end of file
+  event::Promise<std::size_t> Read(char* buf, std::size_t size);
+
+  // the data is sent in place, and only copied if the socket buffer is full.
+  // the stream socket sends all the bytes, and seqpacket sends one message.
+  // like asio::async_write, the next write should wait for the previous one
+  event::Promise<std::size_t> Write(std::string_view data);
+
+  // send the data with the fds attached, the data must not be empty. the fds
+  // are duplicated into the peer, and the caller still owns them
+  event::Promise<std::size_t> SendFds(std::string_view data,
+                                      const std::vector<int>& fds);
+
+  // receive up to |max_size| bytes with the attached fds. the received fds
+  // are close-on-exec. it's rejected with kErrorNetTruncated if the fds were
+  // more than kMaxUnixFds, or the seqpacket message was larger than |max_size|
+  event::Promise<UnixMessage> ReceiveFds(std::size_t max_size);
+
+  void Close();
+  bool is_open() const;
+
+  Socket& socket() { return *socket_; }
+  event::MessageLoop* loop() const { return loop_; }
+
+ private:
+  event::MessageLoop* loop_;
+
+  // shared with the pending operations
+  std::shared_ptr<Socket> socket_;
+
+  DISALLOW_COPY_AND_ASSIGN(UnixSocket);
+};
+
+// UnixAcceptor listens on a path, and the accepted sockets can be bound to
+// other loops.
+//
+// Notes, the stale socket file of the path is removed before listening, and
+// the file is removed again on close
+template <typename Protocol>
+class UnixAcceptor {
+ public:
+  using Acceptor = typename Protocol::acceptor;
+
+  explicit UnixAcceptor(event::MessageLoop* loop);
+  ~UnixAcceptor();
+
+ public:
+  Error Listen(std::string_view path,
+               int backlog = asio::socket_base::max_listen_connections);
+
+  // the accepted socket is bound to |loop|, or the loop of the acceptor
+  event::Promise<UnixSocket<Protocol>> Accept(
+      event::MessageLoop* loop = nullptr);
+
+  void Close();
+
+  const std::string& path() const { return path_; }
+  Acceptor& acceptor() { return acceptor_; }
+
+ private:
+  event::MessageLoop* loop_;
+  Acceptor acceptor_;
+  std::string path_;
+
+  DISALLOW_COPY_AND_ASSIGN(UnixAcceptor);
+};
+
+using UnixStreamSocket = UnixSocket<asio::local::stream_protocol>;
+using UnixSeqPacketSocket = UnixSocket<asio::local::seq_packet_protocol>;
+
+using UnixStreamAcceptor = UnixAcceptor<asio::local::stream_protocol>;
+using UnixSeqPacketAcceptor = UnixAcceptor<asio::local::seq_packet_protocol>;
+
+extern template class UnixSocket<asio::local::stream_protocol>;
+extern template class UnixSocket<asio::local::seq_packet_protocol>;
+extern template class UnixAcceptor<asio::local::stream_protocol>;
+extern template class UnixAcceptor<asio::local::seq_packet_protocol>;
+
+}  // namespace net
+}  // namespace libz